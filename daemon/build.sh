@@ -1,8 +1,9 @@
 (return 0 2>/dev/null) || { echo "Script must be sourced"; exit 1; }
 
-# Generate Version.h from git commit count
+# Generate Version.h from git commit count. Only rewritten when the version
+# changes, so a rebuild of the same commit doesn't recompile its includers.
 VERSION=$(git rev-list --count HEAD 2>/dev/null || echo "0")
-cat > include/Version.h << EOF
+cat > include/Version.h.new << EOF
 #ifndef VERSION_H
 #define VERSION_H
 
@@ -12,8 +13,23 @@ cat > include/Version.h << EOF
 
 #endif // VERSION_H
 EOF
+if cmp -s include/Version.h.new include/Version.h; then
+    rm -f include/Version.h.new
+else
+    mv include/Version.h.new include/Version.h
+fi
 echo "Version: ${VERSION}"
 
+# BUILD_ONLY=1: compile, install nothing (remoteDeployDaemon builds the
+# artifact it hands to peers this way)
+if [ -n "$BUILD_ONLY" ]; then
+    [ -d "build" ] || { mkdir -p build && chmod g+s build; }
+    echo "Building..."
+    (cd build && cmake .. > /dev/null && make -j"$(nproc)" > /dev/null) || return 1
+    echo "Build complete: build/daemon"
+    return 0
+fi
+
 # Ensure socket directory exists with correct permissions
 if [ ! -d "/run/automatelinux" ]; then
     echo "Creating /run/automatelinux..."
@@ -26,19 +42,26 @@ else
     sudo /usr/bin/chown $USER:$USER /run/automatelinux
 fi
 
-if [ ! -d "build" ]; then
-    mkdir -p build
-    chmod g+s build
-fi
+# PREBUILT=<path>: install a binary fetched from the peer that built it
+if [ -n "$PREBUILT" ]; then
+    echo "Installing prebuilt $(basename "$PREBUILT")..."
+    sudo cp "$PREBUILT" daemon && \
+    sudo chown root:coding daemon || return 1
+else
+    if [ ! -d "build" ]; then
+        mkdir -p build
+        chmod g+s build
+    fi
 
-echo "Building..."
-cd build
-cmake .. > /dev/null && \
-make > /dev/null && \
-echo -e "${GREEN}Build complete!${NC}" && \
-sudo cp daemon .. && \
-sudo chown root:coding ../daemon && \
-cd ..
+    echo "Building..."
+    cd build
+    cmake .. > /dev/null && \
+    make -j"$(nproc)" > /dev/null && \
+    echo -e "${GREEN}Build complete!${NC}" && \
+    sudo cp daemon .. && \
+    sudo chown root:coding ../daemon && \
+    cd ..
+fi
 
 # Install man page
 if [ -f "doc/daemon.1" ]; then
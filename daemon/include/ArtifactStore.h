@@ -0,0 +1,48 @@
+#ifndef ARTIFACT_STORE_H
+#define ARTIFACT_STORE_H
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+class ReplyStream;
+
+// Content-addressed daemon binaries under data/artifacts/, named by their
+// SHA-256, plus a manifest mapping the commit they were built from to the
+// hash. remoteDeployDaemon builds once per commit on the deploying daemon;
+// targets fetch the binary from it over the peer port in chunks, resume a
+// cut transfer from the partial file and verify the hash before use.
+struct Artifact {
+  std::string sha256;
+  uint64_t size = 0;
+  std::string commit;
+  std::string arch; // uname -m of the builder
+  std::string path;
+};
+
+class ArtifactStore {
+public:
+  using Progress = std::function<void(const std::string &line)>;
+
+  static std::string directory();
+  static std::string pathFor(const std::string &sha256);
+  static bool isValidHash(const std::string &sha256);
+  static std::string hostArch();
+
+  // Artifact for the checkout's HEAD, building it first unless the manifest
+  // has one. Builds are serialized; concurrent deploys share one.
+  static bool ensureForHead(Artifact &artifact, std::string &error,
+                            const Progress &progress);
+  static std::vector<Artifact> list();
+
+  // Stream the blob from offset as output frames (serveArtifact)
+  static int serve(const std::string &sha256, uint64_t offset,
+                   ReplyStream &out);
+  // Download from the daemon at sourceIp:port into the store
+  static bool fetch(const std::string &sourceIp, int port,
+                    const std::string &sha256, uint64_t size,
+                    std::string &error, const Progress &progress);
+};
+
+#endif // ARTIFACT_STORE_H
@@ -0,0 +1,44 @@
+#ifndef CHROME_TABS_H
+#define CHROME_TABS_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// One DevTools target of type "page"
+struct ChromeTab {
+  std::string id;
+  std::string title;
+  std::string url;
+  uint64_t touched = 0; // Higher: created or updated more recently
+};
+
+// Live map of Chrome's tabs. A thread keeps a DevTools-protocol websocket open
+// to the browser target on localhost:DEVTOOLS_PORT and applies the
+// Target.targetCreated/InfoChanged/Destroyed events it subscribed to, so
+// resolving the focused tab's URL is a lookup instead of a GET of /json.
+// Reconnects with backoff while Chrome runs without remote debugging.
+class ChromeTabs {
+public:
+  static const int DEVTOOLS_PORT = 9222;
+
+  static void start(int port = DEVTOOLS_PORT);
+  static void stop();
+  static bool isConnected();
+  static int port(); // The one start() was given, for the /json fallback
+
+  // URL of the tab behind a Chrome window title. False while the map isn't
+  // live, so callers can fall back to /json.
+  static bool urlFor(const std::string &windowTitle, std::string &url);
+
+  // The tab list rule shared with the /json fallback: a tab whose title
+  // contains or is contained in windowTitle, else the most recently touched
+  // non-chrome:// page, else any page
+  static std::string choose(const std::vector<ChromeTab> &tabs,
+                            const std::string &windowTitle);
+
+  // Skipped when choosing: extension pages and DevTools
+  static bool isUserPage(const std::string &url);
+};
+
+#endif // CHROME_TABS_H
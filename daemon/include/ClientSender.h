@@ -4,6 +4,8 @@
 #include "using.h"
 
 int send_command_to_daemon(const ordered_json &jsonCmd);
+// One-way commands over the notify socket; returns without waiting
+int send_notification_to_daemon(const ordered_json &jsonCmd);
 ordered_json parse_client_args(int argc, char *argv[], int start_index);
 
 #endif // CLIENT_SENDER_H
@@ -3,6 +3,10 @@
 
 #define OUTPUT_FILE "/opt/automateLinux/daemon/output.txt"
 #define SOCKET_PATH "/run/automatelinux/automatelinux-daemon.sock"
+// One-way notifications (datagrams, no reply), see NotifyChannel
+#define NOTIFY_SOCKET_PATH "/run/automatelinux/automatelinux-daemon-notify.sock"
+#define NOTIFY_QUEUE_MAX 1024
+#define NOTIFY_BATCH_PER_LOOP 64
 #define DIR_HISTORY_POINTER_PREFIX "pointerDevPts"
 #define INDEX_OF_LAST_TOUCHED_DIR_KEY "indexOfLastTouchedDir"
 #define TTY_KEY "tty"
@@ -19,6 +23,7 @@
 #define COMMAND_UPDATE_DIR_HISTORY "updateDirHistory"
 #define COMMAND_CD_FORWARD "cdForward"
 #define COMMAND_CD_BACKWARD "cdBackward"
+#define COMMAND_CD_JUMP "cdJump"
 #define COMMAND_SHELL_SIGNAL "shellSignal"
 #define COMMAND_SHOW_TERMINAL_INSTANCE "showTerminalInstance"
 #define COMMAND_SHOW_ALL_TERMINAL_INSTANCES "showAllTerminalInstances"
@@ -35,9 +40,14 @@
 #define COMMAND_ARG_PREFIX "prefix"
 #define COMMAND_ARG_VALUE "value"
 #define COMMAND_ARG_SIGNAL "signal"
+#define COMMAND_ARG_QUERY "query"
+#define COMMAND_ARG_STREAM "stream"
 #define COMMAND_PING "ping"
 #define COMMAND_VERSION "version"
 #define COMMAND_QUIT "quit"
+#define COMMAND_STARTUP_TRACE "startupTrace"
+#define COMMAND_NOTIFY_STATS "notifyStats"
+#define COMMAND_SERVICE_STATS "serviceStats"
 #define COMMAND_GET_PORT "getPort"
 #define COMMAND_SET_PORT "setPort"
 #define COMMAND_GET_KEYBOARD_PATH "getKeyboardPath"
@@ -54,12 +64,11 @@
 #define GOOGLE_CHROME_KEYBOARD "google-chrome"
 #define DEFAULT_KEYBOARD "DefaultKeyboard"
 #define TEST_KEYBOARD "TestKeyboard"
-#define KEYBOARD_DISCOVERY_CMD                                                 \
-  "ls /dev/input/by-id/ | grep 'Corsair.*-event-kbd'"
+#define KEYBOARD_DISCOVERY_PATTERN "Corsair.*-event-kbd"
 #define KEYBOARD_INPUT_PATH "/dev/input/by-id/"
-#define MOUSE_DISCOVERY_CMD                                                    \
-  "awk '/Logitech/ && /Mouse/ {found=1} found && /Handlers/ {if (match($0, "   \
-  "/event[0-9]+/, a)) {print a[0]; exit}}' /proc/bus/input/devices"
+#define MOUSE_DISCOVERY_VENDOR "Logitech"
+#define MOUSE_DISCOVERY_PRODUCT "Mouse"
+#define INPUT_DEVICES_FILE "/proc/bus/input/devices"
 #define MOUSE_INPUT_PATH "/dev/input/"
 #define KEYBOARD_PATH_KEY "keyboardPath"
 #define MOUSE_PATH_KEY "mousePath"
@@ -81,6 +90,8 @@
 #define COMMAND_GET_MACROS "getMacros"
 #define COMMAND_UPDATE_MACROS "updateMacros"
 #define COMMAND_GET_ACTIVE_CONTEXT "getActiveContext"
+#define COMMAND_GET_WINDOW_RULES "getWindowRules"
+#define COMMAND_SET_WINDOW_RULES "setWindowRules"
 #define COMMAND_GET_EVENT_FILTERS "getEventFilters"
 #define COMMAND_SET_EVENT_FILTERS "setEventFilters"
 #define COMMAND_REGISTER_LOG_LISTENER "registerLogListener"
@@ -117,6 +128,7 @@
 #define COMMAND_DEPLOY_TO_PROD "deployToProd"
 #define COMMAND_PROD_STATUS "prodStatus"
 #define COMMAND_CLEAN_PROD "cleanProd"
+#define COMMAND_ROLLBACK_PROD "rollbackProd"
 #define COMMAND_GET_APP_PEERS "getAppPeers"
 #define COMMAND_INSTALL_APP_ON_PEER "installAppOnPeer"
 #define COMMAND_UNINSTALL_APP_ON_PEER "uninstallAppOnPeer"
@@ -155,21 +167,37 @@
 #define COMMAND_DELETE_PEER "deletePeer"
 #define COMMAND_GET_PEER_INFO "getPeerInfo"
 #define COMMAND_EXEC_ON_PEER "execOnPeer"
+#define COMMAND_EXEC_ON_PEERS "execOnPeers"
 #define COMMAND_EXEC_REQUEST "execRequest"
 #define COMMAND_REMOTE_PULL "remotePull"
 #define COMMAND_REMOTE_BD "remoteBd"
 #define COMMAND_REMOTE_DEPLOY_DAEMON "remoteDeployDaemon"
+#define COMMAND_FETCH_ARTIFACT "fetchArtifact"
+#define COMMAND_SERVE_ARTIFACT "serveArtifact" // Peer port, streams chunks
+#define COMMAND_LIST_ARTIFACTS "listArtifacts"
 #define COMMAND_DB_SANITY_CHECK "dbSanityCheck"
 #define COMMAND_REGISTER_WORKER "registerWorker"
 #define COMMAND_UPDATE_PEER_MAC "updatePeerMac"
+#define COMMAND_REPLICA_SYNC "replicaSync"       // Worker -> leader
+#define COMMAND_REPLICA_CHANGES "replicaChanges" // Leader -> workers, no reply
 
 // Peer Arguments
 #define COMMAND_ARG_ROLE "role"
 #define COMMAND_ARG_LEADER "leader"
 #define COMMAND_ARG_ID "id"
 #define COMMAND_ARG_PEER "peer"
+#define COMMAND_ARG_PEERS "peers"       // Comma separated ids, or "all"
+#define COMMAND_ARG_TIMEOUT "timeout"   // Seconds
 #define COMMAND_ARG_DIRECTORY "directory"
 #define COMMAND_ARG_SHELL_CMD "shellCmd"
+#define COMMAND_ARG_SHA256 "sha256"
+#define COMMAND_ARG_SOURCE "source" // IP of the daemon serving an artifact
+#define COMMAND_ARG_SOURCE_PORT "sourcePort" // Its peer port, default 3502
+#define COMMAND_ARG_SIZE "size"
+#define COMMAND_ARG_OFFSET "offset"
+#define COMMAND_ARG_FROM_PEER "fromPeer" // Set by the worker forwarding
+#define EXEC_ON_PEERS_TIMEOUT_SECS 90
+#define EXEC_ON_PEERS_MAX_OUTPUT (256 * 1024) // Per peer, rest is dropped
 
 // Peer Roles
 #define PEER_ROLE_LEADER "leader"
@@ -177,6 +205,9 @@
 
 // Peer Networking Constants
 #define PEER_TCP_PORT 3502
+// Workers answer reads from their replica this long after it was last
+// confirmed current; past that they forward to the leader
+#define REPLICA_MAX_STALENESS_SECS 300
 
 // WireGuard Setup Commands
 #define COMMAND_SETUP_WIREGUARD_PEER "setupWireGuardPeer"
@@ -1,8 +1,10 @@
 #ifndef DATABASE_TABLE_MANAGERS_H
 #define DATABASE_TABLE_MANAGERS_H
 
-#include "MySQLManager.h"
+#include "StorageBackend.h"
+#include <filesystem>
 #include <map>
+#include <nlohmann/json.hpp>
 #include <string>
 #include <vector>
 
@@ -19,7 +21,6 @@ public:
   static std::vector<std::pair<int, int>> getAllSessions();
   static int getMaxHistoryIndex();
   static int getHistoryCount();
-  static void pruneHistory(int maxSize);
 };
 
 class ConfigTable {
@@ -27,18 +28,21 @@ public:
   // For macros and filters
   static void setConfig(const std::string &key, const std::string &jsonValue);
   static std::string getConfig(const std::string &key);
+  static nlohmann::json getConfigJson(const std::string &key); // null if absent
 };
 
 class DeviceTable {
 public:
   static void setDevicePath(const std::string &type, const std::string &path);
   static std::string getDevicePath(const std::string &type);
+  static std::filesystem::path getPath(const std::string &type);
 };
 
 class SettingsTable {
 public:
   static void setSetting(const std::string &key, const std::string &value);
   static std::string getSetting(const std::string &key);
+  static int getSettingInt(const std::string &key, int defaultValue);
   static int deleteSetting(const std::string &key);
   static std::vector<std::pair<std::string, std::string>> getAllSettings();
 };
@@ -52,6 +56,9 @@ struct PeerRecord {
   std::string last_seen;
   bool is_online;
   int daemon_version = 0;
+  // Failure detector output; only set when served from PeerRegistry
+  bool is_suspect = false;
+  double phi = 0.0;
 };
 
 class PeerTable {
@@ -67,6 +74,9 @@ public:
   static void deletePeer(const std::string &peer_id);
   static std::string getIpAddress(const std::string &peer_id);
   static int clearAllPeers();  // Returns count of deleted rows
+  // Write last_seen, is_online and daemon_version in one transaction
+  // (PeerRegistry's periodic persist)
+  static void saveLiveness(const std::vector<PeerRecord> &peers);
 };
 
 // Extra app record structure for installed applications
@@ -94,4 +104,20 @@ public:
   static bool appExists(const std::string &app_id);
 };
 
+// Owner of a registered port (port_<port_key> in system_settings): the app
+// it belongs to and the peer that took it
+struct PortLeaseRecord {
+  std::string port_key;
+  std::string app_id;
+  std::string peer_id;
+  std::string leased_at;
+};
+
+class PortLeaseTable {
+public:
+  static void upsertLease(const PortLeaseRecord &lease);
+  static void deleteLease(const std::string &port_key);
+  static std::vector<PortLeaseRecord> getAllLeases();
+};
+
 #endif // DATABASE_TABLE_MANAGERS_H
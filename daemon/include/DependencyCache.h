@@ -0,0 +1,34 @@
+#ifndef DEPENDENCY_CACHE_H
+#define DEPENDENCY_CACHE_H
+
+#include <string>
+
+// node_modules trees under data/npm-cache/, keyed by a hash of
+// package-lock.json, package.json and the node binary. A directory whose
+// lockfile is unchanged since its last install isn't installed again; one
+// whose lockfile matches a cached tree gets a copy of it (reflinked where the
+// filesystem supports it, hardlinked otherwise) instead of an npm install, so
+// dev and prod worktrees and apps with the same lockfile share one tree.
+// Directories without a lockfile are installed by npm as before.
+struct DependencyInstall {
+  bool ok = false;
+  // "unchanged", "reflinked", "hardlinked" or "copied" (from the cache),
+  // "installed" (npm ran)
+  std::string how;
+  double seconds = 0;      // Time this install took
+  double savedSeconds = 0; // The tree's recorded npm time, less seconds
+  std::string output;      // npm's output when it ran
+};
+
+class DependencyCache {
+public:
+  static std::string directory();
+
+  // npm install in dir, through the cache
+  static DependencyInstall install(const std::string &dir);
+
+  // "npm install: OK (...)" line for a result
+  static std::string describe(const DependencyInstall &install);
+};
+
+#endif // DEPENDENCY_CACHE_H
@@ -0,0 +1,34 @@
+#ifndef DIR_HISTORY_H
+#define DIR_HISTORY_H
+
+#include <string>
+#include <utility>
+#include <vector>
+
+// Global directory history shared by all terminals, held in memory. Entries
+// get monotonically increasing sequence numbers and live in a ring buffer of
+// MAX_DIR_HISTORY_SIZE slots; each tty has a cursor (a sequence number).
+// Lookups, appends and cursor moves are O(1) and never touch storage:
+// appends, trims and cursor moves are persisted through WriteBehindQueue, and
+// sequence numbers are stored as-is, so rows are never renumbered.
+class DirHistory {
+public:
+  static void load(); // From terminal_history / terminal_sessions at startup
+
+  static bool get(int seq, std::string &path);
+  static int append(const std::string &path); // Returns the new sequence
+  static int firstSeq(); // Oldest retained entry
+  static int nextSeq();  // One past the newest; equal to firstSeq() if empty
+  static std::vector<std::pair<int, std::string>> entries();
+  static void clear(); // Sequence numbers keep counting up
+
+  // -1 if the tty has no cursor; clamped to the oldest retained entry
+  static int cursor(int tty);
+  static void setCursor(int tty, int seq);
+  static void dropCursor(int tty);
+
+  static int lastTouched(); // -1 if never set
+  static void setLastTouched(int seq);
+};
+
+#endif // DIR_HISTORY_H
@@ -0,0 +1,27 @@
+#ifndef DIR_JUMP_INDEX_H
+#define DIR_JUMP_INDEX_H
+
+#include <string>
+
+// Search index over the distinct paths in DirHistory, used by cdJump.
+// Query terms of 3+ characters are looked up through a trigram index, shorter
+// ones through a prefix index on the last path component. Matches are ranked
+// by frecency: visits in the history ring, weighted by how recently the path
+// was last visited. A path found missing is cached as such for a few seconds
+// or until inotify on its parent says otherwise; the match returned is always
+// stat'ed again.
+// Paths leave the index when their last visit is evicted from the ring.
+class DirJumpIndex {
+public:
+  static void addVisit(const std::string &path, int seq);
+  static void removeVisit(const std::string &path); // Evicted from the ring
+  static void clear();
+
+  // Best existing match whose path contains every whitespace-separated term
+  // of query (case-insensitive), skipping exclude; empty if none
+  static std::string query(const std::string &query,
+                           const std::string &exclude = "");
+  static std::string getStats();
+};
+
+#endif // DIR_JUMP_INDEX_H
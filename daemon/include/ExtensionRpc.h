@@ -0,0 +1,37 @@
+#ifndef EXTENSION_RPC_H
+#define EXTENSION_RPC_H
+
+#include <nlohmann/json.hpp>
+#include <string>
+
+// Request/response over the connections the GNOME window extension and the
+// Chrome native host keep open to the daemon. Each request carries a
+// requestId the extension echoes in its reply; the event loop reads replies
+// along with the rest of the client traffic and hands them to the waiting
+// caller. A slow or dead extension costs the caller its timeout instead of
+// stalling the loop, and replies are whole lines of any size. A reply without
+// a requestId (older extension builds) completes the oldest request on its
+// connection.
+class ExtensionRpc {
+public:
+  enum class Channel { Window, Chrome };
+
+  static void attach(Channel channel, int fd);
+  // Before the connection is closed: fails its calls, and returns only once
+  // no write to fd is in progress
+  static void detach(int fd);
+  static bool isAttached(Channel channel);
+
+  // Send request and wait for the reply's payload: its "result", or the
+  // reply less requestId. Never call it on the event loop thread.
+  static bool call(Channel channel, nlohmann::json request, int timeoutMs,
+                   std::string &reply, std::string &error);
+  // One-way message
+  static bool notify(Channel channel, const nlohmann::json &message);
+
+  // Event loop: a line read from fd. True when it was a reply (anything but
+  // a command, on an extension's connection) and has been consumed.
+  static bool onLine(int fd, const std::string &line);
+};
+
+#endif // EXTENSION_RPC_H
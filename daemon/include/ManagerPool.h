@@ -0,0 +1,24 @@
+#ifndef MANAGER_POOL_H
+#define MANAGER_POOL_H
+
+#include <cstddef>
+#include <string>
+
+// Keep-alive connections to the per-peer manager service (MANAGER_PORT),
+// pooled by peer IP so multi-step flows (install, then start) reuse one
+// WireGuard connection. A connection goes back to the pool only after a
+// complete reply whose end frame offered keep-alive; idle ones are closed
+// after IDLE_SECS, before the manager's own idle timeout would. acquire()
+// health-checks a pooled connection and skips it if the manager closed it.
+class ManagerPool {
+public:
+  static constexpr int IDLE_SECS = 60;
+  static constexpr size_t MAX_IDLE_PER_PEER = 2;
+
+  // -1 on failure with error set; reused tells whether it came from the pool
+  static int acquire(const std::string &ip, bool &reused, std::string &error);
+  static void release(const std::string &ip, int fd);
+  static void discard(int fd);
+};
+
+#endif // MANAGER_POOL_H
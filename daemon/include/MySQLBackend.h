@@ -0,0 +1,17 @@
+#ifndef MYSQL_BACKEND_H
+#define MYSQL_BACKEND_H
+
+#include "StorageBackend.h"
+
+// StorageBackend over the spawned mysqld and MySQLManager's connection pool
+class MySQLBackend : public StorageBackend {
+public:
+  std::string name() const override { return "mysql"; }
+  bool start() override;
+  void stop() override;
+  std::unique_ptr<StorageConnection> connect() override;
+  std::string getStats() override;
+  long engineRssKb() override;
+};
+
+#endif // MYSQL_BACKEND_H
@@ -6,14 +6,52 @@
 #include <cppconn/prepared_statement.h>
 #include <cppconn/resultset.h>
 #include <cppconn/statement.h>
+#include <chrono>
+#include <map>
+#include <memory>
 #include <mysql_connection.h>
 #include <string>
+#include <vector>
 
 class MySQLManager {
+private:
+  struct PoolEntry;
+
 public:
-  static void initializeAndStartMySQL();
+  // Borrowed pool connection; returned to the pool when it goes out of scope.
+  class PooledConnection {
+  public:
+    PooledConnection();
+    PooledConnection(PooledConnection &&other) noexcept;
+    PooledConnection &operator=(PooledConnection &&other) noexcept;
+    PooledConnection(const PooledConnection &) = delete;
+    PooledConnection &operator=(const PooledConnection &) = delete;
+    ~PooledConnection();
+
+    explicit operator bool() const { return entry != nullptr; }
+    sql::Connection *operator->() const;
+    sql::Connection *get() const;
+
+    // Statement cached on this connection, parameters cleared. Owned by the
+    // pool - do not delete.
+    sql::PreparedStatement *prepare(const std::string &query);
+
+  private:
+    friend class MySQLManager;
+    PooledConnection(std::unique_ptr<PoolEntry> entry,
+                     std::chrono::steady_clock::time_point acquiredAt);
+    void release();
+
+    std::unique_ptr<PoolEntry> entry;
+    std::chrono::steady_clock::time_point acquiredAt;
+  };
+
+  static bool initializeAndStartMySQL();
   static void stopMySQL();
+  static pid_t getServerPid() { return mysqlPid; }
   static sql::Connection *getConnection();
+  static PooledConnection acquireConnection(int timeoutMs = 2000);
+  static std::string getPoolStats();
   static void dropTable(const std::string &tableName);
   static void emptyTable(const std::string &tableName);
 
@@ -27,9 +65,12 @@ private:
                                      const std::string &configFile);
   static void startMySQLServer(const std::string &mysqldPath,
                                const std::string &configFile);
-  static void createDatabaseAndUser(int port, const std::string &socketPath);
+  static bool createDatabaseAndUser(int port, const std::string &socketPath);
   static bool isServerRunning(const std::string &socketPath);
-
+  static void releaseToPool(std::unique_ptr<PoolEntry> entry,
+                            std::chrono::steady_clock::time_point acquiredAt);
+  static bool ensureHealthy(PoolEntry &entry);
+  static void closePool();
 
   static pid_t mysqlPid;
   static std::string mysqlSocket;
@@ -37,6 +78,7 @@ private:
   static std::string mysqlUser;
   static std::string mysqlPassword;
   static std::string mysqlDatabase;
+  static std::vector<std::unique_ptr<PoolEntry>> idlePool;
 };
 
 #endif // MYSQLMANAGER_H
@@ -0,0 +1,37 @@
+#ifndef NOTIFY_CHANNEL_H
+#define NOTIFY_CHANNEL_H
+
+#include <nlohmann/json.hpp>
+#include <string>
+
+// Fire-and-forget endpoint for shell hooks (updateDirHistory, openedTty,
+// closedTty, shellSignal). Senders write one JSON command per datagram to
+// NOTIFY_SOCKET_PATH and never wait for a reply. A receiver thread moves
+// datagrams into a bounded queue; the daemon loop runs them after the stream
+// clients, NOTIFY_BATCH_PER_LOOP at a time, so a burst never delays a reply.
+// The exception is a shell's own notifications, which run before its next
+// stream command (flushFor).
+class NotifyChannel {
+public:
+  static bool isOneWay(const std::string &command);
+
+  // Daemon side. fd() is readable when notifications were queued; call
+  // receive() to clear it, then process() from the daemon loop thread.
+  static int open(); // Returns fd(), -1 on failure
+  static int fd();
+  static void close();
+  static void receive();
+  static bool hasPending();
+  static void process(size_t budget);
+  // Before a stream command from a shell runs: apply that tty's queued
+  // notifications now, so cdForward after a prompt's updateDirHistory sees
+  // the new cursor
+  static void flushFor(const nlohmann::json &tty);
+  static std::string getStats();
+
+  // Client side, never blocks. Returns 0 or the errno of the failed send
+  // (EAGAIN: the daemon's receive buffer is full and the datagram is lost).
+  static int send(const std::string &json);
+};
+
+#endif // NOTIFY_CHANNEL_H
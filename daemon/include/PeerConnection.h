@@ -0,0 +1,48 @@
+#ifndef PEER_CONNECTION_H
+#define PEER_CONNECTION_H
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+
+// A TCP connection between peers, shared by every thread that writes to it
+// (the main loop, slow-command threads, replication pushes, PeerManager).
+// The fd is closed only when the last holder lets go, so its number can't be
+// reused by another client under a writer, and send() writes each message
+// whole under the connection's own lock so frames never interleave.
+class PeerConnection {
+public:
+  // Takes ownership of fd
+  static std::shared_ptr<PeerConnection> adopt(int fd);
+  // The open connection on fd, null when there is none
+  static std::shared_ptr<PeerConnection> find(int fd);
+
+  ~PeerConnection();
+  PeerConnection(const PeerConnection &) = delete;
+  PeerConnection &operator=(const PeerConnection &) = delete;
+
+  int fd() const { return m_fd; }
+  bool isOpen() const { return m_open; }
+
+  // Write all of data. timeoutMs < 0 blocks (up to the socket's SO_SNDTIMEO);
+  // otherwise gives up after timeoutMs without progress. A partial write
+  // leaves the peer's reader out of sync, so it also shuts the connection.
+  bool send(const std::string &data, int timeoutMs = -1);
+  // Stop all I/O without taking the write lock: a blocked writer fails, later
+  // sends fail, and the reader sees EOF
+  void shutdown();
+  // Hand the fd over to code that closes it itself; waits for a write in
+  // progress, then later sends fail and the destructor leaves the fd alone
+  void release();
+
+private:
+  explicit PeerConnection(int fd);
+
+  const int m_fd;
+  std::atomic<bool> m_open{true};
+  bool m_owned = true; // Guarded by m_writeMutex
+  std::mutex m_writeMutex;
+};
+
+#endif // PEER_CONNECTION_H
@@ -1,23 +1,38 @@
 #ifndef PEER_MANAGER_H
 #define PEER_MANAGER_H
 
+#include "PeerConnection.h"
 #include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <future>
 #include <map>
+#include <memory>
 #include <mutex>
 #include <nlohmann/json.hpp>
+#include <stdexcept>
 #include <string>
 #include <thread>
+#include <vector>
 
 using json = nlohmann::json;
 using ordered_json = nlohmann::ordered_json;
 
+// Raised through the future of a leader request that timed out or whose
+// connection dropped before the reply arrived
+class LeaderRpcError : public std::runtime_error {
+public:
+  using std::runtime_error::runtime_error;
+};
+
 struct PeerInfo {
   std::string peer_id;
   std::string ip_address;
   std::string mac_address;
   std::string hostname;
-  bool is_online;
-  int socket_fd;  // -1 if not connected
+  bool is_online = false;
+  std::shared_ptr<PeerConnection> connection; // Null if not connected
 };
 
 class PeerManager {
@@ -37,25 +52,49 @@ public:
   bool connectToLeader();
   void disconnectFromLeader();
   bool isConnectedToLeader() const;
-  int getLeaderSocket() const;
   bool connectToPeer(const std::string &peer_id, const std::string &ip);
 
   // Reconnection loop (for workers)
   void startReconnectLoop();
   void stopReconnectLoop();
 
+  // Wake the reconnect loop to push app status now instead of at the next
+  // heartbeat (workers)
+  void notifyAppStatusChanged();
+  // Wake it to resync the leader replica (a push arrived out of order)
+  void requestReplicaSync();
+
   // Peer tracking (for leader)
   void registerPeer(const std::string &peer_id, const std::string &ip,
                     const std::string &mac, const std::string &hostname,
-                    int socket_fd);
+                    std::shared_ptr<PeerConnection> connection);
   void unregisterPeer(const std::string &peer_id);
+  // The connection closed: forget the peer registered on it, if any
+  void dropConnection(const std::shared_ptr<PeerConnection> &connection);
   void updatePeerStatus(const std::string &peer_id, bool online);
   std::vector<PeerInfo> listPeers() const;
   PeerInfo getPeerInfo(const std::string &peer_id) const;
 
   // Messaging
-  bool sendToLeader(const json &message);
+  bool sendToLeader(const json &message); // One-way, no reply expected
+
+  // Correlated requests to the leader. Each request carries a request_id and
+  // the leader answers with a {"reply_to","status","length"} header line
+  // followed by exactly length bytes. A reader thread owns the socket,
+  // completes the matching future and queues anything else (commands the
+  // leader pushes) for the main loop. Any number of requests can be in
+  // flight; each fails with LeaderRpcError after its own timeout.
+  std::future<std::string> requestLeader(const json &command,
+                                         int timeoutMs = 2000);
+  // Blocking wrapper, empty string on timeout or disconnect
   std::string forwardToLeader(const json &command, int timeoutMs = 2000);
+
+  // Commands pushed by the leader. The fd is readable while some are queued;
+  // replies go back raw through replyToLeader().
+  int getLeaderInboxFd() const;
+  std::vector<json> takeLeaderCommands();
+  bool replyToLeader(const std::string &reply);
+
   bool sendToPeer(const std::string &peer_id, const json &message);
   void broadcastToWorkers(const json &message);
 
@@ -64,24 +103,57 @@ public:
   void saveConfig();
 
 private:
-  PeerManager() = default;
+  PeerManager();
   PeerManager(const PeerManager &) = delete;
   PeerManager &operator=(const PeerManager &) = delete;
 
   std::string m_role = "";       // "leader" or "worker"
   std::string m_peerId = "";     // This peer's identifier
   std::string m_leaderAddress = "";
-  int m_leaderSocket = -1;
-  bool m_connectedToLeader = false;
+  int m_leaderSocket = -1;  // Closed by the reader thread when it exits
+  std::atomic<bool> m_connectedToLeader{false};
 
   std::map<std::string, PeerInfo> m_peers;  // For leader: tracks all workers
   mutable std::mutex m_peersMutex;
-  std::mutex m_leaderCommMutex;  // Protects leader socket read/write sequences
+  std::mutex m_leaderWriteMutex;   // Guards m_leaderSocket and whole writes
+  std::mutex m_leaderConnectMutex; // Serializes connect/disconnect
+
+  // Leader connection reader and request demultiplexing
+  struct PendingRequest {
+    std::promise<std::string> reply;
+    std::chrono::steady_clock::time_point deadline;
+  };
+  std::thread m_leaderReader;
+  std::map<uint64_t, PendingRequest> m_pendingRequests;
+  uint64_t m_nextRequestId = 1;
+  std::vector<json> m_leaderInbox;
+  std::mutex m_pendingMutex; // Guards m_pendingRequests and m_leaderInbox
+  int m_leaderInboxFd = -1;  // eventfd
+
+  void leaderReaderLoop(int fd);
+  bool writeToLeader(const std::string &data);
+  void shutdownLeaderLocked();
+  void joinLeaderReader();
+  void failRequest(uint64_t id, const std::string &reason);
+  void failAllRequests(const std::string &reason);
+  int expireRequests(int maxWaitMs); // Returns ms until the next deadline
 
   // Reconnection loop
   std::thread m_reconnectThread;
   std::atomic<bool> m_reconnectRunning{false};
   void reconnectLoop();
+
+  // App status pushed to the leader (workers). Each push is versioned and
+  // sent as a JSON Patch against the last version the leader acknowledged.
+  enum class StatusPush { Unchanged, Acked, Failed };
+  StatusPush pushAppStatus();
+  std::mutex m_appStatusMutex;
+  std::condition_variable m_appStatusWake;
+  bool m_appStatusDirty = false;
+  bool m_replicaSyncDue = false; // Also guarded by m_appStatusMutex
+  json m_ackedAppStatus;
+  uint64_t m_ackedAppStatusVersion = 0; // 0: leader holds nothing usable
+  uint64_t m_appStatusVersion = 0;
 };
 
 #endif // PEER_MANAGER_H
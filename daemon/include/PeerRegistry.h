@@ -0,0 +1,37 @@
+#ifndef PEER_REGISTRY_H
+#define PEER_REGISTRY_H
+
+#include "DatabaseTableManagers.h"
+#include <string>
+#include <vector>
+
+// In-memory copy of peer_registry and the source of truth once loaded.
+// PeerTable serves reads from it and routes heartbeats and online changes
+// to it, so the heartbeat path never touches the database; a background
+// thread writes last_seen, is_online and daemon_version of changed peers in
+// one transaction per interval and at stop().
+//
+// Liveness comes from a phi-accrual failure detector over each peer's
+// heartbeat inter-arrival times: phi grows the longer a heartbeat is overdue
+// relative to that peer's own history. A peer is suspect above SUSPECT_PHI
+// and offline above OFFLINE_PHI or once its connection closed.
+class PeerRegistry {
+public:
+  static bool start(int persistIntervalMs = 30000); // Loads the table
+  static void stop(); // Stops the persist thread and writes what changed
+  static bool isLoaded();
+
+  static void put(const PeerRecord &peer); // Registration; counts as heartbeat
+  static void heartbeat(const std::string &peer_id, int daemon_version = -1);
+  static void setOnline(const std::string &peer_id, bool online);
+  static void erase(const std::string &peer_id);
+  static void clear();
+
+  // is_online, is_suspect, phi and last_seen are computed at read time
+  static bool get(const std::string &peer_id, PeerRecord &peer);
+  static std::vector<PeerRecord> getAll(); // Ordered by peer_id
+
+  static void persist();
+};
+
+#endif // PEER_REGISTRY_H
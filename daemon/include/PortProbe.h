@@ -0,0 +1,25 @@
+#ifndef PORT_PROBE_H
+#define PORT_PROBE_H
+
+#include <sys/types.h>
+#include <vector>
+
+// TCP socket state for a local port, read from the kernel over netlink
+// sock_diag instead of forking ss and fuser. Every query returns false when
+// the kernel can't be asked (no sock_diag support, netlink refused) so
+// callers can fall back to the tools.
+class PortProbe {
+public:
+  // Anything listening on port, IPv4 or IPv6. One netlink round trip.
+  static bool isListening(int port, bool &listening);
+
+  // The process owning the listener, 0 when nothing listens or the owner
+  // can't be seen. Walks /proc/*/fd, so keep it off polling paths.
+  static bool listenerPid(int port, pid_t &pid);
+
+  // Every process holding a TCP socket bound to port, in any state (what
+  // fuser PORT/tcp reports). The calling process is left out.
+  static bool socketOwners(int port, std::vector<pid_t> &pids);
+};
+
+#endif // PORT_PROBE_H
@@ -0,0 +1,54 @@
+#ifndef PORT_REGISTRY_H
+#define PORT_REGISTRY_H
+
+#include <string>
+#include <vector>
+
+// One registered port and its lease (owner fields empty when unleased)
+struct PortEntry {
+  std::string key; // port_<key> in system_settings
+  int port = 0;
+  std::string app_id;
+  std::string peer_id;
+  std::string leased_at;
+};
+
+// In-memory registry of the app port ranges. Port numbers stay in
+// system_settings as port_<key> rows, where getPort, the worker replicas and
+// the tools read them; port_leases records which app and peer own each key.
+// A bitmap of the taken ports in 3000-3999 makes allocation a scan of a few
+// words instead of a parse of every setting. The registry follows the
+// settings cache, so setPort and deletePort keep it current; it isn't loaded
+// without the cache and callers fall back to scanning the settings.
+class PortRegistry {
+public:
+  static const int RANGE_START = 3000;        // App prod/dev pairs
+  static const int SERVER_RANGE_START = 3500; // Servers, bridges
+  static const int RANGE_END = 4000;
+
+  static bool start();
+  static void stop();
+  static bool isLoaded();
+
+  // Register keys on the lowest free pair (even, odd) below
+  // SERVER_RANGE_START, or the lowest free port from SERVER_RANGE_START,
+  // and lease them to app_id on peer_id. Ports something is listening on are
+  // passed over even when unregistered. False when the range is full.
+  static bool allocatePair(const std::string &firstKey,
+                           const std::string &secondKey,
+                           const std::string &app_id,
+                           const std::string &peer_id, int &first,
+                           int &second);
+  static bool allocateServer(const std::string &key, const std::string &app_id,
+                             const std::string &peer_id, int &port);
+
+  // Lease a key registered some other way (setPort). An empty app_id only
+  // creates a lease where there is none; an existing owner is kept.
+  static void lease(const std::string &key, const std::string &app_id,
+                    const std::string &peer_id);
+
+  static std::vector<std::string> keysOnPort(int port);
+  static std::vector<PortEntry> list(); // By port, then key
+};
+
+#endif // PORT_REGISTRY_H
@@ -0,0 +1,53 @@
+#ifndef REPLICATION_H
+#define REPLICATION_H
+
+#include "DatabaseTableManagers.h"
+#include <cstdint>
+#include <nlohmann/json.hpp>
+#include <string>
+#include <utility>
+#include <vector>
+
+using json = nlohmann::json;
+
+// Read-only copies of the leader's system_settings and peer_registry on
+// workers, so getPort, listPorts and peer lookups don't cost a VPN round
+// trip and keep working while the leader is unreachable.
+//
+// The leader numbers every change in a bounded in-memory log. A log belongs
+// to one leader run (its epoch); sequence numbers restart with it. Changes
+// are pushed to connected workers in small batches as they happen.
+class ReplicationLog {
+public:
+  static void start(); // Follow settings changes, start the pusher
+  static void stop();
+
+  // peer_registry writes report the peer_id; the log reads the record back
+  static void recordPeer(const std::string &peer_id);
+  static void recordPeersCleared();
+
+  // replicaSync reply: the changes after since when the log still holds
+  // them for that epoch, else a snapshot of both tables. Null when not
+  // started (no settings cache).
+  static json sync(uint64_t epoch, uint64_t since);
+};
+
+// The worker's copy. Applied in sequence order from pushes and from
+// replicaSync, which the reconnect loop runs on connect, at every heartbeat
+// and when a push arrives out of order. Reads are served only while the
+// copy was confirmed current within REPLICA_MAX_STALENESS_SECS; callers
+// forward to the leader otherwise. Writes always go to the leader.
+class LeaderReplica {
+public:
+  static bool sync(); // Pull from the leader; false if it didn't answer
+  static void applyPush(const json &message);
+  static bool isFresh();
+
+  static bool getSetting(const std::string &key, std::string &value);
+  static std::vector<std::pair<std::string, std::string>> getAllSettings();
+  static bool getPeer(const std::string &peer_id, PeerRecord &peer);
+
+  static json getStatus(); // For getPeerStatus
+};
+
+#endif // REPLICATION_H
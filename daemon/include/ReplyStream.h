@@ -0,0 +1,72 @@
+#ifndef REPLY_STREAM_H
+#define REPLY_STREAM_H
+
+#include <functional>
+#include <string>
+
+// Partial output for slow commands (execOnPeer, remoteBd, remoteDeployDaemon
+// and the app-on-peer commands). mainCommand installs one on the handler
+// thread, bound to the connection that issued the command; a handler that
+// finds one writes output as it is produced instead of returning it at exit.
+// Handlers run without one (leader RPC, pushed commands) reply as before.
+//
+// Across a hop (peer daemon, manager) the producer sends frames:
+//   {"stream":"output","length":n}\n  followed by n bytes
+//   {"stream":"end","status":s}\n     once, last
+// A manager asked to keep the connection open adds "keep_alive":true to the
+// end frame; the connection can then carry the next request (ManagerPool).
+// relay() forwards them with at most one read buffer held in memory.
+class ReplyStream {
+public:
+  explicit ReplyStream(int fd); // Installed for this thread until destroyed
+  ~ReplyStream();
+  ReplyStream(const ReplyStream &) = delete;
+  ReplyStream &operator=(const ReplyStream &) = delete;
+
+  static ReplyStream *current(); // nullptr when the caller can't stream
+
+  bool write(const char *data, size_t length); // false once the reader left
+  bool write(const std::string &data);
+  bool isOpen() const;
+
+  static std::string outputFrame(const char *data, size_t length);
+  static std::string endFrame(int status);
+
+  // Incremental frame parser, for callers that multiplex several producers.
+  // Output bytes go to the sink as soon as they arrive; feed() returns true
+  // once the reply is complete. An unframed reply (older peer or manager)
+  // is passed through raw and completes at EOF, see finish().
+  class Decoder {
+  public:
+    using Sink = std::function<void(const char *, size_t)>;
+    bool feed(const char *data, size_t length, const Sink &sink);
+    bool finish(const Sink &sink); // At EOF; false if cut short
+    bool done() const { return m_done; }
+    int status() const { return m_status; }
+    // The end frame offered the connection for another request and nothing
+    // followed it
+    bool reusable() const { return m_keepAlive && m_buffer.empty(); }
+
+  private:
+    std::string m_buffer;
+    size_t m_payloadLeft = 0; // Bytes of the current output frame to come
+    bool m_framed = true;     // Cleared when the reply turns out to be raw
+    bool m_sawFrame = false;
+    bool m_done = false;
+    bool m_keepAlive = false;
+    int m_status = 1;
+  };
+
+  // Forward frames read from fd to out until the end frame. A reply that is
+  // not framed (older peer or manager) is forwarded as it arrives. Fails when
+  // nothing arrives for idleTimeoutSec or the connection drops first.
+  static bool relay(int fd, ReplyStream &out, int idleTimeoutSec, int &status,
+                    std::string &error);
+
+private:
+  int m_fd;
+  bool m_open = true;
+  ReplyStream *m_previous;
+};
+
+#endif // REPLY_STREAM_H
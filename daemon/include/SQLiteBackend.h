@@ -0,0 +1,37 @@
+#ifndef SQLITE_BACKEND_H
+#define SQLITE_BACKEND_H
+
+#include "StorageBackend.h"
+#include <map>
+#include <mutex>
+#include <sqlite3.h>
+
+// Embedded StorageBackend: one SQLite connection in WAL mode on
+// data/daemon.db. Access is serialized; a thread may borrow recursively.
+class SQLiteBackend : public StorageBackend {
+public:
+  explicit SQLiteBackend(const std::string &path);
+  ~SQLiteBackend() override;
+
+  std::string name() const override { return "sqlite"; }
+  bool start() override;
+  void stop() override;
+  std::unique_ptr<StorageConnection> connect() override;
+  std::string getStats() override;
+  long engineRssKb() override { return 0; } // Runs inside the daemon
+
+  // True when the database file did not exist before start()
+  bool isNewDatabase() const { return createdFresh; }
+
+private:
+  friend class SQLiteConnection;
+  bool createTables();
+
+  std::string path;
+  sqlite3 *db = nullptr;
+  bool createdFresh = false;
+  std::recursive_timed_mutex dbMutex;
+  std::map<std::string, std::unique_ptr<StorageStatement>> statements;
+};
+
+#endif // SQLITE_BACKEND_H
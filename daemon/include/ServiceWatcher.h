@@ -0,0 +1,87 @@
+#ifndef SERVICE_WATCHER_H
+#define SERVICE_WATCHER_H
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+// State of one unit as the service manager reports it
+struct UnitState {
+  bool found = false;        // LoadState is not "not-found"
+  std::string activeState;   // active, inactive, failed, activating, ...
+  std::string unitFileState; // enabled, disabled, static, ...
+
+  bool isActive() const;  // Same test as systemctl is-active
+  bool isEnabled() const; // Same test as systemctl is-enabled
+};
+
+enum class UnitAction { Start, Stop, Restart, ResetFailed, Enable, Disable };
+
+// Results of the service manager's jobs, by job path. A bus records them as
+// its job-removed signal comes in, while runAction waits for its own job.
+// Keeps the latest MAX_RESULTS, so a job that finished before the wait began
+// is still found.
+class UnitJobs {
+public:
+  static const size_t MAX_RESULTS = 256;
+
+  void finished(const std::string &job, const std::string &result);
+  // The job's result ("done", "failed", ...), empty if it took longer
+  std::string wait(const std::string &job, std::chrono::milliseconds timeout);
+
+private:
+  std::mutex mutex;
+  std::condition_variable done;
+  std::map<std::string, std::string> results;
+  std::deque<std::string> order;
+};
+
+// Transport to the service manager. SystemdBus talks to systemd over the
+// system D-Bus; a stand-in can be passed to ServiceWatcher::start() to run
+// the watcher without systemd, as tests/service_watcher_driver.cpp does.
+class UnitBus {
+public:
+  // Called with the full new state whenever a watched unit changes
+  using ChangeHandler =
+      std::function<void(const std::string &unit, const UnitState &state)>;
+
+  virtual ~UnitBus() = default;
+  virtual bool open(ChangeHandler onChange) = 0;
+  virtual void close() = 0;
+  // Wait up to timeoutMs for signals and dispatch them (watcher thread)
+  virtual void dispatch(int timeoutMs) = 0;
+  // Start watching unit; reports its current state through the handler
+  virtual bool watchUnit(const std::string &unit) = 0;
+  // Blocks until the job finished, like systemctl does
+  virtual bool runAction(UnitAction action, const std::string &unit,
+                         std::string &error) = 0;
+};
+
+// In-memory unit status table kept current by the bus's change signals.
+// Units are watched on first query; after that is-active/is-enabled are
+// memory reads. Every query returns false when the watcher can't answer
+// (not started, bus lost) so callers can fall back to systemctl.
+class ServiceWatcher {
+public:
+  static bool start(std::unique_ptr<UnitBus> bus);
+  static void stop();
+  static bool isRunning();
+
+  static bool isActive(const std::string &unit, bool &active);
+  static bool isEnabled(const std::string &unit, bool &enabled);
+  static bool control(UnitAction action, const std::string &unit, bool &ok);
+
+  // Called on the watcher thread after a watched unit's state changed; keep
+  // it short. One listener, replaced by the next call.
+  using ChangeListener = std::function<void(const std::string &unit)>;
+  static void setChangeListener(ChangeListener listener);
+
+  static std::string getStats();
+};
+
+#endif // SERVICE_WATCHER_H
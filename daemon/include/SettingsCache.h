@@ -0,0 +1,37 @@
+#ifndef SETTINGS_CACHE_H
+#define SETTINGS_CACHE_H
+
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Write-through in-memory copy of system_settings, automation_configs and
+// device_registry. Loaded once after MySQL starts; SettingsTable, ConfigTable
+// and DeviceTable serve reads from it and update it after each DB write.
+// Until load() succeeds the tables fall back to querying MySQL.
+class SettingsCache {
+public:
+  enum class Table { Settings, Config, Device };
+
+  // value is empty when the key was deleted
+  using Listener =
+      std::function<void(const std::string &key, const std::string &value)>;
+
+  static bool load();
+  static bool isLoaded();
+
+  static bool get(Table table, const std::string &key, std::string &value);
+  static std::vector<std::pair<std::string, std::string>> getAll(Table table);
+  static void set(Table table, const std::string &key,
+                  const std::string &value);
+  static void erase(Table table, const std::string &key);
+
+  // Called (outside the cache lock) for changes to keys starting with
+  // keyPrefix. Returns an id for unsubscribe().
+  static int subscribe(Table table, const std::string &keyPrefix,
+                       Listener listener);
+  static void unsubscribe(int id);
+};
+
+#endif // SETTINGS_CACHE_H
@@ -0,0 +1,31 @@
+#ifndef STARTUP_TRACER_H
+#define STARTUP_TRACER_H
+
+#include <chrono>
+#include <string>
+
+// Records how long each daemon startup phase takes, relative to begin().
+// Phases may run on any thread; ones still running when the daemon becomes
+// ready (peer connect, dashboard) are reported as they finish.
+class StartupTracer {
+public:
+  using Clock = std::chrono::steady_clock;
+
+  // Scoped phase: starts on construction, ends on destruction
+  class Phase {
+  public:
+    explicit Phase(const std::string &name);
+    ~Phase();
+    Phase(const Phase &) = delete;
+    Phase &operator=(const Phase &) = delete;
+
+  private:
+    int index;
+  };
+
+  static void begin();     // t=0, called once at process start
+  static void markReady(); // Socket is served from here on; logs the trace
+  static std::string report();
+};
+
+#endif // STARTUP_TRACER_H
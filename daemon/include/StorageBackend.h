@@ -0,0 +1,80 @@
+#ifndef STORAGE_BACKEND_H
+#define STORAGE_BACKEND_H
+
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+// Storage abstraction used by the table managers. Two engines implement it:
+// MySQL (spawned mysqld, the default) and SQLite in WAL mode (embedded,
+// data/daemon.db). Select with AUTOMATE_LINUX_STORAGE_BACKEND=mysql|sqlite.
+//
+// SQL is written in the MySQL dialect; the SQLite backend rewrites the few
+// MySQL-only constructs the tables use (ON DUPLICATE KEY UPDATE, NOW(),
+// INTERVAL n SECOND, GREATEST, IF).
+
+// Raised by every backend in place of driver-specific exceptions
+class StorageError : public std::runtime_error {
+public:
+  using std::runtime_error::runtime_error;
+};
+
+class StorageResult {
+public:
+  virtual ~StorageResult() = default;
+  virtual bool next() = 0;
+  virtual int getInt(const std::string &column) = 0;
+  virtual std::string getString(const std::string &column) = 0;
+  virtual bool getBoolean(const std::string &column) = 0;
+  virtual bool isNull(const std::string &column) = 0;
+};
+
+class StorageStatement {
+public:
+  virtual ~StorageStatement() = default;
+  virtual void setInt(int index, int value) = 0;
+  virtual void setString(int index, const std::string &value) = 0;
+  virtual void setBoolean(int index, bool value) = 0;
+  virtual int executeUpdate() = 0;
+  virtual std::unique_ptr<StorageResult> executeQuery() = 0;
+};
+
+// A borrowed connection, released when destroyed. Statements returned by
+// prepare() are cached and owned by the connection.
+class StorageConnection {
+public:
+  virtual ~StorageConnection() = default;
+  virtual StorageStatement *prepare(const std::string &query) = 0;
+  virtual std::unique_ptr<StorageResult> query(const std::string &query) = 0;
+  virtual int execute(const std::string &query) = 0;
+  virtual void begin() = 0;
+  virtual void commit() = 0;
+  virtual void rollback() = 0;
+};
+
+class StorageBackend {
+public:
+  virtual ~StorageBackend() = default;
+  virtual std::string name() const = 0;
+  virtual bool start() = 0; // Bring the engine up and create the tables
+  virtual void stop() = 0;
+  virtual std::unique_ptr<StorageConnection> connect() = 0; // null on failure
+  virtual std::string getStats() = 0;
+  virtual long engineRssKb() = 0; // Memory held outside the daemon (mysqld)
+};
+
+// Process-wide access to the selected backend
+class Storage {
+public:
+  static bool start();
+  static void stop();
+  static std::unique_ptr<StorageConnection> connect();
+  static std::string backendName();
+  static std::string getStats(); // Startup time, RSS and engine stats
+  static void emptyTable(const std::string &tableName);
+
+private:
+  static bool migrateFromMySQL(StorageBackend &target);
+};
+
+#endif // STORAGE_BACKEND_H
@@ -0,0 +1,49 @@
+#ifndef SYSTEMD_BUS_H
+#define SYSTEMD_BUS_H
+
+#include "ServiceWatcher.h"
+#include <map>
+#include <mutex>
+#include <systemd/sd-bus.h>
+
+// UnitBus over the system D-Bus (org.freedesktop.systemd1). Subscribes to
+// the manager, follows PropertiesChanged of each watched unit and
+// UnitFilesChanged, and waits for JobRemoved to finish start/stop jobs.
+// sd-bus is not thread safe; every use of the connection holds busMutex.
+class SystemdBus : public UnitBus {
+public:
+  ~SystemdBus() override;
+
+  bool open(ChangeHandler onChange) override;
+  void close() override;
+  void dispatch(int timeoutMs) override;
+  bool watchUnit(const std::string &unit) override;
+  bool runAction(UnitAction action, const std::string &unit,
+                 std::string &error) override;
+
+private:
+  struct Watched {
+    std::string unit;
+    UnitState state;
+  };
+
+  static int onPropertiesChanged(sd_bus_message *m, void *userdata,
+                                 sd_bus_error *error);
+  static int onUnitFilesChanged(sd_bus_message *m, void *userdata,
+                                sd_bus_error *error);
+  static int onJobRemoved(sd_bus_message *m, void *userdata,
+                          sd_bus_error *error);
+
+  // Callers hold busMutex
+  bool fetchState(const std::string &path, UnitState &state);
+  void drainLocked();
+
+  sd_bus *bus = nullptr;
+  ChangeHandler onChange;
+  std::mutex busMutex;
+  std::map<std::string, Watched> watched; // Object path -> unit
+
+  UnitJobs jobs;
+};
+
+#endif // SYSTEMD_BUS_H
@@ -4,6 +4,8 @@
 #include "Constants.h" // Added for AppType helpers and LOG_CORE
 #include "Types.h"
 #include <chrono>
+#include <cstddef>
+#include <cstdint>
 #include <string>
 
 using std::string;
@@ -43,6 +45,12 @@ std::string executeCommand(const char *cmd);
 AppType stringToAppType(const std::string &appName);
 std::string appTypeToString(AppType type);
 
+// FNV-1a, 64 bit: change detection only (build fingerprints, cache keys).
+// Start from FNV1A_OFFSET_BASIS and feed the pieces in order.
+const uint64_t FNV1A_OFFSET_BASIS = 14695981039346656037ULL;
+void fnv1a(uint64_t &hash, const char *data, size_t size);
+std::string hashToHex(uint64_t hash); // 16 lowercase hex digits
+
 void registerLogSubscriber(int fd);
 void unregisterLogSubscriber(int fd);
 
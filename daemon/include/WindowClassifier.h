@@ -0,0 +1,36 @@
+#ifndef WINDOW_CLASSIFIER_H
+#define WINDOW_CLASSIFIER_H
+
+#include "Types.h"
+#include <string>
+
+// Result of classifying a window: the rule that matched and the macro
+// context it selects
+struct WindowClass {
+  std::string rule; // Empty when no rule matched
+  AppType app = AppType::OTHER;
+};
+
+// Maps focused windows to a macro context through an ordered rule list, kept
+// as JSON in the windowRules setting (built-in defaults when unset):
+//   [{"name": "chrome", "wmClass": "^google-chrome$", "app": "CHROME"}, ...]
+// wmClass, instance, title and url are case-insensitive regular expressions,
+// searched; a missing field matches anything. The first matching rule wins.
+// Rules are compiled once per change, and results are cached per window id
+// with the inputs they were computed from, so focusing a known window again
+// is a lookup.
+class WindowClassifier {
+public:
+  static WindowClass classify(long windowId, const std::string &wmClass,
+                              const std::string &instance,
+                              const std::string &title, const std::string &url,
+                              bool &cached);
+
+  // Active rules as JSON text
+  static std::string getRules();
+  // Compile, store and apply rules; "" restores the defaults. False (and
+  // nothing changed) when the JSON or a pattern is invalid.
+  static bool setRules(const std::string &rules, std::string &error);
+};
+
+#endif // WINDOW_CLASSIFIER_H
@@ -0,0 +1,38 @@
+#ifndef WRITE_BEHIND_QUEUE_H
+#define WRITE_BEHIND_QUEUE_H
+
+#include <string>
+
+// Coalesces high-frequency writes (heartbeat last_seen, terminal session
+// pointers, last-touched dir, dir history appends) and flushes them to
+// storage in one transaction every few hundred ms and at shutdown. Only the
+// latest value per key is written. Reads through the table managers see
+// pending values.
+class WriteBehindQueue {
+public:
+  static void start(int intervalMs = 500);
+  static void stop(); // Stops the flush thread and writes what is pending
+  static void flush();
+
+  static void setSetting(const std::string &key, const std::string &value);
+  static void setSessionPointer(int tty, int index);
+  static void touchLastSeen(const std::string &peer_id,
+                            int daemon_version = -1);
+  // Append-only: entries are never renumbered, only trimmed below floorSeq
+  static void appendHistory(int seq, const std::string &path, int floorSeq);
+
+  // Read-your-writes lookups for the table managers
+  static bool getPendingSetting(const std::string &key, std::string &value);
+  static bool getPendingSessionPointer(int tty, int &index);
+  static bool hasPendingPeers();
+
+  // Drop pending writes superseded by a direct write or delete. Waits for an
+  // in-flight flush so it cannot land after the direct write.
+  static void discardSetting(const std::string &key);
+  static void discardSessionPointer(int tty);
+  static void discardHistory();
+  static void discardPeer(const std::string &peer_id);
+  static void discardAllPeers();
+};
+
+#endif // WRITE_BEHIND_QUEUE_H
@@ -2,6 +2,7 @@
 #define CMD_APP_H
 
 #include "Types.h"
+#include <cstdint>
 #include <nlohmann/json.hpp>
 #include <string>
 #include <vector>
@@ -37,6 +38,7 @@ CmdResult handleAddExtraApp(const json &command);
 CmdResult handleRemoveExtraApp(const json &command);
 CmdResult handleListExtraApps(const json &command);
 CmdResult handleDeployToProd(const json &command);
+CmdResult handleRollbackProd(const json &command);
 CmdResult handleProdStatus(const json &command);
 CmdResult handleCleanProd(const json &command);
 CmdResult handleGetAppPeers(const json &command);
@@ -49,7 +51,7 @@ CmdResult handleInstallAppServices(const json &command);
 // App Manager namespace for internal utilities
 namespace AppManager {
 
-// Service control (direct systemctl calls)
+// Service control (systemd over D-Bus via ServiceWatcher, else systemctl)
 bool startService(const std::string &serviceName);
 bool stopService(const std::string &serviceName);
 bool restartService(const std::string &serviceName);
@@ -62,6 +64,7 @@ std::string getServiceStatus(const std::string &serviceName);
 // Port management
 bool isPortListening(int port);
 bool waitForPortRelease(int port, int timeoutMs = 10000);
+bool waitForPortListen(int port, int timeoutMs = 60000);
 void killProcessOnPort(int port);
 
 // App configuration
@@ -86,9 +89,16 @@ std::string installDependencies(const std::string &appId,
                                 const std::string &mode,
                                 const std::string &component);
 
-// Peer app status cache (leader-side, populated from worker heartbeats)
+// Peer app status cache (leader-side, populated from worker heartbeats).
+// Workers version their status: a full update sets the version, a delta (a
+// JSON Patch) applies only on top of the version it was computed against.
+// applyPeerAppStatusDelta returns the version held afterwards, 0 if none.
 json getLocalAppStatusAll();
-void updatePeerAppStatus(const std::string &peerId, const json &appStatus);
+void updatePeerAppStatus(const std::string &peerId, const json &appStatus,
+                         uint64_t version = 0);
+uint64_t applyPeerAppStatusDelta(const std::string &peerId,
+                                 uint64_t baseVersion, uint64_t version,
+                                 const json &delta);
 void clearPeerAppStatus(const std::string &peerId);
 
 } // namespace AppManager
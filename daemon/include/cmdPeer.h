@@ -21,13 +21,19 @@ CmdResult handleListPeers(const json &command);
 CmdResult handleDeletePeer(const json &command);
 CmdResult handleGetPeerInfo(const json &command);
 CmdResult handleExecOnPeer(const json &command);
+CmdResult handleExecOnPeers(const json &command);
 CmdResult handleExecRequest(const json &command);
 CmdResult handleRemotePull(const json &command);
 CmdResult handleRemoteBd(const json &command);
 CmdResult handleRemoteDeployDaemon(const json &command);
+CmdResult handleFetchArtifact(const json &command);
+CmdResult handleServeArtifact(const json &command);
+CmdResult handleListArtifacts(const json &command);
 CmdResult handleDbSanityCheck(const json &command);
 CmdResult handleRegisterWorker(const json &command);
 CmdResult handleUpdatePeerMac(const json &command);
 CmdResult handleUpdatePeerMacInternal(const json &command);
+CmdResult handleReplicaSync(const json &command);
+CmdResult handleReplicaChanges(const json &command);
 
 #endif // CMD_PEER_H
@@ -11,6 +11,9 @@ using json = nlohmann::json;
 CmdResult handleHelp(const json &command);
 CmdResult handlePing(const json &command);
 CmdResult handleQuit(const json &command);
+CmdResult handleStartupTrace(const json &command);
+CmdResult handleNotifyStats(const json &command);
+CmdResult handleServiceStats(const json &command);
 CmdResult handleGetDir(const json &command);
 CmdResult handleGetFile(const json &command);
 CmdResult handleGetSocketPath(const json &command);
@@ -13,6 +13,7 @@ CmdResult handleClosedTty(const json &command);
 CmdResult handleUpdateDirHistory(const json &command);
 CmdResult handleCdForward(const json &command);
 CmdResult handleCdBackward(const json &command);
+CmdResult handleCdJump(const json &command);
 CmdResult handleShowTerminalInstance(const json &command);
 CmdResult handleShowAllTerminalInstances(const json &command);
 CmdResult handlePrintDirHistory(const json &command);
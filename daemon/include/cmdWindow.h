@@ -13,6 +13,8 @@ CmdResult handleListWindows(const json &command);
 CmdResult handleActivateWindow(const json &command);
 CmdResult handleActiveWindowChanged(const json &command);
 CmdResult handleGetActiveContext(const json &command);
+CmdResult handleGetWindowRules(const json &command);
+CmdResult handleSetWindowRules(const json &command);
 
 // Provides access to the window extension socket for registration
 void setWindowExtensionClientSocket(int socket);
@@ -7,6 +7,10 @@
 
 CmdResult testIntegrity(const json &command);
 CmdResult handleActiveWindowChanged(const json &command);
+// Validate and run a command, without writing the reply anywhere
+CmdResult dispatchCommand(const json &command);
+// Commands that block for long and run on their own thread
+bool isSlowCommand(const std::string &commandName);
 int mainCommand(const json &command, int client_sock);
 bool isNativeHostConnected();
 #endif // MAINCOMMAND_H
@@ -19,6 +19,7 @@ public:
   CmdResult _cdForward(const json &command);
   static CmdResult cdBackward(const json &command);
   CmdResult _cdBackward(const json &command);
+  static CmdResult cdJump(const json &command);
   static CmdResult showTerminalInstance(const json &command);
   static CmdResult showAllTerminalInstances(const json &command);
   static string standardizePath(string path);
@@ -0,0 +1,435 @@
+#include "ArtifactStore.h"
+#include "Constants.h"
+#include "Globals.h"
+#include "ReplyStream.h"
+#include "Utils.h"
+#include <arpa/inet.h>
+#include <cctype>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <netinet/in.h>
+#include <nlohmann/json.hpp>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/utsname.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+using json = nlohmann::json;
+
+namespace {
+
+const size_t CHUNK_SIZE = 65536;  // Bytes per output frame
+const size_t KEEP_ARTIFACTS = 5;  // Newest commits kept in the store
+const int FETCH_ATTEMPTS = 5;     // Each resumes where the last one stopped
+const int FETCH_IDLE_SECS = 30;
+
+std::mutex buildMutex;    // One build at a time, shared by concurrent deploys
+std::mutex manifestMutex;
+
+std::string manifestPath() {
+  return ArtifactStore::directory() + "manifest.json";
+}
+
+// Caller holds manifestMutex. Entries oldest first.
+json loadManifest() {
+  std::ifstream in(manifestPath());
+  if (!in)
+    return json::array();
+  json manifest = json::parse(in, nullptr, false);
+  return manifest.is_array() ? manifest : json::array();
+}
+
+// Caller holds manifestMutex
+bool saveManifest(const json &manifest) {
+  std::string tmp = manifestPath() + ".tmp";
+  {
+    std::ofstream out(tmp);
+    if (!out)
+      return false;
+    out << manifest.dump(2) << "\n";
+  }
+  return rename(tmp.c_str(), manifestPath().c_str()) == 0;
+}
+
+Artifact fromEntry(const json &entry) {
+  Artifact artifact;
+  artifact.sha256 = entry.value("sha256", "");
+  artifact.size = entry.value("size", uint64_t(0));
+  artifact.commit = entry.value("commit", "");
+  artifact.arch = entry.value("arch", "");
+  artifact.path = ArtifactStore::pathFor(artifact.sha256);
+  return artifact;
+}
+
+std::string hashFile(const std::string &path) {
+  std::string out =
+      executeCommand(("sha256sum '" + path + "' 2>/dev/null").c_str());
+  if (out.size() < 64)
+    return "";
+  std::string hash = out.substr(0, 64);
+  return ArtifactStore::isValidHash(hash) ? hash : "";
+}
+
+uint64_t fileSize(const std::string &path) {
+  struct stat st;
+  if (stat(path.c_str(), &st) != 0)
+    return 0;
+  return st.st_size;
+}
+
+// Run cmd, handing its output to progress line by line
+int runWithProgress(const std::string &cmd,
+                    const ArtifactStore::Progress &progress) {
+  FILE *pipe = popen((cmd + " 2>&1").c_str(), "r");
+  if (!pipe)
+    return -1;
+  char line[1024];
+  while (fgets(line, sizeof(line), pipe))
+    progress(line);
+  int status = pclose(pipe);
+  return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+}
+
+int connectTo(const std::string &ip, int port) {
+  int sock = socket(AF_INET, SOCK_STREAM, 0);
+  if (sock < 0)
+    return -1;
+  struct timeval timeout;
+  timeout.tv_sec = 2;
+  timeout.tv_usec = 0;
+  setsockopt(sock, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(port);
+  if (inet_pton(AF_INET, ip.c_str(), &addr.sin_addr) <= 0 ||
+      connect(sock, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+    close(sock);
+    return -1;
+  }
+  return sock;
+}
+
+// One serveArtifact exchange, appending to the open part file. True when
+// the source sent everything from offset and a zero status; retry is
+// cleared when trying again can't help.
+bool fetchOnce(const std::string &ip, int port, const std::string &sha256,
+               uint64_t offset, int partFd, std::string &error, bool &retry) {
+  retry = true;
+  int sock = connectTo(ip, port);
+  if (sock < 0) {
+    error = "cannot connect to " + ip;
+    return false;
+  }
+  json request;
+  request["command"] = COMMAND_SERVE_ARTIFACT;
+  request[COMMAND_ARG_SHA256] = sha256;
+  request[COMMAND_ARG_OFFSET] = offset;
+  request[COMMAND_ARG_STREAM] = true;
+  std::string msg = request.dump() + "\n";
+  if (send(sock, msg.c_str(), msg.length(), MSG_NOSIGNAL) !=
+      (ssize_t)msg.length()) {
+    close(sock);
+    error = "cannot send request to " + ip;
+    return false;
+  }
+
+  bool writeFailed = false;
+  ReplyStream::Decoder decoder;
+  ReplyStream::Decoder::Sink sink = [&](const char *data, size_t length) {
+    while (!writeFailed && length > 0) {
+      ssize_t n = write(partFd, data, length);
+      if (n < 0 && errno == EINTR)
+        continue;
+      if (n <= 0) {
+        writeFailed = true;
+        break;
+      }
+      data += n;
+      length -= n;
+    }
+  };
+
+  char buffer[CHUNK_SIZE];
+  while (!decoder.done() && !writeFailed) {
+    struct pollfd pfd;
+    pfd.fd = sock;
+    pfd.events = POLLIN;
+    int ready = poll(&pfd, 1, FETCH_IDLE_SECS * 1000);
+    if (ready < 0 && errno == EINTR)
+      continue;
+    if (ready <= 0) {
+      error = ready == 0
+                  ? "no data for " + std::to_string(FETCH_IDLE_SECS) + "s"
+                  : std::string(strerror(errno));
+      break;
+    }
+    ssize_t n = recv(sock, buffer, sizeof(buffer), 0);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0) {
+      error = "connection closed mid-transfer";
+      break;
+    }
+    decoder.feed(buffer, n, sink);
+  }
+  close(sock);
+
+  if (writeFailed) {
+    error = "cannot write artifact: " + std::string(strerror(errno));
+    retry = false;
+    return false;
+  }
+  if (!decoder.done())
+    return false;
+  if (decoder.status() != 0) {
+    error = "source has no artifact " + sha256.substr(0, 12);
+    retry = false;
+    return false;
+  }
+  return true;
+}
+
+} // namespace
+
+std::string ArtifactStore::directory() {
+  return directories.data + "artifacts/";
+}
+
+std::string ArtifactStore::pathFor(const std::string &sha256) {
+  return directory() + sha256;
+}
+
+bool ArtifactStore::isValidHash(const std::string &sha256) {
+  if (sha256.size() != 64)
+    return false;
+  for (char c : sha256) {
+    if (!isxdigit((unsigned char)c) || isupper((unsigned char)c))
+      return false;
+  }
+  return true;
+}
+
+std::string ArtifactStore::hostArch() {
+  struct utsname name;
+  if (uname(&name) != 0)
+    return "";
+  return name.machine;
+}
+
+bool ArtifactStore::ensureForHead(Artifact &artifact, std::string &error,
+                                  const Progress &progress) {
+  std::string base = directories.base;
+  std::string commit = executeCommand(
+      ("git -C '" + base + "' rev-parse HEAD 2>/dev/null").c_str());
+  if (commit.size() != 40) {
+    error = "cannot read the checkout's commit";
+    return false;
+  }
+  // A binary built from local edits would be installed under the commit's
+  // name on every target
+  std::string dirty = executeCommand(
+      ("git -C '" + base +
+       "' status --porcelain --untracked-files=no -- daemon")
+          .c_str());
+  if (!dirty.empty()) {
+    error = "uncommitted changes under daemon/";
+    return false;
+  }
+
+  std::lock_guard<std::mutex> buildLock(buildMutex);
+  {
+    std::lock_guard<std::mutex> lock(manifestMutex);
+    for (const json &entry : loadManifest()) {
+      Artifact cached = fromEntry(entry);
+      if (cached.commit == commit && fileSize(cached.path) == cached.size) {
+        artifact = cached;
+        progress("Artifact for " + commit.substr(0, 12) + " already built (" +
+                 cached.sha256.substr(0, 12) + ")\n");
+        return true;
+      }
+    }
+  }
+
+  progress("Building " + commit.substr(0, 12) + " once for all targets...\n");
+  int status = runWithProgress(
+      "cd '" + base + "daemon' && BUILD_ONLY=1 bash -c 'source ./build.sh'",
+      progress);
+  std::string built = base + "daemon/build/daemon";
+  if (status != 0 || fileSize(built) == 0) {
+    error = "build failed (exit " + std::to_string(status) + ")";
+    return false;
+  }
+
+  std::error_code ec;
+  std::filesystem::create_directories(directory(), ec);
+  std::string sha256 = hashFile(built);
+  if (sha256.empty()) {
+    error = "cannot hash " + built;
+    return false;
+  }
+  std::string path = pathFor(sha256);
+  std::string tmp = path + ".tmp";
+  std::filesystem::copy_file(
+      built, tmp, std::filesystem::copy_options::overwrite_existing, ec);
+  if (ec || rename(tmp.c_str(), path.c_str()) != 0) {
+    error = "cannot store artifact: " +
+            (ec ? ec.message() : std::string(strerror(errno)));
+    unlink(tmp.c_str());
+    return false;
+  }
+  chmod(path.c_str(), 0755);
+
+  artifact.sha256 = sha256;
+  artifact.size = fileSize(path);
+  artifact.commit = commit;
+  artifact.arch = hostArch();
+  artifact.path = path;
+
+  std::lock_guard<std::mutex> lock(manifestMutex);
+  json manifest = loadManifest();
+  json kept = json::array();
+  for (const json &entry : manifest) {
+    if (entry.value("commit", "") != commit)
+      kept.push_back(entry);
+  }
+  kept.push_back({{"commit", commit},
+                  {"sha256", sha256},
+                  {"size", artifact.size},
+                  {"arch", artifact.arch},
+                  {"built", (long long)time(nullptr)}});
+  while (kept.size() > KEEP_ARTIFACTS) {
+    std::string old = kept[0].value("sha256", "");
+    kept.erase(0);
+    bool shared = false;
+    for (const json &entry : kept)
+      shared = shared || entry.value("sha256", "") == old;
+    if (!shared && isValidHash(old))
+      unlink(pathFor(old).c_str());
+  }
+  if (!saveManifest(kept))
+    logToFile("ArtifactStore: cannot write " + manifestPath(), 0xFFFFFFFF);
+  logToFile("ArtifactStore: built " + sha256 + " for " + commit, LOG_CORE);
+  return true;
+}
+
+std::vector<Artifact> ArtifactStore::list() {
+  std::vector<Artifact> result;
+  std::lock_guard<std::mutex> lock(manifestMutex);
+  for (const json &entry : loadManifest())
+    result.push_back(fromEntry(entry));
+  return result;
+}
+
+int ArtifactStore::serve(const std::string &sha256, uint64_t offset,
+                         ReplyStream &out) {
+  if (!isValidHash(sha256)) {
+    out.write(ReplyStream::endFrame(1));
+    return 1;
+  }
+  int fd = open(pathFor(sha256).c_str(), O_RDONLY);
+  if (fd < 0 || lseek(fd, offset, SEEK_SET) < 0) {
+    if (fd >= 0)
+      close(fd);
+    out.write(ReplyStream::endFrame(1));
+    return 1;
+  }
+
+  char buffer[CHUNK_SIZE];
+  int status = 0;
+  while (true) {
+    ssize_t n = read(fd, buffer, sizeof(buffer));
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n < 0)
+      status = 1;
+    if (n <= 0)
+      break;
+    if (!out.write(ReplyStream::outputFrame(buffer, n))) {
+      close(fd);
+      return 1; // Fetcher went away; it resumes from what it has
+    }
+  }
+  close(fd);
+  out.write(ReplyStream::endFrame(status));
+  return status;
+}
+
+bool ArtifactStore::fetch(const std::string &sourceIp, int port,
+                          const std::string &sha256, uint64_t size,
+                          std::string &error, const Progress &progress) {
+  if (!isValidHash(sha256)) {
+    error = "invalid artifact hash";
+    return false;
+  }
+  std::string path = pathFor(sha256);
+  if (fileSize(path) == size && hashFile(path) == sha256) {
+    progress("Artifact " + sha256.substr(0, 12) + " already present\n");
+    return true;
+  }
+
+  std::error_code ec;
+  std::filesystem::create_directories(directory(), ec);
+  std::string part = path + ".part";
+  if (fileSize(part) > size)
+    unlink(part.c_str());
+
+  uint64_t resumedAt = fileSize(part);
+  for (int attempt = 0; attempt < FETCH_ATTEMPTS; attempt++) {
+    uint64_t offset = fileSize(part);
+    if (offset == size)
+      break;
+    int fd = open(part.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+    if (fd < 0) {
+      error = "cannot open " + part + ": " + strerror(errno);
+      return false;
+    }
+    std::string attemptError;
+    bool retry = true;
+    bool complete =
+        fetchOnce(sourceIp, port, sha256, offset, fd, attemptError, retry);
+    close(fd);
+    if (complete) {
+      error.clear();
+      break;
+    }
+    error = attemptError;
+    logToFile("ArtifactStore: fetch " + sha256.substr(0, 12) + " from " +
+                  sourceIp + " stopped at " + std::to_string(fileSize(part)) +
+                  " bytes: " + attemptError,
+              LOG_CORE);
+    if (!retry)
+      break;
+  }
+
+  uint64_t got = fileSize(part);
+  if (got != size) {
+    error = "got " + std::to_string(got) + " of " + std::to_string(size) +
+            " bytes" + (error.empty() ? "" : ": " + error);
+    return false; // The part file stays for the next deploy to resume
+  }
+  if (hashFile(part) != sha256) {
+    unlink(part.c_str());
+    error = "hash mismatch, discarded the download";
+    return false;
+  }
+  chmod(part.c_str(), 0755);
+  if (rename(part.c_str(), path.c_str()) != 0) {
+    error = "cannot store artifact: " + std::string(strerror(errno));
+    return false;
+  }
+  progress("Fetched " + std::to_string(size / 1024) + " KiB from " + sourceIp +
+           (resumedAt > 0 ? " (resumed at " + std::to_string(resumedAt / 1024) +
+                                " KiB)"
+                          : "") +
+           "\n");
+  return true;
+}
@@ -3,6 +3,7 @@
 #include "Globals.h"         // for g_logFile
 #include "KeyboardManager.h" // Added include
 #include "Utils.h"
+#include "WindowClassifier.h"
 #include "sendKeys.h"
 #include <iostream>
 
@@ -27,6 +28,8 @@ CmdResult AutomationManager::onActiveWindowChanged(const json &command) {
 
   std::string wmClass = command[COMMAND_ARG_WM_CLASS].get<string>();
   std::string windowTitle = command[COMMAND_ARG_WINDOW_TITLE].get<string>();
+  std::string wmInstance = command[COMMAND_ARG_WM_INSTANCE].get<string>();
+  long windowId = command[COMMAND_ARG_WINDOW_ID].get<long>();
 
   logToFile("[ACTIVE_WINDOW_CHANGED] Received wmClass: [" + wmClass +
                 "] Title: [" + windowTitle + "]\n",
@@ -41,22 +44,14 @@ CmdResult AutomationManager::onActiveWindowChanged(const json &command) {
         LOG_WINDOW);
   }
 
-  AppType appType = stringToAppType(wmClass);
-
-  // Fallback: Check title for Antigravity or ChatGPT to ensure Chrome macros
-  // work in dev
-  std::string lowerTitle = windowTitle;
-  std::transform(lowerTitle.begin(), lowerTitle.end(), lowerTitle.begin(),
-                 ::tolower);
-  if (appType == AppType::OTHER &&
-      (lowerTitle.find("antigravity") != std::string::npos ||
-       lowerTitle.find("chatgpt") != std::string::npos)) {
-    appType = AppType::CHROME;
-  }
-  if (appType == AppType::OTHER &&
-      (lowerTitle.find("terminal") != std::string::npos)) {
-    appType = AppType::TERMINAL;
-  }
+  bool cached;
+  WindowClass windowClass = WindowClassifier::classify(
+      windowId, wmClass, wmInstance, windowTitle, url, cached);
+  AppType appType = windowClass.app;
+  logToFile("[ACTIVE_WINDOW_CHANGED] Class: [" +
+                (windowClass.rule.empty() ? "-" : windowClass.rule) + "] " +
+                appTypeToString(appType) + (cached ? " (cached)" : "") + "\n",
+            LOG_WINDOW);
 
   // Set the mapping context directly in InputMapper, tracking title too
   KeyboardManager::setContext(appType, url, windowTitle);
@@ -0,0 +1,411 @@
+#include "ChromeTabs.h"
+#include "Utils.h"
+#include <arpa/inet.h>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <netinet/in.h>
+#include <nlohmann/json.hpp>
+#include <poll.h>
+#include <random>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+
+using json = nlohmann::json;
+
+namespace {
+
+const int POLL_MS = 500;          // How soon stop() is noticed
+const int MAX_BACKOFF_MS = 30000; // Between attempts while Chrome is away
+const size_t MAX_MESSAGE = 16 << 20;
+
+std::thread socketThread;
+std::atomic<bool> running{false};
+std::atomic<bool> connected{false};
+std::atomic<int> devtoolsPort{ChromeTabs::DEVTOOLS_PORT};
+
+std::mutex tabsMutex;
+std::map<std::string, ChromeTab> tabs;        // By target id
+std::map<std::string, std::string> idByTitle; // Last tab with the title
+uint64_t touchCounter = 0;
+
+// Caller holds tabsMutex
+void forgetLocked(const std::string &id) {
+  auto it = tabs.find(id);
+  if (it == tabs.end())
+    return;
+  auto title = idByTitle.find(it->second.title);
+  if (title != idByTitle.end() && title->second == id)
+    idByTitle.erase(title);
+  tabs.erase(it);
+}
+
+void applyTargetInfo(const json &info) {
+  std::string id = info.value("targetId", "");
+  if (id.empty())
+    return;
+  std::lock_guard<std::mutex> lock(tabsMutex);
+  forgetLocked(id);
+  if (info.value("type", "") != "page")
+    return;
+  ChromeTab &tab = tabs[id];
+  tab.id = id;
+  tab.title = info.value("title", "");
+  tab.url = info.value("url", "");
+  tab.touched = ++touchCounter;
+  idByTitle[tab.title] = id;
+}
+
+void clearTabs() {
+  std::lock_guard<std::mutex> lock(tabsMutex);
+  tabs.clear();
+  idByTitle.clear();
+}
+
+bool sendAll(int fd, const std::string &data) {
+  size_t sent = 0;
+  while (sent < data.size()) {
+    ssize_t n = send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return false;
+    sent += (size_t)n;
+  }
+  return true;
+}
+
+// Client frames are masked (RFC 6455 5.3)
+bool sendFrame(int fd, int opcode, const std::string &payload) {
+  std::string frame;
+  frame += (char)(0x80 | opcode);
+  size_t size = payload.size();
+  if (size < 126) {
+    frame += (char)(0x80 | size);
+  } else if (size < 65536) {
+    frame += (char)(0x80 | 126);
+    frame += (char)(size >> 8);
+    frame += (char)size;
+  } else {
+    frame += (char)(0x80 | 127);
+    for (int shift = 56; shift >= 0; shift -= 8)
+      frame += (char)(size >> shift);
+  }
+  static std::mt19937 random{std::random_device{}()};
+  char mask[4];
+  for (char &c : mask)
+    c = (char)random();
+  frame.append(mask, 4);
+  for (size_t i = 0; i < size; i++)
+    frame += (char)(payload[i] ^ mask[i % 4]);
+  return sendAll(fd, frame);
+}
+
+std::string base64(const unsigned char *data, size_t size) {
+  static const char *alphabet =
+      "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+  std::string out;
+  for (size_t i = 0; i < size; i += 3) {
+    uint32_t n = data[i] << 16;
+    if (i + 1 < size)
+      n |= data[i + 1] << 8;
+    if (i + 2 < size)
+      n |= data[i + 2];
+    out += alphabet[(n >> 18) & 63];
+    out += alphabet[(n >> 12) & 63];
+    out += i + 1 < size ? alphabet[(n >> 6) & 63] : '=';
+    out += i + 2 < size ? alphabet[n & 63] : '=';
+  }
+  return out;
+}
+
+int connectLocal(int port) {
+  int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (fd < 0)
+    return -1;
+  sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(port);
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  struct timeval tv = {2, 0}; // Handshake only; the loop polls
+  setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+  if (connect(fd, (sockaddr *)&addr, sizeof(addr)) < 0) {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+// Path of the browser target's websocket, from /json/version
+std::string browserPath(int port) {
+  std::string response =
+      httpGet("http://localhost:" + std::to_string(port) + "/json/version");
+  json version = json::parse(response, nullptr, false);
+  if (!version.is_object())
+    return "";
+  std::string url = version.value("webSocketDebuggerUrl", "");
+  size_t path = url.find('/', url.find("://") + 3);
+  return path == std::string::npos || url.find("://") == std::string::npos
+             ? ""
+             : url.substr(path);
+}
+
+// Upgrade the connection. Bytes past the response headers are left in
+// pending as the start of the first frame.
+bool handshake(int fd, int port, const std::string &path,
+               std::string &pending) {
+  unsigned char nonce[16];
+  std::random_device random;
+  for (unsigned char &c : nonce)
+    c = (unsigned char)random();
+  std::string request = "GET " + path +
+                        " HTTP/1.1\r\n"
+                        "Host: localhost:" +
+                        std::to_string(port) +
+                        "\r\n"
+                        "Upgrade: websocket\r\n"
+                        "Connection: Upgrade\r\n"
+                        "Sec-WebSocket-Key: " +
+                        base64(nonce, sizeof(nonce)) +
+                        "\r\n"
+                        "Sec-WebSocket-Version: 13\r\n\r\n";
+  if (!sendAll(fd, request))
+    return false;
+  std::string response;
+  size_t end;
+  while ((end = response.find("\r\n\r\n")) == std::string::npos) {
+    char buffer[4096];
+    ssize_t n = recv(fd, buffer, sizeof(buffer), 0);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0 || response.size() > 65536)
+      return false;
+    response.append(buffer, (size_t)n);
+  }
+  pending = response.substr(end + 4);
+  return response.compare(0, 12, "HTTP/1.1 101") == 0;
+}
+
+// One complete frame from the front of buffer. False until it has arrived.
+bool takeFrame(std::string &buffer, int &opcode, bool &fin,
+               std::string &payload) {
+  if (buffer.size() < 2)
+    return false;
+  const unsigned char *b = (const unsigned char *)buffer.data();
+  fin = b[0] & 0x80;
+  opcode = b[0] & 0x0F;
+  bool masked = b[1] & 0x80;
+  uint64_t size = b[1] & 0x7F;
+  size_t header = 2;
+  if (size == 126) {
+    if (buffer.size() < 4)
+      return false;
+    size = (uint64_t)b[2] << 8 | b[3];
+    header = 4;
+  } else if (size == 127) {
+    if (buffer.size() < 10)
+      return false;
+    size = 0;
+    for (int i = 2; i < 10; i++)
+      size = size << 8 | b[i];
+    header = 10;
+  }
+  size_t maskAt = header;
+  if (masked)
+    header += 4;
+  if (buffer.size() < header + size)
+    return false;
+  payload = buffer.substr(header, size);
+  if (masked) {
+    for (size_t i = 0; i < payload.size(); i++)
+      payload[i] ^= buffer[maskAt + i % 4];
+  }
+  buffer.erase(0, header + size);
+  return true;
+}
+
+void handleMessage(const std::string &text) {
+  json message = json::parse(text, nullptr, false);
+  if (!message.is_object())
+    return;
+  if (message.contains("error")) {
+    logToFile("ChromeTabs: DevTools error: " + message["error"].dump(),
+              0xFFFFFFFF);
+    return;
+  }
+  std::string method = message.value("method", "");
+  const json &params = message.contains("params") ? message["params"] : json();
+  if (method == "Target.targetCreated" ||
+      method == "Target.targetInfoChanged") {
+    if (params.contains("targetInfo"))
+      applyTargetInfo(params["targetInfo"]);
+  } else if (method == "Target.targetDestroyed") {
+    std::lock_guard<std::mutex> lock(tabsMutex);
+    forgetLocked(params.value("targetId", ""));
+  }
+}
+
+// Read events until the connection drops or stop() is called
+void readEvents(int fd, std::string buffer) {
+  std::string message;
+  while (running) {
+    int opcode;
+    bool fin;
+    std::string payload;
+    while (takeFrame(buffer, opcode, fin, payload)) {
+      if (opcode == 0x8) { // Close
+        sendFrame(fd, 0x8, "");
+        return;
+      }
+      if (opcode == 0x9) { // Ping
+        sendFrame(fd, 0xA, payload);
+        continue;
+      }
+      if (opcode == 0xA)
+        continue;
+      message += payload; // Text, binary or continuation
+      if (message.size() > MAX_MESSAGE)
+        return;
+      if (fin) {
+        handleMessage(message);
+        message.clear();
+      }
+    }
+
+    pollfd pfd = {fd, POLLIN, 0};
+    int ready = poll(&pfd, 1, POLL_MS);
+    if (ready < 0 && errno != EINTR)
+      return;
+    if (ready <= 0)
+      continue;
+    char chunk[65536];
+    ssize_t n = recv(fd, chunk, sizeof(chunk), 0);
+    if (n < 0 && (errno == EINTR || errno == EAGAIN))
+      continue;
+    if (n <= 0)
+      return;
+    buffer.append(chunk, (size_t)n);
+    if (buffer.size() > MAX_MESSAGE) // A frame no tab list needs
+      return;
+  }
+}
+
+// Connect, subscribe and follow the events. False when Chrome couldn't be
+// reached.
+bool session(int port) {
+  std::string path = browserPath(port);
+  if (path.empty())
+    return false;
+  int fd = connectLocal(port);
+  if (fd < 0)
+    return false;
+  std::string pending;
+  json subscribe = {{"id", 1},
+                    {"method", "Target.setDiscoverTargets"},
+                    {"params", {{"discover", true}}}};
+  if (!handshake(fd, port, path, pending) ||
+      !sendFrame(fd, 0x1, subscribe.dump())) {
+    close(fd);
+    return false;
+  }
+  // Every existing target arrives as a targetCreated
+  clearTabs();
+  connected = true;
+  logToFile("ChromeTabs: following DevTools targets on port " +
+                std::to_string(port),
+            LOG_CORE);
+  readEvents(fd, pending);
+  connected = false;
+  clearTabs();
+  close(fd);
+  logToFile("ChromeTabs: DevTools connection closed", LOG_CORE);
+  return true;
+}
+
+void socketLoop() {
+  int backoffMs = 1000;
+  while (running) {
+    if (session(devtoolsPort))
+      backoffMs = 1000;
+    auto until = std::chrono::steady_clock::now() +
+                 std::chrono::milliseconds(backoffMs);
+    while (running && std::chrono::steady_clock::now() < until)
+      std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    backoffMs = std::min(backoffMs * 2, MAX_BACKOFF_MS);
+  }
+}
+
+} // namespace
+
+void ChromeTabs::start(int port) {
+  if (running.exchange(true))
+    return;
+  devtoolsPort = port;
+  socketThread = std::thread(socketLoop);
+}
+
+void ChromeTabs::stop() {
+  if (!running.exchange(false))
+    return;
+  if (socketThread.joinable())
+    socketThread.join();
+}
+
+bool ChromeTabs::isConnected() { return connected; }
+
+int ChromeTabs::port() { return devtoolsPort; }
+
+bool ChromeTabs::isUserPage(const std::string &url) {
+  return url.find("chrome-extension://") == std::string::npos &&
+         url.find("devtools://") == std::string::npos;
+}
+
+bool ChromeTabs::urlFor(const std::string &windowTitle, std::string &url) {
+  if (!connected)
+    return false;
+  std::vector<ChromeTab> pages;
+  {
+    std::lock_guard<std::mutex> lock(tabsMutex);
+    // Window titles are "<tab title> - <browser>"
+    size_t suffix = windowTitle.rfind(" - ");
+    for (const std::string &title :
+         {windowTitle, windowTitle.substr(0, suffix)}) {
+      auto it = idByTitle.find(title);
+      if (it != idByTitle.end() && isUserPage(tabs[it->second].url)) {
+        url = tabs[it->second].url;
+        return true;
+      }
+    }
+    for (const auto &[id, tab] : tabs)
+      pages.push_back(tab);
+  }
+  url = choose(pages, windowTitle);
+  return true;
+}
+
+std::string ChromeTabs::choose(const std::vector<ChromeTab> &tabs,
+                               const std::string &windowTitle) {
+  const ChromeTab *fallback = nullptr; // Any page
+  const ChromeTab *lastReal = nullptr; // Most recent non-chrome:// page
+  for (const ChromeTab &tab : tabs) {
+    if (!isUserPage(tab.url))
+      continue;
+    if (!fallback || tab.touched > fallback->touched)
+      fallback = &tab;
+    if (tab.url.find("chrome://") == std::string::npos &&
+        (!lastReal || tab.touched > lastReal->touched))
+      lastReal = &tab;
+    if (!windowTitle.empty() && !tab.title.empty() &&
+        (windowTitle.find(tab.title) != std::string::npos ||
+         tab.title.find(windowTitle) != std::string::npos))
+      return tab.url;
+  }
+  if (lastReal)
+    return lastReal->url;
+  return fallback ? fallback->url : "";
+}
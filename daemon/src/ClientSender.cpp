@@ -1,5 +1,7 @@
 #include "ClientSender.h"
+#include "NotifyChannel.h"
 #include "common.h"
+#include <fcntl.h>
 #include <iostream>
 #include <sstream>
 #include <sys/socket.h>
@@ -82,6 +84,32 @@ int send_command_to_daemon(const ordered_json &jsonCmd) {
   return 0;
 }
 
+int send_notification_to_daemon(const ordered_json &jsonCmd) {
+  string commandName = jsonCmd[COMMAND_KEY].get<string>();
+  if (!NotifyChannel::isOneWay(commandName)) {
+    cerr << "Error: '" << commandName
+         << "' needs a reply; use 'daemon send' instead." << endl;
+    return 1;
+  }
+  int err = NotifyChannel::send(jsonCmd.dump());
+  if (err == 0)
+    return 0;
+  if (err == ENOENT || err == ECONNREFUSED) {
+    // Daemon without a notify endpoint: deliver over the stream socket and
+    // drop the reply
+    int saved = dup(STDOUT_FILENO);
+    int devNull = open("/dev/null", O_WRONLY);
+    dup2(devNull, STDOUT_FILENO);
+    int rc = send_command_to_daemon(jsonCmd);
+    dup2(saved, STDOUT_FILENO);
+    close(devNull);
+    close(saved);
+    return rc;
+  }
+  cerr << "notify failed: " << strerror(err) << endl;
+  return 1;
+}
+
 ordered_json parse_client_args(int argc, char *argv[], int start_index) {
   ordered_json j;
   if (argc <= start_index) {
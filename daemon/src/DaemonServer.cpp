@@ -1,14 +1,30 @@
 #include "DaemonServer.h"
+#include "ChromeTabs.h"
 #include "DatabaseTableManagers.h"
+#include "DirHistory.h"
+#include "ExtensionRpc.h"
 #include "KeyboardManager.h"
+#include "NotifyChannel.h"
+#include "PeerConnection.h"
 #include "PeerManager.h"
+#include "PeerRegistry.h"
+#include "PortRegistry.h"
+#include "Replication.h"
+#include "ServiceWatcher.h"
+#include "SettingsCache.h"
+#include "StartupTracer.h"
+#include "StorageBackend.h"
+#include "SystemdBus.h"
 #include "Utils.h"
+#include "Version.h"
+#include "WriteBehindQueue.h"
 #include "cmdApp.h"
 #include "common.h"
 #include "main.h"
 #include "mainCommand.h"
 #include "sendKeys.h"
 #include "using.h"
+#include <algorithm>
 #include <arpa/inet.h>
 #include <array>
 #include <csignal>
@@ -16,11 +32,13 @@
 #include <dirent.h>
 #include <fcntl.h>
 #include <fstream>
+#include <future>
 #include <ifaddrs.h>
 #include <iostream>
 #include <map>
 #include <net/if.h>
 #include <netinet/in.h>
+#include <regex>
 #include <sys/select.h>
 #include <sys/socket.h>
 #include <sys/un.h>
@@ -36,6 +54,7 @@ extern int g_keyboard_fd;       // Defined in main.cpp, used here
 extern volatile int running;    // Defined in main.cpp
 extern std::ofstream g_logFile; // Defined in Globals.h/main.cpp
 extern bool g_keyboardEnabled;  // Defined in mainCommand.cpp
+extern int g_clientSocket;      // Defined in mainCommand.cpp
 
 struct ClientState {
   int fd;
@@ -49,6 +68,9 @@ struct PeerClientState {
   string peer_ip;
   string peer_id;
   bool authenticated;
+  // Shared with PeerManager and writer threads; closes the fd when the last
+  // holder lets go
+  std::shared_ptr<PeerConnection> connection;
 };
 
 static std::map<int, ClientState> clients;
@@ -63,21 +85,64 @@ void emitDaemonReadySignal() {
   }
 }
 
-void initializeKeyboardPath() {
-  string deviceName = executeCommand(KEYBOARD_DISCOVERY_CMD);
-  if (!deviceName.empty()) {
-    string fullPath = KEYBOARD_INPUT_PATH + deviceName;
-    DeviceTable::setDevicePath("keyboard", fullPath);
-    cerr << "Keyboard path initialized: " << fullPath << endl;
+struct InputDevices {
+  string keyboard; // Full path, empty if not found
+  string mouse;
+};
+
+// First /dev/input/by-id entry matching KEYBOARD_DISCOVERY_PATTERN, in name
+// order
+static string discoverKeyboardPath() {
+  DIR *dir = opendir(KEYBOARD_INPUT_PATH);
+  if (!dir)
+    return "";
+  std::regex pattern(KEYBOARD_DISCOVERY_PATTERN);
+  vector<string> matches;
+  while (struct dirent *entry = readdir(dir)) {
+    if (std::regex_search(entry->d_name, pattern))
+      matches.push_back(entry->d_name);
+  }
+  closedir(dir);
+  if (matches.empty())
+    return "";
+  return KEYBOARD_INPUT_PATH + *std::min_element(matches.begin(),
+                                                 matches.end());
+}
+
+// eventN handler of the first device in /proc/bus/input/devices whose name
+// mentions both MOUSE_DISCOVERY_VENDOR and MOUSE_DISCOVERY_PRODUCT
+static string discoverMousePath() {
+  std::ifstream devices(INPUT_DEVICES_FILE);
+  std::regex eventPattern("event[0-9]+");
+  string line;
+  bool found = false;
+  while (std::getline(devices, line)) {
+    if (line.empty()) {
+      found = false; // Blank line ends a device block
+    } else if (line.compare(0, 3, "N: ") == 0) {
+      found = line.find(MOUSE_DISCOVERY_VENDOR) != string::npos &&
+              line.find(MOUSE_DISCOVERY_PRODUCT) != string::npos;
+    } else if (found && line.compare(0, 3, "H: ") == 0) {
+      std::smatch match;
+      if (std::regex_search(line, match, eventPattern))
+        return MOUSE_INPUT_PATH + match.str();
+    }
   }
+  return "";
 }
 
-void initializeMousePath() {
-  string eventNum = executeCommand(MOUSE_DISCOVERY_CMD);
-  if (!eventNum.empty()) {
-    string fullPath = MOUSE_INPUT_PATH + eventNum;
-    DeviceTable::setDevicePath("mouse", fullPath);
-    cerr << "Mouse path initialized: " << fullPath << endl;
+static InputDevices discoverInputDevices() {
+  return {discoverKeyboardPath(), discoverMousePath()};
+}
+
+static void applyInputDevices(const InputDevices &devices) {
+  if (!devices.keyboard.empty()) {
+    DeviceTable::setDevicePath("keyboard", devices.keyboard);
+    cerr << "Keyboard path initialized: " << devices.keyboard << endl;
+  }
+  if (!devices.mouse.empty()) {
+    DeviceTable::setDevicePath("mouse", devices.mouse);
+    cerr << "Mouse path initialized: " << devices.mouse << endl;
   }
 }
 
@@ -317,11 +382,27 @@ void accept_new_peer() {
   char ip_str[INET_ADDRSTRLEN];
   inet_ntop(AF_INET, &(peer_addr.sin_addr), ip_str, INET_ADDRSTRLEN);
 
-  peer_clients[peer_fd] = PeerClientState{peer_fd, "", ip_str, "", false};
+  peer_clients[peer_fd] = PeerClientState{peer_fd, "", ip_str, "", false,
+                                          PeerConnection::adopt(peer_fd)};
   cerr << "Peer connected: FD=" << peer_fd << " IP=" << ip_str << endl;
   logToFile("Peer connected from " + string(ip_str), LOG_CORE);
 }
 
+// Header line announcing the payload length, then the payload itself, sent
+// as one message under the connection's write lock so neither replies from
+// handler threads nor replication pushes can land inside it
+static void writeReplyFrame(const std::shared_ptr<PeerConnection> &connection,
+                            uint64_t requestId, const CmdResult &result) {
+  json header;
+  header["reply_to"] = requestId;
+  header["status"] = result.status;
+  header["length"] = result.message.size();
+  if (!connection->send(header.dump() + "\n" + result.message))
+    logToFile("Failed to send reply " + to_string(requestId) + ": " +
+                  string(strerror(errno)),
+              LOG_CORE);
+}
+
 int handle_peer_data(int peer_fd) {
   PeerClientState &state = peer_clients[peer_fd];
   char buffer[4096];
@@ -336,7 +417,8 @@ int handle_peer_data(int peer_fd) {
       PeerTable::updateOnlineStatus(state.peer_id, false);
       AppManager::clearPeerAppStatus(state.peer_id);
     }
-    close(peer_fd);
+    state.connection->shutdown();
+    PeerManager::getInstance().dropConnection(state.connection);
     peer_clients.erase(peer_fd);
     return 0;
   }
@@ -355,8 +437,16 @@ int handle_peer_data(int peer_fd) {
     try {
       j = json::parse(message);
     } catch (...) {
-      string result = "ERROR: Invalid JSON\n";
-      write(peer_fd, result.c_str(), result.length());
+      state.connection->send("ERROR: Invalid JSON\n");
+      continue;
+    }
+    // Replies are framed by request_id; one that isn't an id can't be
+    // answered, and reading it below would throw out of the daemon loop
+    if (j.contains("request_id") && !j["request_id"].is_number_unsigned()) {
+      logToFile("Peer message from " + state.peer_ip +
+                    " has an invalid request_id, dropped",
+                LOG_CORE);
+      state.connection->send("ERROR: Invalid request_id\n");
       continue;
     }
 
@@ -364,7 +454,8 @@ int handle_peer_data(int peer_fd) {
     // Peer connections are persistent - don't close based on mainCommand return
     logToFile("Peer message from " + state.peer_ip + ": " + message, LOG_CORE);
 
-    // Intercept heartbeat — just update last_seen, no response
+    // Intercept heartbeat — update last_seen and app status. Only app
+    // status updates (sent as requests) get a reply: the version now held.
     if (j.contains("command") && j["command"] == "heartbeat" &&
         j.contains("peer_id")) {
       string hbPeerId = j["peer_id"].get<string>();
@@ -373,8 +464,19 @@ int handle_peer_data(int peer_fd) {
       } else {
         PeerTable::touchLastSeen(hbPeerId);
       }
-      if (j.contains("appStatus") && j["appStatus"].is_object()) {
-        AppManager::updatePeerAppStatus(hbPeerId, j["appStatus"]);
+      uint64_t version = j.value("appStatusVersion", uint64_t(0));
+      if (j.contains("appStatusDelta")) {
+        version = AppManager::applyPeerAppStatusDelta(
+            hbPeerId, j.value("appStatusBase", uint64_t(0)), version,
+            j["appStatusDelta"]);
+      } else if (j.contains("appStatus") && j["appStatus"].is_object()) {
+        AppManager::updatePeerAppStatus(hbPeerId, j["appStatus"], version);
+      }
+      if (j.contains("request_id")) {
+        json ack;
+        ack["version"] = version;
+        writeReplyFrame(state.connection, j["request_id"].get<uint64_t>(),
+                        CmdResult(0, ack.dump()));
       }
       if (state.peer_id.empty())
         state.peer_id = hbPeerId;
@@ -386,60 +488,60 @@ int handle_peer_data(int peer_fd) {
         j.contains("peer_id")) {
       state.peer_id = j["peer_id"].get<string>();
       if (j.contains("appStatus") && j["appStatus"].is_object()) {
-        AppManager::updatePeerAppStatus(state.peer_id, j["appStatus"]);
+        AppManager::updatePeerAppStatus(
+            state.peer_id, j["appStatus"],
+            j.value("appStatusVersion", uint64_t(0)));
       }
     }
 
-    // Just process the command - peer connections stay open
-    mainCommand(j, peer_fd);
+    // Correlated request from a worker: reply framed so the worker's reader
+    // can match it to the waiting request
+    if (j.contains("request_id")) {
+      uint64_t requestId = j["request_id"].get<uint64_t>();
+      string commandName = j.value(COMMAND_KEY, "");
+      if (isSlowCommand(commandName)) {
+        std::thread([j, connection = state.connection, requestId]() {
+          writeReplyFrame(connection, requestId, dispatchCommand(j));
+        }).detach();
+      } else {
+        g_clientSocket = peer_fd; // registerPeer keeps the connection
+        writeReplyFrame(state.connection, requestId, dispatchCommand(j));
+      }
+      continue;
+    }
+
+    // Just process the command - peer connections stay open, except for
+    // slow commands: their thread replies and closes the fd itself, so
+    // nothing else may write to it from here on
+    if (isSlowCommand(j.value(COMMAND_KEY, ""))) {
+      state.connection->release();
+      PeerManager::getInstance().dropConnection(state.connection);
+      if (mainCommand(j, peer_fd) != 2)
+        close(peer_fd); // Rejected before it reached its thread
+      peer_clients.erase(peer_fd);
+      return 0;
+    }
+    // What mainCommand does, with the reply written under the connection's
+    // lock like every other write to a peer
+    g_clientSocket = peer_fd;
+    state.connection->send(dispatchCommand(j).message);
   }
   return 0;
 }
 
-// Handle commands from leader (for workers)
-static string leader_buffer;
-
+// Handle commands pushed by the leader (for workers). The PeerManager reader
+// thread owns the socket; replies go back raw, as the leader expects.
 int handle_leader_data() {
   PeerManager &pm = PeerManager::getInstance();
-  int leader_fd = pm.getLeaderSocket();
-  if (leader_fd < 0)
-    return 0;
-
-  char buffer[4096];
-  ssize_t bytesRead = read(leader_fd, buffer, sizeof(buffer) - 1);
-  if (bytesRead <= 0) {
-    logToFile("Lost connection to leader", LOG_CORE);
-    pm.disconnectFromLeader();
-    leader_buffer.clear();
-    return 0;
-  }
-
-  buffer[bytesRead] = '\0';
-  leader_buffer += buffer;
-
-  size_t pos;
-  while ((pos = leader_buffer.find('\n')) != string::npos) {
-    string message = leader_buffer.substr(0, pos);
-    leader_buffer.erase(0, pos + 1);
-    if (!message.empty() && message.back() == '\r')
-      message.pop_back();
-
-    ordered_json j;
-    try {
-      j = json::parse(message);
-    } catch (...) {
-      logToFile("Invalid JSON from leader: " + message, LOG_CORE);
-      continue;
-    }
-
-    // Only process JSON objects with a "command" field — ignore responses
-    if (!j.is_object() || !j.contains("command")) {
-      logToFile("Ignoring non-command from leader: " + message, LOG_CORE);
+  for (const json &j : pm.takeLeaderCommands()) {
+    logToFile("Command from leader: " + j.dump(), LOG_CORE);
+    if (isSlowCommand(j.value(COMMAND_KEY, ""))) {
+      std::thread([j]() {
+        PeerManager::getInstance().replyToLeader(dispatchCommand(j).message);
+      }).detach();
       continue;
     }
-
-    logToFile("Command from leader: " + message, LOG_CORE);
-    mainCommand(j, leader_fd);
+    pm.replyToLeader(dispatchCommand(j).message);
   }
   return 0;
 }
@@ -450,6 +552,7 @@ int handle_client_data(int client_fd) {
   ssize_t bytesRead = read(client_fd, buffer, sizeof(buffer) - 1);
   if (bytesRead <= 0) {
     unregisterLogSubscriber(client_fd);
+    ExtensionRpc::detach(client_fd);
     close(client_fd);
     clients.erase(client_fd);
     return 0;
@@ -465,6 +568,10 @@ int handle_client_data(int client_fd) {
     if (!command.empty() && command.back() == '\r')
       command.pop_back();
 
+    // A reply from an extension goes to the command waiting for it
+    if (ExtensionRpc::onLine(client_fd, command))
+      continue;
+
     ordered_json j;
     try {
       j = json::parse(command);
@@ -473,10 +580,14 @@ int handle_client_data(int client_fd) {
       write(client_fd, result.c_str(), result.length());
       continue;
     }
+    // Notifications the same shell sent first must not run after this
+    if (j.contains(COMMAND_ARG_TTY))
+      NotifyChannel::flushFor(j[COMMAND_ARG_TTY]);
     int res = mainCommand(j, client_fd);
     if (res == 1) {
       // If mainCommand returns 1, it means we should close the connection.
       unregisterLogSubscriber(client_fd);
+      ExtensionRpc::detach(client_fd);
       close(client_fd);
       clients.erase(client_fd);
       return 0;
@@ -549,15 +660,41 @@ void retry_peer_socket_setup() {
   }
 }
 
-int initialize_daemon() {
-  cerr << "Starting daemon..." << endl;
-  signal(SIGTERM, signal_handler);
-  signal(SIGINT, signal_handler);
-  signal(SIGPIPE, SIG_IGN);
+// Leader self-registration and the worker's first leader connect; run off
+// the startup path since a connect can block on the network. The peer config
+// is loaded before this starts, as the main loop reads it unlocked.
+static std::thread peerStartupThread;
 
-  files.initialize(directories);
+static void restorePeerConnections() {
+  PeerManager &pm = PeerManager::getInstance();
+  if (pm.isLeader() && !pm.getPeerId().empty()) {
+    // Leader self-registers in database
+    string my_ip = getWgInterfaceIP();
+    string my_mac = getPrimaryMacAddress();
+    char hostname[256];
+    string my_hostname = "";
+    if (gethostname(hostname, sizeof(hostname)) == 0) {
+      my_hostname = string(hostname);
+    }
+    PeerTable::upsertPeer(pm.getPeerId(), my_ip, my_mac, my_hostname, true,
+                          DAEMON_VERSION);
+    cerr << "Peer config restored: leader " << pm.getPeerId() << endl;
+    pm.startReconnectLoop(); // Leader self-heartbeat to keep last_seen fresh
+  } else if (!pm.getLeaderAddress().empty()) {
+    // Worker connects to leader
+    if (pm.connectToLeader()) {
+      cerr << "Peer config restored: connected to leader at "
+           << pm.getLeaderAddress() << endl;
+    } else {
+      cerr << "Peer config restored: will retry leader connection" << endl;
+    }
+    // Start background reconnect loop (handles disconnections and failed
+    // initial connects)
+    pm.startReconnectLoop();
+  }
+}
 
-  // Restore logging state EARLY
+static void restoreLogState() {
   string savedLogState = SettingsTable::getSetting("shouldLogState");
   if (!savedLogState.empty()) {
     try {
@@ -568,6 +705,41 @@ int initialize_daemon() {
   } else {
     shouldLog = LOG_CORE;
   }
+  // Apply shouldLogState edits (e.g. via upsertEntry) without a restart
+  SettingsCache::subscribe(SettingsCache::Table::Settings, "shouldLogState",
+                           [](const string &, const string &value) {
+                             try {
+                               shouldLog = std::stoul(value);
+                             } catch (...) {
+                             }
+                           });
+  logToFile("Logging mask restored/initialized to: " +
+                std::to_string(shouldLog),
+            LOG_CORE);
+}
+
+static void startDashboard() {
+  string startDashboardScript =
+      directories.base + "daemon/scripts/start_dashboard.sh";
+  string dashboardCmd = startDashboardScript + " > /dev/null 2>&1 &";
+  int dashboardRc = system(dashboardCmd.c_str());
+  if (dashboardRc != 0) {
+    logToFile("WARNING: Failed to start Dashboard, rc=" +
+                  std::to_string(dashboardRc),
+              LOG_CORE);
+  } else {
+    logToFile("Dashboard startup script executed", LOG_CORE);
+  }
+}
+
+int initialize_daemon() {
+  cerr << "Starting daemon..." << endl;
+  signal(SIGTERM, signal_handler);
+  signal(SIGINT, signal_handler);
+  signal(SIGPIPE, SIG_IGN);
+
+  files.initialize(directories);
+  shouldLog = LOG_CORE; // Until the saved mask is read from storage
 
   g_logFile.open(directories.data + "combined.log", std::ios::app);
   if (!g_logFile.is_open()) {
@@ -575,25 +747,64 @@ int initialize_daemon() {
          << "combined.log" << endl;
   }
 
-  logToFile("Logging mask restored/initialized to: " +
-                std::to_string(shouldLog),
-            LOG_CORE);
+  // Bind first: clients connecting during the rest of startup wait in the
+  // listen backlog instead of being refused, and a second daemon bails out
+  // before starting storage
+  int rc;
+  {
+    StartupTracer::Phase phase("socket");
+    rc = setup_socket();
+    if (rc == 0 && NotifyChannel::open() < 0)
+      cerr << "WARNING: Notify socket unavailable, shell hooks fall back to "
+              "the command socket"
+           << endl;
+  }
+  if (rc != 0)
+    return rc;
 
-  initializeKeyboardPath();
-  initializeMousePath();
-  KeyboardManager::mapper.loadPersistence();
-  openKeyboardDevice();
-  int rc = setup_socket();
-  if (rc != 0) {
-    if (g_keyboard_fd >= 0) {
-      close(g_keyboard_fd);
-      g_keyboard_fd = -1;
+  // Device discovery only reads /dev and /proc, so it overlaps storage start
+  std::future<InputDevices> devices = std::async(std::launch::async, [] {
+    StartupTracer::Phase phase("deviceDiscovery");
+    return discoverInputDevices();
+  });
+
+  {
+    StartupTracer::Phase phase("storage");
+    Storage::start();
+    bool settingsCached = SettingsCache::load();
+    WriteBehindQueue::start();
+    DirHistory::load();
+    PeerRegistry::start();
+    if (settingsCached) { // The change log and port bitmap follow the cache
+      ReplicationLog::start();
+      PortRegistry::start();
     }
-    return rc;
+  }
+  {
+    StartupTracer::Phase phase("serviceWatcher");
+    ServiceWatcher::start(std::make_unique<SystemdBus>());
+  }
+  ChromeTabs::start(); // Connects in the background, whenever Chrome is up
+  restoreLogState();
+
+  PeerManager::getInstance().loadConfig();
+  peerStartupThread = std::thread([] {
+    StartupTracer::Phase phase("peerConnect");
+    restorePeerConnections();
+  });
+
+  {
+    StartupTracer::Phase phase("inputDevices");
+    applyInputDevices(devices.get());
+    KeyboardManager::mapper.loadPersistence();
+    openKeyboardDevice();
   }
 
   // Setup peer-to-peer socket (optional - only if wg0 exists)
-  rc = setup_peer_socket();
+  {
+    StartupTracer::Phase phase("peerSocket");
+    rc = setup_peer_socket();
+  }
   if (rc != 0) {
     logToFile(
         "WARNING: Peer socket setup failed, continuing without peer networking",
@@ -612,21 +823,15 @@ int initialize_daemon() {
   //   logToFile("ERROR: Failed to initialize keyboard mapping", LOG_CORE);
   // }
 
-  // Start Dashboard
-  string startDashboardScript =
-      directories.base + "daemon/scripts/start_dashboard.sh";
-  string dashboardCmd = startDashboardScript + " > /dev/null 2>&1 &";
-  int dashboardRc = system(dashboardCmd.c_str());
-  if (dashboardRc != 0) {
-    logToFile("WARNING: Failed to start Dashboard, rc=" +
-                  std::to_string(dashboardRc),
-              LOG_CORE);
-  } else {
-    logToFile("Dashboard startup script executed", LOG_CORE);
-  }
-
-  emitDaemonReadySignal();
+  // Dashboard launch and the DBus signal fork shells; keep them off the path
+  // to serving the socket
+  std::thread([] {
+    StartupTracer::Phase phase("dashboard");
+    startDashboard();
+    emitDaemonReadySignal();
+  }).detach();
 
+  StartupTracer::markReady();
   return 0;
 }
 
@@ -637,6 +842,13 @@ void daemon_loop() {
     FD_SET(socket_fd, &read_fds);
     int max_fd = socket_fd;
 
+    int notify_fd = NotifyChannel::fd();
+    if (notify_fd >= 0) {
+      FD_SET(notify_fd, &read_fds);
+      if (notify_fd > max_fd)
+        max_fd = notify_fd;
+    }
+
     // Add peer socket if available
     if (peer_socket_fd >= 0) {
       FD_SET(peer_socket_fd, &read_fds);
@@ -658,20 +870,25 @@ void daemon_loop() {
         max_fd = pair.first;
     }
 
-    // For workers: add leader socket to receive commands from leader
-    PeerManager &pm = PeerManager::getInstance();
-    int leader_fd = pm.isConnectedToLeader() ? pm.getLeaderSocket() : -1;
-    if (leader_fd >= 0) {
-      FD_SET(leader_fd, &read_fds);
-      if (leader_fd > max_fd)
-        max_fd = leader_fd;
+    // For workers: commands the leader pushed, queued by the reader thread
+    int leader_inbox_fd = PeerManager::getInstance().getLeaderInboxFd();
+    if (leader_inbox_fd >= 0) {
+      FD_SET(leader_inbox_fd, &read_fds);
+      if (leader_inbox_fd > max_fd)
+        max_fd = leader_inbox_fd;
     }
 
     struct timeval timeout{
         0, 200000}; // 200ms timeout for faster shutdown response
+    if (NotifyChannel::hasPending())
+      timeout.tv_usec = 0; // Just poll, queued notifications are waiting
     int activity = select(max_fd + 1, &read_fds, nullptr, nullptr, &timeout);
-    if (activity <= 0)
+    if (activity < 0)
+      continue;
+    if (activity == 0) {
+      NotifyChannel::process(NOTIFY_BATCH_PER_LOOP);
       continue;
+    }
 
     // Accept new local clients
     if (FD_ISSET(socket_fd, &read_fds))
@@ -699,19 +916,35 @@ void daemon_loop() {
         handle_peer_data(fd);
 
     // Handle data from leader (for workers)
-    if (leader_fd >= 0 && FD_ISSET(leader_fd, &read_fds))
+    if (leader_inbox_fd >= 0 && FD_ISSET(leader_inbox_fd, &read_fds))
       handle_leader_data();
+
+    // One-way notifications run after everything waiting on a reply
+    if (notify_fd >= 0 && FD_ISSET(notify_fd, &read_fds))
+      NotifyChannel::receive();
+    NotifyChannel::process(NOTIFY_BATCH_PER_LOOP);
   }
 
+  // The caller stops the reconnect loop next; make sure it was started
+  if (peerStartupThread.joinable())
+    peerStartupThread.join();
+
+  ServiceWatcher::stop();
+  ChromeTabs::stop();
+  ReplicationLog::stop();
+  PortRegistry::stop();
+
   // Cleanup local clients
   for (auto &pair : clients)
     close(pair.first);
   close(socket_fd);
   unlink(socketPath.c_str());
+  NotifyChannel::close();
 
   // Cleanup peer clients and socket
   for (auto &pair : peer_clients)
-    close(pair.first);
+    pair.second.connection->shutdown();
+  peer_clients.clear();
   if (peer_socket_fd >= 0) {
     close(peer_socket_fd);
     peer_socket_fd = -1;
@@ -1,14 +1,15 @@
 #include "DatabaseTableManagers.h"
+#include "PeerRegistry.h"
+#include "Replication.h"
+#include "SettingsCache.h"
 #include "Utils.h"
-#include <cppconn/prepared_statement.h>
-#include <cppconn/resultset.h>
-#include <cppconn/statement.h>
+#include "WriteBehindQueue.h"
 #include <memory>
 #include <tuple>
 
-// Helper to check and get connection
-static sql::Connection *getCon() {
-  sql::Connection *con = MySQLManager::getConnection();
+// Helper to borrow a connection from the active storage backend
+static std::unique_ptr<StorageConnection> getCon() {
+  std::unique_ptr<StorageConnection> con = Storage::connect();
   if (!con) {
     logToFile("DatabaseTableManagers: Failed to get connection", 0xFFFFFFFF);
   }
@@ -18,36 +19,36 @@ static sql::Connection *getCon() {
 // TerminalTable Implementation
 
 void TerminalTable::upsertHistory(int index, const std::string &path) {
-  std::unique_ptr<sql::Connection> con(getCon());
+  std::unique_ptr<StorageConnection> con = getCon();
   if (!con)
     return;
   try {
-    std::unique_ptr<sql::PreparedStatement> pstmt(
-        con->prepareStatement("INSERT INTO terminal_history (entry_index, "
-                              "path) VALUES (?, ?) "
-                              "ON DUPLICATE KEY UPDATE path = ?"));
+    StorageStatement *pstmt =
+        con->prepare("INSERT INTO terminal_history (entry_index, "
+                    "path) VALUES (?, ?) "
+                    "ON DUPLICATE KEY UPDATE path = ?");
     pstmt->setInt(1, index);
     pstmt->setString(2, path);
     pstmt->setString(3, path);
     pstmt->executeUpdate();
-  } catch (sql::SQLException &e) {
+  } catch (StorageError &e) {
     logToFile("TerminalTable: upsertHistory error: " + std::string(e.what()),
               0xFFFFFFFF);
   }
 }
 
 std::string TerminalTable::getHistory(int index) {
-  std::unique_ptr<sql::Connection> con(getCon());
+  std::unique_ptr<StorageConnection> con = getCon();
   if (!con)
     return "";
   try {
-    std::unique_ptr<sql::PreparedStatement> pstmt(con->prepareStatement(
-        "SELECT path FROM terminal_history WHERE entry_index = ?"));
+    StorageStatement *pstmt = con->prepare(
+        "SELECT path FROM terminal_history WHERE entry_index = ?");
     pstmt->setInt(1, index);
-    std::unique_ptr<sql::ResultSet> res(pstmt->executeQuery());
+    std::unique_ptr<StorageResult> res = pstmt->executeQuery();
     if (res->next())
       return res->getString("path");
-  } catch (sql::SQLException &e) {
+  } catch (StorageError &e) {
     logToFile("TerminalTable: getHistory error: " + std::string(e.what()),
               0xFFFFFFFF);
   }
@@ -55,18 +56,19 @@ std::string TerminalTable::getHistory(int index) {
 }
 
 void TerminalTable::setSessionPointer(int tty, int index) {
-  std::unique_ptr<sql::Connection> con(getCon());
+  WriteBehindQueue::discardSessionPointer(tty);
+  std::unique_ptr<StorageConnection> con = getCon();
   if (!con)
     return;
   try {
-    std::unique_ptr<sql::PreparedStatement> pstmt(con->prepareStatement(
+    StorageStatement *pstmt = con->prepare(
         "INSERT INTO terminal_sessions (tty, history_index) VALUES (?, ?) "
-        "ON DUPLICATE KEY UPDATE history_index = ?"));
+        "ON DUPLICATE KEY UPDATE history_index = ?");
     pstmt->setInt(1, tty);
     pstmt->setInt(2, index);
     pstmt->setInt(3, index);
     pstmt->executeUpdate();
-  } catch (sql::SQLException &e) {
+  } catch (StorageError &e) {
     logToFile("TerminalTable: setSessionPointer error: " +
                   std::string(e.what()),
               0xFFFFFFFF);
@@ -74,17 +76,20 @@ void TerminalTable::setSessionPointer(int tty, int index) {
 }
 
 int TerminalTable::getSessionPointer(int tty) {
-  std::unique_ptr<sql::Connection> con(getCon());
+  int pendingIndex;
+  if (WriteBehindQueue::getPendingSessionPointer(tty, pendingIndex))
+    return pendingIndex;
+  std::unique_ptr<StorageConnection> con = getCon();
   if (!con)
     return -1;
   try {
-    std::unique_ptr<sql::PreparedStatement> pstmt(con->prepareStatement(
-        "SELECT history_index FROM terminal_sessions WHERE tty = ?"));
+    StorageStatement *pstmt = con->prepare(
+        "SELECT history_index FROM terminal_sessions WHERE tty = ?");
     pstmt->setInt(1, tty);
-    std::unique_ptr<sql::ResultSet> res(pstmt->executeQuery());
+    std::unique_ptr<StorageResult> res = pstmt->executeQuery();
     if (res->next())
       return res->getInt("history_index");
-  } catch (sql::SQLException &e) {
+  } catch (StorageError &e) {
     logToFile("TerminalTable: getSessionPointer error: " +
                   std::string(e.what()),
               0xFFFFFFFF);
@@ -93,15 +98,16 @@ int TerminalTable::getSessionPointer(int tty) {
 }
 
 void TerminalTable::deleteSession(int tty) {
-  std::unique_ptr<sql::Connection> con(getCon());
+  WriteBehindQueue::discardSessionPointer(tty);
+  std::unique_ptr<StorageConnection> con = getCon();
   if (!con)
     return;
   try {
-    std::unique_ptr<sql::PreparedStatement> pstmt(
-        con->prepareStatement("DELETE FROM terminal_sessions WHERE tty = ?"));
+    StorageStatement *pstmt =
+        con->prepare("DELETE FROM terminal_sessions WHERE tty = ?");
     pstmt->setInt(1, tty);
     pstmt->executeUpdate();
-  } catch (sql::SQLException &e) {
+  } catch (StorageError &e) {
     logToFile("TerminalTable: deleteSession error: " + std::string(e.what()),
               0xFFFFFFFF);
   }
@@ -109,18 +115,17 @@ void TerminalTable::deleteSession(int tty) {
 
 std::vector<std::pair<int, std::string>> TerminalTable::getAllHistoryEntries() {
   std::vector<std::pair<int, std::string>> results;
-  std::unique_ptr<sql::Connection> con(getCon());
+  std::unique_ptr<StorageConnection> con = getCon();
   if (!con)
     return results;
   try {
-    std::unique_ptr<sql::Statement> stmt(con->createStatement());
-    std::unique_ptr<sql::ResultSet> res(
-        stmt->executeQuery("SELECT entry_index, path FROM terminal_history "
-                           "ORDER BY entry_index"));
+    std::unique_ptr<StorageResult> res =
+        con->query("SELECT entry_index, path FROM terminal_history "
+                   "ORDER BY entry_index");
     while (res->next()) {
       results.push_back({res->getInt("entry_index"), res->getString("path")});
     }
-  } catch (sql::SQLException &e) {
+  } catch (StorageError &e) {
     logToFile("TerminalTable: getAllHistoryEntries error: " +
                   std::string(e.what()),
               0xFFFFFFFF);
@@ -129,23 +134,23 @@ std::vector<std::pair<int, std::string>> TerminalTable::getAllHistoryEntries() {
 }
 
 std::vector<std::tuple<int, int, std::string>> TerminalTable::getAllHistory() {
+  WriteBehindQueue::flush();
   std::vector<std::tuple<int, int, std::string>> results;
-  std::unique_ptr<sql::Connection> con(getCon());
+  std::unique_ptr<StorageConnection> con = getCon();
   if (!con)
     return results;
   try {
-    std::unique_ptr<sql::Statement> stmt(con->createStatement());
     // Joining with sessions to show current state for each TTY
-    std::unique_ptr<sql::ResultSet> res(stmt->executeQuery(
+    std::unique_ptr<StorageResult> res = con->query(
         "SELECT s.tty, h.entry_index, h.path FROM "
         "terminal_history h JOIN terminal_sessions s ON "
-        "h.entry_index = s.history_index ORDER BY s.tty, h.entry_index"));
+        "h.entry_index = s.history_index ORDER BY s.tty, h.entry_index");
     while (res->next()) {
       results.push_back(std::make_tuple(res->getInt("tty"),
                                         res->getInt("entry_index"),
                                         res->getString("path")));
     }
-  } catch (sql::SQLException &e) {
+  } catch (StorageError &e) {
     logToFile("TerminalTable: getAllHistory error: " + std::string(e.what()),
               0xFFFFFFFF);
   }
@@ -153,18 +158,18 @@ std::vector<std::tuple<int, int, std::string>> TerminalTable::getAllHistory() {
 }
 
 std::vector<std::pair<int, int>> TerminalTable::getAllSessions() {
+  WriteBehindQueue::flush();
   std::vector<std::pair<int, int>> results;
-  std::unique_ptr<sql::Connection> con(getCon());
+  std::unique_ptr<StorageConnection> con = getCon();
   if (!con)
     return results;
   try {
-    std::unique_ptr<sql::Statement> stmt(con->createStatement());
-    std::unique_ptr<sql::ResultSet> res(
-        stmt->executeQuery("SELECT tty, history_index FROM terminal_sessions"));
+    std::unique_ptr<StorageResult> res =
+        con->query("SELECT tty, history_index FROM terminal_sessions");
     while (res->next()) {
       results.push_back({res->getInt("tty"), res->getInt("history_index")});
     }
-  } catch (sql::SQLException &e) {
+  } catch (StorageError &e) {
     logToFile("TerminalTable: getAllSessions error: " + std::string(e.what()),
               0xFFFFFFFF);
   }
@@ -172,20 +177,19 @@ std::vector<std::pair<int, int>> TerminalTable::getAllSessions() {
 }
 
 int TerminalTable::getMaxHistoryIndex() {
-  std::unique_ptr<sql::Connection> con(getCon());
+  std::unique_ptr<StorageConnection> con = getCon();
   if (!con)
     return -1;
   try {
-    std::unique_ptr<sql::Statement> stmt(con->createStatement());
-    std::unique_ptr<sql::ResultSet> res(stmt->executeQuery(
-        "SELECT MAX(entry_index) as max_idx FROM terminal_history"));
+    std::unique_ptr<StorageResult> res = con->query(
+        "SELECT MAX(entry_index) as max_idx FROM terminal_history");
     if (res->next()) {
       if (res->isNull("max_idx")) {
         return -1;
       }
       return res->getInt("max_idx");
     }
-  } catch (sql::SQLException &e) {
+  } catch (StorageError &e) {
     logToFile("TerminalTable: getMaxHistoryIndex error: " +
                   std::string(e.what()),
               0xFFFFFFFF);
@@ -194,233 +198,203 @@ int TerminalTable::getMaxHistoryIndex() {
 }
 
 int TerminalTable::getHistoryCount() {
-  std::unique_ptr<sql::Connection> con(getCon());
+  std::unique_ptr<StorageConnection> con = getCon();
   if (!con)
     return 0;
   try {
-    std::unique_ptr<sql::Statement> stmt(con->createStatement());
-    std::unique_ptr<sql::ResultSet> res(
-        stmt->executeQuery("SELECT COUNT(*) as cnt FROM terminal_history"));
+    std::unique_ptr<StorageResult> res =
+        con->query("SELECT COUNT(*) as cnt FROM terminal_history");
     if (res->next())
       return res->getInt("cnt");
-  } catch (sql::SQLException &e) {
+  } catch (StorageError &e) {
     logToFile("TerminalTable: getHistoryCount error: " + std::string(e.what()),
               0xFFFFFFFF);
   }
   return 0;
 }
 
-void TerminalTable::pruneHistory(int maxSize) {
-  std::unique_ptr<sql::Connection> con(getCon());
-  if (!con)
-    return;
-  try {
-    // Get count
-    std::unique_ptr<sql::Statement> stmt(con->createStatement());
-    std::unique_ptr<sql::ResultSet> res(
-        stmt->executeQuery("SELECT COUNT(*) as cnt FROM terminal_history"));
-    if (!res->next())
-      return;
-    int count = res->getInt("cnt");
-    if (count <= maxSize)
-      return;
-
-    // Get min index
-    res.reset(stmt->executeQuery(
-        "SELECT MIN(entry_index) as min_idx FROM terminal_history"));
-    if (!res->next())
-      return;
-    int minIndex = res->getInt("min_idx");
-
-    // Delete oldest entries
-    int cutoff = minIndex + (count - maxSize);
-    std::unique_ptr<sql::PreparedStatement> pstmt(con->prepareStatement(
-        "DELETE FROM terminal_history WHERE entry_index < ?"));
-    pstmt->setInt(1, cutoff);
-    pstmt->executeUpdate();
-
-    // Get new min index after deletion
-    res.reset(stmt->executeQuery(
-        "SELECT MIN(entry_index) as min_idx FROM terminal_history"));
-    if (!res->next())
-      return;
-    int newMin = res->getInt("min_idx");
-    if (newMin <= 0)
-      return;
-
-    // Rebase history entries
-    pstmt.reset(con->prepareStatement(
-        "UPDATE terminal_history SET entry_index = entry_index - ?"));
-    pstmt->setInt(1, newMin);
-    pstmt->executeUpdate();
-
-    // Rebase session pointers
-    pstmt.reset(con->prepareStatement(
-        "UPDATE terminal_sessions SET history_index = GREATEST(0, history_index - ?)"));
-    pstmt->setInt(1, newMin);
-    pstmt->executeUpdate();
-
-    // Rebase the indexOfLastTouchedDir setting
-    std::unique_ptr<sql::PreparedStatement> getSetting(con->prepareStatement(
-        "SELECT setting_value FROM system_settings WHERE setting_key = ?"));
-    getSetting->setString(1, "indexOfLastTouchedDir");
-    res.reset(getSetting->executeQuery());
-    if (res->next()) {
-      std::string val = res->getString("setting_value");
-      try {
-        int oldIdx = std::stoi(val);
-        int newIdx = std::max(0, oldIdx - newMin);
-        std::unique_ptr<sql::PreparedStatement> upd(con->prepareStatement(
-            "UPDATE system_settings SET setting_value = ? WHERE setting_key = ?"));
-        upd->setString(1, std::to_string(newIdx));
-        upd->setString(2, "indexOfLastTouchedDir");
-        upd->executeUpdate();
-      } catch (...) {
-      }
-    }
-
-    logToFile("TerminalTable: pruneHistory pruned " +
-                  std::to_string(count - maxSize) +
-                  " entries, rebased by " + std::to_string(newMin),
-              LOG_TERMINAL);
-  } catch (sql::SQLException &e) {
-    logToFile("TerminalTable: pruneHistory error: " + std::string(e.what()),
-              0xFFFFFFFF);
-  }
-}
-
 void ConfigTable::setConfig(const std::string &key,
                             const std::string &jsonValue) {
-  std::unique_ptr<sql::Connection> con(getCon());
+  std::unique_ptr<StorageConnection> con = getCon();
   if (!con)
     return;
   try {
-    std::unique_ptr<sql::PreparedStatement> pstmt(
-        con->prepareStatement("INSERT INTO automation_configs (config_key, "
-                              "config_value) VALUES (?, ?) "
-                              "ON DUPLICATE KEY UPDATE config_value = ?"));
+    StorageStatement *pstmt =
+        con->prepare("INSERT INTO automation_configs (config_key, "
+                    "config_value) VALUES (?, ?) "
+                    "ON DUPLICATE KEY UPDATE config_value = ?");
     pstmt->setString(1, key);
     pstmt->setString(2, jsonValue);
     pstmt->setString(3, jsonValue);
     pstmt->executeUpdate();
-  } catch (sql::SQLException &e) {
+    SettingsCache::set(SettingsCache::Table::Config, key, jsonValue);
+  } catch (StorageError &e) {
     logToFile("ConfigTable: setConfig error: " + std::string(e.what()),
               0xFFFFFFFF);
   }
 }
 
 std::string ConfigTable::getConfig(const std::string &key) {
-  std::unique_ptr<sql::Connection> con(getCon());
+  std::string cached;
+  if (SettingsCache::get(SettingsCache::Table::Config, key, cached))
+    return cached;
+  if (SettingsCache::isLoaded())
+    return "";
+  std::unique_ptr<StorageConnection> con = getCon();
   if (!con)
     return "";
   try {
-    std::unique_ptr<sql::PreparedStatement> pstmt(
-        con->prepareStatement("SELECT config_value FROM automation_configs "
-                              "WHERE config_key = ?"));
+    StorageStatement *pstmt =
+        con->prepare("SELECT config_value FROM automation_configs "
+                    "WHERE config_key = ?");
     pstmt->setString(1, key);
-    std::unique_ptr<sql::ResultSet> res(pstmt->executeQuery());
+    std::unique_ptr<StorageResult> res = pstmt->executeQuery();
     if (res->next())
       return res->getString("config_value");
-  } catch (sql::SQLException &e) {
+  } catch (StorageError &e) {
     logToFile("ConfigTable: getConfig error: " + std::string(e.what()),
               0xFFFFFFFF);
   }
   return "";
 }
 
+nlohmann::json ConfigTable::getConfigJson(const std::string &key) {
+  std::string value = getConfig(key);
+  if (value.empty())
+    return nullptr;
+  nlohmann::json j = nlohmann::json::parse(value, nullptr, false);
+  if (j.is_discarded()) {
+    logToFile("ConfigTable: invalid JSON for " + key, 0xFFFFFFFF);
+    return nullptr;
+  }
+  return j;
+}
+
 // DeviceTable Implementation
 
 void DeviceTable::setDevicePath(const std::string &type,
                                 const std::string &path) {
-  std::unique_ptr<sql::Connection> con(getCon());
+  std::unique_ptr<StorageConnection> con = getCon();
   if (!con)
     return;
   try {
-    std::unique_ptr<sql::PreparedStatement> pstmt(
-        con->prepareStatement("INSERT INTO device_registry (device_type, path) "
-                              "VALUES (?, ?) "
-                              "ON DUPLICATE KEY UPDATE path = ?"));
+    StorageStatement *pstmt =
+        con->prepare("INSERT INTO device_registry (device_type, path) "
+                    "VALUES (?, ?) "
+                    "ON DUPLICATE KEY UPDATE path = ?");
     pstmt->setString(1, type);
     pstmt->setString(2, path);
     pstmt->setString(3, path);
     pstmt->executeUpdate();
-  } catch (sql::SQLException &e) {
+    SettingsCache::set(SettingsCache::Table::Device, type, path);
+  } catch (StorageError &e) {
     logToFile("DeviceTable: setDevicePath error: " + std::string(e.what()),
               0xFFFFFFFF);
   }
 }
 
 std::string DeviceTable::getDevicePath(const std::string &type) {
-  std::unique_ptr<sql::Connection> con(getCon());
+  std::string cached;
+  if (SettingsCache::get(SettingsCache::Table::Device, type, cached))
+    return cached;
+  if (SettingsCache::isLoaded())
+    return "";
+  std::unique_ptr<StorageConnection> con = getCon();
   if (!con)
     return "";
   try {
-    std::unique_ptr<sql::PreparedStatement> pstmt(
-        con->prepareStatement("SELECT path FROM device_registry WHERE "
-                              "device_type = ?"));
+    StorageStatement *pstmt =
+        con->prepare("SELECT path FROM device_registry WHERE "
+                    "device_type = ?");
     pstmt->setString(1, type);
-    std::unique_ptr<sql::ResultSet> res(pstmt->executeQuery());
+    std::unique_ptr<StorageResult> res = pstmt->executeQuery();
     if (res->next())
       return res->getString("path");
-  } catch (sql::SQLException &e) {
+  } catch (StorageError &e) {
     logToFile("DeviceTable: getDevicePath error: " + std::string(e.what()),
               0xFFFFFFFF);
   }
   return "";
 }
 
+std::filesystem::path DeviceTable::getPath(const std::string &type) {
+  return std::filesystem::path(getDevicePath(type));
+}
+
 // SettingsTable Implementation
 
 void SettingsTable::setSetting(const std::string &key,
                                const std::string &value) {
-  std::unique_ptr<sql::Connection> con(getCon());
+  WriteBehindQueue::discardSetting(key);
+  std::unique_ptr<StorageConnection> con = getCon();
   if (!con)
     return;
   try {
-    std::unique_ptr<sql::PreparedStatement> pstmt(
-        con->prepareStatement("INSERT INTO system_settings (setting_key, "
-                              "setting_value) VALUES (?, ?) "
-                              "ON DUPLICATE KEY UPDATE setting_value = ?"));
+    StorageStatement *pstmt =
+        con->prepare("INSERT INTO system_settings (setting_key, "
+                    "setting_value) VALUES (?, ?) "
+                    "ON DUPLICATE KEY UPDATE setting_value = ?");
     pstmt->setString(1, key);
     pstmt->setString(2, value);
     pstmt->setString(3, value);
     pstmt->executeUpdate();
-  } catch (sql::SQLException &e) {
+    SettingsCache::set(SettingsCache::Table::Settings, key, value);
+  } catch (StorageError &e) {
     logToFile("SettingsTable: setSetting error: " + std::string(e.what()),
               0xFFFFFFFF);
   }
 }
 
 std::string SettingsTable::getSetting(const std::string &key) {
-  std::unique_ptr<sql::Connection> con(getCon());
+  std::string pendingValue;
+  if (WriteBehindQueue::getPendingSetting(key, pendingValue))
+    return pendingValue;
+  if (SettingsCache::get(SettingsCache::Table::Settings, key, pendingValue))
+    return pendingValue;
+  if (SettingsCache::isLoaded())
+    return "";
+  std::unique_ptr<StorageConnection> con = getCon();
   if (!con)
     return "";
   try {
-    std::unique_ptr<sql::PreparedStatement> pstmt(
-        con->prepareStatement("SELECT setting_value FROM system_settings WHERE "
-                              "setting_key = ?"));
+    StorageStatement *pstmt =
+        con->prepare("SELECT setting_value FROM system_settings WHERE "
+                    "setting_key = ?");
     pstmt->setString(1, key);
-    std::unique_ptr<sql::ResultSet> res(pstmt->executeQuery());
+    std::unique_ptr<StorageResult> res = pstmt->executeQuery();
     if (res->next())
       return res->getString("setting_value");
-  } catch (sql::SQLException &e) {
+  } catch (StorageError &e) {
     logToFile("SettingsTable: getSetting error: " + std::string(e.what()),
               0xFFFFFFFF);
   }
   return "";
 }
 
+int SettingsTable::getSettingInt(const std::string &key, int defaultValue) {
+  std::string value = getSetting(key);
+  if (value.empty())
+    return defaultValue;
+  try {
+    return std::stoi(value);
+  } catch (...) {
+    return defaultValue;
+  }
+}
+
 int SettingsTable::deleteSetting(const std::string &key) {
-  std::unique_ptr<sql::Connection> con(getCon());
+  WriteBehindQueue::discardSetting(key);
+  std::unique_ptr<StorageConnection> con = getCon();
   if (!con)
     return 0;
   try {
-    std::unique_ptr<sql::PreparedStatement> pstmt(
-        con->prepareStatement("DELETE FROM system_settings "
-                              "WHERE setting_key = ?"));
+    StorageStatement *pstmt = con->prepare("DELETE FROM system_settings "
+                              "WHERE setting_key = ?");
     pstmt->setString(1, key);
-    return pstmt->executeUpdate();
-  } catch (sql::SQLException &e) {
+    int rc = pstmt->executeUpdate();
+    SettingsCache::erase(SettingsCache::Table::Settings, key);
+    return rc;
+  } catch (StorageError &e) {
     logToFile("SettingsTable: deleteSetting error: " + std::string(e.what()),
               0xFFFFFFFF);
     return 0;
@@ -428,19 +402,21 @@ int SettingsTable::deleteSetting(const std::string &key) {
 }
 std::vector<std::pair<std::string, std::string>>
 SettingsTable::getAllSettings() {
+  if (SettingsCache::isLoaded())
+    return SettingsCache::getAll(SettingsCache::Table::Settings);
+  WriteBehindQueue::flush();
   std::vector<std::pair<std::string, std::string>> results;
-  std::unique_ptr<sql::Connection> con(getCon());
+  std::unique_ptr<StorageConnection> con = getCon();
   if (!con)
     return results;
   try {
-    std::unique_ptr<sql::Statement> stmt(con->createStatement());
-    std::unique_ptr<sql::ResultSet> res(stmt->executeQuery(
-        "SELECT setting_key, setting_value FROM system_settings"));
+    std::unique_ptr<StorageResult> res = con->query(
+        "SELECT setting_key, setting_value FROM system_settings");
     while (res->next()) {
       results.push_back(
           {res->getString("setting_key"), res->getString("setting_value")});
     }
-  } catch (sql::SQLException &e) {
+  } catch (StorageError &e) {
     logToFile("SettingsTable: getAllSettings error: " + std::string(e.what()),
               0xFFFFFFFF);
   }
@@ -452,18 +428,18 @@ SettingsTable::getAllSettings() {
 void PeerTable::upsertPeer(const std::string &peer_id, const std::string &ip,
                            const std::string &mac, const std::string &hostname,
                            bool is_online, int daemon_version) {
-  std::unique_ptr<sql::Connection> con(getCon());
+  std::unique_ptr<StorageConnection> con = getCon();
   if (!con)
     return;
   try {
-    std::unique_ptr<sql::PreparedStatement> pstmt(con->prepareStatement(
+    StorageStatement *pstmt = con->prepare(
         "INSERT INTO peer_registry (peer_id, ip_address, mac_address, "
         "hostname, "
         "is_online, last_seen, daemon_version) VALUES (?, ?, ?, ?, ?, NOW(), "
         "?) "
         "ON DUPLICATE KEY UPDATE ip_address = ?, mac_address = ?, hostname = "
         "?, "
-        "is_online = ?, last_seen = NOW(), daemon_version = ?"));
+        "is_online = ?, last_seen = NOW(), daemon_version = ?");
     pstmt->setString(1, peer_id);
     pstmt->setString(2, ip);
     pstmt->setString(3, mac);
@@ -476,24 +452,41 @@ void PeerTable::upsertPeer(const std::string &peer_id, const std::string &ip,
     pstmt->setBoolean(10, is_online);
     pstmt->setInt(11, daemon_version);
     pstmt->executeUpdate();
-  } catch (sql::SQLException &e) {
+  } catch (StorageError &e) {
     logToFile("PeerTable: upsertPeer error: " + std::string(e.what()),
               0xFFFFFFFF);
   }
+  if (PeerRegistry::isLoaded()) {
+    PeerRecord peer;
+    peer.peer_id = peer_id;
+    peer.ip_address = ip;
+    peer.mac_address = mac;
+    peer.hostname = hostname;
+    peer.is_online = is_online;
+    peer.daemon_version = daemon_version;
+    PeerRegistry::put(peer);
+  }
+  ReplicationLog::recordPeer(peer_id);
 }
 
 PeerRecord PeerTable::getPeer(const std::string &peer_id) {
   PeerRecord result;
-  std::unique_ptr<sql::Connection> con(getCon());
+  if (PeerRegistry::isLoaded()) {
+    PeerRegistry::get(peer_id, result);
+    return result;
+  }
+  if (WriteBehindQueue::hasPendingPeers())
+    WriteBehindQueue::flush();
+  std::unique_ptr<StorageConnection> con = getCon();
   if (!con)
     return result;
   try {
-    std::unique_ptr<sql::PreparedStatement> pstmt(con->prepareStatement(
+    StorageStatement *pstmt = con->prepare(
         "SELECT peer_id, ip_address, mac_address, hostname, last_seen, "
         "is_online, "
-        "daemon_version FROM peer_registry WHERE peer_id = ?"));
+        "daemon_version FROM peer_registry WHERE peer_id = ?");
     pstmt->setString(1, peer_id);
-    std::unique_ptr<sql::ResultSet> res(pstmt->executeQuery());
+    std::unique_ptr<StorageResult> res = pstmt->executeQuery();
     if (res->next()) {
       result.peer_id = res->getString("peer_id");
       result.ip_address = res->getString("ip_address");
@@ -503,26 +496,29 @@ PeerRecord PeerTable::getPeer(const std::string &peer_id) {
       result.is_online = res->getBoolean("is_online");
       result.daemon_version = res->getInt("daemon_version");
     }
-  } catch (sql::SQLException &e) {
+  } catch (StorageError &e) {
     logToFile("PeerTable: getPeer error: " + std::string(e.what()), 0xFFFFFFFF);
   }
   return result;
 }
 
 std::vector<PeerRecord> PeerTable::getAllPeers() {
+  if (PeerRegistry::isLoaded())
+    return PeerRegistry::getAll();
+  if (WriteBehindQueue::hasPendingPeers())
+    WriteBehindQueue::flush();
   std::vector<PeerRecord> results;
-  std::unique_ptr<sql::Connection> con(getCon());
+  std::unique_ptr<StorageConnection> con = getCon();
   if (!con)
     return results;
   try {
-    std::unique_ptr<sql::Statement> stmt(con->createStatement());
     // Mark as offline if last_seen > 20s ago (heartbeat is every 10s, so
     // 20s gives 100% grace period). Using IF to avoid alias conflicts.
-    std::unique_ptr<sql::ResultSet> res(stmt->executeQuery(
+    std::unique_ptr<StorageResult> res = con->query(
         "SELECT peer_id, ip_address, mac_address, hostname, last_seen, "
         "IF(is_online = 1 AND last_seen > NOW() - INTERVAL 20 SECOND, 1, 0) as "
         "is_online_calculated, "
-        "daemon_version FROM peer_registry ORDER BY peer_id"));
+        "daemon_version FROM peer_registry ORDER BY peer_id");
     while (res->next()) {
       PeerRecord record;
       record.peer_id = res->getString("peer_id");
@@ -534,7 +530,7 @@ std::vector<PeerRecord> PeerTable::getAllPeers() {
       record.daemon_version = res->getInt("daemon_version");
       results.push_back(record);
     }
-  } catch (sql::SQLException &e) {
+  } catch (StorageError &e) {
     logToFile("PeerTable: getAllPeers error: " + std::string(e.what()),
               0xFFFFFFFF);
   }
@@ -542,82 +538,78 @@ std::vector<PeerRecord> PeerTable::getAllPeers() {
 }
 
 void PeerTable::updateOnlineStatus(const std::string &peer_id, bool is_online) {
-  std::unique_ptr<sql::Connection> con(getCon());
+  // The registry persists the change with its next batch
+  if (PeerRegistry::isLoaded()) {
+    PeerRegistry::setOnline(peer_id, is_online);
+    ReplicationLog::recordPeer(peer_id);
+    return;
+  }
+  WriteBehindQueue::discardPeer(peer_id);
+  std::unique_ptr<StorageConnection> con = getCon();
   if (!con)
     return;
   try {
-    std::unique_ptr<sql::PreparedStatement> pstmt(con->prepareStatement(
+    StorageStatement *pstmt = con->prepare(
         "UPDATE peer_registry SET is_online = ?, last_seen = NOW() "
-        "WHERE peer_id = ?"));
+        "WHERE peer_id = ?");
     pstmt->setBoolean(1, is_online);
     pstmt->setString(2, peer_id);
     pstmt->executeUpdate();
-  } catch (sql::SQLException &e) {
+  } catch (StorageError &e) {
     logToFile("PeerTable: updateOnlineStatus error: " + std::string(e.what()),
               0xFFFFFFFF);
   }
+  ReplicationLog::recordPeer(peer_id);
 }
 
 void PeerTable::touchLastSeen(const std::string &peer_id) {
-  std::unique_ptr<sql::Connection> con(getCon());
-  if (!con)
-    return;
-  try {
-    std::unique_ptr<sql::PreparedStatement> pstmt(
-        con->prepareStatement("UPDATE peer_registry SET last_seen = NOW(), "
-                              "is_online = 1 WHERE peer_id = ?"));
-    pstmt->setString(1, peer_id);
-    pstmt->executeUpdate();
-  } catch (sql::SQLException &e) {
-    logToFile("PeerTable: touchLastSeen error: " + std::string(e.what()),
-              0xFFFFFFFF);
-  }
+  touchLastSeen(peer_id, -1);
 }
 
+// Heartbeat path: memory only once the registry is loaded, else coalesced
+// through the write-behind queue
 void PeerTable::touchLastSeen(const std::string &peer_id, int daemon_version) {
-  std::unique_ptr<sql::Connection> con(getCon());
-  if (!con)
-    return;
-  try {
-    std::unique_ptr<sql::PreparedStatement> pstmt(con->prepareStatement(
-        "UPDATE peer_registry SET last_seen = NOW(), is_online = 1, "
-        "daemon_version = ? WHERE peer_id = ?"));
-    pstmt->setInt(1, daemon_version);
-    pstmt->setString(2, peer_id);
-    pstmt->executeUpdate();
-  } catch (sql::SQLException &e) {
-    logToFile("PeerTable: touchLastSeen error: " + std::string(e.what()),
-              0xFFFFFFFF);
-  }
+  if (PeerRegistry::isLoaded())
+    PeerRegistry::heartbeat(peer_id, daemon_version);
+  else
+    WriteBehindQueue::touchLastSeen(peer_id, daemon_version);
 }
 
 void PeerTable::deletePeer(const std::string &peer_id) {
-  std::unique_ptr<sql::Connection> con(getCon());
+  WriteBehindQueue::discardPeer(peer_id);
+  PeerRegistry::erase(peer_id);
+  std::unique_ptr<StorageConnection> con = getCon();
   if (!con)
     return;
   try {
-    std::unique_ptr<sql::PreparedStatement> pstmt(
-        con->prepareStatement("DELETE FROM peer_registry WHERE peer_id = ?"));
+    StorageStatement *pstmt =
+        con->prepare("DELETE FROM peer_registry WHERE peer_id = ?");
     pstmt->setString(1, peer_id);
     pstmt->executeUpdate();
-  } catch (sql::SQLException &e) {
+  } catch (StorageError &e) {
     logToFile("PeerTable: deletePeer error: " + std::string(e.what()),
               0xFFFFFFFF);
   }
+  ReplicationLog::recordPeer(peer_id);
 }
 
 std::string PeerTable::getIpAddress(const std::string &peer_id) {
-  std::unique_ptr<sql::Connection> con(getCon());
+  if (PeerRegistry::isLoaded()) {
+    PeerRecord peer;
+    PeerRegistry::get(peer_id, peer);
+    return peer.ip_address;
+  }
+  std::unique_ptr<StorageConnection> con = getCon();
   if (!con)
     return "";
   try {
-    std::unique_ptr<sql::PreparedStatement> pstmt(con->prepareStatement(
-        "SELECT ip_address FROM peer_registry WHERE peer_id = ?"));
+    StorageStatement *pstmt = con->prepare(
+        "SELECT ip_address FROM peer_registry WHERE peer_id = ?");
     pstmt->setString(1, peer_id);
-    std::unique_ptr<sql::ResultSet> res(pstmt->executeQuery());
+    std::unique_ptr<StorageResult> res = pstmt->executeQuery();
     if (res->next())
       return res->getString("ip_address");
-  } catch (sql::SQLException &e) {
+  } catch (StorageError &e) {
     logToFile("PeerTable: getIpAddress error: " + std::string(e.what()),
               0xFFFFFFFF);
   }
@@ -625,27 +617,56 @@ std::string PeerTable::getIpAddress(const std::string &peer_id) {
 }
 
 int PeerTable::clearAllPeers() {
-  std::unique_ptr<sql::Connection> con(getCon());
+  WriteBehindQueue::discardAllPeers();
+  PeerRegistry::clear();
+  ReplicationLog::recordPeersCleared();
+  std::unique_ptr<StorageConnection> con = getCon();
   if (!con)
     return 0;
   try {
-    std::unique_ptr<sql::Statement> stmt(con->createStatement());
-    return stmt->executeUpdate("DELETE FROM peer_registry");
-  } catch (sql::SQLException &e) {
+    return con->execute("DELETE FROM peer_registry");
+  } catch (StorageError &e) {
     logToFile("PeerTable: clearAllPeers error: " + std::string(e.what()),
               0xFFFFFFFF);
     return 0;
   }
 }
 
+void PeerTable::saveLiveness(const std::vector<PeerRecord> &peers) {
+  std::unique_ptr<StorageConnection> con = getCon();
+  if (!con)
+    return;
+  try {
+    con->begin();
+    for (const PeerRecord &peer : peers) {
+      StorageStatement *pstmt = con->prepare(
+          "UPDATE peer_registry SET last_seen = ?, is_online = ?, "
+          "daemon_version = ? WHERE peer_id = ?");
+      pstmt->setString(1, peer.last_seen);
+      pstmt->setBoolean(2, peer.is_online);
+      pstmt->setInt(3, peer.daemon_version);
+      pstmt->setString(4, peer.peer_id);
+      pstmt->executeUpdate();
+    }
+    con->commit();
+  } catch (StorageError &e) {
+    logToFile("PeerTable: saveLiveness error: " + std::string(e.what()),
+              0xFFFFFFFF);
+    try {
+      con->rollback();
+    } catch (StorageError &) {
+    }
+  }
+}
+
 // ExtraAppTable Implementation
 
 void ExtraAppTable::upsertApp(const ExtraAppRecord &app) {
-  std::unique_ptr<sql::Connection> con(getCon());
+  std::unique_ptr<StorageConnection> con = getCon();
   if (!con)
     return;
   try {
-    std::unique_ptr<sql::PreparedStatement> pstmt(con->prepareStatement(
+    StorageStatement *pstmt = con->prepare(
         "INSERT INTO extra_apps (app_id, display_name, repo_url, "
         "has_server_component, server_service_template, "
         "client_service_template, "
@@ -657,7 +678,7 @@ void ExtraAppTable::upsertApp(const ExtraAppRecord &app) {
         "client_service_template = ?, port_key_client = ?, port_key_server = "
         "?, "
         "dev_path = ?, prod_path = ?, server_build_subdir = ?, client_subdir = "
-        "?"));
+        "?");
     // Insert values
     pstmt->setString(1, app.app_id);
     pstmt->setString(2, app.display_name);
@@ -684,7 +705,7 @@ void ExtraAppTable::upsertApp(const ExtraAppRecord &app) {
     pstmt->setString(22, app.server_build_subdir);
     pstmt->setString(23, app.client_subdir);
     pstmt->executeUpdate();
-  } catch (sql::SQLException &e) {
+  } catch (StorageError &e) {
     logToFile("ExtraAppTable: upsertApp error: " + std::string(e.what()),
               0xFFFFFFFF);
   }
@@ -692,18 +713,18 @@ void ExtraAppTable::upsertApp(const ExtraAppRecord &app) {
 
 ExtraAppRecord ExtraAppTable::getApp(const std::string &app_id) {
   ExtraAppRecord result{"", "", "", false, "", "", "", "", "", "", "", ""};
-  std::unique_ptr<sql::Connection> con(getCon());
+  std::unique_ptr<StorageConnection> con = getCon();
   if (!con)
     return result;
   try {
-    std::unique_ptr<sql::PreparedStatement> pstmt(con->prepareStatement(
+    StorageStatement *pstmt = con->prepare(
         "SELECT app_id, display_name, repo_url, has_server_component, "
         "server_service_template, client_service_template, port_key_client, "
         "port_key_server, dev_path, prod_path, server_build_subdir, "
         "client_subdir "
-        "FROM extra_apps WHERE app_id = ?"));
+        "FROM extra_apps WHERE app_id = ?");
     pstmt->setString(1, app_id);
-    std::unique_ptr<sql::ResultSet> res(pstmt->executeQuery());
+    std::unique_ptr<StorageResult> res = pstmt->executeQuery();
     if (res->next()) {
       auto safeStr = [&](const char *col) -> std::string {
         return res->isNull(col) ? "" : std::string(res->getString(col));
@@ -721,7 +742,7 @@ ExtraAppRecord ExtraAppTable::getApp(const std::string &app_id) {
       result.server_build_subdir = safeStr("server_build_subdir");
       result.client_subdir = safeStr("client_subdir");
     }
-  } catch (sql::SQLException &e) {
+  } catch (StorageError &e) {
     logToFile("ExtraAppTable: getApp error: " + std::string(e.what()),
               0xFFFFFFFF);
   }
@@ -730,17 +751,16 @@ ExtraAppRecord ExtraAppTable::getApp(const std::string &app_id) {
 
 std::vector<ExtraAppRecord> ExtraAppTable::getAllApps() {
   std::vector<ExtraAppRecord> results;
-  std::unique_ptr<sql::Connection> con(getCon());
+  std::unique_ptr<StorageConnection> con = getCon();
   if (!con)
     return results;
   try {
-    std::unique_ptr<sql::Statement> stmt(con->createStatement());
-    std::unique_ptr<sql::ResultSet> res(stmt->executeQuery(
+    std::unique_ptr<StorageResult> res = con->query(
         "SELECT app_id, display_name, repo_url, has_server_component, "
         "server_service_template, client_service_template, port_key_client, "
         "port_key_server, dev_path, prod_path, server_build_subdir, "
         "client_subdir "
-        "FROM extra_apps ORDER BY app_id"));
+        "FROM extra_apps ORDER BY app_id");
     while (res->next()) {
       auto safeStr = [&](const char *col) -> std::string {
         return res->isNull(col) ? "" : std::string(res->getString(col));
@@ -760,7 +780,7 @@ std::vector<ExtraAppRecord> ExtraAppTable::getAllApps() {
       record.client_subdir = safeStr("client_subdir");
       results.push_back(record);
     }
-  } catch (sql::SQLException &e) {
+  } catch (StorageError &e) {
     logToFile("ExtraAppTable: getAllApps error: " + std::string(e.what()),
               0xFFFFFFFF);
   }
@@ -768,33 +788,98 @@ std::vector<ExtraAppRecord> ExtraAppTable::getAllApps() {
 }
 
 void ExtraAppTable::deleteApp(const std::string &app_id) {
-  std::unique_ptr<sql::Connection> con(getCon());
+  std::unique_ptr<StorageConnection> con = getCon();
   if (!con)
     return;
   try {
-    std::unique_ptr<sql::PreparedStatement> pstmt(
-        con->prepareStatement("DELETE FROM extra_apps WHERE app_id = ?"));
+    StorageStatement *pstmt =
+        con->prepare("DELETE FROM extra_apps WHERE app_id = ?");
     pstmt->setString(1, app_id);
     pstmt->executeUpdate();
-  } catch (sql::SQLException &e) {
+  } catch (StorageError &e) {
     logToFile("ExtraAppTable: deleteApp error: " + std::string(e.what()),
               0xFFFFFFFF);
   }
 }
 
 bool ExtraAppTable::appExists(const std::string &app_id) {
-  std::unique_ptr<sql::Connection> con(getCon());
+  std::unique_ptr<StorageConnection> con = getCon();
   if (!con)
     return false;
   try {
-    std::unique_ptr<sql::PreparedStatement> pstmt(
-        con->prepareStatement("SELECT 1 FROM extra_apps WHERE app_id = ?"));
+    StorageStatement *pstmt =
+        con->prepare("SELECT 1 FROM extra_apps WHERE app_id = ?");
     pstmt->setString(1, app_id);
-    std::unique_ptr<sql::ResultSet> res(pstmt->executeQuery());
+    std::unique_ptr<StorageResult> res = pstmt->executeQuery();
     return res->next();
-  } catch (sql::SQLException &e) {
+  } catch (StorageError &e) {
     logToFile("ExtraAppTable: appExists error: " + std::string(e.what()),
               0xFFFFFFFF);
   }
   return false;
 }
+
+// PortLeaseTable Implementation
+
+void PortLeaseTable::upsertLease(const PortLeaseRecord &lease) {
+  std::unique_ptr<StorageConnection> con = getCon();
+  if (!con)
+    return;
+  try {
+    StorageStatement *pstmt = con->prepare(
+        "INSERT INTO port_leases (port_key, app_id, peer_id, leased_at) "
+        "VALUES (?, ?, ?, NOW()) "
+        "ON DUPLICATE KEY UPDATE app_id = ?, peer_id = ?, leased_at = NOW()");
+    pstmt->setString(1, lease.port_key);
+    pstmt->setString(2, lease.app_id);
+    pstmt->setString(3, lease.peer_id);
+    pstmt->setString(4, lease.app_id);
+    pstmt->setString(5, lease.peer_id);
+    pstmt->executeUpdate();
+  } catch (StorageError &e) {
+    logToFile("PortLeaseTable: upsertLease error: " + std::string(e.what()),
+              0xFFFFFFFF);
+  }
+}
+
+void PortLeaseTable::deleteLease(const std::string &port_key) {
+  std::unique_ptr<StorageConnection> con = getCon();
+  if (!con)
+    return;
+  try {
+    StorageStatement *pstmt =
+        con->prepare("DELETE FROM port_leases WHERE port_key = ?");
+    pstmt->setString(1, port_key);
+    pstmt->executeUpdate();
+  } catch (StorageError &e) {
+    logToFile("PortLeaseTable: deleteLease error: " + std::string(e.what()),
+              0xFFFFFFFF);
+  }
+}
+
+std::vector<PortLeaseRecord> PortLeaseTable::getAllLeases() {
+  std::vector<PortLeaseRecord> results;
+  std::unique_ptr<StorageConnection> con = getCon();
+  if (!con)
+    return results;
+  try {
+    std::unique_ptr<StorageResult> res = con->query(
+        "SELECT port_key, app_id, peer_id, leased_at FROM port_leases "
+        "ORDER BY port_key");
+    while (res->next()) {
+      auto safeStr = [&](const char *col) -> std::string {
+        return res->isNull(col) ? "" : std::string(res->getString(col));
+      };
+      PortLeaseRecord lease;
+      lease.port_key = safeStr("port_key");
+      lease.app_id = safeStr("app_id");
+      lease.peer_id = safeStr("peer_id");
+      lease.leased_at = safeStr("leased_at");
+      results.push_back(lease);
+    }
+  } catch (StorageError &e) {
+    logToFile("PortLeaseTable: getAllLeases error: " + std::string(e.what()),
+              0xFFFFFFFF);
+  }
+  return results;
+}
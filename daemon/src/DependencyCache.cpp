@@ -0,0 +1,244 @@
+#include "DependencyCache.h"
+#include "Globals.h"
+#include "Utils.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <unistd.h>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+const size_t KEEP_TREES = 10;          // Most recently used trees kept
+const char *STAMP = ".deps-key";       // In node_modules: key it came from
+const char *SECONDS = ".install-seconds"; // In a cache entry: npm's time
+
+std::atomic<unsigned> tempCounter{0};
+
+bool hashFile(uint64_t &hash, const fs::path &file) {
+  std::ifstream in(file, std::ios::binary);
+  if (!in)
+    return false;
+  std::vector<char> buffer(65536);
+  while (in.read(buffer.data(), buffer.size()) || in.gcount() > 0)
+    fnv1a(hash, buffer.data(), (size_t)in.gcount());
+  fnv1a(hash, "", 1); // Separate the files
+  return true;
+}
+
+// Empty without a lockfile. Native modules are built for the node binary,
+// so a node upgrade changes the key.
+std::string keyFor(const std::string &dir) {
+  uint64_t hash = FNV1A_OFFSET_BASIS;
+  if (!hashFile(hash, fs::path(dir) / "package-lock.json"))
+    return "";
+  hashFile(hash, fs::path(dir) / "package.json");
+  std::error_code ec;
+  fs::path node = fs::canonical("/usr/bin/node", ec);
+  if (!ec) {
+    std::string id = node.string() + ":" +
+                     std::to_string(fs::file_size(node, ec)) + ":" +
+                     std::to_string(fs::last_write_time(node, ec)
+                                        .time_since_epoch()
+                                        .count());
+    fnv1a(hash, id.c_str(), id.size());
+  }
+  return hashToHex(hash);
+}
+
+std::string firstLine(const fs::path &file) {
+  std::ifstream in(file);
+  std::string line;
+  std::getline(in, line);
+  return line;
+}
+
+// Replaced rather than rewritten: in a linked tree the old file may be
+// shared with the cache
+void writeFile(const fs::path &file, const std::string &text) {
+  ::unlink(file.c_str());
+  std::ofstream out(file);
+  out << text << "\n";
+}
+
+double recordedSeconds(const fs::path &entry) {
+  try {
+    return std::stod(firstLine(entry / SECONDS));
+  } catch (...) {
+    return 0;
+  }
+}
+
+double secondsSince(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                       start)
+      .count();
+}
+
+fs::path tempSibling(const fs::path &path) {
+  return path.string() + ".tmp-" + std::to_string(getpid()) + "-" +
+         std::to_string(tempCounter++);
+}
+
+// Copy the tree at from to to (which must not exist) sharing its data:
+// reflinks on filesystems with copy-on-write, else hardlinks, else a plain
+// copy (the cache on another filesystem). Returns how, empty on failure.
+std::string shareTree(const fs::path &from, const fs::path &to) {
+  const std::pair<const char *, const char *> methods[] = {
+      {"reflinked", "/usr/bin/cp -a --reflink=always "},
+      {"hardlinked", "/usr/bin/cp -al "},
+      {"copied", "/usr/bin/cp -a "}};
+  std::error_code ec;
+  for (const auto &[how, cp] : methods) {
+    std::string cmd = std::string(cp) + from.string() + " " + to.string() +
+                      " >/dev/null 2>&1";
+    if (std::system(cmd.c_str()) == 0)
+      return how;
+    fs::remove_all(to, ec);
+  }
+  return "";
+}
+
+// Swap dir/node_modules for a copy of the cached tree
+std::string linkFromCache(const fs::path &entry, const fs::path &modules) {
+  fs::path incoming = tempSibling(modules);
+  std::string how = shareTree(entry / "node_modules", incoming);
+  if (how.empty())
+    return "";
+  std::error_code ec;
+  fs::path old = tempSibling(modules);
+  fs::rename(modules, old, ec); // Absent on a first install
+  fs::rename(incoming, modules, ec);
+  if (ec) {
+    fs::remove_all(incoming, ec);
+    return "";
+  }
+  fs::remove_all(old, ec);
+  return how;
+}
+
+// Keep the most recently used trees
+void prune() {
+  std::error_code ec;
+  std::vector<std::pair<fs::file_time_type, fs::path>> entries;
+  for (const auto &item :
+       fs::directory_iterator(DependencyCache::directory(), ec)) {
+    std::string name = item.path().filename().string();
+    if (item.is_directory(ec) && name.find(".tmp-") == std::string::npos)
+      entries.push_back({fs::last_write_time(item.path(), ec), item.path()});
+  }
+  if (entries.size() <= KEEP_TREES)
+    return;
+  std::sort(entries.begin(), entries.end());
+  for (size_t i = 0; i + KEEP_TREES < entries.size(); i++) {
+    fs::remove_all(entries[i].second, ec);
+    logToFile("DependencyCache: evicted " +
+                  entries[i].second.filename().string(),
+              LOG_CORE);
+  }
+}
+
+// Store the tree npm just installed under key, with npm's time
+void store(const std::string &key, const fs::path &modules, double seconds) {
+  std::error_code ec;
+  fs::path entry = fs::path(DependencyCache::directory()) / key;
+  if (fs::exists(entry / SECONDS, ec))
+    return;
+  fs::create_directories(DependencyCache::directory(), ec);
+  fs::path staging = tempSibling(entry);
+  fs::create_directories(staging, ec);
+  if (ec || shareTree(modules, staging / "node_modules").empty()) {
+    logToFile("DependencyCache: cannot store " + key, 0xFFFFFFFF);
+    fs::remove_all(staging, ec);
+    return;
+  }
+  writeFile(staging / SECONDS, std::to_string(seconds));
+  fs::rename(staging, entry, ec);
+  if (ec) // Another install stored it first
+    fs::remove_all(staging, ec);
+  else
+    logToFile("DependencyCache: stored " + key, LOG_CORE);
+  prune();
+}
+
+bool runNpm(const std::string &dir, std::string &output) {
+  std::string npmCmd = "cd " + dir + " && /usr/bin/npm install 2>&1";
+  output = executeCommand(npmCmd.c_str());
+  return output.find("ERR!") == std::string::npos &&
+         output.find("error") == std::string::npos;
+}
+
+} // namespace
+
+std::string DependencyCache::directory() {
+  return directories.data + "npm-cache/";
+}
+
+DependencyInstall DependencyCache::install(const std::string &dir) {
+  DependencyInstall result;
+  auto start = std::chrono::steady_clock::now();
+  fs::path modules = fs::path(dir) / "node_modules";
+  std::error_code ec;
+
+  std::string key = keyFor(dir);
+  if (key.empty()) {
+    result.how = "installed";
+    result.ok = runNpm(dir, result.output);
+    result.seconds = secondsSince(start);
+    return result;
+  }
+
+  fs::path entry = fs::path(directory()) / key;
+  double recorded = recordedSeconds(entry);
+  if (fs::is_directory(modules, ec) && firstLine(modules / STAMP) == key) {
+    result.ok = true;
+    result.how = "unchanged";
+  } else if (recorded > 0) {
+    result.how = linkFromCache(entry, modules);
+    result.ok = !result.how.empty();
+    if (result.ok)
+      writeFile(modules / STAMP, key);
+  }
+  if (result.ok) {
+    fs::last_write_time(entry, fs::file_time_type::clock::now(), ec);
+    result.seconds = secondsSince(start);
+    result.savedSeconds = std::max(0.0, recorded - result.seconds);
+    return result;
+  }
+
+  // A tree from the cache shares its files; npm must not update them in place
+  if (fs::exists(modules / STAMP, ec))
+    fs::remove_all(modules, ec);
+  result.how = "installed";
+  result.ok = runNpm(dir, result.output);
+  result.seconds = secondsSince(start);
+  if (!result.ok)
+    return result;
+
+  key = keyFor(dir); // npm may have rewritten the lockfile
+  store(key, modules, result.seconds);
+  writeFile(modules / STAMP, key);
+  return result;
+}
+
+std::string DependencyCache::describe(const DependencyInstall &install) {
+  char text[128];
+  if (install.how == "installed") {
+    snprintf(text, sizeof(text), "npm install: OK (%.1fs)", install.seconds);
+  } else if (install.how == "unchanged") {
+    snprintf(text, sizeof(text),
+             "npm install: OK (lockfile unchanged, saved %.1fs)",
+             install.savedSeconds);
+  } else {
+    snprintf(text, sizeof(text), "npm install: OK (%s from cache, saved %.1fs)",
+             install.how.c_str(), install.savedSeconds);
+  }
+  return text;
+}
@@ -0,0 +1,173 @@
+#include "DirHistory.h"
+#include "Constants.h"
+#include "DatabaseTableManagers.h"
+#include "DirJumpIndex.h"
+#include "Utils.h"
+#include "WriteBehindQueue.h"
+#include <algorithm>
+#include <mutex>
+#include <unordered_map>
+
+namespace {
+
+struct Slot {
+  int seq = -1; // Sequence stored here; a slot is valid only if it matches
+  std::string path;
+};
+
+std::mutex historyMutex;
+std::vector<Slot> ring(MAX_DIR_HISTORY_SIZE);
+int oldestSeq = 0;
+int newestSeq = 0; // One past the newest
+std::unordered_map<int, int> cursors;
+int lastTouchedSeq = -1;
+
+Slot &slotFor(int seq) { return ring[seq % ring.size()]; }
+
+int clampToRing(int seq) { return seq < oldestSeq ? oldestSeq : seq; }
+
+} // namespace
+
+void DirHistory::load() {
+  std::vector<std::pair<int, std::string>> rows =
+      TerminalTable::getAllHistoryEntries();
+  std::vector<std::pair<int, int>> sessions = TerminalTable::getAllSessions();
+  std::string lastTouched = SettingsTable::getSetting(INDEX_OF_LAST_TOUCHED_DIR_KEY);
+
+  std::lock_guard<std::mutex> lock(historyMutex);
+  ring.assign(MAX_DIR_HISTORY_SIZE, Slot());
+  cursors.clear();
+  oldestSeq = newestSeq = 0;
+  if (!rows.empty()) {
+    // Rows come ordered by entry_index; keep the newest ring-full
+    newestSeq = rows.back().first + 1;
+    oldestSeq = std::max(rows.front().first,
+                         newestSeq - static_cast<int>(ring.size()));
+    for (const auto &[seq, path] : rows) {
+      if (seq >= oldestSeq)
+        slotFor(seq) = {seq, path};
+    }
+  }
+  for (const auto &[tty, seq] : sessions)
+    cursors[tty] = seq;
+  lastTouchedSeq = -1;
+  if (!lastTouched.empty()) {
+    try {
+      lastTouchedSeq = std::stoi(lastTouched);
+    } catch (...) {
+    }
+  }
+  // The ring may have wrapped past it since it was saved
+  if (lastTouchedSeq >= 0)
+    lastTouchedSeq = newestSeq > oldestSeq
+                         ? std::clamp(lastTouchedSeq, oldestSeq, newestSeq - 1)
+                         : -1;
+  DirJumpIndex::clear();
+  for (int seq = oldestSeq; seq < newestSeq; seq++) {
+    const Slot &slot = slotFor(seq);
+    if (slot.seq == seq)
+      DirJumpIndex::addVisit(slot.path, seq);
+  }
+  logToFile("DirHistory: Loaded " + std::to_string(newestSeq - oldestSeq) +
+                " entries (seq " + std::to_string(oldestSeq) + ".." +
+                std::to_string(newestSeq) + "), " +
+                std::to_string(cursors.size()) + " cursors",
+            LOG_TERMINAL);
+}
+
+bool DirHistory::get(int seq, std::string &path) {
+  std::lock_guard<std::mutex> lock(historyMutex);
+  if (seq < oldestSeq || seq >= newestSeq)
+    return false;
+  const Slot &slot = slotFor(seq);
+  if (slot.seq != seq)
+    return false;
+  path = slot.path;
+  return true;
+}
+
+int DirHistory::append(const std::string &path) {
+  int seq, floorSeq;
+  Slot evicted;
+  {
+    std::lock_guard<std::mutex> lock(historyMutex);
+    seq = newestSeq++;
+    evicted = std::move(slotFor(seq));
+    slotFor(seq) = {seq, path};
+    oldestSeq = std::max(oldestSeq, newestSeq - static_cast<int>(ring.size()));
+    floorSeq = oldestSeq;
+  }
+  if (evicted.seq >= 0)
+    DirJumpIndex::removeVisit(evicted.path);
+  DirJumpIndex::addVisit(path, seq);
+  WriteBehindQueue::appendHistory(seq, path, floorSeq);
+  return seq;
+}
+
+int DirHistory::firstSeq() {
+  std::lock_guard<std::mutex> lock(historyMutex);
+  return oldestSeq;
+}
+
+int DirHistory::nextSeq() {
+  std::lock_guard<std::mutex> lock(historyMutex);
+  return newestSeq;
+}
+
+std::vector<std::pair<int, std::string>> DirHistory::entries() {
+  std::lock_guard<std::mutex> lock(historyMutex);
+  std::vector<std::pair<int, std::string>> result;
+  for (int seq = oldestSeq; seq < newestSeq; seq++) {
+    const Slot &slot = slotFor(seq);
+    if (slot.seq == seq)
+      result.push_back({seq, slot.path});
+  }
+  return result;
+}
+
+void DirHistory::clear() {
+  std::lock_guard<std::mutex> lock(historyMutex);
+  ring.assign(ring.size(), Slot());
+  oldestSeq = newestSeq;
+  DirJumpIndex::clear();
+}
+
+int DirHistory::cursor(int tty) {
+  std::lock_guard<std::mutex> lock(historyMutex);
+  auto it = cursors.find(tty);
+  if (it == cursors.end())
+    return -1;
+  return clampToRing(it->second);
+}
+
+void DirHistory::setCursor(int tty, int seq) {
+  {
+    std::lock_guard<std::mutex> lock(historyMutex);
+    cursors[tty] = seq;
+  }
+  WriteBehindQueue::setSessionPointer(tty, seq);
+}
+
+void DirHistory::dropCursor(int tty) {
+  {
+    std::lock_guard<std::mutex> lock(historyMutex);
+    cursors.erase(tty);
+  }
+  TerminalTable::deleteSession(tty);
+}
+
+int DirHistory::lastTouched() {
+  std::lock_guard<std::mutex> lock(historyMutex);
+  return lastTouchedSeq;
+}
+
+void DirHistory::setLastTouched(int seq) {
+  {
+    std::lock_guard<std::mutex> lock(historyMutex);
+    if (lastTouchedSeq == seq)
+      return;
+    lastTouchedSeq = seq;
+  }
+  WriteBehindQueue::setSetting(INDEX_OF_LAST_TOUCHED_DIR_KEY,
+                               std::to_string(seq));
+}
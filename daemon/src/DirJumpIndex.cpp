@@ -0,0 +1,382 @@
+#include "DirJumpIndex.h"
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// A cached Missing expires after this even with its parent watched, since
+// the watch says nothing when an ancestor is renamed back into place
+constexpr int MISSING_TTL_MS = 5000;
+constexpr size_t MAX_WATCHES = 1024;
+
+enum class Existence { Unknown, Exists, Missing };
+
+struct Entry {
+  std::string path;  // As stored in history, with a trailing '/'
+  std::string lower; // Lowercased path, what queries match against
+  int visits = 0;
+  int lastSeq = -1;
+  Existence existence = Existence::Unknown;
+  Clock::time_point checkedAt;
+};
+
+std::mutex indexMutex;
+// Ids are stable while a path has visits; its slot is reused once it has none
+std::vector<Entry> entries;
+std::vector<int> freeIds;
+std::map<std::string, int> idByPath;
+std::unordered_map<uint32_t, std::vector<int>> trigrams; // Sorted ids
+std::multimap<std::string, int> byBasename;
+int newestSeq = -1;
+
+int inotifyFd = -1;
+std::unordered_map<int, std::string> watchDirs; // wd -> dir with '/'
+std::unordered_map<std::string, int> watchByDir;
+
+// Counters for getStats
+long queries = 0;
+long statCalls = 0;
+long invalidations = 0;
+long totalQueryNs = 0;
+
+std::string toLower(const std::string &s) {
+  std::string out = s;
+  std::transform(out.begin(), out.end(), out.begin(),
+                 [](unsigned char c) { return std::tolower(c); });
+  return out;
+}
+
+uint32_t trigramKey(const std::string &s, size_t i) {
+  return (static_cast<unsigned char>(s[i]) << 16) |
+         (static_cast<unsigned char>(s[i + 1]) << 8) |
+         static_cast<unsigned char>(s[i + 2]);
+}
+
+// "/a/b/" -> "b"
+std::string basenameOf(const std::string &path) {
+  size_t end = path.size();
+  while (end > 0 && path[end - 1] == '/')
+    end--;
+  size_t start = path.rfind('/', end == 0 ? 0 : end - 1);
+  start = (start == std::string::npos) ? 0 : start + 1;
+  return path.substr(start, end - start);
+}
+
+// "/a/b/" -> "/a/"
+std::string parentOf(const std::string &path) {
+  std::string trimmed = path;
+  while (trimmed.size() > 1 && trimmed.back() == '/')
+    trimmed.pop_back();
+  size_t slash = trimmed.rfind('/');
+  if (slash == std::string::npos)
+    return "";
+  return trimmed.substr(0, slash + 1);
+}
+
+std::vector<uint32_t> trigramKeys(const std::string &lower) {
+  std::vector<uint32_t> keys;
+  for (size_t i = 0; i + 2 < lower.size(); i++)
+    keys.push_back(trigramKey(lower, i));
+  std::sort(keys.begin(), keys.end());
+  keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+  return keys;
+}
+
+int internPath(const std::string &path) {
+  auto it = idByPath.find(path);
+  if (it != idByPath.end())
+    return it->second;
+  int id;
+  if (!freeIds.empty()) {
+    id = freeIds.back();
+    freeIds.pop_back();
+  } else {
+    id = static_cast<int>(entries.size());
+    entries.emplace_back();
+  }
+  Entry &entry = entries[id];
+  entry = Entry();
+  entry.path = path;
+  entry.lower = toLower(path);
+  idByPath[path] = id;
+
+  for (uint32_t key : trigramKeys(entry.lower)) {
+    std::vector<int> &ids = trigrams[key];
+    ids.insert(std::lower_bound(ids.begin(), ids.end(), id), id);
+  }
+  byBasename.emplace(toLower(basenameOf(path)), id);
+  return id;
+}
+
+// Take a path with no visits left out of the index and free its slot
+void dropEntry(int id) {
+  Entry &entry = entries[id];
+  for (uint32_t key : trigramKeys(entry.lower)) {
+    auto list = trigrams.find(key);
+    if (list == trigrams.end())
+      continue;
+    std::vector<int> &ids = list->second;
+    auto at = std::lower_bound(ids.begin(), ids.end(), id);
+    if (at != ids.end() && *at == id)
+      ids.erase(at);
+    if (ids.empty())
+      trigrams.erase(list);
+  }
+  auto range = byBasename.equal_range(toLower(basenameOf(entry.path)));
+  for (auto it = range.first; it != range.second; ++it) {
+    if (it->second == id) {
+      byBasename.erase(it);
+      break;
+    }
+  }
+  idByPath.erase(entry.path);
+  entry = Entry();
+  freeIds.push_back(id);
+}
+
+// Drop cached existence for path and everything below it
+void invalidatePrefix(const std::string &prefix) {
+  for (auto it = idByPath.lower_bound(prefix);
+       it != idByPath.end() &&
+       it->first.compare(0, prefix.size(), prefix) == 0;
+       ++it) {
+    Entry &entry = entries[it->second];
+    if (entry.existence != Existence::Unknown) {
+      entry.existence = Existence::Unknown;
+      invalidations++;
+    }
+  }
+}
+
+void removeWatch(int wd) {
+  auto it = watchDirs.find(wd);
+  if (it == watchDirs.end())
+    return;
+  watchByDir.erase(it->second);
+  watchDirs.erase(it);
+}
+
+void drainEvents() {
+  if (inotifyFd < 0)
+    return;
+  alignas(struct inotify_event) char buffer[8192];
+  ssize_t len;
+  while ((len = read(inotifyFd, buffer, sizeof(buffer))) > 0) {
+    for (char *p = buffer; p < buffer + len;) {
+      auto *event = reinterpret_cast<struct inotify_event *>(p);
+      p += sizeof(struct inotify_event) + event->len;
+      if (event->mask & IN_Q_OVERFLOW) {
+        // Lost events: trust nothing
+        for (Entry &entry : entries)
+          entry.existence = Existence::Unknown;
+        continue;
+      }
+      auto it = watchDirs.find(event->wd);
+      if (it == watchDirs.end())
+        continue;
+      const std::string dir = it->second;
+      if (event->mask & (IN_DELETE_SELF | IN_MOVE_SELF | IN_IGNORED)) {
+        invalidatePrefix(dir);
+        if (event->mask & IN_IGNORED)
+          removeWatch(event->wd);
+        else
+          inotify_rm_watch(inotifyFd, event->wd);
+      } else if (event->len > 0) {
+        invalidatePrefix(dir + event->name + "/");
+      }
+    }
+  }
+}
+
+bool watchParent(const std::string &path) {
+  std::string dir = parentOf(path);
+  if (dir.empty())
+    return false;
+  if (watchByDir.count(dir))
+    return true;
+  if (inotifyFd < 0 || watchByDir.size() >= MAX_WATCHES)
+    return false;
+  int wd = inotify_add_watch(inotifyFd, dir.c_str(),
+                             IN_CREATE | IN_DELETE | IN_MOVED_FROM |
+                                 IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF |
+                                 IN_ONLYDIR);
+  if (wd < 0)
+    return false;
+  watchDirs[wd] = dir;
+  watchByDir[dir] = wd;
+  return true;
+}
+
+// Only a cached Missing is trusted: the watch on the parent misses an
+// ancestor being renamed or deleted, so a path reported to exist is stat'ed
+// again. That costs one stat per query, for the match returned.
+bool isExistingDir(Entry &entry) {
+  bool fresh = entry.existence == Existence::Missing &&
+               Clock::now() - entry.checkedAt <
+                   std::chrono::milliseconds(MISSING_TTL_MS);
+  if (!fresh) {
+    struct stat st;
+    statCalls++;
+    bool exists = stat(entry.path.c_str(), &st) == 0 && S_ISDIR(st.st_mode);
+    entry.existence = exists ? Existence::Exists : Existence::Missing;
+    watchParent(entry.path); // Invalidates sooner than the TTL
+    entry.checkedAt = Clock::now();
+  }
+  return entry.existence == Existence::Exists;
+}
+
+// Sorted ids containing every trigram of term
+std::vector<int> trigramCandidates(const std::string &term) {
+  std::vector<const std::vector<int> *> lists;
+  for (size_t i = 0; i + 2 < term.size(); i++) {
+    auto it = trigrams.find(trigramKey(term, i));
+    if (it == trigrams.end())
+      return {};
+    lists.push_back(&it->second);
+  }
+  std::sort(lists.begin(), lists.end(),
+            [](const std::vector<int> *a, const std::vector<int> *b) {
+              return a->size() < b->size();
+            });
+  std::vector<int> result = *lists.front();
+  for (size_t i = 1; i < lists.size() && !result.empty(); i++) {
+    std::vector<int> next;
+    std::set_intersection(result.begin(), result.end(), lists[i]->begin(),
+                          lists[i]->end(), std::back_inserter(next));
+    result.swap(next);
+  }
+  return result;
+}
+
+std::vector<int> prefixCandidates(const std::string &term) {
+  std::vector<int> result;
+  for (auto it = byBasename.lower_bound(term);
+       it != byBasename.end() && it->first.compare(0, term.size(), term) == 0;
+       ++it)
+    result.push_back(it->second);
+  return result;
+}
+
+double frecency(const Entry &entry) {
+  int age = newestSeq - entry.lastSeq;
+  double recency = age < 16 ? 4.0 : age < 128 ? 2.0 : age < 1024 ? 1.0 : 0.5;
+  return entry.visits * recency;
+}
+
+} // namespace
+
+void DirJumpIndex::addVisit(const std::string &path, int seq) {
+  std::lock_guard<std::mutex> lock(indexMutex);
+  if (inotifyFd < 0)
+    inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  Entry &entry = entries[internPath(path)];
+  entry.visits++;
+  entry.lastSeq = std::max(entry.lastSeq, seq);
+  newestSeq = std::max(newestSeq, seq);
+}
+
+void DirJumpIndex::removeVisit(const std::string &path) {
+  std::lock_guard<std::mutex> lock(indexMutex);
+  auto it = idByPath.find(path);
+  if (it == idByPath.end())
+    return;
+  int id = it->second;
+  if (--entries[id].visits <= 0)
+    dropEntry(id);
+}
+
+void DirJumpIndex::clear() {
+  std::lock_guard<std::mutex> lock(indexMutex);
+  entries.clear();
+  freeIds.clear();
+  idByPath.clear();
+  trigrams.clear();
+  byBasename.clear();
+  newestSeq = -1;
+}
+
+std::string DirJumpIndex::query(const std::string &query,
+                                const std::string &exclude) {
+  Clock::time_point start = Clock::now();
+  std::lock_guard<std::mutex> lock(indexMutex);
+  drainEvents();
+
+  std::vector<std::string> terms;
+  std::istringstream words(toLower(query));
+  for (std::string word; words >> word;)
+    terms.push_back(word);
+  if (terms.empty())
+    return "";
+
+  // The longest term narrows candidates the most
+  const std::string &key = *std::max_element(
+      terms.begin(), terms.end(), [](const std::string &a,
+                                     const std::string &b) {
+        return a.size() < b.size();
+      });
+  std::vector<int> candidates =
+      key.size() >= 3 ? trigramCandidates(key) : prefixCandidates(key);
+
+  std::vector<std::pair<double, int>> ranked;
+  for (int id : candidates) {
+    const Entry &entry = entries[id];
+    if (entry.visits == 0 || entry.path == exclude)
+      continue;
+    bool matches = true;
+    for (const std::string &term : terms) {
+      if (entry.lower.find(term) == std::string::npos) {
+        matches = false;
+        break;
+      }
+    }
+    if (!matches)
+      continue;
+    double score = frecency(entry);
+    // Prefer paths whose last component matches, as in "jump to project"
+    if (toLower(basenameOf(entry.path)).find(terms.back()) !=
+        std::string::npos)
+      score *= 2;
+    ranked.push_back({score, id});
+  }
+  std::sort(ranked.begin(), ranked.end(),
+            [](const std::pair<double, int> &a,
+               const std::pair<double, int> &b) {
+              if (a.first != b.first)
+                return a.first > b.first;
+              return entries[a.second].lastSeq > entries[b.second].lastSeq;
+            });
+
+  std::string result;
+  for (const auto &[score, id] : ranked) {
+    if (isExistingDir(entries[id])) {
+      result = entries[id].path;
+      break;
+    }
+  }
+  queries++;
+  totalQueryNs += std::chrono::duration_cast<std::chrono::nanoseconds>(
+                      Clock::now() - start)
+                      .count();
+  return result;
+}
+
+std::string DirJumpIndex::getStats() {
+  std::lock_guard<std::mutex> lock(indexMutex);
+  std::ostringstream ss;
+  ss << "Jump index: " << idByPath.size() << " paths, " << trigrams.size()
+     << " trigrams, " << watchDirs.size() << " watched dirs\n";
+  ss << "  Queries: " << queries << " (avg "
+     << (queries ? totalQueryNs / queries / 1000 : 0) << " us), stats: "
+     << statCalls << ", invalidations: " << invalidations << "\n";
+  return ss.str();
+}
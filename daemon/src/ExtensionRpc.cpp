@@ -0,0 +1,210 @@
+#include "ExtensionRpc.h"
+#include "Constants.h"
+#include "Utils.h"
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <poll.h>
+#include <sys/socket.h>
+
+using json = nlohmann::json;
+
+namespace {
+
+struct Pending {
+  int fd;
+  bool done = false;
+  bool ok = false;
+  std::string reply; // Or the error when !ok
+};
+
+std::mutex rpcMutex;
+std::condition_variable replied;
+int channelFds[2] = {-1, -1};
+std::map<uint64_t, std::shared_ptr<Pending>> pending; // By id: oldest first
+uint64_t nextId = 1;
+
+// Lines from concurrent callers must not interleave, and detach() takes it
+// so the main loop can't close an fd under a write. Taken before rpcMutex.
+std::mutex writeMutex;
+const int WRITE_TIMEOUT_MS = 1000; // A stuck extension mustn't hold it long
+
+const char *channelName(ExtensionRpc::Channel channel) {
+  return channel == ExtensionRpc::Channel::Window ? "Window extension"
+                                                  : "Chrome native host";
+}
+
+// Caller holds rpcMutex
+void failLocked(int fd, const std::string &error) {
+  for (auto &[id, call] : pending) {
+    if (call->fd == fd && !call->done) {
+      call->done = true;
+      call->reply = error;
+    }
+  }
+  replied.notify_all();
+}
+
+// Caller holds writeMutex
+bool sendLineLocked(int fd, const std::string &line) {
+  size_t sent = 0;
+  while (sent < line.size()) {
+    ssize_t n = send(fd, line.data() + sent, line.size() - sent,
+                     MSG_NOSIGNAL | MSG_DONTWAIT);
+    if (n > 0) {
+      sent += (size_t)n;
+      continue;
+    }
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n < 0 && errno == EAGAIN) {
+      pollfd pfd = {fd, POLLOUT, 0};
+      if (poll(&pfd, 1, WRITE_TIMEOUT_MS) > 0)
+        continue;
+    }
+    return false;
+  }
+  return true;
+}
+
+// Send on the channel's connection if fd is still it, dropping it when the
+// write fails. The check and the write share writeMutex, so a detach (and
+// the close after it) can't come between them and hand the line to
+// whichever client reused the fd number.
+bool sendOn(ExtensionRpc::Channel channel, int fd, const json &message) {
+  std::lock_guard<std::mutex> writeLock(writeMutex);
+  {
+    std::lock_guard<std::mutex> lock(rpcMutex);
+    if (channelFds[(int)channel] != fd)
+      return false; // Detached or replaced; its calls were failed then
+  }
+  if (sendLineLocked(fd, message.dump() + mustEndWithNewLine))
+    return true;
+  logToFile(std::string("[ExtensionRpc] Write to ") + channelName(channel) +
+                " failed (errno=" + std::to_string(errno) + "), detaching",
+            LOG_CORE);
+  std::lock_guard<std::mutex> lock(rpcMutex);
+  if (channelFds[(int)channel] == fd)
+    channelFds[(int)channel] = -1;
+  failLocked(fd, std::string("Failed to write to ") + channelName(channel));
+  return false;
+}
+
+} // namespace
+
+void ExtensionRpc::attach(Channel channel, int fd) {
+  std::lock_guard<std::mutex> lock(rpcMutex);
+  int &current = channelFds[(int)channel];
+  if (current != -1 && current != fd)
+    failLocked(current, std::string(channelName(channel)) + " reconnected");
+  current = fd;
+}
+
+void ExtensionRpc::detach(int fd) {
+  std::lock_guard<std::mutex> writeLock(writeMutex); // Let a write finish
+  std::lock_guard<std::mutex> lock(rpcMutex);
+  for (int &channelFd : channelFds) {
+    if (channelFd == fd)
+      channelFd = -1;
+  }
+  failLocked(fd, "Extension disconnected");
+}
+
+bool ExtensionRpc::isAttached(Channel channel) {
+  std::lock_guard<std::mutex> lock(rpcMutex);
+  return channelFds[(int)channel] != -1;
+}
+
+bool ExtensionRpc::call(Channel channel, json request, int timeoutMs,
+                        std::string &reply, std::string &error) {
+  auto call = std::make_shared<Pending>();
+  uint64_t id;
+  {
+    std::lock_guard<std::mutex> lock(rpcMutex);
+    call->fd = channelFds[(int)channel];
+    if (call->fd == -1) {
+      error = std::string(channelName(channel)) + " not registered";
+      return false;
+    }
+    id = nextId++;
+    pending[id] = call;
+  }
+
+  request["requestId"] = id;
+  sendOn(channel, call->fd, request); // A failed write or detach fails it
+
+  std::unique_lock<std::mutex> lock(rpcMutex);
+  bool done = replied.wait_for(lock, std::chrono::milliseconds(timeoutMs),
+                               [&] { return call->done; });
+  pending.erase(id);
+  if (!done) {
+    error = std::string("No response from ") + channelName(channel) +
+            " within " + std::to_string(timeoutMs) + " ms";
+    return false;
+  }
+  if (!call->ok) {
+    error = call->reply;
+    return false;
+  }
+  reply = call->reply;
+  return true;
+}
+
+bool ExtensionRpc::notify(Channel channel, const json &message) {
+  int fd;
+  {
+    std::lock_guard<std::mutex> lock(rpcMutex);
+    fd = channelFds[(int)channel];
+  }
+  return fd != -1 && sendOn(channel, fd, message);
+}
+
+bool ExtensionRpc::onLine(int fd, const std::string &line) {
+  {
+    std::lock_guard<std::mutex> lock(rpcMutex);
+    if (channelFds[0] != fd && channelFds[1] != fd)
+      return false; // Not an extension; the common case
+  }
+  json message = json::parse(line, nullptr, false);
+  if (message.is_discarded() ||
+      (message.is_object() && message.contains(COMMAND_KEY)))
+    return false; // Commands the extension sends (focusAck, ...)
+
+  std::lock_guard<std::mutex> lock(rpcMutex);
+  std::shared_ptr<Pending> call;
+  if (message.is_object() && message.contains("requestId")) {
+    auto it = message["requestId"].is_number_unsigned()
+                  ? pending.find(message["requestId"].get<uint64_t>())
+                  : pending.end();
+    if (it == pending.end() || it->second->fd != fd || it->second->done) {
+      logToFile("[ExtensionRpc] Dropped late reply: " +
+                    message["requestId"].dump(),
+                LOG_CORE);
+      return true;
+    }
+    call = it->second;
+    message.erase("requestId");
+  } else {
+    for (auto &[id, waiting] : pending) {
+      if (waiting->fd == fd && !waiting->done) {
+        call = waiting;
+        break;
+      }
+    }
+    if (!call) { // Timed out already; never a command, so don't run it
+      logToFile("[ExtensionRpc] Dropped unexpected reply", LOG_CORE);
+      return true;
+    }
+  }
+
+  call->done = true;
+  call->ok = true;
+  call->reply = message.is_object() && message.contains("result")
+                    ? message["result"].dump()
+                    : message.dump();
+  replied.notify_all();
+  return true;
+}
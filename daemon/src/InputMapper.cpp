@@ -27,13 +27,12 @@ InputMapper::~InputMapper() { stop(); }
 
 void InputMapper::loadPersistence() {
   // Load Macros from DB
-  string savedMacros = ConfigTable::getConfig("custom_macros");
-  if (!savedMacros.empty()) {
+  json savedMacros = ConfigTable::getConfigJson("custom_macros");
+  if (!savedMacros.is_null()) {
     try {
-      json j = json::parse(savedMacros);
       {
         std::lock_guard<std::mutex> lock(macrosMutex_);
-        setMacrosFromJsonInternal(j);
+        setMacrosFromJsonInternal(savedMacros);
       }
       logToFile("Loaded custom macros from DB", LOG_CORE);
     } catch (...) {
@@ -42,13 +41,12 @@ void InputMapper::loadPersistence() {
   }
 
   // Load Filters from DB
-  string savedFilters = ConfigTable::getConfig("custom_event_filters");
-  if (!savedFilters.empty()) {
+  json savedFilters = ConfigTable::getConfigJson("custom_event_filters");
+  if (!savedFilters.is_null()) {
     try {
-      json j = json::parse(savedFilters);
       {
         std::lock_guard<std::mutex> lock(filtersMutex_);
-        setEventFiltersInternal(j);
+        setEventFiltersInternal(savedFilters);
       }
       logToFile("Loaded custom event filters from DB", LOG_CORE);
     } catch (...) {
@@ -582,11 +580,13 @@ void InputMapper::ungrabDevicesSignalSafe() {
 
 void InputMapper::setContext(AppType appType, const std::string &url,
                              const std::string &title) {
+  bool macrosChanged;
   {
     std::lock_guard<std::mutex> lock(contextMutex_);
     if (activeApp_ == appType && activeUrl_ == url && activeTitle_ == title) {
       return; // No change
     }
+    macrosChanged = activeApp_ != appType;
     activeApp_ = appType;
     activeUrl_ = url;
     activeTitle_ = title;
@@ -596,9 +596,11 @@ void InputMapper::setContext(AppType appType, const std::string &url,
                 url + "] Title=[" + title + "]",
             LOG_WINDOW);
 
-  // Release keys and clear pending events on window change to prevent stuck
-  // keys/macros
-  releaseAllPressedKeys();
+  // Release keys and clear pending events when the macro set changes to
+  // prevent stuck keys/macros. Macros are chosen by app only, so a new title
+  // or URL in the same app leaves combos in progress alone.
+  if (macrosChanged)
+    releaseAllPressedKeys();
 }
 
 void InputMapper::processEvent(struct input_event &ev, bool isKeyboard,
@@ -1007,12 +1009,12 @@ void InputMapper::triggerPublicTransportationMacro() {
 
   // We can just call a bash command here for simplicity, similar to other
   // macros.
-  string port = SettingsTable::getSetting("port_pt");
-  if (port.empty()) {
+  int port = SettingsTable::getSettingInt("port_pt", 0);
+  if (port <= 0) {
     logToFile("[InputMapper] PT port not set, using default 3001", LOG_CHROME);
-    port = "3001";
+    port = 3001;
   }
-  string url = "http://localhost:" + port;
+  string url = "http://localhost:" + to_string(port);
   string cmd = "google-chrome " + url + " > /dev/null 2>&1 &";
   std::system(cmd.c_str());
 }
@@ -0,0 +1,122 @@
+#include "ManagerPool.h"
+#include "Constants.h"
+#include <arpa/inet.h>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct IdleConnection {
+  int fd;
+  Clock::time_point since;
+};
+
+std::mutex poolMutex;
+std::map<std::string, std::vector<IdleConnection>> idle; // ip -> connections
+
+// Caller holds poolMutex. Closes connections idle for too long.
+void evictIdleLocked(Clock::time_point now) {
+  for (auto it = idle.begin(); it != idle.end();) {
+    auto &connections = it->second;
+    for (auto c = connections.begin(); c != connections.end();) {
+      if (now - c->since > std::chrono::seconds(ManagerPool::IDLE_SECS)) {
+        close(c->fd);
+        c = connections.erase(c);
+      } else {
+        ++c;
+      }
+    }
+    it = connections.empty() ? idle.erase(it) : std::next(it);
+  }
+}
+
+// An idle connection must have nothing to read: readable means the manager
+// closed it (EOF) or sent something unexpected
+bool isHealthy(int fd) {
+  struct pollfd pfd;
+  pfd.fd = fd;
+  pfd.events = POLLIN;
+  pfd.revents = 0;
+  return poll(&pfd, 1, 0) == 0;
+}
+
+int connectTo(const std::string &ip, std::string &error) {
+  int sock = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (sock < 0) {
+    error = "Failed to create socket for manager\n";
+    return -1;
+  }
+
+  struct sockaddr_in server_addr = {};
+  server_addr.sin_family = AF_INET;
+  server_addr.sin_port = htons(MANAGER_PORT);
+  if (inet_pton(AF_INET, ip.c_str(), &server_addr.sin_addr) <= 0) {
+    close(sock);
+    error = "Invalid IP address for manager: " + ip + "\n";
+    return -1;
+  }
+
+  // Bounds connect and sends; replies are waited for with poll
+  struct timeval timeout;
+  timeout.tv_sec = 10;
+  timeout.tv_usec = 0;
+  setsockopt(sock, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+  int one = 1;
+  setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+  if (connect(sock, (struct sockaddr *)&server_addr, sizeof(server_addr)) < 0) {
+    close(sock);
+    error = "Failed to connect to manager at " + ip + ":" +
+            std::to_string(MANAGER_PORT) + "\n";
+    return -1;
+  }
+  return sock;
+}
+
+} // namespace
+
+int ManagerPool::acquire(const std::string &ip, bool &reused,
+                         std::string &error) {
+  {
+    std::lock_guard<std::mutex> lock(poolMutex);
+    evictIdleLocked(Clock::now());
+    auto it = idle.find(ip);
+    while (it != idle.end() && !it->second.empty()) {
+      int fd = it->second.back().fd;
+      it->second.pop_back();
+      if (isHealthy(fd)) {
+        reused = true;
+        return fd;
+      }
+      close(fd);
+    }
+  }
+  reused = false;
+  return connectTo(ip, error);
+}
+
+void ManagerPool::release(const std::string &ip, int fd) {
+  std::lock_guard<std::mutex> lock(poolMutex);
+  Clock::time_point now = Clock::now();
+  evictIdleLocked(now);
+  auto &connections = idle[ip];
+  if (connections.size() >= MAX_IDLE_PER_PEER) {
+    close(fd);
+    return;
+  }
+  connections.push_back({fd, now});
+}
+
+void ManagerPool::discard(int fd) {
+  if (fd >= 0)
+    close(fd);
+}
@@ -0,0 +1,142 @@
+#include "MySQLBackend.h"
+#include "MySQLManager.h"
+#include "Utils.h"
+#include <fstream>
+#include <map>
+
+namespace {
+
+template <typename F> auto translateErrors(F &&f) -> decltype(f()) {
+  try {
+    return f();
+  } catch (sql::SQLException &e) {
+    throw StorageError(e.what());
+  }
+}
+
+class MySQLResult : public StorageResult {
+public:
+  explicit MySQLResult(sql::ResultSet *res) : res(res) {}
+  bool next() override {
+    return translateErrors([&] { return res->next(); });
+  }
+  int getInt(const std::string &column) override {
+    return translateErrors([&] { return (int)res->getInt(column); });
+  }
+  std::string getString(const std::string &column) override {
+    return translateErrors(
+        [&] { return std::string(res->getString(column)); });
+  }
+  bool getBoolean(const std::string &column) override {
+    return translateErrors([&] { return res->getBoolean(column); });
+  }
+  bool isNull(const std::string &column) override {
+    return translateErrors([&] { return res->isNull(column); });
+  }
+
+private:
+  std::unique_ptr<sql::ResultSet> res;
+};
+
+class MySQLStatement : public StorageStatement {
+public:
+  explicit MySQLStatement(sql::PreparedStatement *pstmt) : pstmt(pstmt) {}
+  void setInt(int index, int value) override {
+    translateErrors([&] { pstmt->setInt(index, value); });
+  }
+  void setString(int index, const std::string &value) override {
+    translateErrors([&] { pstmt->setString(index, value); });
+  }
+  void setBoolean(int index, bool value) override {
+    translateErrors([&] { pstmt->setBoolean(index, value); });
+  }
+  int executeUpdate() override {
+    return translateErrors([&] { return (int)pstmt->executeUpdate(); });
+  }
+  std::unique_ptr<StorageResult> executeQuery() override {
+    return translateErrors([&] {
+      return std::unique_ptr<StorageResult>(
+          new MySQLResult(pstmt->executeQuery()));
+    });
+  }
+
+private:
+  sql::PreparedStatement *pstmt; // Owned by the pooled connection's cache
+};
+
+class MySQLConnection : public StorageConnection {
+public:
+  explicit MySQLConnection(MySQLManager::PooledConnection con)
+      : con(std::move(con)) {}
+
+  StorageStatement *prepare(const std::string &query) override {
+    sql::PreparedStatement *pstmt =
+        translateErrors([&] { return con.prepare(query); });
+    auto &wrapper = statements[pstmt];
+    if (!wrapper)
+      wrapper = std::make_unique<MySQLStatement>(pstmt);
+    return wrapper.get();
+  }
+  std::unique_ptr<StorageResult> query(const std::string &query) override {
+    return translateErrors([&] {
+      std::unique_ptr<sql::Statement> stmt(con->createStatement());
+      return std::unique_ptr<StorageResult>(
+          new MySQLResult(stmt->executeQuery(query)));
+    });
+  }
+  int execute(const std::string &query) override {
+    return translateErrors([&] {
+      std::unique_ptr<sql::Statement> stmt(con->createStatement());
+      return (int)stmt->executeUpdate(query);
+    });
+  }
+  void begin() override {
+    translateErrors([&] { con->setAutoCommit(false); });
+  }
+  void commit() override {
+    translateErrors([&] {
+      con->commit();
+      con->setAutoCommit(true);
+    });
+  }
+  void rollback() override {
+    translateErrors([&] {
+      con->rollback();
+      con->setAutoCommit(true);
+    });
+  }
+
+private:
+  // Declared before 'statements' so the wrappers go first
+  MySQLManager::PooledConnection con;
+  std::map<sql::PreparedStatement *, std::unique_ptr<MySQLStatement>>
+      statements;
+};
+
+} // namespace
+
+bool MySQLBackend::start() { return MySQLManager::initializeAndStartMySQL(); }
+
+void MySQLBackend::stop() { MySQLManager::stopMySQL(); }
+
+std::unique_ptr<StorageConnection> MySQLBackend::connect() {
+  MySQLManager::PooledConnection con = MySQLManager::acquireConnection();
+  if (!con)
+    return nullptr;
+  return std::make_unique<MySQLConnection>(std::move(con));
+}
+
+std::string MySQLBackend::getStats() { return MySQLManager::getPoolStats(); }
+
+long MySQLBackend::engineRssKb() {
+  pid_t pid = MySQLManager::getServerPid();
+  if (pid <= 0)
+    return 0;
+  std::ifstream status("/proc/" + std::to_string(pid) + "/status");
+  std::string line;
+  while (std::getline(status, line)) {
+    if (line.compare(0, 6, "VmRSS:") == 0)
+      return std::atol(line.c_str() + 6);
+  }
+  return 0;
+}
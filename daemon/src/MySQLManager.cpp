@@ -2,15 +2,19 @@
 #include "Globals.h"
 #include "Utils.h"
 #include <chrono>
+#include <condition_variable>
 #include <filesystem>
 #include <fstream>
 #include <iostream>
+#include <mutex>
 #include <netinet/in.h>
 #include <random>
+#include <sstream>
 #include <sys/socket.h>
 #include <sys/wait.h>
 #include <thread>
 #include <unistd.h>
+#include <vector>
 
 pid_t MySQLManager::mysqlPid = -1;
 std::string MySQLManager::mysqlSocket = "";
@@ -20,6 +24,49 @@ std::string MySQLManager::mysqlPassword =
     "automate_password"; // Simple password for local access
 std::string MySQLManager::mysqlDatabase = "automate_db";
 
+// Connection pool. Statements are destroyed before their connection, so
+// 'statements' must stay declared after 'con'.
+struct MySQLManager::PoolEntry {
+  std::unique_ptr<sql::Connection> con;
+  std::map<std::string, std::unique_ptr<sql::PreparedStatement>> statements;
+  std::chrono::steady_clock::time_point lastUsed;
+};
+
+namespace {
+const size_t POOL_MAX_CONNECTIONS = 4;
+// Idle connections older than this are validated before being handed out
+const auto POOL_VALIDATE_AFTER = std::chrono::seconds(5);
+
+std::mutex poolMutex;
+std::condition_variable poolAvailable;
+size_t poolOpenConnections = 0;
+bool poolClosed = false;
+
+struct PoolStats {
+  uint64_t acquires = 0;
+  uint64_t releases = 0;
+  uint64_t waits = 0;
+  uint64_t timeouts = 0;
+  uint64_t created = 0;
+  uint64_t reconnects = 0;
+  uint64_t discarded = 0;
+  uint64_t stmtHits = 0;
+  uint64_t stmtMisses = 0;
+  uint64_t waitTotalUs = 0;
+  uint64_t waitMaxUs = 0;
+  uint64_t holdTotalUs = 0;
+  uint64_t holdMaxUs = 0;
+} poolStats;
+
+uint64_t elapsedUs(std::chrono::steady_clock::time_point since) {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+             std::chrono::steady_clock::now() - since)
+      .count();
+}
+} // namespace
+
+std::vector<std::unique_ptr<MySQLManager::PoolEntry>> MySQLManager::idlePool;
+
 int MySQLManager::findFreePort() {
   int sock = socket(AF_INET, SOCK_STREAM, 0);
   if (sock < 0)
@@ -120,7 +167,7 @@ bool MySQLManager::isServerRunning(const std::string &socketPath) {
   return std::filesystem::exists(socketPath);
 }
 
-void MySQLManager::createDatabaseAndUser(int port,
+bool MySQLManager::createDatabaseAndUser(int port,
                                          [[maybe_unused]] const std::string &socketPath) {
   try {
     sql::Driver *driver = get_driver_instance();
@@ -211,16 +258,25 @@ void MySQLManager::createDatabaseAndUser(int port,
                        "client_subdir VARCHAR(128), "
                        "installed_at TIMESTAMP DEFAULT CURRENT_TIMESTAMP)");
 
+    // 9. Port Leases (owner of each port_* setting)
+    tableStmt->execute("CREATE TABLE IF NOT EXISTS port_leases ("
+                       "port_key VARCHAR(64) PRIMARY KEY, "
+                       "app_id VARCHAR(64), "
+                       "peer_id VARCHAR(64), "
+                       "leased_at TIMESTAMP DEFAULT CURRENT_TIMESTAMP)");
+
     logToFile(
         "MySQLManager: Database, user, and tables configured successfully.");
+    return true;
   } catch (sql::SQLException &e) {
     logToFile("MySQLManager: Error configuring database: " +
                   std::string(e.what()),
               0xFFFFFFFF);
+    return false;
   }
 }
 
-void MySQLManager::initializeAndStartMySQL() {
+bool MySQLManager::initializeAndStartMySQL() {
   std::string baseDir = directories.base + "data/mysql";
   std::string binDir = baseDir + "/bin";
   std::string confDir = baseDir + "/conf";
@@ -288,14 +344,16 @@ void MySQLManager::initializeAndStartMySQL() {
   if (isServerRunning(mysqlSocket)) {
     logToFile("MySQLManager: MySQL Server is ready.");
     // Setup initial DB structure
-    createDatabaseAndUser(mysqlPort, mysqlSocket);
-  } else {
-    logToFile("MySQLManager: Failed to start MySQL server within timeout.",
-              0xFFFFFFFF);
+    return createDatabaseAndUser(mysqlPort, mysqlSocket);
   }
+  logToFile("MySQLManager: Failed to start MySQL server within timeout.",
+            0xFFFFFFFF);
+  return false;
 }
 
 void MySQLManager::stopMySQL() {
+  closePool();
+
   // Try to stop the one we started
   if (mysqlPid > 0) {
     logToFile("MySQLManager: Stopping MySQL server (PID " +
@@ -337,6 +395,193 @@ sql::Connection *MySQLManager::getConnection() {
   }
 }
 
+// PooledConnection
+
+MySQLManager::PooledConnection::PooledConnection() = default;
+
+MySQLManager::PooledConnection::PooledConnection(
+    std::unique_ptr<PoolEntry> entry,
+    std::chrono::steady_clock::time_point acquiredAt)
+    : entry(std::move(entry)), acquiredAt(acquiredAt) {}
+
+MySQLManager::PooledConnection::PooledConnection(
+    PooledConnection &&other) noexcept
+    : entry(std::move(other.entry)), acquiredAt(other.acquiredAt) {}
+
+MySQLManager::PooledConnection &
+MySQLManager::PooledConnection::operator=(PooledConnection &&other) noexcept {
+  if (this != &other) {
+    release();
+    entry = std::move(other.entry);
+    acquiredAt = other.acquiredAt;
+  }
+  return *this;
+}
+
+MySQLManager::PooledConnection::~PooledConnection() { release(); }
+
+void MySQLManager::PooledConnection::release() {
+  if (entry)
+    MySQLManager::releaseToPool(std::move(entry), acquiredAt);
+}
+
+sql::Connection *MySQLManager::PooledConnection::operator->() const {
+  return entry->con.get();
+}
+
+sql::Connection *MySQLManager::PooledConnection::get() const {
+  return entry ? entry->con.get() : nullptr;
+}
+
+sql::PreparedStatement *
+MySQLManager::PooledConnection::prepare(const std::string &query) {
+  auto it = entry->statements.find(query);
+  if (it != entry->statements.end()) {
+    it->second->clearParameters();
+    std::lock_guard<std::mutex> lock(poolMutex);
+    poolStats.stmtHits++;
+    return it->second.get();
+  }
+  // Throws sql::SQLException like prepareStatement; callers already catch it
+  std::unique_ptr<sql::PreparedStatement> pstmt(
+      entry->con->prepareStatement(query));
+  sql::PreparedStatement *raw = pstmt.get();
+  entry->statements[query] = std::move(pstmt);
+  std::lock_guard<std::mutex> lock(poolMutex);
+  poolStats.stmtMisses++;
+  return raw;
+}
+
+// Pool management
+
+bool MySQLManager::ensureHealthy(PoolEntry &entry) {
+  if (std::chrono::steady_clock::now() - entry.lastUsed < POOL_VALIDATE_AFTER)
+    return true;
+  try {
+    if (entry.con->isValid())
+      return true;
+    // Server-side statement handles die with the session
+    entry.statements.clear();
+    if (entry.con->reconnect()) {
+      entry.con->setSchema(mysqlDatabase);
+      std::lock_guard<std::mutex> lock(poolMutex);
+      poolStats.reconnects++;
+      logToFile("MySQLManager: Reconnected stale pooled connection");
+      return true;
+    }
+  } catch (sql::SQLException &e) {
+    logToFile("MySQLManager: Pooled connection health check failed: " +
+                  std::string(e.what()),
+              0xFFFFFFFF);
+  }
+  return false;
+}
+
+MySQLManager::PooledConnection MySQLManager::acquireConnection(int timeoutMs) {
+  auto start = std::chrono::steady_clock::now();
+  std::unique_ptr<PoolEntry> entry;
+  {
+    std::unique_lock<std::mutex> lock(poolMutex);
+    poolStats.acquires++;
+    bool waited = false;
+    while (!poolClosed && idlePool.empty() &&
+           poolOpenConnections >= POOL_MAX_CONNECTIONS) {
+      waited = true;
+      if (poolAvailable.wait_until(
+              lock, start + std::chrono::milliseconds(timeoutMs)) ==
+          std::cv_status::timeout) {
+        if (!idlePool.empty() || poolOpenConnections < POOL_MAX_CONNECTIONS)
+          break;
+        poolStats.timeouts++;
+        logToFile("MySQLManager: Timed out waiting for a pooled connection",
+                  0xFFFFFFFF);
+        return PooledConnection();
+      }
+    }
+    if (poolClosed)
+      return PooledConnection();
+    uint64_t waitUs = elapsedUs(start);
+    if (waited)
+      poolStats.waits++;
+    poolStats.waitTotalUs += waitUs;
+    poolStats.waitMaxUs = std::max(poolStats.waitMaxUs, waitUs);
+    if (!idlePool.empty()) {
+      // LIFO keeps the most recently used (and likely still valid) connection
+      entry = std::move(idlePool.back());
+      idlePool.pop_back();
+    } else {
+      poolOpenConnections++;
+    }
+  }
+
+  if (entry && !ensureHealthy(*entry)) {
+    std::lock_guard<std::mutex> lock(poolMutex);
+    poolStats.discarded++;
+    entry.reset(); // Slot stays counted; reused for a fresh connection below
+  }
+
+  if (!entry) {
+    sql::Connection *con = getConnection();
+    if (!con) {
+      std::lock_guard<std::mutex> lock(poolMutex);
+      poolOpenConnections--;
+      poolAvailable.notify_one();
+      return PooledConnection();
+    }
+    entry = std::make_unique<PoolEntry>();
+    entry->con.reset(con);
+    std::lock_guard<std::mutex> lock(poolMutex);
+    poolStats.created++;
+  }
+  return PooledConnection(std::move(entry), std::chrono::steady_clock::now());
+}
+
+void MySQLManager::releaseToPool(
+    std::unique_ptr<PoolEntry> entry,
+    std::chrono::steady_clock::time_point acquiredAt) {
+  uint64_t holdUs = elapsedUs(acquiredAt);
+  entry->lastUsed = std::chrono::steady_clock::now();
+  std::lock_guard<std::mutex> lock(poolMutex);
+  poolStats.releases++;
+  poolStats.holdTotalUs += holdUs;
+  poolStats.holdMaxUs = std::max(poolStats.holdMaxUs, holdUs);
+  if (poolClosed) {
+    poolOpenConnections--;
+    return; // entry (and its statements) destroyed here
+  }
+  idlePool.push_back(std::move(entry));
+  poolAvailable.notify_one();
+}
+
+void MySQLManager::closePool() {
+  std::lock_guard<std::mutex> lock(poolMutex);
+  poolClosed = true;
+  poolOpenConnections -= idlePool.size();
+  idlePool.clear();
+  poolAvailable.notify_all();
+}
+
+std::string MySQLManager::getPoolStats() {
+  std::lock_guard<std::mutex> lock(poolMutex);
+  uint64_t released = poolStats.releases;
+  std::stringstream ss;
+  ss << "Connections: " << poolOpenConnections << " open, " << idlePool.size()
+     << " idle, max " << POOL_MAX_CONNECTIONS << "\n";
+  ss << "Acquires: " << poolStats.acquires << " (waited " << poolStats.waits
+     << ", timed out " << poolStats.timeouts << ")\n";
+  ss << "Pool wait: avg "
+     << (poolStats.acquires ? poolStats.waitTotalUs / poolStats.acquires : 0)
+     << "us, max " << poolStats.waitMaxUs << "us\n";
+  ss << "Query time: avg " << (released ? poolStats.holdTotalUs / released : 0)
+     << "us, max " << poolStats.holdMaxUs << "us\n";
+  ss << "Created: " << poolStats.created
+     << ", reconnects: " << poolStats.reconnects
+     << ", discarded: " << poolStats.discarded << "\n";
+  ss << "Statement cache: " << poolStats.stmtHits << " hits, "
+     << poolStats.stmtMisses << " misses\n";
+  return ss.str();
+}
+
 void MySQLManager::dropTable(const std::string &tableName) {
   try {
     std::unique_ptr<sql::Connection> con(getConnection());
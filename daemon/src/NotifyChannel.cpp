@@ -0,0 +1,274 @@
+#include "NotifyChannel.h"
+#include "Constants.h"
+#include "Utils.h"
+#include "mainCommand.h"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <poll.h>
+#include <sstream>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct Notification {
+  json command;
+  Clock::time_point receivedAt;
+};
+
+int notifyFd = -1;
+int wakeFd = -1; // eventfd the daemon loop selects on
+std::thread receiverThread;
+std::atomic<bool> receiverRunning{false};
+std::mutex ingestMutex; // Held while moving datagrams into the queue
+std::mutex queueMutex;  // Guards queue and the counters
+std::deque<Notification> queue;
+
+// Counters for getStats
+long received = 0;
+long processed = 0;
+long failed = 0;   // Handler returned a non-zero status
+long rejected = 0; // Bad JSON or a command that needs a reply
+long dropped = 0;  // Queue full
+size_t maxDepth = 0;
+long totalQueueUs = 0;
+
+sockaddr_un notifyAddress() {
+  sockaddr_un addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  strncpy(addr.sun_path, NOTIFY_SOCKET_PATH, sizeof(addr.sun_path) - 1);
+  return addr;
+}
+
+// Caller holds ingestMutex. Moves every datagram already in the socket into
+// the queue without blocking; returns how many were queued.
+int ingestLocked() {
+  char buffer[65536];
+  int queued = 0;
+  while (true) {
+    ssize_t len = recv(notifyFd, buffer, sizeof(buffer), MSG_DONTWAIT);
+    if (len < 0 && errno == EINTR)
+      continue;
+    if (len <= 0)
+      return queued; // EAGAIN: drained
+    json command = json::parse(buffer, buffer + len, nullptr, false);
+    bool valid = !command.is_discarded() && command.contains(COMMAND_KEY) &&
+                 command[COMMAND_KEY].is_string() &&
+                 NotifyChannel::isOneWay(command[COMMAND_KEY].get<std::string>());
+    std::lock_guard<std::mutex> lock(queueMutex);
+    received++;
+    if (!valid) {
+      rejected++;
+      continue;
+    }
+    if (queue.size() >= NOTIFY_QUEUE_MAX) {
+      dropped++;
+      continue;
+    }
+    queue.push_back({std::move(command), Clock::now()});
+    maxDepth = std::max(maxDepth, queue.size());
+    queued++;
+  }
+}
+
+// Caller holds queueMutex
+void recordLocked(const Notification &notification) {
+  totalQueueUs += std::chrono::duration_cast<std::chrono::microseconds>(
+                      Clock::now() - notification.receivedAt)
+                      .count();
+}
+
+void run(const Notification &notification) {
+  CmdResult result = dispatchCommand(notification.command);
+  std::lock_guard<std::mutex> lock(queueMutex);
+  processed++;
+  if (result.status != 0) {
+    failed++;
+    logToFile("NotifyChannel: " + notification.command.dump() +
+                  " failed: " + result.message,
+              LOG_CORE);
+  }
+}
+
+// The kernel only queues a handful of datagrams per unix socket
+// (net.unix.max_dgram_qlen), so a dedicated thread keeps it drained
+void receiverLoop() {
+  while (receiverRunning) {
+    pollfd pfd{notifyFd, POLLIN, 0};
+    if (poll(&pfd, 1, 200) <= 0)
+      continue; // Timeout (checks receiverRunning) or signal
+    int queued;
+    {
+      std::lock_guard<std::mutex> lock(ingestMutex);
+      queued = ingestLocked();
+    }
+    uint64_t one = 1;
+    if (queued > 0 && write(wakeFd, &one, sizeof(one)) < 0) {
+      // Counter saturated; the loop is already due to wake
+    }
+  }
+}
+
+} // namespace
+
+bool NotifyChannel::isOneWay(const std::string &command) {
+  return command == COMMAND_UPDATE_DIR_HISTORY ||
+         command == COMMAND_OPENED_TTY || command == COMMAND_CLOSED_TTY ||
+         command == COMMAND_SHELL_SIGNAL;
+}
+
+int NotifyChannel::open() {
+  notifyFd = socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+  if (notifyFd < 0) {
+    logToFile("NotifyChannel: socket() failed: " + std::string(strerror(errno)),
+              0xFFFFFFFF);
+    return -1;
+  }
+  unlink(NOTIFY_SOCKET_PATH);
+  sockaddr_un addr = notifyAddress();
+  if (bind(notifyFd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+    logToFile("NotifyChannel: bind() failed for " +
+                  std::string(NOTIFY_SOCKET_PATH) + ": " + strerror(errno),
+              0xFFFFFFFF);
+    ::close(notifyFd);
+    notifyFd = -1;
+    return -1;
+  }
+  chmod(NOTIFY_SOCKET_PATH, 0666);
+
+  wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (wakeFd < 0) {
+    logToFile("NotifyChannel: eventfd() failed: " +
+                  std::string(strerror(errno)),
+              0xFFFFFFFF);
+    close();
+    return -1;
+  }
+  receiverRunning = true;
+  receiverThread = std::thread(receiverLoop);
+  logToFile("NotifyChannel: Listening on " + std::string(NOTIFY_SOCKET_PATH),
+            LOG_CORE);
+  return wakeFd;
+}
+
+int NotifyChannel::fd() { return wakeFd; }
+
+void NotifyChannel::close() {
+  if (receiverRunning.exchange(false)) {
+    shutdown(notifyFd, SHUT_RDWR);
+    if (receiverThread.joinable())
+      receiverThread.join();
+  }
+  if (notifyFd >= 0) {
+    ::close(notifyFd);
+    notifyFd = -1;
+    unlink(NOTIFY_SOCKET_PATH);
+  }
+  if (wakeFd >= 0) {
+    ::close(wakeFd);
+    wakeFd = -1;
+  }
+}
+
+void NotifyChannel::receive() {
+  uint64_t count;
+  if (wakeFd >= 0 && read(wakeFd, &count, sizeof(count)) < 0) {
+    // Nothing to clear
+  }
+}
+
+bool NotifyChannel::hasPending() {
+  std::lock_guard<std::mutex> lock(queueMutex);
+  return !queue.empty();
+}
+
+void NotifyChannel::process(size_t budget) {
+  for (; budget > 0; budget--) {
+    Notification notification;
+    {
+      std::lock_guard<std::mutex> lock(queueMutex);
+      if (queue.empty())
+        return;
+      notification = std::move(queue.front());
+      queue.pop_front();
+      recordLocked(notification);
+    }
+    run(notification);
+  }
+}
+
+void NotifyChannel::flushFor(const json &tty) {
+  if (notifyFd < 0)
+    return;
+  {
+    // Whatever the shell sent before this command is in the socket by now
+    std::lock_guard<std::mutex> lock(ingestMutex);
+    ingestLocked();
+  }
+  std::vector<Notification> due;
+  {
+    std::lock_guard<std::mutex> lock(queueMutex);
+    for (auto it = queue.begin(); it != queue.end();) {
+      const json &command = it->command;
+      if (command.contains(COMMAND_ARG_TTY) &&
+          command[COMMAND_ARG_TTY] == tty) {
+        recordLocked(*it);
+        due.push_back(std::move(*it));
+        it = queue.erase(it);
+      } else {
+        ++it;
+      }
+    }
+  }
+  for (const Notification &notification : due)
+    run(notification);
+}
+
+std::string NotifyChannel::getStats() {
+  std::lock_guard<std::mutex> lock(queueMutex);
+  std::ostringstream ss;
+  ss << "Notify socket: " << NOTIFY_SOCKET_PATH
+     << (notifyFd >= 0 ? "" : " (not open)") << "\n";
+  ss << "  Received: " << received << ", processed: " << processed
+     << ", failed: " << failed << "\n";
+  ss << "  Lost: " << rejected + dropped << " (rejected: " << rejected
+     << ", dropped on full queue: " << dropped << ")\n";
+  ss << "  Queue depth: " << queue.size() << " (max " << maxDepth << " of "
+     << NOTIFY_QUEUE_MAX << "), avg wait: "
+     << (processed ? totalQueueUs / processed : 0) << " us\n";
+  return ss.str();
+}
+
+int NotifyChannel::send(const std::string &json) {
+  int fd = socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+  if (fd < 0)
+    return errno;
+  sockaddr_un addr = notifyAddress();
+  int rc = 0;
+  // EAGAIN means the receiver is momentarily behind; retry for ~1 ms at most
+  for (int attempt = 0; attempt < 5; attempt++) {
+    rc = 0;
+    if (sendto(fd, json.data(), json.size(), MSG_DONTWAIT,
+               (struct sockaddr *)&addr, sizeof(addr)) >= 0)
+      break;
+    rc = errno;
+    if (rc != EAGAIN)
+      break;
+    usleep(200);
+  }
+  ::close(fd);
+  return rc;
+}
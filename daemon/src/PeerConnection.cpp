@@ -0,0 +1,102 @@
+#include "PeerConnection.h"
+#include "Utils.h"
+#include <cerrno>
+#include <cstring>
+#include <map>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace {
+
+mutex registryMutex;
+map<int, weak_ptr<PeerConnection>> registry; // Open connections by fd
+
+// Caller holds registryMutex. Drops fd's entry unless it already belongs to
+// a newer connection on a reused fd number.
+void forgetLocked(int fd) {
+  auto it = registry.find(fd);
+  if (it != registry.end() && it->second.expired())
+    registry.erase(it);
+}
+
+} // namespace
+
+shared_ptr<PeerConnection> PeerConnection::adopt(int fd) {
+  shared_ptr<PeerConnection> connection(new PeerConnection(fd));
+  lock_guard<mutex> lock(registryMutex);
+  registry[fd] = connection;
+  return connection;
+}
+
+shared_ptr<PeerConnection> PeerConnection::find(int fd) {
+  lock_guard<mutex> lock(registryMutex);
+  auto it = registry.find(fd);
+  if (it == registry.end())
+    return nullptr;
+  shared_ptr<PeerConnection> connection = it->second.lock();
+  return connection && connection->isOpen() ? connection : nullptr;
+}
+
+PeerConnection::PeerConnection(int fd) : m_fd(fd) {}
+
+PeerConnection::~PeerConnection() {
+  {
+    lock_guard<mutex> lock(registryMutex);
+    forgetLocked(m_fd);
+  }
+  if (m_owned)
+    close(m_fd);
+}
+
+bool PeerConnection::send(const string &data, int timeoutMs) {
+  lock_guard<mutex> lock(m_writeMutex);
+  if (!m_open || !m_owned)
+    return false;
+  int flags = MSG_NOSIGNAL | (timeoutMs >= 0 ? MSG_DONTWAIT : 0);
+  size_t offset = 0;
+  while (offset < data.size()) {
+    ssize_t sent =
+        ::send(m_fd, data.data() + offset, data.size() - offset, flags);
+    if (sent > 0) {
+      offset += sent;
+      continue;
+    }
+    if (sent < 0 && errno == EINTR)
+      continue;
+    if (sent < 0 && errno == EAGAIN && timeoutMs >= 0) {
+      struct pollfd pfd;
+      pfd.fd = m_fd;
+      pfd.events = POLLOUT;
+      if (poll(&pfd, 1, timeoutMs) > 0)
+        continue;
+    }
+    break;
+  }
+  if (offset == data.size())
+    return true;
+  if (offset > 0) {
+    logToFile("Partial write to peer fd " + to_string(m_fd) +
+                  ", closing the connection",
+              LOG_CORE);
+    shutdown();
+  }
+  return false;
+}
+
+void PeerConnection::shutdown() {
+  if (m_open.exchange(false))
+    ::shutdown(m_fd, SHUT_RDWR);
+}
+
+void PeerConnection::release() {
+  lock_guard<mutex> lock(m_writeMutex);
+  m_open = false;
+  m_owned = false;
+  lock_guard<mutex> registryLock(registryMutex);
+  auto it = registry.find(m_fd);
+  if (it != registry.end() && it->second.lock().get() == this)
+    registry.erase(it);
+}
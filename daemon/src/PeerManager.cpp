@@ -1,15 +1,20 @@
 #include "PeerManager.h"
 #include "Constants.h"
 #include "DatabaseTableManagers.h"
+#include "Replication.h"
+#include "ServiceWatcher.h"
 #include "Utils.h"
 #include "Version.h"
 #include "cmdApp.h"
+#include <algorithm>
 #include <arpa/inet.h>
+#include <cerrno>
 #include <chrono>
 #include <cstring>
 #include <iostream>
 #include <netinet/in.h>
 #include <poll.h>
+#include <sys/eventfd.h>
 #include <sys/socket.h>
 #include <thread>
 #include <unistd.h>
@@ -25,6 +30,15 @@ PeerManager &PeerManager::getInstance() {
   return instance;
 }
 
+PeerManager::PeerManager() {
+  m_leaderInboxFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (m_leaderInboxFd < 0) {
+    logToFile("Failed to create leader inbox eventfd: " +
+                  string(strerror(errno)),
+              0xFFFFFFFF);
+  }
+}
+
 void PeerManager::setRole(const string &role) {
   m_role = role;
   saveConfig();
@@ -49,6 +63,8 @@ string PeerManager::getLeaderAddress() const { return m_leaderAddress; }
 bool PeerManager::isLeader() const { return m_role == PEER_ROLE_LEADER; }
 
 bool PeerManager::connectToLeader() {
+  lock_guard<mutex> connectLock(m_leaderConnectMutex);
+
   if (isLeader()) {
     logToFile("Cannot connect to leader: this daemon is the leader", LOG_CORE);
     return false;
@@ -60,14 +76,15 @@ bool PeerManager::connectToLeader() {
     return false;
   }
 
-  // Close existing connection if any
-  if (m_leaderSocket >= 0) {
-    close(m_leaderSocket);
-    m_leaderSocket = -1;
+  // Close existing connection if any; the old reader fails its requests
+  {
+    lock_guard<mutex> lock(m_leaderWriteMutex);
+    shutdownLeaderLocked();
   }
+  joinLeaderReader();
 
-  m_leaderSocket = socket(AF_INET, SOCK_STREAM, 0);
-  if (m_leaderSocket < 0) {
+  int sock = socket(AF_INET, SOCK_STREAM, 0);
+  if (sock < 0) {
     logToFile("Failed to create socket for leader connection: " +
                   string(strerror(errno)),
               LOG_CORE);
@@ -78,8 +95,7 @@ bool PeerManager::connectToLeader() {
   struct timeval timeout;
   timeout.tv_sec = 5;
   timeout.tv_usec = 0;
-  setsockopt(m_leaderSocket, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
-  setsockopt(m_leaderSocket, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+  setsockopt(sock, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
 
   struct sockaddr_in addr;
   memset(&addr, 0, sizeof(addr));
@@ -88,21 +104,24 @@ bool PeerManager::connectToLeader() {
 
   if (inet_pton(AF_INET, m_leaderAddress.c_str(), &addr.sin_addr) <= 0) {
     logToFile("Invalid leader address: " + m_leaderAddress, LOG_CORE);
-    close(m_leaderSocket);
-    m_leaderSocket = -1;
+    close(sock);
     return false;
   }
 
-  if (connect(m_leaderSocket, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+  if (connect(sock, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
     logToFile("Failed to connect to leader at " + m_leaderAddress + ":" +
                   to_string(PEER_TCP_PORT) + ": " + strerror(errno),
               LOG_CORE);
-    close(m_leaderSocket);
-    m_leaderSocket = -1;
+    close(sock);
     return false;
   }
 
-  m_connectedToLeader = true;
+  {
+    lock_guard<mutex> lock(m_leaderWriteMutex);
+    m_leaderSocket = sock;
+    m_connectedToLeader = true;
+  }
+  m_leaderReader = std::thread(&PeerManager::leaderReaderLoop, this, sock);
   logToFile("Connected to leader at " + m_leaderAddress, LOG_CORE);
 
   // Send registration message with peer info
@@ -112,7 +131,15 @@ bool PeerManager::connectToLeader() {
   regMsg["ip"] = getWgInterfaceIP();
   regMsg["mac"] = getPrimaryMacAddress();
   regMsg["daemon_version"] = DAEMON_VERSION;
-  regMsg["appStatus"] = AppManager::getLocalAppStatusAll();
+  json appStatus = AppManager::getLocalAppStatusAll();
+  uint64_t appStatusVersion;
+  {
+    lock_guard<mutex> lock(m_appStatusMutex);
+    appStatusVersion = ++m_appStatusVersion;
+    m_ackedAppStatusVersion = 0;
+  }
+  regMsg["appStatus"] = appStatus;
+  regMsg["appStatusVersion"] = appStatusVersion;
 
   // Get hostname
   char hostname[256];
@@ -120,29 +147,42 @@ bool PeerManager::connectToLeader() {
     regMsg["hostname"] = string(hostname);
   }
 
-  sendToLeader(regMsg);
-
-  // Wait for and consume the registration response to avoid it being
-  // returned for subsequent commands
-  char buffer[1024];
-  memset(buffer, 0, sizeof(buffer));
-  ssize_t n = read(m_leaderSocket, buffer, sizeof(buffer) - 1);
-  if (n > 0) {
-    logToFile("Registration response: " + string(buffer), LOG_CORE);
+  string response = forwardToLeader(regMsg, 5000);
+  if (!response.empty()) {
+    logToFile("Registration response: " + response, LOG_CORE);
+    // The leader stores the status before handling the registration
+    lock_guard<mutex> lock(m_appStatusMutex);
+    m_ackedAppStatus = appStatus;
+    m_ackedAppStatusVersion = appStatusVersion;
   }
 
   return true;
 }
 
 void PeerManager::disconnectFromLeader() {
-  if (m_leaderSocket >= 0) {
-    close(m_leaderSocket);
-    m_leaderSocket = -1;
+  lock_guard<mutex> connectLock(m_leaderConnectMutex);
+  {
+    lock_guard<mutex> lock(m_leaderWriteMutex);
+    shutdownLeaderLocked();
   }
-  m_connectedToLeader = false;
+  joinLeaderReader();
   logToFile("Disconnected from leader", LOG_CORE);
 }
 
+// Caller holds m_leaderWriteMutex. Wakes the reader, which closes the fd.
+void PeerManager::shutdownLeaderLocked() {
+  if (m_leaderSocket >= 0)
+    shutdown(m_leaderSocket, SHUT_RDWR);
+  m_connectedToLeader = false;
+}
+
+void PeerManager::joinLeaderReader() {
+  if (m_leaderReader.joinable() &&
+      m_leaderReader.get_id() != std::this_thread::get_id()) {
+    m_leaderReader.join();
+  }
+}
+
 bool PeerManager::isConnectedToLeader() const { return m_connectedToLeader; }
 
 bool PeerManager::connectToPeer(const string &peer_id, const string &ip) {
@@ -150,7 +190,8 @@ bool PeerManager::connectToPeer(const string &peer_id, const string &ip) {
   {
     lock_guard<mutex> lock(m_peersMutex);
     auto it = m_peers.find(peer_id);
-    if (it != m_peers.end() && it->second.socket_fd >= 0) {
+    if (it != m_peers.end() && it->second.connection &&
+        it->second.connection->isOpen()) {
       return true; // Already connected
     }
   }
@@ -197,18 +238,16 @@ bool PeerManager::connectToPeer(const string &peer_id, const string &ip) {
     info.peer_id = peer_id;
     info.ip_address = ip;
     info.is_online = true;
-    info.socket_fd = sock;
+    info.connection = PeerConnection::adopt(sock);
     m_peers[peer_id] = info;
   }
 
   return true;
 }
 
-int PeerManager::getLeaderSocket() const { return m_leaderSocket; }
-
 void PeerManager::registerPeer(const string &peer_id, const string &ip,
                                const string &mac, const string &hostname,
-                               int socket_fd) {
+                               shared_ptr<PeerConnection> connection) {
   lock_guard<mutex> lock(m_peersMutex);
   PeerInfo info;
   info.peer_id = peer_id;
@@ -216,7 +255,7 @@ void PeerManager::registerPeer(const string &peer_id, const string &ip,
   info.mac_address = mac;
   info.hostname = hostname;
   info.is_online = true;
-  info.socket_fd = socket_fd;
+  info.connection = std::move(connection);
   m_peers[peer_id] = info;
   logToFile("Registered peer: " + peer_id + " (" + ip + ")", LOG_CORE);
 }
@@ -225,14 +264,26 @@ void PeerManager::unregisterPeer(const string &peer_id) {
   lock_guard<mutex> lock(m_peersMutex);
   auto it = m_peers.find(peer_id);
   if (it != m_peers.end()) {
-    if (it->second.socket_fd >= 0) {
-      close(it->second.socket_fd);
-    }
+    // The main loop still reads an accepted connection; it sees EOF and
+    // lets go of its handle, which closes the fd
+    if (it->second.connection)
+      it->second.connection->shutdown();
     m_peers.erase(it);
     logToFile("Unregistered peer: " + peer_id, LOG_CORE);
   }
 }
 
+void PeerManager::dropConnection(const shared_ptr<PeerConnection> &connection) {
+  lock_guard<mutex> lock(m_peersMutex);
+  for (auto it = m_peers.begin(); it != m_peers.end(); ++it) {
+    if (it->second.connection == connection) {
+      logToFile("Peer " + it->first + " disconnected", LOG_CORE);
+      m_peers.erase(it);
+      return;
+    }
+  }
+}
+
 void PeerManager::updatePeerStatus(const string &peer_id, bool online) {
   lock_guard<mutex> lock(m_peersMutex);
   auto it = m_peers.find(peer_id);
@@ -256,100 +307,277 @@ PeerInfo PeerManager::getPeerInfo(const string &peer_id) const {
   if (it != m_peers.end()) {
     return it->second;
   }
-  return PeerInfo{"", "", "", "", false, -1};
+  return PeerInfo{};
 }
 
-bool PeerManager::sendToLeader(const json &message) {
-  lock_guard<mutex> lock(m_leaderCommMutex);
+bool PeerManager::writeToLeader(const string &data) {
+  lock_guard<mutex> lock(m_leaderWriteMutex);
 
   if (!m_connectedToLeader || m_leaderSocket < 0) {
     logToFile("Cannot send to leader: not connected", LOG_CORE);
     return false;
   }
 
-  string msg = message.dump() + "\n";
-  ssize_t sent = write(m_leaderSocket, msg.c_str(), msg.length());
-  if (sent < 0) {
-    logToFile("Failed to send to leader: " + string(strerror(errno)), LOG_CORE);
-    disconnectFromLeader();
-    return false;
+  size_t offset = 0;
+  while (offset < data.size()) {
+    ssize_t sent = write(m_leaderSocket, data.data() + offset,
+                         data.size() - offset);
+    if (sent < 0 && errno == EINTR)
+      continue;
+    if (sent <= 0) {
+      logToFile("Failed to send to leader: " + string(strerror(errno)),
+                LOG_CORE);
+      shutdownLeaderLocked();
+      return false;
+    }
+    offset += sent;
   }
   return true;
 }
 
-string PeerManager::forwardToLeader(const json &command, int timeoutMs) {
-  lock_guard<mutex> lock(m_leaderCommMutex);
+bool PeerManager::sendToLeader(const json &message) {
+  return writeToLeader(message.dump() + "\n");
+}
 
-  if (!m_connectedToLeader || m_leaderSocket < 0) {
+bool PeerManager::replyToLeader(const string &reply) {
+  if (reply.empty())
+    return true;
+  return writeToLeader(reply);
+}
+
+future<string> PeerManager::requestLeader(const json &command,
+                                          int timeoutMs) {
+  json request = command;
+  uint64_t id;
+  future<string> reply;
+  {
+    lock_guard<mutex> lock(m_pendingMutex);
+    id = m_nextRequestId++;
+    PendingRequest &pending = m_pendingRequests[id];
+    pending.deadline =
+        chrono::steady_clock::now() + chrono::milliseconds(timeoutMs);
+    reply = pending.reply.get_future();
+  }
+  request["request_id"] = id;
+
+  if (!writeToLeader(request.dump() + "\n"))
+    failRequest(id, "not connected to leader");
+  return reply;
+}
+
+string PeerManager::forwardToLeader(const json &command, int timeoutMs) {
+  string name = command.value("command", "");
+  try {
+    return requestLeader(command, timeoutMs).get();
+  } catch (const LeaderRpcError &e) {
+    logToFile("forwardToLeader: " + name + ": " + e.what(), LOG_CORE);
     return "";
   }
+}
 
-  string msg = command.dump() + "\n";
-  ssize_t sent = write(m_leaderSocket, msg.c_str(), msg.length());
-  if (sent < 0) {
-    logToFile("forwardToLeader: write failed: " + string(strerror(errno)),
-              LOG_CORE);
-    disconnectFromLeader();
-    return "";
+void PeerManager::failRequest(uint64_t id, const string &reason) {
+  lock_guard<mutex> lock(m_pendingMutex);
+  auto it = m_pendingRequests.find(id);
+  if (it == m_pendingRequests.end())
+    return;
+  it->second.reply.set_exception(make_exception_ptr(LeaderRpcError(reason)));
+  m_pendingRequests.erase(it);
+}
+
+void PeerManager::failAllRequests(const string &reason) {
+  lock_guard<mutex> lock(m_pendingMutex);
+  for (auto &pair : m_pendingRequests) {
+    pair.second.reply.set_exception(
+        make_exception_ptr(LeaderRpcError(reason)));
   }
+  m_pendingRequests.clear();
+}
 
-  // Wait for response with timeout using poll()
-  struct pollfd pfd;
-  pfd.fd = m_leaderSocket;
-  pfd.events = POLLIN;
-  int ready = poll(&pfd, 1, timeoutMs);
-  if (ready <= 0) {
-    logToFile("forwardToLeader: " +
-                  string(ready == 0 ? "timeout" : "poll error"),
-              LOG_CORE);
-    return "";
+int PeerManager::expireRequests(int maxWaitMs) {
+  auto now = chrono::steady_clock::now();
+  auto next = now + chrono::milliseconds(maxWaitMs);
+  lock_guard<mutex> lock(m_pendingMutex);
+  for (auto it = m_pendingRequests.begin(); it != m_pendingRequests.end();) {
+    if (it->second.deadline <= now) {
+      it->second.reply.set_exception(
+          make_exception_ptr(LeaderRpcError("timeout")));
+      it = m_pendingRequests.erase(it);
+      continue;
+    }
+    next = min(next, it->second.deadline);
+    ++it;
   }
+  auto waitMs =
+      chrono::duration_cast<chrono::milliseconds>(next - now).count();
+  return static_cast<int>(max<long long>(waitMs, 1));
+}
 
-  char buffer[16384];
-  memset(buffer, 0, sizeof(buffer));
-  ssize_t n = read(m_leaderSocket, buffer, sizeof(buffer) - 1);
-  if (n <= 0) {
-    logToFile("forwardToLeader: read failed", LOG_CORE);
-    return "";
+void PeerManager::leaderReaderLoop(int fd) {
+  const int MAX_POLL_MS = 200;
+  string buffer;
+  bool inPayload = false; // Waiting for the body announced by a header
+  uint64_t replyId = 0;
+  size_t replyLength = 0;
+  char chunk[16384];
+
+  while (true) {
+    struct pollfd pfd;
+    pfd.fd = fd;
+    pfd.events = POLLIN;
+    int ready = poll(&pfd, 1, expireRequests(MAX_POLL_MS));
+    if (ready < 0 && errno == EINTR)
+      continue;
+    if (ready < 0)
+      break;
+    if (ready == 0)
+      continue;
+
+    ssize_t n = read(fd, chunk, sizeof(chunk));
+    if (n < 0 && (errno == EINTR || errno == EAGAIN))
+      continue;
+    if (n <= 0)
+      break;
+    buffer.append(chunk, n);
+
+    while (true) {
+      if (inPayload) {
+        if (buffer.size() < replyLength)
+          break;
+        string payload = buffer.substr(0, replyLength);
+        buffer.erase(0, replyLength);
+        inPayload = false;
+
+        lock_guard<mutex> lock(m_pendingMutex);
+        auto it = m_pendingRequests.find(replyId);
+        if (it == m_pendingRequests.end()) {
+          logToFile("Late reply from leader for request " +
+                        to_string(replyId) + " dropped",
+                    LOG_CORE);
+          continue;
+        }
+        it->second.reply.set_value(std::move(payload));
+        m_pendingRequests.erase(it);
+        continue;
+      }
+
+      size_t pos = buffer.find('\n');
+      if (pos == string::npos)
+        break;
+      string line = buffer.substr(0, pos);
+      buffer.erase(0, pos + 1);
+      if (!line.empty() && line.back() == '\r')
+        line.pop_back();
+
+      json j;
+      try {
+        j = json::parse(line);
+      } catch (...) {
+        logToFile("Invalid JSON from leader: " + line, LOG_CORE);
+        continue;
+      }
+      if (!j.is_object()) {
+        logToFile("Ignoring non-command from leader: " + line, LOG_CORE);
+        continue;
+      }
+
+      if (j.contains("reply_to") && j.contains("length")) {
+        replyId = j["reply_to"].get<uint64_t>();
+        replyLength = j["length"].get<size_t>();
+        inPayload = true;
+        continue;
+      }
+
+      if (!j.contains("command")) {
+        logToFile("Ignoring non-command from leader: " + line, LOG_CORE);
+        continue;
+      }
+
+      {
+        lock_guard<mutex> lock(m_pendingMutex);
+        m_leaderInbox.push_back(std::move(j));
+      }
+      uint64_t one = 1;
+      if (m_leaderInboxFd >= 0 &&
+          write(m_leaderInboxFd, &one, sizeof(one)) < 0 && errno != EAGAIN) {
+        // EAGAIN: counter saturated, the loop is already due to wake
+        logToFile("Failed to wake loop for leader command: " +
+                      string(strerror(errno)),
+                  0xFFFFFFFF);
+      }
+    }
+  }
+
+  logToFile("Lost connection to leader", LOG_CORE);
+  {
+    lock_guard<mutex> lock(m_leaderWriteMutex);
+    close(fd);
+    if (m_leaderSocket == fd) {
+      m_leaderSocket = -1;
+      m_connectedToLeader = false;
+    }
   }
+  failAllRequests("connection to leader lost");
+}
 
-  return string(buffer, n);
+int PeerManager::getLeaderInboxFd() const { return m_leaderInboxFd; }
+
+vector<json> PeerManager::takeLeaderCommands() {
+  uint64_t count;
+  if (m_leaderInboxFd >= 0 &&
+      read(m_leaderInboxFd, &count, sizeof(count)) < 0 && errno != EAGAIN) {
+    // EAGAIN: already cleared; the inbox below is what counts
+    logToFile("Failed to clear leader inbox eventfd: " +
+                  string(strerror(errno)),
+              0xFFFFFFFF);
+  }
+  lock_guard<mutex> lock(m_pendingMutex);
+  vector<json> commands;
+  commands.swap(m_leaderInbox);
+  return commands;
 }
 
 bool PeerManager::sendToPeer(const string &peer_id, const json &message) {
-  lock_guard<mutex> lock(m_peersMutex);
-  auto it = m_peers.find(peer_id);
-  if (it == m_peers.end() || it->second.socket_fd < 0) {
+  shared_ptr<PeerConnection> connection;
+  {
+    lock_guard<mutex> lock(m_peersMutex);
+    auto it = m_peers.find(peer_id);
+    if (it != m_peers.end())
+      connection = it->second.connection;
+  }
+  if (!connection || !connection->isOpen()) {
     logToFile("Cannot send to peer " + peer_id + ": not connected", LOG_CORE);
     return false;
   }
 
-  string msg = message.dump() + "\n";
-  ssize_t sent = write(it->second.socket_fd, msg.c_str(), msg.length());
-  if (sent < 0) {
+  if (!connection->send(message.dump() + "\n")) {
     logToFile("Failed to send to peer " + peer_id + ": " +
                   string(strerror(errno)),
               LOG_CORE);
-    close(it->second.socket_fd);
-    m_peers.erase(it);
+    connection->shutdown();
+    dropConnection(connection);
     return false;
   }
   return true;
 }
 
 void PeerManager::broadcastToWorkers(const json &message) {
-  lock_guard<mutex> lock(m_peersMutex);
-  string msg = message.dump() + "\n";
-
-  for (auto &pair : m_peers) {
-    if (pair.second.socket_fd >= 0 && pair.second.is_online) {
-      ssize_t sent =
-          write(pair.second.socket_fd, msg.c_str(), msg.length());
-      if (sent < 0) {
-        logToFile("Failed to broadcast to " + pair.first, LOG_CORE);
-      }
+  const int SEND_TIMEOUT_MS = 1000;
+  vector<pair<string, shared_ptr<PeerConnection>>> targets;
+  {
+    lock_guard<mutex> lock(m_peersMutex);
+    for (auto &pair : m_peers) {
+      if (pair.second.connection && pair.second.is_online)
+        targets.push_back({pair.first, pair.second.connection});
     }
   }
+
+  // Send outside the lock, each worker bounded so a stalled one can't hold
+  // up the rest. The handles keep the fds open until we are done.
+  string msg = message.dump() + "\n";
+  for (const auto &[peer_id, connection] : targets) {
+    if (!connection->send(msg, SEND_TIMEOUT_MS))
+      logToFile("Failed to broadcast to " + peer_id, LOG_CORE);
+  }
 }
 
 void PeerManager::loadConfig() {
@@ -388,22 +616,96 @@ void PeerManager::startReconnectLoop() {
   }
 
   m_reconnectRunning.store(true);
+  ServiceWatcher::setChangeListener(
+      [this](const string &) { notifyAppStatusChanged(); });
   m_reconnectThread = std::thread(&PeerManager::reconnectLoop, this);
   logToFile("Started reconnect loop thread", LOG_CORE);
 }
 
 void PeerManager::stopReconnectLoop() {
-  m_reconnectRunning.store(false);
+  ServiceWatcher::setChangeListener(nullptr);
+  {
+    lock_guard<mutex> lock(m_appStatusMutex);
+    m_reconnectRunning.store(false);
+  }
+  m_appStatusWake.notify_all();
   if (m_reconnectThread.joinable()) {
     m_reconnectThread.join();
   }
+  if (!isLeader())
+    disconnectFromLeader(); // Joins the reader thread
   logToFile("Stopped reconnect loop thread", LOG_CORE);
 }
 
+void PeerManager::notifyAppStatusChanged() {
+  {
+    lock_guard<mutex> lock(m_appStatusMutex);
+    m_appStatusDirty = true;
+  }
+  m_appStatusWake.notify_all();
+}
+
+void PeerManager::requestReplicaSync() {
+  {
+    lock_guard<mutex> lock(m_appStatusMutex);
+    m_replicaSyncDue = true;
+  }
+  m_appStatusWake.notify_all();
+}
+
+PeerManager::StatusPush PeerManager::pushAppStatus() {
+  const int APP_STATUS_TIMEOUT_MS = 2000;
+  json current = AppManager::getLocalAppStatusAll();
+
+  // Second round only when the leader lost the base version (it restarted
+  // or missed a push): resend in full
+  for (int round = 0; round < 2; round++) {
+    json msg;
+    msg["command"] = "heartbeat";
+    msg["peer_id"] = m_peerId;
+    msg["daemon_version"] = DAEMON_VERSION;
+    uint64_t version;
+    {
+      lock_guard<mutex> lock(m_appStatusMutex);
+      if (m_ackedAppStatusVersion != 0 && current == m_ackedAppStatus)
+        return StatusPush::Unchanged;
+      version = ++m_appStatusVersion;
+      if (m_ackedAppStatusVersion == 0) {
+        msg["appStatus"] = current;
+      } else {
+        msg["appStatusBase"] = m_ackedAppStatusVersion;
+        msg["appStatusDelta"] = json::diff(m_ackedAppStatus, current);
+      }
+    }
+    msg["appStatusVersion"] = version;
+
+    string reply = forwardToLeader(msg, APP_STATUS_TIMEOUT_MS);
+    if (reply.empty())
+      return StatusPush::Failed; // Older leader (no ack) or connection lost
+    uint64_t held = 0;
+    try {
+      held = json::parse(reply).value("version", uint64_t(0));
+    } catch (...) {
+    }
+
+    lock_guard<mutex> lock(m_appStatusMutex);
+    if (held == version) {
+      m_ackedAppStatus = current;
+      m_ackedAppStatusVersion = version;
+      return StatusPush::Acked;
+    }
+    m_ackedAppStatusVersion = 0;
+  }
+  return StatusPush::Failed;
+}
+
 void PeerManager::reconnectLoop() {
   const int HEARTBEAT_INTERVAL_SECS = 10;
-  const int APP_STATUS_INTERVAL_SECS = 60;
-  int appStatusCounter = 0;
+  // Without the service watcher each status read forks systemctl; poll for
+  // changes at the old full-status interval then
+  const int APP_STATUS_POLL_SECS = 60;
+  int secsSinceStatusPoll = 0;
+  bool pushFailed = false; // Hold change pushes until the next heartbeat
 
   while (m_reconnectRunning.load()) {
     // Leader: just touch own last_seen periodically
@@ -423,28 +725,60 @@ void PeerManager::reconnectLoop() {
                 LOG_CORE);
       if (connectToLeader()) {
         logToFile("Reconnected to leader successfully", LOG_CORE);
-        appStatusCounter = 0;
+        pushFailed = false;
+        LeaderReplica::sync();
       }
     }
 
-    // Sleep in small increments to allow quick shutdown
-    for (int i = 0; i < HEARTBEAT_INTERVAL_SECS && m_reconnectRunning.load();
-         i++) {
-      std::this_thread::sleep_for(std::chrono::seconds(1));
-      appStatusCounter++;
+    // Sleep until the next heartbeat; a status change is pushed right away,
+    // a replica gap is filled right away
+    auto heartbeatAt = chrono::steady_clock::now() +
+                       chrono::seconds(HEARTBEAT_INTERVAL_SECS);
+    while (m_reconnectRunning.load() &&
+           chrono::steady_clock::now() < heartbeatAt) {
+      bool changed;
+      bool syncDue;
+      {
+        unique_lock<mutex> lock(m_appStatusMutex);
+        m_appStatusWake.wait_until(lock, heartbeatAt, [this] {
+          return m_appStatusDirty || m_replicaSyncDue ||
+                 !m_reconnectRunning.load();
+        });
+        changed = m_appStatusDirty;
+        m_appStatusDirty = false;
+        syncDue = m_replicaSyncDue;
+        m_replicaSyncDue = false;
+      }
+      if (changed && !pushFailed && m_connectedToLeader)
+        pushFailed = pushAppStatus() == StatusPush::Failed;
+      if (syncDue && m_connectedToLeader)
+        LeaderReplica::sync();
     }
+    secsSinceStatusPoll += HEARTBEAT_INTERVAL_SECS;
 
-    // Send heartbeat every 10s, include appStatus every 60s
-    if (m_connectedToLeader) {
+    if (!m_reconnectRunning.load() || !m_connectedToLeader)
+      continue;
+
+    // The heartbeat carries the app status if it changed since the last ack;
+    // in steady state it is just the liveness ping
+    StatusPush pushed = StatusPush::Unchanged;
+    if (ServiceWatcher::isRunning() ||
+        secsSinceStatusPoll >= APP_STATUS_POLL_SECS) {
+      pushed = pushAppStatus();
+      secsSinceStatusPoll = 0;
+    }
+    pushFailed = pushed == StatusPush::Failed;
+    if (pushed != StatusPush::Acked) {
       json hb;
       hb["command"] = "heartbeat";
       hb["peer_id"] = m_peerId;
       hb["daemon_version"] = DAEMON_VERSION;
-      if (appStatusCounter >= APP_STATUS_INTERVAL_SECS) {
+      if (pushed == StatusPush::Failed) // Leader without versioned status
         hb["appStatus"] = AppManager::getLocalAppStatusAll();
-        appStatusCounter = 0;
-      }
       sendToLeader(hb);
     }
+    // Catches pushes lost with a dropped connection and keeps the replica
+    // confirmed current while nothing changes
+    LeaderReplica::sync();
   }
 }
@@ -0,0 +1,260 @@
+#include "PeerRegistry.h"
+#include "Utils.h"
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <ctime>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <thread>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+const size_t INTERVAL_WINDOW = 100;        // Heartbeat intervals kept per peer
+const double EXPECTED_INTERVAL_MS = 10000; // Worker heartbeat interval
+const double MIN_STDDEV_MS = 1000;         // Heartbeats are near-periodic
+const double ACCEPTABLE_PAUSE_MS = 2000;   // GC, slow leader RPC, scheduling
+const double SUSPECT_PHI = 3.0;            // ~15 s overdue at 10 s heartbeats
+const double OFFLINE_PHI = 8.0;            // ~17 s
+
+struct Entry {
+  PeerRecord record;
+  bool connected = false; // Heard from and not disconnected since
+  bool heard = false;     // lastHeartbeat is a real arrival, not the load
+  Clock::time_point lastHeartbeat;
+  time_t lastSeenWall = 0;
+  std::deque<double> intervalsMs;
+  bool dirty = false;          // Changed since the last persist
+  bool persistedOnline = false;
+};
+
+std::mutex registryMutex;
+std::map<std::string, Entry> peers;
+std::atomic<bool> loaded{false};
+
+std::mutex persistMutex; // Serializes persist() runs
+std::thread persistThread;
+std::atomic<bool> persistRunning{false};
+std::condition_variable persistWake;
+std::mutex wakeMutex;
+
+// Probability, on a log scale, that a heartbeat this late is still coming:
+// -log10(1 - F(elapsed)) for a normal distribution fitted to the window
+// (logistic approximation of the CDF, as in Akka's detector)
+double computePhi(const Entry &entry, Clock::time_point now) {
+  double elapsed =
+      std::chrono::duration<double, std::milli>(now - entry.lastHeartbeat)
+          .count();
+  double mean = EXPECTED_INTERVAL_MS;
+  double stddev = EXPECTED_INTERVAL_MS / 4;
+  if (!entry.intervalsMs.empty()) {
+    double sum = 0, sumSquares = 0;
+    for (double interval : entry.intervalsMs) {
+      sum += interval;
+      sumSquares += interval * interval;
+    }
+    double n = entry.intervalsMs.size();
+    mean = sum / n;
+    stddev = std::sqrt(std::max(0.0, sumSquares / n - mean * mean));
+  }
+  mean += ACCEPTABLE_PAUSE_MS;
+  stddev = std::max(stddev, MIN_STDDEV_MS);
+
+  double y = (elapsed - mean) / stddev;
+  double e = std::exp(-y * (1.5976 + 0.070566 * y * y));
+  if (elapsed > mean)
+    return -std::log10(e / (1.0 + e));
+  return -std::log10(1.0 - 1.0 / (1.0 + e));
+}
+
+std::string formatTime(time_t t) {
+  if (t == 0)
+    return "";
+  struct tm tm;
+  localtime_r(&t, &tm);
+  char buffer[32];
+  strftime(buffer, sizeof(buffer), "%Y-%m-%d %H:%M:%S", &tm);
+  return buffer;
+}
+
+// Caller holds registryMutex
+PeerRecord snapshot(const Entry &entry, Clock::time_point now) {
+  PeerRecord peer = entry.record;
+  peer.phi = entry.connected ? computePhi(entry, now) : 0.0;
+  peer.is_online = entry.connected && peer.phi < OFFLINE_PHI;
+  peer.is_suspect = peer.is_online && peer.phi >= SUSPECT_PHI;
+  peer.last_seen = formatTime(entry.lastSeenWall);
+  return peer;
+}
+
+// Caller holds registryMutex
+void recordHeartbeat(Entry &entry) {
+  Clock::time_point now = Clock::now();
+  if (entry.connected && entry.heard) {
+    entry.intervalsMs.push_back(
+        std::chrono::duration<double, std::milli>(now - entry.lastHeartbeat)
+            .count());
+    if (entry.intervalsMs.size() > INTERVAL_WINDOW)
+      entry.intervalsMs.pop_front();
+  }
+  entry.connected = true;
+  entry.heard = true;
+  entry.lastHeartbeat = now;
+  entry.lastSeenWall = time(nullptr);
+  entry.dirty = true;
+}
+
+void persistLoop(int intervalMs) {
+  while (persistRunning) {
+    {
+      std::unique_lock<std::mutex> lock(wakeMutex);
+      persistWake.wait_for(lock, std::chrono::milliseconds(intervalMs),
+                           [] { return !persistRunning.load(); });
+    }
+    PeerRegistry::persist();
+  }
+}
+
+} // namespace
+
+bool PeerRegistry::start(int persistIntervalMs) {
+  if (loaded)
+    return true;
+  // Freshness of the stored rows stands in for the first heartbeat: peers
+  // that were online get one detector period to show up again
+  std::vector<PeerRecord> rows = PeerTable::getAllPeers();
+  {
+    std::lock_guard<std::mutex> lock(registryMutex);
+    time_t now = time(nullptr);
+    for (const PeerRecord &row : rows) {
+      Entry &entry = peers[row.peer_id];
+      entry.record = row;
+      entry.connected = row.is_online;
+      entry.persistedOnline = row.is_online;
+      entry.lastHeartbeat = Clock::now();
+      entry.lastSeenWall = now;
+      struct tm tm = {};
+      tm.tm_isdst = -1;
+      if (strptime(row.last_seen.c_str(), "%Y-%m-%d %H:%M:%S", &tm))
+        entry.lastSeenWall = mktime(&tm);
+    }
+    loaded = true;
+  }
+  persistRunning = true;
+  persistThread = std::thread(persistLoop, persistIntervalMs);
+  logToFile("PeerRegistry: loaded " + std::to_string(rows.size()) + " peers",
+            LOG_CORE);
+  return true;
+}
+
+void PeerRegistry::stop() {
+  if (!persistRunning.exchange(false))
+    return;
+  {
+    std::lock_guard<std::mutex> lock(wakeMutex);
+  }
+  persistWake.notify_all();
+  if (persistThread.joinable())
+    persistThread.join();
+  persist();
+}
+
+bool PeerRegistry::isLoaded() { return loaded; }
+
+void PeerRegistry::put(const PeerRecord &peer) {
+  std::lock_guard<std::mutex> lock(registryMutex);
+  Entry &entry = peers[peer.peer_id];
+  entry.record.peer_id = peer.peer_id;
+  entry.record.ip_address = peer.ip_address;
+  entry.record.mac_address = peer.mac_address;
+  entry.record.hostname = peer.hostname;
+  entry.record.daemon_version = peer.daemon_version;
+  if (peer.is_online) {
+    recordHeartbeat(entry);
+  } else {
+    entry.connected = false;
+    entry.heard = false;
+    if (entry.lastSeenWall == 0)
+      entry.lastSeenWall = time(nullptr);
+    entry.dirty = true;
+  }
+}
+
+void PeerRegistry::heartbeat(const std::string &peer_id, int daemon_version) {
+  std::lock_guard<std::mutex> lock(registryMutex);
+  auto it = peers.find(peer_id);
+  if (it == peers.end())
+    return; // Like the UPDATE it replaces: unknown until registered
+  if (daemon_version >= 0)
+    it->second.record.daemon_version = daemon_version;
+  recordHeartbeat(it->second);
+}
+
+void PeerRegistry::setOnline(const std::string &peer_id, bool online) {
+  std::lock_guard<std::mutex> lock(registryMutex);
+  auto it = peers.find(peer_id);
+  if (it == peers.end())
+    return;
+  if (online) {
+    recordHeartbeat(it->second);
+    return;
+  }
+  it->second.connected = false;
+  it->second.heard = false;
+  it->second.lastSeenWall = time(nullptr);
+  it->second.dirty = true;
+}
+
+void PeerRegistry::erase(const std::string &peer_id) {
+  std::lock_guard<std::mutex> lock(registryMutex);
+  peers.erase(peer_id);
+}
+
+void PeerRegistry::clear() {
+  std::lock_guard<std::mutex> lock(registryMutex);
+  peers.clear();
+}
+
+bool PeerRegistry::get(const std::string &peer_id, PeerRecord &peer) {
+  std::lock_guard<std::mutex> lock(registryMutex);
+  auto it = peers.find(peer_id);
+  if (it == peers.end())
+    return false;
+  peer = snapshot(it->second, Clock::now());
+  return true;
+}
+
+std::vector<PeerRecord> PeerRegistry::getAll() {
+  std::vector<PeerRecord> result;
+  std::lock_guard<std::mutex> lock(registryMutex);
+  Clock::time_point now = Clock::now();
+  result.reserve(peers.size());
+  for (const auto &pair : peers)
+    result.push_back(snapshot(pair.second, now));
+  return result;
+}
+
+void PeerRegistry::persist() {
+  std::lock_guard<std::mutex> persistLock(persistMutex);
+  std::vector<PeerRecord> changed;
+  {
+    std::lock_guard<std::mutex> lock(registryMutex);
+    Clock::time_point now = Clock::now();
+    for (auto &pair : peers) {
+      Entry &entry = pair.second;
+      PeerRecord peer = snapshot(entry, now);
+      // Detector verdicts change without an event; store those too
+      if (!entry.dirty && peer.is_online == entry.persistedOnline)
+        continue;
+      changed.push_back(peer);
+      entry.dirty = false;
+      entry.persistedOnline = peer.is_online;
+    }
+  }
+  if (!changed.empty())
+    PeerTable::saveLiveness(changed);
+}
@@ -0,0 +1,183 @@
+#include "PortProbe.h"
+#include "Utils.h"
+#include <arpa/inet.h>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <dirent.h>
+#include <linux/inet_diag.h>
+#include <linux/netlink.h>
+#include <linux/sock_diag.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <set>
+#include <string>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+namespace {
+
+const uint32_t LISTEN_STATES = 1u << TCP_LISTEN;
+const uint32_t ALL_STATES = 0xFFFFFFFF;
+
+// Dump the TCP sockets of one family bound to port in the given states and
+// collect their inodes (0 for sockets no process owns, like TIME_WAIT).
+// Returns false when the kernel refused the request.
+bool dumpFamily(int family, int port, uint32_t states,
+                std::set<uint32_t> &inodes, bool &found) {
+  int fd = socket(AF_NETLINK, SOCK_DGRAM | SOCK_CLOEXEC, NETLINK_SOCK_DIAG);
+  if (fd < 0)
+    return false;
+  struct timeval tv = {1, 0}; // Never hang a restart on the kernel
+  setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+  struct {
+    nlmsghdr nlh;
+    inet_diag_req_v2 req;
+  } request;
+  memset(&request, 0, sizeof(request));
+  request.nlh.nlmsg_len = sizeof(request);
+  request.nlh.nlmsg_type = SOCK_DIAG_BY_FAMILY;
+  request.nlh.nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP;
+  request.req.sdiag_family = family;
+  request.req.sdiag_protocol = IPPROTO_TCP;
+  request.req.idiag_states = states;
+  request.req.id.idiag_sport = htons(port); // The kernel filters on it
+
+  sockaddr_nl kernel;
+  memset(&kernel, 0, sizeof(kernel));
+  kernel.nl_family = AF_NETLINK;
+  if (sendto(fd, &request, sizeof(request), 0, (sockaddr *)&kernel,
+             sizeof(kernel)) < 0) {
+    close(fd);
+    return false;
+  }
+
+  alignas(nlmsghdr) char buffer[16384];
+  bool ok = true;
+  bool done = false;
+  while (!done) {
+    int len = (int)recv(fd, buffer, sizeof(buffer), 0);
+    if (len < 0 && errno == EINTR)
+      continue;
+    if (len <= 0) {
+      ok = false;
+      break;
+    }
+    for (nlmsghdr *h = (nlmsghdr *)buffer; NLMSG_OK(h, len);
+         h = NLMSG_NEXT(h, len)) {
+      if (h->nlmsg_type == NLMSG_DONE) {
+        done = true;
+        break;
+      }
+      if (h->nlmsg_type == NLMSG_ERROR) {
+        ok = false;
+        done = true;
+        break;
+      }
+      auto *msg = (inet_diag_msg *)NLMSG_DATA(h);
+      // Older kernels ignore idiag_sport in dumps
+      if (ntohs(msg->id.idiag_sport) != port)
+        continue;
+      found = true;
+      inodes.insert(msg->idiag_inode);
+    }
+  }
+  close(fd);
+  return ok;
+}
+
+// Both families. A host without IPv6 answers the AF_INET6 dump with an
+// error; only IPv4 failing means the probe can't be used.
+bool dumpPort(int port, uint32_t states, std::set<uint32_t> &inodes,
+              bool &found) {
+  found = false;
+  if (port <= 0 || port > 65535)
+    return true;
+  if (!dumpFamily(AF_INET, port, states, inodes, found)) {
+    static bool warned = false;
+    if (!warned) {
+      warned = true;
+      logToFile("PortProbe: sock_diag unavailable, using ss/fuser",
+                LOG_CORE);
+    }
+    return false;
+  }
+  dumpFamily(AF_INET6, port, states, inodes, found);
+  return true;
+}
+
+// Processes with an open fd on any of the socket inodes
+std::set<pid_t> ownersOf(const std::set<uint32_t> &inodes) {
+  std::set<pid_t> pids;
+  DIR *proc = opendir("/proc");
+  if (!proc)
+    return pids;
+  while (dirent *entry = readdir(proc)) {
+    char *end;
+    long pid = strtol(entry->d_name, &end, 10);
+    if (*end != '\0' || pid <= 0)
+      continue;
+    std::string fdDir = std::string("/proc/") + entry->d_name + "/fd";
+    DIR *fds = opendir(fdDir.c_str());
+    if (!fds)
+      continue; // Exited, or not ours to look at
+    while (dirent *fdEntry = readdir(fds)) {
+      char target[64];
+      std::string link = fdDir + "/" + fdEntry->d_name;
+      ssize_t n = readlink(link.c_str(), target, sizeof(target) - 1);
+      if (n <= 0)
+        continue;
+      target[n] = '\0';
+      unsigned long inode;
+      if (sscanf(target, "socket:[%lu]", &inode) == 1 &&
+          inodes.count((uint32_t)inode)) {
+        pids.insert((pid_t)pid);
+        break;
+      }
+    }
+    closedir(fds);
+  }
+  closedir(proc);
+  return pids;
+}
+
+} // namespace
+
+bool PortProbe::isListening(int port, bool &listening) {
+  std::set<uint32_t> inodes;
+  return dumpPort(port, LISTEN_STATES, inodes, listening);
+}
+
+bool PortProbe::listenerPid(int port, pid_t &pid) {
+  std::set<uint32_t> inodes;
+  bool found;
+  if (!dumpPort(port, LISTEN_STATES, inodes, found))
+    return false;
+  pid = 0;
+  inodes.erase(0);
+  if (!inodes.empty()) {
+    std::set<pid_t> owners = ownersOf(inodes);
+    if (!owners.empty())
+      pid = *owners.begin();
+  }
+  return true;
+}
+
+bool PortProbe::socketOwners(int port, std::vector<pid_t> &pids) {
+  std::set<uint32_t> inodes;
+  bool found;
+  if (!dumpPort(port, ALL_STATES, inodes, found))
+    return false;
+  pids.clear();
+  inodes.erase(0);
+  if (inodes.empty())
+    return true;
+  for (pid_t pid : ownersOf(inodes)) {
+    if (pid != getpid())
+      pids.push_back(pid);
+  }
+  return true;
+}
@@ -0,0 +1,279 @@
+#include "PortRegistry.h"
+#include "DatabaseTableManagers.h"
+#include "PortProbe.h"
+#include "SettingsCache.h"
+#include "Utils.h"
+#include <algorithm>
+#include <cstdint>
+#include <ctime>
+#include <map>
+#include <mutex>
+
+namespace {
+
+const int SLOTS = PortRegistry::RANGE_END - PortRegistry::RANGE_START;
+const int WORDS = (SLOTS + 63) / 64;
+const std::string PREFIX = "port_";
+
+std::mutex registryMutex;
+bool loaded = false;
+int subscription = -1;
+std::map<std::string, int> portByKey;
+std::map<std::string, PortLeaseRecord> leases;
+uint16_t holders[SLOTS]; // Keys per port; a port may be shared
+uint64_t taken[WORDS];   // Bit per slot, set while it has holders
+
+bool inRange(int port) {
+  return port >= PortRegistry::RANGE_START && port < PortRegistry::RANGE_END;
+}
+
+int parsePort(const std::string &value) {
+  try {
+    return std::stoi(value);
+  } catch (...) {
+    return 0;
+  }
+}
+
+std::string now() {
+  time_t t = time(nullptr);
+  struct tm tm;
+  localtime_r(&t, &tm);
+  char buffer[32];
+  strftime(buffer, sizeof(buffer), "%Y-%m-%d %H:%M:%S", &tm);
+  return buffer;
+}
+
+// Caller holds registryMutex
+void holdLocked(int port) {
+  if (!inRange(port))
+    return;
+  int slot = port - PortRegistry::RANGE_START;
+  if (holders[slot]++ == 0)
+    taken[slot / 64] |= 1ULL << (slot % 64);
+}
+
+// Caller holds registryMutex
+void releaseLocked(int port) {
+  if (!inRange(port))
+    return;
+  int slot = port - PortRegistry::RANGE_START;
+  if (holders[slot] > 0 && --holders[slot] == 0)
+    taken[slot / 64] &= ~(1ULL << (slot % 64));
+}
+
+// Caller holds registryMutex. port 0 unregisters key.
+void setKeyLocked(const std::string &key, int port) {
+  auto it = portByKey.find(key);
+  if (it != portByKey.end()) {
+    if (it->second == port)
+      return;
+    releaseLocked(it->second);
+    portByKey.erase(it);
+  }
+  if (port > 0) {
+    portByKey[key] = port;
+    holdLocked(port);
+  }
+}
+
+// Caller holds registryMutex. Lowest free slot in [from, to) that isn't in
+// skip; with pair, the lowest even slot whose odd neighbour is free too.
+int findFreeLocked(int from, int to, bool pair, const uint64_t *skip) {
+  for (int w = from / 64; w < WORDS && w * 64 < to; w++) {
+    int base = w * 64;
+    uint64_t free = ~(taken[w] | skip[w]);
+    if (from > base)
+      free &= ~0ULL << (from - base);
+    if (to < base + 64)
+      free &= ~0ULL >> (64 - (to - base));
+    if (pair) // Slots start at an even port, so even slots pair within a word
+      free &= (free >> 1) & 0x5555555555555555ULL;
+    if (free)
+      return base + __builtin_ctzll(free);
+  }
+  return -1;
+}
+
+// Caller holds registryMutex. Checks candidates against the live sockets:
+// a port something listens on outside the registry is passed over.
+int allocateLocked(int fromPort, int toPort, bool pair) {
+  uint64_t skip[WORDS] = {};
+  int from = fromPort - PortRegistry::RANGE_START;
+  int to = toPort - PortRegistry::RANGE_START;
+  int slot;
+  while ((slot = findFreeLocked(from, to, pair, skip)) >= 0) {
+    bool busy = false;
+    for (int s = slot; s < slot + (pair ? 2 : 1); s++) {
+      bool listening = false;
+      int port = PortRegistry::RANGE_START + s;
+      if (PortProbe::isListening(port, listening) && listening) {
+        logToFile("PortRegistry: port " + std::to_string(port) +
+                      " is in use by an unregistered listener, skipping",
+                  LOG_CORE);
+        skip[s / 64] |= 1ULL << (s % 64);
+        busy = true;
+      }
+    }
+    if (!busy)
+      return PortRegistry::RANGE_START + slot;
+  }
+  return -1;
+}
+
+// After the in-memory reservation: write the port_ row and the lease
+void commit(const std::string &key, int port, const std::string &app_id,
+            const std::string &peer_id) {
+  SettingsTable::setSetting(PREFIX + key, std::to_string(port));
+  PortRegistry::lease(key, app_id, peer_id);
+}
+
+void onPortSetting(const std::string &settingKey, const std::string &value) {
+  std::string key = settingKey.substr(PREFIX.size());
+  int port = value.empty() ? 0 : parsePort(value);
+  bool dropLease = false;
+  {
+    std::lock_guard<std::mutex> lock(registryMutex);
+    setKeyLocked(key, port);
+    if (port == 0)
+      dropLease = leases.erase(key) > 0;
+  }
+  if (dropLease)
+    PortLeaseTable::deleteLease(key);
+}
+
+} // namespace
+
+bool PortRegistry::start() {
+  if (loaded || !SettingsCache::isLoaded())
+    return false;
+  // Subscribe first: a change racing the load is applied after it
+  subscription = SettingsCache::subscribe(SettingsCache::Table::Settings,
+                                          PREFIX, onPortSetting);
+  std::vector<std::string> staleLeases;
+  {
+    std::lock_guard<std::mutex> lock(registryMutex);
+    portByKey.clear();
+    leases.clear();
+    std::fill(std::begin(holders), std::end(holders), 0);
+    std::fill(std::begin(taken), std::end(taken), 0);
+    for (const auto &[settingKey, value] :
+         SettingsCache::getAll(SettingsCache::Table::Settings)) {
+      if (settingKey.compare(0, PREFIX.size(), PREFIX) == 0)
+        setKeyLocked(settingKey.substr(PREFIX.size()), parsePort(value));
+    }
+    for (const PortLeaseRecord &lease : PortLeaseTable::getAllLeases()) {
+      if (portByKey.count(lease.port_key))
+        leases[lease.port_key] = lease;
+      else
+        staleLeases.push_back(lease.port_key);
+    }
+    loaded = true;
+    logToFile("PortRegistry: " + std::to_string(portByKey.size()) +
+                  " ports, " + std::to_string(leases.size()) + " leases",
+              LOG_CORE);
+  }
+  for (const std::string &key : staleLeases)
+    PortLeaseTable::deleteLease(key);
+  return true;
+}
+
+void PortRegistry::stop() {
+  std::lock_guard<std::mutex> lock(registryMutex);
+  if (!loaded)
+    return;
+  SettingsCache::unsubscribe(subscription);
+  loaded = false;
+}
+
+bool PortRegistry::isLoaded() {
+  std::lock_guard<std::mutex> lock(registryMutex);
+  return loaded;
+}
+
+bool PortRegistry::allocatePair(const std::string &firstKey,
+                                const std::string &secondKey,
+                                const std::string &app_id,
+                                const std::string &peer_id, int &first,
+                                int &second) {
+  {
+    std::lock_guard<std::mutex> lock(registryMutex);
+    if (!loaded)
+      return false;
+    first = allocateLocked(RANGE_START, SERVER_RANGE_START, true);
+    if (first < 0)
+      return false;
+    second = first + 1;
+    setKeyLocked(firstKey, first);
+    setKeyLocked(secondKey, second);
+  }
+  commit(firstKey, first, app_id, peer_id);
+  commit(secondKey, second, app_id, peer_id);
+  return true;
+}
+
+bool PortRegistry::allocateServer(const std::string &key,
+                                  const std::string &app_id,
+                                  const std::string &peer_id, int &port) {
+  {
+    std::lock_guard<std::mutex> lock(registryMutex);
+    if (!loaded)
+      return false;
+    port = allocateLocked(SERVER_RANGE_START, RANGE_END, false);
+    if (port < 0)
+      return false;
+    setKeyLocked(key, port);
+  }
+  commit(key, port, app_id, peer_id);
+  return true;
+}
+
+void PortRegistry::lease(const std::string &key, const std::string &app_id,
+                         const std::string &peer_id) {
+  PortLeaseRecord lease{key, app_id, peer_id, now()};
+  {
+    std::lock_guard<std::mutex> lock(registryMutex);
+    if (!loaded || !portByKey.count(key))
+      return;
+    if (app_id.empty() && leases.count(key))
+      return; // Keep the owner; setPort without --app only moves the port
+    leases[key] = lease;
+  }
+  PortLeaseTable::upsertLease(lease);
+}
+
+std::vector<std::string> PortRegistry::keysOnPort(int port) {
+  std::vector<std::string> keys;
+  std::lock_guard<std::mutex> lock(registryMutex);
+  if (inRange(port) && holders[port - RANGE_START] == 0)
+    return keys;
+  for (const auto &[key, keyPort] : portByKey) {
+    if (keyPort == port)
+      keys.push_back(key);
+  }
+  return keys;
+}
+
+std::vector<PortEntry> PortRegistry::list() {
+  std::vector<PortEntry> entries;
+  {
+    std::lock_guard<std::mutex> lock(registryMutex);
+    for (const auto &[key, port] : portByKey) {
+      PortEntry entry;
+      entry.key = key;
+      entry.port = port;
+      auto it = leases.find(key);
+      if (it != leases.end()) {
+        entry.app_id = it->second.app_id;
+        entry.peer_id = it->second.peer_id;
+        entry.leased_at = it->second.leased_at;
+      }
+      entries.push_back(entry);
+    }
+  }
+  std::sort(entries.begin(), entries.end(),
+            [](const PortEntry &a, const PortEntry &b) {
+              return a.port != b.port ? a.port < b.port : a.key < b.key;
+            });
+  return entries;
+}
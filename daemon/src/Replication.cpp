@@ -0,0 +1,368 @@
+#include "Replication.h"
+#include "Constants.h"
+#include "PeerManager.h"
+#include "SettingsCache.h"
+#include "Utils.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <random>
+#include <set>
+#include <thread>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+const size_t LOG_CAPACITY = 1024; // Changes a reconnecting worker can replay
+const int PUSH_COALESCE_MS = 20;  // Batch bursts like installApp's setPorts
+const int SYNC_TIMEOUT_MS = 2000;
+
+// Node-local settings that change often and mean nothing on another machine
+const std::set<std::string> LOCAL_SETTINGS = {INDEX_OF_LAST_TOUCHED_DIR_KEY};
+
+json peerToJson(const PeerRecord &peer) {
+  return {{"peer_id", peer.peer_id},
+          {"ip_address", peer.ip_address},
+          {"mac_address", peer.mac_address},
+          {"hostname", peer.hostname},
+          {"last_seen", peer.last_seen},
+          {"is_online", peer.is_online},
+          {"daemon_version", peer.daemon_version}};
+}
+
+PeerRecord peerFromJson(const json &j) {
+  PeerRecord peer;
+  peer.peer_id = j.value("peer_id", "");
+  peer.ip_address = j.value("ip_address", "");
+  peer.mac_address = j.value("mac_address", "");
+  peer.hostname = j.value("hostname", "");
+  peer.last_seen = j.value("last_seen", "");
+  peer.is_online = j.value("is_online", false);
+  peer.daemon_version = j.value("daemon_version", 0);
+  return peer;
+}
+
+// Leader log
+std::mutex logMutex;
+std::deque<json> changes; // Oldest first, consecutive seq
+uint64_t epoch = 0;
+uint64_t lastSeq = 0;
+uint64_t pushedSeq = 0;
+int settingsSubscription = -1;
+std::condition_variable pushWake;
+std::thread pushThread;
+std::atomic<bool> pushRunning{false};
+
+// Caller holds logMutex
+void appendLocked(json change) {
+  change["seq"] = ++lastSeq;
+  changes.push_back(std::move(change));
+  if (changes.size() > LOG_CAPACITY)
+    changes.pop_front();
+}
+
+// Record the key's current value rather than the listener's: two writers
+// racing on one key then still leave the log ending in the stored value
+void recordSetting(const std::string &key) {
+  if (LOCAL_SETTINGS.count(key))
+    return;
+  {
+    std::lock_guard<std::mutex> lock(logMutex);
+    std::string value;
+    if (SettingsCache::get(SettingsCache::Table::Settings, key, value))
+      appendLocked({{"table", "settings"}, {"op", "put"}, {"key", key},
+                    {"value", value}});
+    else
+      appendLocked({{"table", "settings"}, {"op", "delete"}, {"key", key}});
+  }
+  pushWake.notify_one();
+}
+
+// Caller holds logMutex. Changes after since, or null when the log no
+// longer reaches back that far.
+json changesAfterLocked(uint64_t since) {
+  uint64_t oldest = lastSeq - changes.size(); // seq just before the first
+  if (since < oldest || since > lastSeq)
+    return nullptr;
+  json result = json::array();
+  for (size_t i = since - oldest; i < changes.size(); i++)
+    result.push_back(changes[i]);
+  return result;
+}
+
+void pushLoop() {
+  while (pushRunning) {
+    json batch;
+    uint64_t batchEpoch;
+    {
+      std::unique_lock<std::mutex> lock(logMutex);
+      pushWake.wait(lock,
+                    [] { return !pushRunning || lastSeq > pushedSeq; });
+      if (!pushRunning)
+        break;
+      lock.unlock();
+      std::this_thread::sleep_for(std::chrono::milliseconds(PUSH_COALESCE_MS));
+      lock.lock();
+      batch = changesAfterLocked(pushedSeq);
+      if (batch.is_null()) { // Overflowed; workers notice the gap and sync
+        batch = json::array();
+        for (const json &change : changes)
+          batch.push_back(change);
+      }
+      pushedSeq = lastSeq;
+      batchEpoch = epoch;
+    }
+    PeerManager &pm = PeerManager::getInstance();
+    if (!pm.isLeader() || batch.empty())
+      continue;
+    json message;
+    message["command"] = COMMAND_REPLICA_CHANGES;
+    message["epoch"] = batchEpoch;
+    message["changes"] = std::move(batch);
+    pm.broadcastToWorkers(message);
+  }
+}
+
+// Worker replica
+std::mutex replicaMutex;
+bool replicaLoaded = false;
+uint64_t replicaEpoch = 0;
+uint64_t replicaSeq = 0;
+std::map<std::string, std::string> replicaSettings;
+std::map<std::string, PeerRecord> replicaPeers;
+Clock::time_point confirmedAt;
+std::atomic<long> syncs{0};
+std::atomic<long> snapshots{0};
+std::atomic<long> localReads{0};
+
+// Caller holds replicaMutex
+void applyChangeLocked(const json &change) {
+  std::string table = change.value("table", "");
+  std::string op = change.value("op", "");
+  std::string key = change.value("key", "");
+  if (table == "settings") {
+    if (op == "put")
+      replicaSettings[key] = change.value("value", "");
+    else
+      replicaSettings.erase(key);
+  } else if (table == "peers") {
+    if (op == "put")
+      replicaPeers[key] = peerFromJson(change["value"]);
+    else if (op == "clear")
+      replicaPeers.clear();
+    else
+      replicaPeers.erase(key);
+  }
+  replicaSeq = change.value("seq", replicaSeq);
+}
+
+} // namespace
+
+void ReplicationLog::start() {
+  if (pushRunning)
+    return;
+  {
+    std::lock_guard<std::mutex> lock(logMutex);
+    std::random_device random;
+    epoch = ((uint64_t)random() << 32 | random()) | 1; // Never 0
+  }
+  settingsSubscription = SettingsCache::subscribe(
+      SettingsCache::Table::Settings, "",
+      [](const std::string &key, const std::string &) { recordSetting(key); });
+  pushRunning = true;
+  pushThread = std::thread(pushLoop);
+}
+
+void ReplicationLog::stop() {
+  if (!pushRunning.exchange(false))
+    return;
+  SettingsCache::unsubscribe(settingsSubscription);
+  {
+    std::lock_guard<std::mutex> lock(logMutex);
+  }
+  pushWake.notify_all();
+  if (pushThread.joinable())
+    pushThread.join();
+}
+
+void ReplicationLog::recordPeer(const std::string &peer_id) {
+  if (!pushRunning)
+    return;
+  {
+    std::lock_guard<std::mutex> lock(logMutex);
+    PeerRecord peer = PeerTable::getPeer(peer_id);
+    if (peer.peer_id.empty())
+      appendLocked({{"table", "peers"}, {"op", "delete"}, {"key", peer_id}});
+    else
+      appendLocked({{"table", "peers"}, {"op", "put"}, {"key", peer_id},
+                    {"value", peerToJson(peer)}});
+  }
+  pushWake.notify_one();
+}
+
+void ReplicationLog::recordPeersCleared() {
+  if (!pushRunning)
+    return;
+  {
+    std::lock_guard<std::mutex> lock(logMutex);
+    appendLocked({{"table", "peers"}, {"op", "clear"}, {"key", ""}});
+  }
+  pushWake.notify_one();
+}
+
+json ReplicationLog::sync(uint64_t workerEpoch, uint64_t since) {
+  if (!pushRunning)
+    return nullptr;
+  std::lock_guard<std::mutex> lock(logMutex);
+  json reply;
+  reply["epoch"] = epoch;
+  reply["seq"] = lastSeq;
+  json after = workerEpoch == epoch ? changesAfterLocked(since) : json();
+  if (!after.is_null()) {
+    reply["changes"] = std::move(after);
+    return reply;
+  }
+  // A write between its table update and its record shows up in the
+  // snapshot and again as a change after lastSeq; replaying a put or a
+  // delete is harmless
+  json settings = json::object();
+  for (const auto &[key, value] :
+       SettingsCache::getAll(SettingsCache::Table::Settings)) {
+    if (!LOCAL_SETTINGS.count(key))
+      settings[key] = value;
+  }
+  json peers = json::array();
+  for (const PeerRecord &peer : PeerTable::getAllPeers())
+    peers.push_back(peerToJson(peer));
+  reply["snapshot"] = {{"settings", settings}, {"peers", peers}};
+  return reply;
+}
+
+bool LeaderReplica::sync() {
+  PeerManager &pm = PeerManager::getInstance();
+  if (pm.isLeader() || !pm.isConnectedToLeader())
+    return false;
+  json request;
+  request["command"] = COMMAND_REPLICA_SYNC;
+  {
+    std::lock_guard<std::mutex> lock(replicaMutex);
+    request["epoch"] = replicaEpoch;
+    request["since"] = replicaSeq;
+  }
+  std::string response = pm.forwardToLeader(request, SYNC_TIMEOUT_MS);
+  json reply = json::parse(response, nullptr, false);
+  if (!reply.is_object() || !reply.contains("epoch")) {
+    // Older leader or one without a settings cache: keep forwarding
+    if (!response.empty())
+      logToFile("LeaderReplica: leader can't replicate: " + response,
+                LOG_CORE);
+    return false;
+  }
+
+  std::lock_guard<std::mutex> lock(replicaMutex);
+  syncs++;
+  if (reply.contains("snapshot")) {
+    snapshots++;
+    replicaSettings.clear();
+    for (const auto &[key, value] : reply["snapshot"]["settings"].items())
+      replicaSettings[key] = value.get<std::string>();
+    replicaPeers.clear();
+    for (const json &peer : reply["snapshot"]["peers"])
+      replicaPeers[peer.value("peer_id", "")] = peerFromJson(peer);
+    logToFile("LeaderReplica: snapshot of " +
+                  std::to_string(replicaSettings.size()) + " settings, " +
+                  std::to_string(replicaPeers.size()) + " peers",
+              LOG_CORE);
+  } else {
+    for (const json &change : reply["changes"]) {
+      // A push may have applied some of them meanwhile
+      if (change.value("seq", uint64_t(0)) > replicaSeq)
+        applyChangeLocked(change);
+    }
+  }
+  replicaEpoch = reply["epoch"].get<uint64_t>();
+  replicaSeq = reply["seq"].get<uint64_t>();
+  replicaLoaded = true;
+  confirmedAt = Clock::now();
+  return true;
+}
+
+void LeaderReplica::applyPush(const json &message) {
+  bool gap = false;
+  {
+    std::lock_guard<std::mutex> lock(replicaMutex);
+    if (!replicaLoaded || message.value("epoch", uint64_t(0)) != replicaEpoch) {
+      gap = true;
+    } else if (message.contains("changes")) {
+      for (const json &change : message["changes"]) {
+        uint64_t seq = change.value("seq", uint64_t(0));
+        if (seq <= replicaSeq)
+          continue;
+        if (seq != replicaSeq + 1) {
+          gap = true;
+          break;
+        }
+        applyChangeLocked(change);
+      }
+      if (!gap)
+        confirmedAt = Clock::now();
+    }
+  }
+  if (gap)
+    PeerManager::getInstance().requestReplicaSync();
+}
+
+bool LeaderReplica::isFresh() {
+  std::lock_guard<std::mutex> lock(replicaMutex);
+  return replicaLoaded &&
+         Clock::now() - confirmedAt <=
+             std::chrono::seconds(REPLICA_MAX_STALENESS_SECS);
+}
+
+bool LeaderReplica::getSetting(const std::string &key, std::string &value) {
+  std::lock_guard<std::mutex> lock(replicaMutex);
+  localReads++;
+  auto it = replicaSettings.find(key);
+  if (it == replicaSettings.end())
+    return false;
+  value = it->second;
+  return true;
+}
+
+std::vector<std::pair<std::string, std::string>>
+LeaderReplica::getAllSettings() {
+  std::lock_guard<std::mutex> lock(replicaMutex);
+  localReads++;
+  return {replicaSettings.begin(), replicaSettings.end()};
+}
+
+bool LeaderReplica::getPeer(const std::string &peer_id, PeerRecord &peer) {
+  std::lock_guard<std::mutex> lock(replicaMutex);
+  localReads++;
+  auto it = replicaPeers.find(peer_id);
+  if (it == replicaPeers.end())
+    return false;
+  peer = it->second;
+  return true;
+}
+
+json LeaderReplica::getStatus() {
+  std::lock_guard<std::mutex> lock(replicaMutex);
+  json status;
+  status["loaded"] = replicaLoaded;
+  status["seq"] = replicaSeq;
+  status["settings"] = replicaSettings.size();
+  status["peers"] = replicaPeers.size();
+  if (replicaLoaded)
+    status["age_secs"] = std::chrono::duration_cast<std::chrono::seconds>(
+                             Clock::now() - confirmedAt)
+                             .count();
+  status["syncs"] = syncs.load();
+  status["snapshots"] = snapshots.load();
+  status["local_reads"] = localReads.load();
+  return status;
+}
@@ -0,0 +1,180 @@
+#include "ReplyStream.h"
+#include "Utils.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <nlohmann/json.hpp>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using json = nlohmann::json;
+
+namespace {
+
+const size_t READ_CHUNK = 16384;
+const size_t MAX_HEADER = 4096; // Longer first line: not a framed reply
+
+thread_local ReplyStream *currentStream = nullptr;
+
+} // namespace
+
+ReplyStream::ReplyStream(int fd) : m_fd(fd), m_previous(currentStream) {
+  currentStream = this;
+}
+
+ReplyStream::~ReplyStream() { currentStream = m_previous; }
+
+ReplyStream *ReplyStream::current() { return currentStream; }
+
+bool ReplyStream::write(const char *data, size_t length) {
+  size_t offset = 0;
+  while (m_open && offset < length) {
+    ssize_t sent = send(m_fd, data + offset, length - offset, MSG_NOSIGNAL);
+    if (sent < 0 && errno == EINTR)
+      continue;
+    if (sent <= 0) {
+      logToFile("ReplyStream: reader went away: " + std::string(strerror(errno)),
+                LOG_CORE);
+      m_open = false;
+      break;
+    }
+    offset += sent;
+  }
+  return m_open;
+}
+
+bool ReplyStream::write(const std::string &data) {
+  return write(data.data(), data.size());
+}
+
+bool ReplyStream::isOpen() const { return m_open; }
+
+std::string ReplyStream::outputFrame(const char *data, size_t length) {
+  json header;
+  header["stream"] = "output";
+  header["length"] = length;
+  return header.dump() + "\n" + std::string(data, length);
+}
+
+std::string ReplyStream::endFrame(int status) {
+  json header;
+  header["stream"] = "end";
+  header["status"] = status;
+  return header.dump() + "\n";
+}
+
+bool ReplyStream::Decoder::feed(const char *data, size_t length,
+                                const Sink &sink) {
+  if (m_done)
+    return true;
+  m_buffer.append(data, length);
+
+  while (!m_buffer.empty()) {
+    if (!m_framed || m_payloadLeft > 0) {
+      size_t n = m_framed ? std::min(m_payloadLeft, m_buffer.size())
+                          : m_buffer.size();
+      sink(m_buffer.data(), n);
+      m_buffer.erase(0, n);
+      if (m_framed)
+        m_payloadLeft -= n;
+      continue;
+    }
+
+    size_t pos = m_buffer.find('\n');
+    if (pos == std::string::npos) {
+      if (m_buffer.size() <= MAX_HEADER)
+        break;
+      m_framed = false;
+      continue;
+    }
+
+    json header = json::parse(m_buffer.substr(0, pos), nullptr, false);
+    if (header.is_object() && header.contains("stream")) {
+      m_buffer.erase(0, pos + 1);
+      m_sawFrame = true;
+      if (header["stream"] == "end") {
+        m_status = header.value("status", 1);
+        m_keepAlive = header.value("keep_alive", false);
+        m_done = true;
+        return true;
+      }
+      m_payloadLeft = header.value("length", (size_t)0);
+      continue;
+    }
+    if (header.is_object() && header.contains("output")) {
+      // Unframed manager reply: one JSON object with the whole output
+      std::string output = header["output"].get<std::string>();
+      sink(output.data(), output.size());
+      m_status = header.value("status", 1);
+      m_done = true;
+      return true;
+    }
+    m_framed = false; // Raw output from a peer that doesn't stream
+  }
+  return false;
+}
+
+bool ReplyStream::Decoder::finish(const Sink &sink) {
+  if (m_done)
+    return true;
+  if (m_sawFrame)
+    return false;
+  // A raw reply ends at EOF
+  sink(m_buffer.data(), m_buffer.size());
+  m_buffer.clear();
+  m_status = 0;
+  m_done = true;
+  return true;
+}
+
+bool ReplyStream::relay(int fd, ReplyStream &out, int idleTimeoutSec,
+                        int &status, std::string &error) {
+  Decoder decoder;
+  Decoder::Sink forward = [&out](const char *data, size_t length) {
+    out.write(data, length);
+  };
+  char chunk[READ_CHUNK];
+
+  while (true) {
+    struct pollfd pfd;
+    pfd.fd = fd;
+    pfd.events = POLLIN;
+    int ready = poll(&pfd, 1, idleTimeoutSec * 1000);
+    if (ready < 0 && errno == EINTR)
+      continue;
+    if (ready == 0) {
+      error = "no output for " + std::to_string(idleTimeoutSec) + "s";
+      return false;
+    }
+    if (ready < 0) {
+      error = strerror(errno);
+      return false;
+    }
+
+    ssize_t n = read(fd, chunk, sizeof(chunk));
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n < 0) {
+      error = strerror(errno);
+      return false;
+    }
+    if (n == 0) {
+      if (!decoder.finish(forward)) {
+        error = "connection closed before the final status";
+        return false;
+      }
+      status = decoder.status();
+      return true;
+    }
+    if (decoder.feed(chunk, n, forward)) {
+      status = decoder.status();
+      return true;
+    }
+    if (!out.isOpen()) {
+      // Closing fd on return makes the producer stop
+      error = "client disconnected";
+      return false;
+    }
+  }
+}
@@ -0,0 +1,269 @@
+#include "SQLiteBackend.h"
+#include "Utils.h"
+#include <chrono>
+#include <filesystem>
+#include <regex>
+#include <sstream>
+
+namespace {
+
+void replaceAll(std::string &s, const std::string &from,
+                const std::string &to) {
+  for (size_t pos = s.find(from); pos != std::string::npos;
+       pos = s.find(from, pos + to.size()))
+    s.replace(pos, from.size(), to);
+}
+
+// Rewrites the MySQL-only constructs used by the table managers
+std::string toSQLiteDialect(std::string query) {
+  static const std::regex interval(R"(NOW\(\) - INTERVAL (\d+) SECOND)");
+  static const std::regex ifCall(R"(\bIF\()");
+  query = std::regex_replace(query, interval,
+                             "datetime('now', 'localtime', '-$1 seconds')");
+  replaceAll(query, "NOW()", "datetime('now', 'localtime')");
+  replaceAll(query, "ON DUPLICATE KEY UPDATE", "ON CONFLICT DO UPDATE SET");
+  replaceAll(query, "GREATEST(", "MAX(");
+  return std::regex_replace(query, ifCall, "IIF(");
+}
+
+void check(sqlite3 *db, int rc) {
+  if (rc != SQLITE_OK)
+    throw StorageError(sqlite3_errmsg(db));
+}
+
+class SQLiteResult : public StorageResult {
+public:
+  SQLiteResult(sqlite3 *db, sqlite3_stmt *stmt, bool owned)
+      : db(db), stmt(stmt), owned(owned) {
+    int count = sqlite3_column_count(stmt);
+    for (int i = 0; i < count; i++)
+      columns[sqlite3_column_name(stmt, i)] = i;
+  }
+  ~SQLiteResult() override {
+    if (owned)
+      sqlite3_finalize(stmt);
+    else
+      sqlite3_reset(stmt);
+  }
+  bool next() override {
+    int rc = sqlite3_step(stmt);
+    if (rc == SQLITE_ROW)
+      return true;
+    if (rc == SQLITE_DONE)
+      return false;
+    throw StorageError(sqlite3_errmsg(db));
+  }
+  int getInt(const std::string &column) override {
+    return sqlite3_column_int(stmt, index(column));
+  }
+  std::string getString(const std::string &column) override {
+    const unsigned char *text = sqlite3_column_text(stmt, index(column));
+    return text ? reinterpret_cast<const char *>(text) : "";
+  }
+  bool getBoolean(const std::string &column) override {
+    return sqlite3_column_int(stmt, index(column)) != 0;
+  }
+  bool isNull(const std::string &column) override {
+    return sqlite3_column_type(stmt, index(column)) == SQLITE_NULL;
+  }
+
+private:
+  int index(const std::string &column) {
+    auto it = columns.find(column);
+    if (it == columns.end())
+      throw StorageError("Unknown column " + column);
+    return it->second;
+  }
+
+  sqlite3 *db;
+  sqlite3_stmt *stmt;
+  bool owned;
+  std::map<std::string, int> columns;
+};
+
+class SQLiteStatement : public StorageStatement {
+public:
+  SQLiteStatement(sqlite3 *db, sqlite3_stmt *stmt) : db(db), stmt(stmt) {}
+  ~SQLiteStatement() override { sqlite3_finalize(stmt); }
+
+  void reset() {
+    sqlite3_reset(stmt);
+    sqlite3_clear_bindings(stmt);
+  }
+  void setInt(int index, int value) override {
+    check(db, sqlite3_bind_int(stmt, index, value));
+  }
+  void setString(int index, const std::string &value) override {
+    check(db, sqlite3_bind_text(stmt, index, value.c_str(), (int)value.size(),
+                                SQLITE_TRANSIENT));
+  }
+  void setBoolean(int index, bool value) override {
+    check(db, sqlite3_bind_int(stmt, index, value ? 1 : 0));
+  }
+  int executeUpdate() override {
+    int rc = sqlite3_step(stmt);
+    sqlite3_reset(stmt);
+    if (rc != SQLITE_DONE && rc != SQLITE_ROW)
+      throw StorageError(sqlite3_errmsg(db));
+    return sqlite3_changes(db);
+  }
+  std::unique_ptr<StorageResult> executeQuery() override {
+    sqlite3_reset(stmt);
+    return std::make_unique<SQLiteResult>(db, stmt, false);
+  }
+
+private:
+  sqlite3 *db;
+  sqlite3_stmt *stmt;
+};
+
+sqlite3_stmt *compile(sqlite3 *db, const std::string &query) {
+  sqlite3_stmt *stmt = nullptr;
+  check(db, sqlite3_prepare_v2(db, toSQLiteDialect(query).c_str(), -1, &stmt,
+                               nullptr));
+  return stmt;
+}
+
+} // namespace
+
+class SQLiteConnection : public StorageConnection {
+public:
+  SQLiteConnection(SQLiteBackend &backend,
+                   std::unique_lock<std::recursive_timed_mutex> lock)
+      : backend(backend), lock(std::move(lock)) {}
+
+  StorageStatement *prepare(const std::string &query) override {
+    auto &cached = backend.statements[query];
+    if (!cached) {
+      cached = std::make_unique<SQLiteStatement>(backend.db,
+                                                 compile(backend.db, query));
+    } else {
+      static_cast<SQLiteStatement *>(cached.get())->reset();
+    }
+    return cached.get();
+  }
+  std::unique_ptr<StorageResult> query(const std::string &query) override {
+    return std::make_unique<SQLiteResult>(backend.db,
+                                          compile(backend.db, query), true);
+  }
+  int execute(const std::string &query) override {
+    char *err = nullptr;
+    if (sqlite3_exec(backend.db, toSQLiteDialect(query).c_str(), nullptr,
+                     nullptr, &err) != SQLITE_OK) {
+      std::string msg = err ? err : "unknown error";
+      sqlite3_free(err);
+      throw StorageError(msg);
+    }
+    return sqlite3_changes(backend.db);
+  }
+  void begin() override { execute("BEGIN IMMEDIATE"); }
+  void commit() override { execute("COMMIT"); }
+  void rollback() override { execute("ROLLBACK"); }
+
+private:
+  SQLiteBackend &backend;
+  std::unique_lock<std::recursive_timed_mutex> lock;
+};
+
+SQLiteBackend::SQLiteBackend(const std::string &path) : path(path) {}
+
+SQLiteBackend::~SQLiteBackend() { stop(); }
+
+bool SQLiteBackend::start() {
+  createdFresh = !std::filesystem::exists(path);
+  if (sqlite3_open_v2(path.c_str(), &db,
+                      SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE |
+                          SQLITE_OPEN_FULLMUTEX,
+                      nullptr) != SQLITE_OK) {
+    logToFile("SQLiteBackend: Failed to open " + path + ": " +
+                  sqlite3_errmsg(db),
+              0xFFFFFFFF);
+    sqlite3_close(db);
+    db = nullptr;
+    return false;
+  }
+  sqlite3_busy_timeout(db, 2000);
+  sqlite3_exec(db, "PRAGMA journal_mode=WAL", nullptr, nullptr, nullptr);
+  sqlite3_exec(db, "PRAGMA synchronous=NORMAL", nullptr, nullptr, nullptr);
+  if (!createTables())
+    return false;
+  logToFile("SQLiteBackend: Opened " + path + " (WAL)");
+  return true;
+}
+
+bool SQLiteBackend::createTables() {
+  // Mirrors MySQLManager::createDatabaseAndUser
+  static const char *schema =
+      "CREATE TABLE IF NOT EXISTS terminal_history ("
+      "entry_index INTEGER PRIMARY KEY, path TEXT NOT NULL);"
+      "CREATE TABLE IF NOT EXISTS terminal_sessions ("
+      "tty INTEGER PRIMARY KEY, history_index INTEGER NOT NULL);"
+      "CREATE TABLE IF NOT EXISTS automation_configs ("
+      "config_key TEXT PRIMARY KEY, config_value TEXT NOT NULL);"
+      "CREATE TABLE IF NOT EXISTS device_registry ("
+      "device_type TEXT PRIMARY KEY, path TEXT NOT NULL);"
+      "CREATE TABLE IF NOT EXISTS system_settings ("
+      "setting_key TEXT PRIMARY KEY, setting_value TEXT NOT NULL);"
+      "CREATE TABLE IF NOT EXISTS peer_registry ("
+      "peer_id TEXT PRIMARY KEY, ip_address TEXT NOT NULL, "
+      "mac_address TEXT, hostname TEXT, "
+      "last_seen TIMESTAMP DEFAULT (datetime('now', 'localtime')), "
+      "is_online INTEGER DEFAULT 0, daemon_version INTEGER DEFAULT 0);"
+      "CREATE TABLE IF NOT EXISTS app_assignments ("
+      "app_name TEXT PRIMARY KEY, assigned_peer TEXT, "
+      "assigned_at TIMESTAMP DEFAULT (datetime('now', 'localtime')), "
+      "last_activity TIMESTAMP DEFAULT (datetime('now', 'localtime')));"
+      "CREATE TABLE IF NOT EXISTS extra_apps ("
+      "app_id TEXT PRIMARY KEY, display_name TEXT NOT NULL, "
+      "repo_url TEXT NOT NULL, has_server_component INTEGER DEFAULT 0, "
+      "server_service_template TEXT, client_service_template TEXT, "
+      "port_key_client TEXT, port_key_server TEXT, "
+      "dev_path TEXT NOT NULL, prod_path TEXT NOT NULL, "
+      "server_build_subdir TEXT, client_subdir TEXT, "
+      "installed_at TIMESTAMP DEFAULT (datetime('now', 'localtime')));"
+      "CREATE TABLE IF NOT EXISTS port_leases ("
+      "port_key TEXT PRIMARY KEY, app_id TEXT, peer_id TEXT, "
+      "leased_at TIMESTAMP DEFAULT (datetime('now', 'localtime')));";
+  char *err = nullptr;
+  if (sqlite3_exec(db, schema, nullptr, nullptr, &err) != SQLITE_OK) {
+    logToFile("SQLiteBackend: Error creating tables: " +
+                  std::string(err ? err : "unknown error"),
+              0xFFFFFFFF);
+    sqlite3_free(err);
+    return false;
+  }
+  return true;
+}
+
+void SQLiteBackend::stop() {
+  std::lock_guard<std::recursive_timed_mutex> lock(dbMutex);
+  statements.clear(); // Finalize before closing
+  if (db) {
+    sqlite3_close(db);
+    db = nullptr;
+  }
+}
+
+std::unique_ptr<StorageConnection> SQLiteBackend::connect() {
+  std::unique_lock<std::recursive_timed_mutex> lock(
+      dbMutex, std::chrono::milliseconds(2000));
+  if (!lock.owns_lock()) {
+    logToFile("SQLiteBackend: Timed out waiting for the database", 0xFFFFFFFF);
+    return nullptr;
+  }
+  if (!db)
+    return nullptr;
+  return std::make_unique<SQLiteConnection>(*this, std::move(lock));
+}
+
+std::string SQLiteBackend::getStats() {
+  std::lock_guard<std::recursive_timed_mutex> lock(dbMutex);
+  std::stringstream ss;
+  ss << "SQLite " << sqlite3_libversion() << " (WAL), " << path << "\n";
+  std::error_code ec;
+  auto size = std::filesystem::file_size(path, ec);
+  if (!ec)
+    ss << "Database size: " << size / 1024 << " KB\n";
+  ss << "Cached statements: " << statements.size() << "\n";
+  return ss.str();
+}
@@ -0,0 +1,191 @@
+#include "ServiceWatcher.h"
+#include "Utils.h"
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <thread>
+
+namespace {
+
+std::unique_ptr<UnitBus> unitBus;
+std::thread dispatchThread;
+std::atomic<bool> running{false};
+
+std::mutex tableMutex;
+std::map<std::string, UnitState> units;
+
+std::mutex listenerMutex;
+ServiceWatcher::ChangeListener changeListener;
+
+std::atomic<long> memoryReads{0};
+std::atomic<long> busLoads{0};
+std::atomic<long> busActions{0};
+
+// systemctl accepts "cad-dev"; the bus wants "cad-dev.service"
+std::string unitName(const std::string &name) {
+  if (name.find('.') == std::string::npos)
+    return name + ".service";
+  return name;
+}
+
+void dispatchLoop() {
+  while (running)
+    unitBus->dispatch(500);
+}
+
+// Looks unit up, watching it on first use
+bool lookup(const std::string &name, UnitState &state) {
+  if (!running)
+    return false;
+  std::string unit = unitName(name);
+  {
+    std::lock_guard<std::mutex> lock(tableMutex);
+    auto it = units.find(unit);
+    if (it != units.end()) {
+      state = it->second;
+      memoryReads++;
+      return true;
+    }
+  }
+  busLoads++;
+  if (!unitBus->watchUnit(unit))
+    return false;
+  std::lock_guard<std::mutex> lock(tableMutex);
+  auto it = units.find(unit);
+  if (it == units.end())
+    return false;
+  state = it->second;
+  return true;
+}
+
+} // namespace
+
+void UnitJobs::finished(const std::string &job, const std::string &result) {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    results[job] = result;
+    order.push_back(job);
+    while (order.size() > MAX_RESULTS) {
+      results.erase(order.front());
+      order.pop_front();
+    }
+  }
+  done.notify_all();
+}
+
+std::string UnitJobs::wait(const std::string &job,
+                           std::chrono::milliseconds timeout) {
+  std::unique_lock<std::mutex> lock(mutex);
+  if (!done.wait_for(lock, timeout, [&] { return results.count(job) > 0; }))
+    return "";
+  return results[job];
+}
+
+bool UnitState::isActive() const {
+  return activeState == "active" || activeState == "reloading";
+}
+
+bool UnitState::isEnabled() const {
+  return unitFileState == "enabled" || unitFileState == "enabled-runtime" ||
+         unitFileState == "static" || unitFileState == "alias" ||
+         unitFileState == "indirect" || unitFileState == "generated" ||
+         unitFileState == "transient";
+}
+
+bool ServiceWatcher::start(std::unique_ptr<UnitBus> bus) {
+  if (running)
+    return true;
+  bool opened = bus->open([](const std::string &unit, const UnitState &state) {
+    {
+      std::lock_guard<std::mutex> lock(tableMutex);
+      UnitState &entry = units[unit];
+      bool changed = entry.found != state.found ||
+                     entry.activeState != state.activeState ||
+                     entry.unitFileState != state.unitFileState;
+      entry = state;
+      if (!changed)
+        return;
+    }
+    ServiceWatcher::ChangeListener listener;
+    {
+      std::lock_guard<std::mutex> lock(listenerMutex);
+      listener = changeListener;
+    }
+    if (listener)
+      listener(unit);
+  });
+  if (!opened) {
+    logToFile("ServiceWatcher: bus unavailable, using systemctl", LOG_CORE);
+    return false;
+  }
+  unitBus = std::move(bus);
+  running = true;
+  dispatchThread = std::thread(dispatchLoop);
+  logToFile("ServiceWatcher: watching units over D-Bus", LOG_CORE);
+  return true;
+}
+
+void ServiceWatcher::stop() {
+  if (!running.exchange(false))
+    return;
+  if (dispatchThread.joinable())
+    dispatchThread.join();
+  unitBus->close();
+  unitBus.reset();
+  std::lock_guard<std::mutex> lock(tableMutex);
+  units.clear();
+}
+
+bool ServiceWatcher::isRunning() { return running; }
+
+void ServiceWatcher::setChangeListener(ChangeListener listener) {
+  std::lock_guard<std::mutex> lock(listenerMutex);
+  changeListener = std::move(listener);
+}
+
+bool ServiceWatcher::isActive(const std::string &unit, bool &active) {
+  UnitState state;
+  if (!lookup(unit, state))
+    return false;
+  active = state.isActive();
+  return true;
+}
+
+bool ServiceWatcher::isEnabled(const std::string &unit, bool &enabled) {
+  UnitState state;
+  if (!lookup(unit, state))
+    return false;
+  enabled = state.isEnabled();
+  return true;
+}
+
+bool ServiceWatcher::control(UnitAction action, const std::string &unit,
+                             bool &ok) {
+  if (!running)
+    return false;
+  std::string name = unitName(unit);
+  UnitState state;
+  lookup(name, state); // Watch it so the result lands in the table
+  busActions++;
+  std::string error;
+  ok = unitBus->runAction(action, name, error);
+  if (!ok)
+    logToFile("ServiceWatcher: " + name + ": " + error, LOG_CORE);
+  return true;
+}
+
+std::string ServiceWatcher::getStats() {
+  std::ostringstream ss;
+  ss << "Service watcher: " << (running ? "D-Bus" : "off (systemctl)") << "\n"
+     << "Memory reads: " << memoryReads << "\n"
+     << "Units loaded over bus: " << busLoads << "\n"
+     << "Bus actions: " << busActions << "\n";
+  std::lock_guard<std::mutex> lock(tableMutex);
+  for (const auto &[unit, state] : units) {
+    ss << "  " << unit << ": "
+       << (state.found ? state.activeState : "not-found") << ", "
+       << (state.unitFileState.empty() ? "-" : state.unitFileState) << "\n";
+  }
+  return ss.str();
+}
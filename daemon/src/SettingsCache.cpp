@@ -0,0 +1,147 @@
+#include "SettingsCache.h"
+#include "StorageBackend.h"
+#include "Utils.h"
+#include <map>
+#include <mutex>
+
+namespace {
+
+struct Subscription {
+  int id;
+  SettingsCache::Table table;
+  std::string keyPrefix;
+  SettingsCache::Listener listener;
+};
+
+std::mutex cacheMutex;
+bool cacheLoaded = false;
+std::map<std::string, std::string> tables[3];
+std::vector<Subscription> subscriptions;
+int nextSubscriptionId = 1;
+
+std::map<std::string, std::string> &tableFor(SettingsCache::Table table) {
+  return tables[static_cast<int>(table)];
+}
+
+void notify(SettingsCache::Table table, const std::string &key,
+            const std::string &value) {
+  std::vector<SettingsCache::Listener> listeners;
+  {
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    for (const auto &sub : subscriptions) {
+      if (sub.table == table && key.compare(0, sub.keyPrefix.size(),
+                                            sub.keyPrefix) == 0)
+        listeners.push_back(sub.listener);
+    }
+  }
+  for (const auto &listener : listeners)
+    listener(key, value);
+}
+
+void loadTable(StorageConnection &con, const std::string &query,
+               const std::string &keyCol, const std::string &valueCol,
+               std::map<std::string, std::string> &out) {
+  std::unique_ptr<StorageResult> res = con.query(query);
+  while (res->next())
+    out[res->getString(keyCol)] = res->getString(valueCol);
+}
+
+} // namespace
+
+bool SettingsCache::load() {
+  std::unique_ptr<StorageConnection> con = Storage::connect();
+  if (!con) {
+    logToFile("SettingsCache: Failed to get connection, reads go to storage",
+              0xFFFFFFFF);
+    return false;
+  }
+  std::map<std::string, std::string> settings, configs, devices;
+  try {
+    loadTable(*con, "SELECT setting_key, setting_value FROM system_settings",
+              "setting_key", "setting_value", settings);
+    loadTable(*con, "SELECT config_key, config_value FROM automation_configs",
+              "config_key", "config_value", configs);
+    loadTable(*con, "SELECT device_type, path FROM device_registry",
+              "device_type", "path", devices);
+  } catch (StorageError &e) {
+    logToFile("SettingsCache: load error: " + std::string(e.what()),
+              0xFFFFFFFF);
+    return false;
+  }
+  std::lock_guard<std::mutex> lock(cacheMutex);
+  tableFor(Table::Settings) = std::move(settings);
+  tableFor(Table::Config) = std::move(configs);
+  tableFor(Table::Device) = std::move(devices);
+  cacheLoaded = true;
+  logToFile("SettingsCache: Loaded " +
+            std::to_string(tableFor(Table::Settings).size()) + " settings, " +
+            std::to_string(tableFor(Table::Config).size()) + " configs, " +
+            std::to_string(tableFor(Table::Device).size()) + " devices");
+  return true;
+}
+
+bool SettingsCache::isLoaded() {
+  std::lock_guard<std::mutex> lock(cacheMutex);
+  return cacheLoaded;
+}
+
+bool SettingsCache::get(Table table, const std::string &key,
+                        std::string &value) {
+  std::lock_guard<std::mutex> lock(cacheMutex);
+  const auto &entries = tableFor(table);
+  auto it = entries.find(key);
+  if (it == entries.end())
+    return false;
+  value = it->second;
+  return true;
+}
+
+std::vector<std::pair<std::string, std::string>>
+SettingsCache::getAll(Table table) {
+  std::lock_guard<std::mutex> lock(cacheMutex);
+  const auto &entries = tableFor(table);
+  return std::vector<std::pair<std::string, std::string>>(entries.begin(),
+                                                          entries.end());
+}
+
+void SettingsCache::set(Table table, const std::string &key,
+                        const std::string &value) {
+  {
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    if (!cacheLoaded)
+      return;
+    auto &entries = tableFor(table);
+    auto it = entries.find(key);
+    if (it != entries.end() && it->second == value)
+      return;
+    entries[key] = value;
+  }
+  notify(table, key, value);
+}
+
+void SettingsCache::erase(Table table, const std::string &key) {
+  {
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    if (!cacheLoaded || tableFor(table).erase(key) == 0)
+      return;
+  }
+  notify(table, key, "");
+}
+
+int SettingsCache::subscribe(Table table, const std::string &keyPrefix,
+                             Listener listener) {
+  std::lock_guard<std::mutex> lock(cacheMutex);
+  int id = nextSubscriptionId++;
+  subscriptions.push_back({id, table, keyPrefix, std::move(listener)});
+  return id;
+}
+
+void SettingsCache::unsubscribe(int id) {
+  std::lock_guard<std::mutex> lock(cacheMutex);
+  for (auto it = subscriptions.begin(); it != subscriptions.end(); ++it) {
+    if (it->id == id) {
+      subscriptions.erase(it);
+      return;
+    }
+  }
+}
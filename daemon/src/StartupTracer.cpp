@@ -0,0 +1,102 @@
+#include "StartupTracer.h"
+#include "Constants.h"
+#include "Utils.h"
+#include <cstdio>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+namespace {
+
+struct PhaseRecord {
+  std::string name;
+  StartupTracer::Clock::time_point start;
+  StartupTracer::Clock::time_point end;
+  bool done;
+  bool mainThread;
+};
+
+std::mutex tracerMutex;
+StartupTracer::Clock::time_point startupBegin = StartupTracer::Clock::now();
+StartupTracer::Clock::time_point startupReady;
+bool ready = false;
+std::thread::id mainThreadId = std::this_thread::get_id();
+std::vector<PhaseRecord> phases;
+
+long msSinceBegin(StartupTracer::Clock::time_point t) {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(t -
+                                                               startupBegin)
+      .count();
+}
+
+} // namespace
+
+StartupTracer::Phase::Phase(const std::string &name) {
+  std::lock_guard<std::mutex> lock(tracerMutex);
+  index = static_cast<int>(phases.size());
+  phases.push_back({name, Clock::now(), Clock::time_point(), false,
+                    std::this_thread::get_id() == mainThreadId});
+}
+
+StartupTracer::Phase::~Phase() {
+  PhaseRecord record;
+  bool logNow;
+  {
+    std::lock_guard<std::mutex> lock(tracerMutex);
+    PhaseRecord &entry = phases[index];
+    entry.end = Clock::now();
+    entry.done = true;
+    record = entry;
+    logNow = ready;
+  }
+  if (logNow) {
+    logToFile("Startup phase " + record.name + " finished after ready: " +
+                  std::to_string(msSinceBegin(record.end) -
+                                 msSinceBegin(record.start)) +
+                  " ms",
+              LOG_CORE);
+  }
+}
+
+void StartupTracer::begin() {
+  std::lock_guard<std::mutex> lock(tracerMutex);
+  startupBegin = Clock::now();
+  mainThreadId = std::this_thread::get_id();
+  phases.clear();
+  ready = false;
+}
+
+void StartupTracer::markReady() {
+  {
+    std::lock_guard<std::mutex> lock(tracerMutex);
+    startupReady = Clock::now();
+    ready = true;
+  }
+  logToFile(report(), LOG_CORE);
+}
+
+std::string StartupTracer::report() {
+  std::lock_guard<std::mutex> lock(tracerMutex);
+  std::ostringstream ss;
+  if (ready)
+    ss << "Startup: ready after " << msSinceBegin(startupReady) << " ms\n";
+  else
+    ss << "Startup: not ready yet\n";
+  for (const auto &phase : phases) {
+    char line[128];
+    long startMs = msSinceBegin(phase.start);
+    if (phase.done) {
+      snprintf(line, sizeof(line), "  %-18s +%6ld ms %6ld ms%s\n",
+               phase.name.c_str(), startMs,
+               msSinceBegin(phase.end) - startMs,
+               phase.mainThread ? "" : "  (background)");
+    } else {
+      snprintf(line, sizeof(line), "  %-18s +%6ld ms  running%s\n",
+               phase.name.c_str(), startMs,
+               phase.mainThread ? "" : "  (background)");
+    }
+    ss << line;
+  }
+  return ss.str();
+}
@@ -0,0 +1,223 @@
+#include "StorageBackend.h"
+#include "Globals.h"
+#include "MySQLBackend.h"
+#include "SQLiteBackend.h"
+#include "Utils.h"
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <vector>
+
+namespace {
+
+std::unique_ptr<StorageBackend> activeBackend;
+long startupMs = 0;
+long startupRssKb = 0;
+
+long selfRssKb() {
+  std::ifstream status("/proc/self/status");
+  std::string line;
+  while (std::getline(status, line)) {
+    if (line.compare(0, 6, "VmRSS:") == 0)
+      return std::atol(line.c_str() + 6);
+  }
+  return 0;
+}
+
+std::string startupReportPath() {
+  return directories.data + "storage_startup.json";
+}
+
+// Keeps the latest startup measurement per backend so both can be compared
+void recordStartup(const std::string &backend, long ms, long daemonRssKb,
+                   long engineRssKb) {
+  json report = json::object();
+  std::ifstream in(startupReportPath());
+  if (in)
+    report = json::parse(in, nullptr, false);
+  if (!report.is_object())
+    report = json::object();
+  report[backend] = {{"startupMs", ms},
+                     {"daemonRssKb", daemonRssKb},
+                     {"engineRssKb", engineRssKb}};
+  std::ofstream out(startupReportPath());
+  out << report.dump(2) << std::endl;
+}
+
+struct TableColumns {
+  const char *table;
+  std::vector<std::string> columns;
+};
+
+const std::vector<TableColumns> MIGRATED_TABLES = {
+    {"terminal_history", {"entry_index", "path"}},
+    {"terminal_sessions", {"tty", "history_index"}},
+    {"automation_configs", {"config_key", "config_value"}},
+    {"device_registry", {"device_type", "path"}},
+    {"system_settings", {"setting_key", "setting_value"}},
+    {"peer_registry",
+     {"peer_id", "ip_address", "mac_address", "hostname", "last_seen",
+      "is_online", "daemon_version"}},
+    {"app_assignments",
+     {"app_name", "assigned_peer", "assigned_at", "last_activity"}},
+    {"extra_apps",
+     {"app_id", "display_name", "repo_url", "has_server_component",
+      "server_service_template", "client_service_template", "port_key_client",
+      "port_key_server", "dev_path", "prod_path", "server_build_subdir",
+      "client_subdir", "installed_at"}},
+    {"port_leases", {"port_key", "app_id", "peer_id", "leased_at"}},
+};
+
+} // namespace
+
+bool Storage::start() {
+  auto start = std::chrono::steady_clock::now();
+  long rssBefore = selfRssKb();
+  const char *env = getenv("AUTOMATE_LINUX_STORAGE_BACKEND");
+  std::string choice = env ? env : "mysql";
+
+  bool ok;
+  if (choice == "sqlite") {
+    std::string dbPath = directories.data + "daemon.db";
+    auto sqlite = std::make_unique<SQLiteBackend>(dbPath);
+    ok = sqlite->start();
+    if (ok && sqlite->isNewDatabase() &&
+        std::filesystem::exists(directories.base + "data/mysql/data/mysql")) {
+      if (!migrateFromMySQL(*sqlite)) {
+        // Leave no half-migrated file behind so the next start retries; the
+        // WAL and shared-memory files go too or the next open replays them
+        sqlite->stop();
+        for (const char *suffix : {"", "-wal", "-shm"})
+          std::filesystem::remove(dbPath + suffix);
+        ok = sqlite->start();
+      }
+    }
+    activeBackend = std::move(sqlite);
+  } else {
+    if (choice != "mysql")
+      logToFile("Storage: Unknown backend '" + choice + "', using mysql",
+                0xFFFFFFFF);
+    activeBackend = std::make_unique<MySQLBackend>();
+    ok = activeBackend->start();
+  }
+
+  startupMs = std::chrono::duration_cast<std::chrono::milliseconds>(
+                  std::chrono::steady_clock::now() - start)
+                  .count();
+  startupRssKb = selfRssKb() - rssBefore;
+  long engineKb = activeBackend->engineRssKb();
+  logToFile("Storage: " + activeBackend->name() + " ready in " +
+            std::to_string(startupMs) + " ms, daemon RSS +" +
+            std::to_string(startupRssKb) + " KB, engine RSS " +
+            std::to_string(engineKb) + " KB");
+  if (ok)
+    recordStartup(activeBackend->name(), startupMs, startupRssKb, engineKb);
+  return ok;
+}
+
+void Storage::stop() {
+  if (activeBackend)
+    activeBackend->stop();
+}
+
+std::unique_ptr<StorageConnection> Storage::connect() {
+  if (!activeBackend)
+    return nullptr;
+  return activeBackend->connect();
+}
+
+std::string Storage::backendName() {
+  return activeBackend ? activeBackend->name() : "none";
+}
+
+std::string Storage::getStats() {
+  if (!activeBackend)
+    return "Storage not started\n";
+  std::stringstream ss;
+  ss << "Backend: " << activeBackend->name() << "\n";
+  ss << "Startup: " << startupMs << " ms, daemon RSS +" << startupRssKb
+     << " KB, engine RSS " << activeBackend->engineRssKb() << " KB\n";
+  std::ifstream in(startupReportPath());
+  json report = in ? json::parse(in, nullptr, false) : json();
+  if (report.is_object()) {
+    for (auto &[name, m] : report.items()) {
+      ss << "  last " << name << " start: " << m.value("startupMs", 0L)
+         << " ms, daemon +" << m.value("daemonRssKb", 0L) << " KB, engine "
+         << m.value("engineRssKb", 0L) << " KB\n";
+    }
+  }
+  ss << activeBackend->getStats();
+  return ss.str();
+}
+
+void Storage::emptyTable(const std::string &tableName) {
+  std::unique_ptr<StorageConnection> con = connect();
+  if (!con) {
+    logToFile("Storage: Failed to get connection to empty table " + tableName,
+              0xFFFFFFFF);
+    return;
+  }
+  try {
+    con->execute("DELETE FROM " + tableName);
+    logToFile("Storage: Emptied table " + tableName);
+  } catch (StorageError &e) {
+    logToFile("Storage: Error emptying table " + tableName + ": " +
+                  std::string(e.what()),
+              0xFFFFFFFF);
+  }
+}
+
+bool Storage::migrateFromMySQL(StorageBackend &target) {
+  logToFile("Storage: Migrating existing MySQL tables into " + target.name());
+  MySQLBackend source;
+  if (!source.start()) {
+    source.stop();
+    return false;
+  }
+  bool ok = true;
+  {
+    std::unique_ptr<StorageConnection> from = source.connect();
+    std::unique_ptr<StorageConnection> to = target.connect();
+    if (!from || !to) {
+      ok = false;
+    } else {
+      try {
+        to->begin();
+        for (const auto &t : MIGRATED_TABLES) {
+          std::string cols, marks;
+          for (size_t i = 0; i < t.columns.size(); i++) {
+            cols += (i ? ", " : "") + t.columns[i];
+            marks += i ? ", ?" : "?";
+          }
+          StorageStatement *insert =
+              to->prepare(std::string("INSERT INTO ") + t.table + " (" +
+                          cols + ") VALUES (" + marks + ")");
+          std::unique_ptr<StorageResult> rows =
+              from->query("SELECT " + cols + " FROM " + t.table);
+          int count = 0;
+          while (rows->next()) {
+            for (size_t i = 0; i < t.columns.size(); i++)
+              insert->setString(i + 1, rows->getString(t.columns[i]));
+            insert->executeUpdate();
+            count++;
+          }
+          logToFile("Storage: Migrated " + std::to_string(count) +
+                    " rows from " + t.table);
+        }
+        to->commit();
+      } catch (StorageError &e) {
+        logToFile("Storage: Migration failed: " + std::string(e.what()),
+                  0xFFFFFFFF);
+        try {
+          to->rollback();
+        } catch (StorageError &) {
+        }
+        ok = false;
+      }
+    }
+  }
+  source.stop();
+  return ok;
+}
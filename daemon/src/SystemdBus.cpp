@@ -0,0 +1,329 @@
+#include "SystemdBus.h"
+#include "Utils.h"
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <poll.h>
+
+namespace {
+
+const char *SYSTEMD = "org.freedesktop.systemd1";
+const char *MANAGER_PATH = "/org/freedesktop/systemd1";
+const char *MANAGER_IFACE = "org.freedesktop.systemd1.Manager";
+const char *UNIT_IFACE = "org.freedesktop.systemd1.Unit";
+const int JOB_TIMEOUT_SECS = 120;
+
+std::string busError(const sd_bus_error &error, int rc) {
+  if (error.message)
+    return error.message;
+  return strerror(-rc);
+}
+
+// Read one string property, empty on failure
+std::string getProperty(sd_bus *bus, const std::string &path,
+                        const char *name) {
+  sd_bus_error error = SD_BUS_ERROR_NULL;
+  char *value = nullptr;
+  int rc = sd_bus_get_property_string(bus, SYSTEMD, path.c_str(), UNIT_IFACE,
+                                      name, &error, &value);
+  sd_bus_error_free(&error);
+  if (rc < 0 || !value)
+    return "";
+  std::string result = value;
+  free(value);
+  return result;
+}
+
+} // namespace
+
+SystemdBus::~SystemdBus() { close(); }
+
+bool SystemdBus::open(ChangeHandler handler) {
+  std::lock_guard<std::mutex> lock(busMutex);
+  onChange = std::move(handler);
+  int rc = sd_bus_open_system(&bus);
+  if (rc < 0) {
+    logToFile("SystemdBus: cannot open system bus: " +
+                  std::string(strerror(-rc)),
+              0xFFFFFFFF);
+    bus = nullptr;
+    return false;
+  }
+
+  rc = sd_bus_add_match(bus, nullptr,
+                        "type='signal',sender='org.freedesktop.systemd1',"
+                        "interface='org.freedesktop.DBus.Properties',"
+                        "member='PropertiesChanged',"
+                        "arg0='org.freedesktop.systemd1.Unit'",
+                        &SystemdBus::onPropertiesChanged, this);
+  if (rc >= 0)
+    rc = sd_bus_match_signal(bus, nullptr, SYSTEMD, MANAGER_PATH,
+                             MANAGER_IFACE, "UnitFilesChanged",
+                             &SystemdBus::onUnitFilesChanged, this);
+  if (rc >= 0)
+    rc = sd_bus_match_signal(bus, nullptr, SYSTEMD, MANAGER_PATH,
+                             MANAGER_IFACE, "JobRemoved",
+                             &SystemdBus::onJobRemoved, this);
+
+  // systemd only sends unit and job signals to subscribed clients
+  sd_bus_error error = SD_BUS_ERROR_NULL;
+  if (rc >= 0)
+    rc = sd_bus_call_method(bus, SYSTEMD, MANAGER_PATH, MANAGER_IFACE,
+                            "Subscribe", &error, nullptr, "");
+  if (rc < 0) {
+    logToFile("SystemdBus: subscribe failed: " + busError(error, rc),
+              0xFFFFFFFF);
+    sd_bus_error_free(&error);
+    sd_bus_flush_close_unref(bus);
+    bus = nullptr;
+    return false;
+  }
+  sd_bus_error_free(&error);
+  return true;
+}
+
+void SystemdBus::close() {
+  std::lock_guard<std::mutex> lock(busMutex);
+  if (bus) {
+    sd_bus_flush_close_unref(bus);
+    bus = nullptr;
+  }
+  watched.clear();
+}
+
+void SystemdBus::dispatch(int timeoutMs) {
+  int fd;
+  short events;
+  {
+    std::lock_guard<std::mutex> lock(busMutex);
+    if (!bus)
+      return;
+    // Another thread's method call may have queued signals already
+    drainLocked();
+    fd = sd_bus_get_fd(bus);
+    events = sd_bus_get_events(bus);
+  }
+
+  struct pollfd pfd;
+  pfd.fd = fd;
+  pfd.events = events;
+  if (poll(&pfd, 1, timeoutMs) <= 0)
+    return;
+
+  std::lock_guard<std::mutex> lock(busMutex);
+  if (bus)
+    drainLocked();
+}
+
+void SystemdBus::drainLocked() {
+  while (sd_bus_process(bus, nullptr) > 0) {
+  }
+}
+
+bool SystemdBus::fetchState(const std::string &path, UnitState &state) {
+  std::string loadState = getProperty(bus, path, "LoadState");
+  if (loadState.empty())
+    return false;
+  state.found = loadState != "not-found";
+  state.activeState = getProperty(bus, path, "ActiveState");
+  state.unitFileState = getProperty(bus, path, "UnitFileState");
+  return true;
+}
+
+bool SystemdBus::watchUnit(const std::string &unit) {
+  std::lock_guard<std::mutex> lock(busMutex);
+  if (!bus)
+    return false;
+
+  sd_bus_error error = SD_BUS_ERROR_NULL;
+  sd_bus_message *reply = nullptr;
+  int rc = sd_bus_call_method(bus, SYSTEMD, MANAGER_PATH, MANAGER_IFACE,
+                              "LoadUnit", &error, &reply, "s", unit.c_str());
+  const char *path = nullptr;
+  if (rc >= 0)
+    rc = sd_bus_message_read(reply, "o", &path);
+  if (rc < 0) {
+    logToFile("SystemdBus: LoadUnit " + unit + ": " + busError(error, rc),
+              LOG_CORE);
+    sd_bus_error_free(&error);
+    sd_bus_message_unref(reply);
+    return false;
+  }
+  std::string unitPath = path;
+  sd_bus_error_free(&error);
+  sd_bus_message_unref(reply);
+
+  // Register before fetching so no change signal falls in between
+  Watched &entry = watched[unitPath];
+  entry.unit = unit;
+  if (!fetchState(unitPath, entry.state)) {
+    watched.erase(unitPath);
+    return false;
+  }
+  onChange(unit, entry.state);
+  return true;
+}
+
+bool SystemdBus::runAction(UnitAction action, const std::string &unit,
+                           std::string &errorText) {
+  std::string job;
+  {
+    std::lock_guard<std::mutex> lock(busMutex);
+    if (!bus) {
+      errorText = "not connected to systemd";
+      return false;
+    }
+
+    sd_bus_error error = SD_BUS_ERROR_NULL;
+    sd_bus_message *reply = nullptr;
+    const char *u = unit.c_str();
+    int rc = 0;
+    switch (action) {
+    case UnitAction::Start:
+    case UnitAction::Stop:
+    case UnitAction::Restart: {
+      const char *method = action == UnitAction::Start  ? "StartUnit"
+                           : action == UnitAction::Stop ? "StopUnit"
+                                                        : "RestartUnit";
+      rc = sd_bus_call_method(bus, SYSTEMD, MANAGER_PATH, MANAGER_IFACE,
+                              method, &error, &reply, "ss", u, "replace");
+      const char *jobPath = nullptr;
+      if (rc >= 0)
+        rc = sd_bus_message_read(reply, "o", &jobPath);
+      if (rc >= 0)
+        job = jobPath;
+      break;
+    }
+    case UnitAction::ResetFailed:
+      rc = sd_bus_call_method(bus, SYSTEMD, MANAGER_PATH, MANAGER_IFACE,
+                              "ResetFailedUnit", &error, nullptr, "s", u);
+      break;
+    case UnitAction::Enable:
+    case UnitAction::Disable:
+      if (action == UnitAction::Enable)
+        rc = sd_bus_call_method(bus, SYSTEMD, MANAGER_PATH, MANAGER_IFACE,
+                                "EnableUnitFiles", &error, nullptr, "asbb", 1,
+                                u, 0, 1);
+      else
+        rc = sd_bus_call_method(bus, SYSTEMD, MANAGER_PATH, MANAGER_IFACE,
+                                "DisableUnitFiles", &error, nullptr, "asb", 1,
+                                u, 0);
+      // systemctl enable/disable reload the manager afterwards too
+      if (rc >= 0)
+        rc = sd_bus_call_method(bus, SYSTEMD, MANAGER_PATH, MANAGER_IFACE,
+                                "Reload", &error, nullptr, "");
+      break;
+    }
+    sd_bus_message_unref(reply);
+    if (rc < 0) {
+      errorText = busError(error, rc);
+      sd_bus_error_free(&error);
+      return false;
+    }
+    sd_bus_error_free(&error);
+    drainLocked();
+  }
+
+  bool ok = true;
+  if (!job.empty()) {
+    // The watcher thread dispatches JobRemoved while we wait
+    std::string result =
+        jobs.wait(job, std::chrono::seconds(JOB_TIMEOUT_SECS));
+    if (result.empty()) {
+      errorText = "job timed out";
+      ok = false;
+    } else if (result != "done") {
+      errorText = "job " + result;
+      ok = false;
+    }
+  }
+
+  // Don't rely on signal order: report the state the job left behind
+  std::lock_guard<std::mutex> lock(busMutex);
+  if (bus) {
+    for (auto &pair : watched) {
+      if (pair.second.unit == unit &&
+          fetchState(pair.first, pair.second.state))
+        onChange(unit, pair.second.state);
+    }
+  }
+  return ok;
+}
+
+int SystemdBus::onPropertiesChanged(sd_bus_message *m, void *userdata,
+                                    sd_bus_error *) {
+  SystemdBus *self = static_cast<SystemdBus *>(userdata);
+  const char *path = sd_bus_message_get_path(m);
+  auto it = path ? self->watched.find(path) : self->watched.end();
+  if (it == self->watched.end())
+    return 0;
+  Watched &entry = it->second;
+
+  const char *iface = nullptr;
+  if (sd_bus_message_read(m, "s", &iface) < 0)
+    return 0;
+
+  bool changed = false;
+  if (sd_bus_message_enter_container(m, 'a', "{sv}") > 0) {
+    while (sd_bus_message_enter_container(m, 'e', "sv") > 0) {
+      const char *name = nullptr;
+      const char *value = nullptr;
+      sd_bus_message_read(m, "s", &name);
+      if (name && strcmp(name, "ActiveState") == 0 &&
+          sd_bus_message_read(m, "v", "s", &value) >= 0 && value) {
+        entry.state.activeState = value;
+        changed = true;
+      } else {
+        sd_bus_message_skip(m, "v");
+      }
+      sd_bus_message_exit_container(m);
+    }
+    sd_bus_message_exit_container(m);
+  }
+
+  // Properties sent without their value have to be read back
+  if (sd_bus_message_enter_container(m, 'a', "s") > 0) {
+    const char *name = nullptr;
+    while (sd_bus_message_read(m, "s", &name) > 0) {
+      if (strcmp(name, "ActiveState") == 0) {
+        entry.state.activeState =
+            getProperty(self->bus, it->first, "ActiveState");
+        changed = true;
+      }
+    }
+    sd_bus_message_exit_container(m);
+  }
+
+  if (changed)
+    self->onChange(entry.unit, entry.state);
+  return 0;
+}
+
+int SystemdBus::onUnitFilesChanged(sd_bus_message *, void *userdata,
+                                   sd_bus_error *) {
+  // Sent without details after any enable/disable; re-read every unit
+  SystemdBus *self = static_cast<SystemdBus *>(userdata);
+  for (auto &pair : self->watched) {
+    std::string fileState =
+        getProperty(self->bus, pair.first, "UnitFileState");
+    if (fileState != pair.second.state.unitFileState) {
+      pair.second.state.unitFileState = fileState;
+      self->onChange(pair.second.unit, pair.second.state);
+    }
+  }
+  return 0;
+}
+
+int SystemdBus::onJobRemoved(sd_bus_message *m, void *userdata,
+                             sd_bus_error *) {
+  SystemdBus *self = static_cast<SystemdBus *>(userdata);
+  uint32_t id = 0;
+  const char *job = nullptr;
+  const char *unit = nullptr;
+  const char *result = nullptr;
+  if (sd_bus_message_read(m, "uoss", &id, &job, &unit, &result) < 0)
+    return 0;
+
+  self->jobs.finished(job, result);
+  return 0;
+}
@@ -1,4 +1,5 @@
 #include "Utils.h"
+#include "ChromeTabs.h"
 #include "Constants.h"
 #include "Globals.h"
 #include "using.h"
@@ -71,57 +72,33 @@ std::string getChromeTabUrl(const std::string &preferredTitle) {
     return extensionUrl;
   }
 
-  // Fallback to Chrome DevTools Protocol with title matching
-  std::string response = httpGet("http://localhost:9222/json");
+  // The live tab map, kept by the DevTools subscription
+  std::string url;
+  if (ChromeTabs::urlFor(preferredTitle, url)) {
+    return url;
+  }
+
+  // Not subscribed (yet): fall back to polling the DevTools tab list
+  std::string response = httpGet("http://localhost:" +
+                                 std::to_string(ChromeTabs::port()) +
+                                 "/json");
   Json::Value root;
   Json::Reader reader;
   if (!reader.parse(response, root)) {
     return "";
   }
 
-  std::string fallbackUrl = "";
-  std::string lastRealUrl = ""; // Last non-chrome:// URL
-  int tabIndex = 0;
-
+  // Later entries count as more recent, as they always did here
+  std::vector<ChromeTab> tabs;
+  uint64_t touched = 0;
   for (const auto &tab : root) {
-    std::string type = tab["type"].asString();
-    std::string url = tab["url"].asString();
-    std::string title = tab["title"].asString();
-
-    // Skip over extension pages and devtools
-    if (type == "page" &&
-        url.find("chrome-extension://") == std::string::npos &&
-        url.find("devtools://") == std::string::npos) {
-
-      // Store the first valid page as ultimate fallback
-      if (fallbackUrl.empty()) {
-        fallbackUrl = url;
-      }
-
-      // Track last non-chrome:// URL (more likely to be the active tab)
-      if (url.find("chrome://") == std::string::npos) {
-        lastRealUrl = url;
-      }
-
-      // If we have a preferred title, look for a substring match
-      if (!preferredTitle.empty()) {
-        bool titleInWindow = preferredTitle.find(title) != std::string::npos;
-        bool windowInTitle = title.find(preferredTitle) != std::string::npos;
-
-        if (titleInWindow || windowInTitle) {
-          return url;
-        }
-      }
+    touched++;
+    if (tab["type"].asString() == "page") {
+      tabs.push_back({tab["id"].asString(), tab["title"].asString(),
+                      tab["url"].asString(), touched});
     }
-    tabIndex++;
-  }
-
-  // Prefer lastRealUrl over fallback (chrome:// URLs)
-  if (!lastRealUrl.empty()) {
-    return lastRealUrl;
   }
-
-  return fallbackUrl;
+  return ChromeTabs::choose(tabs, preferredTitle);
 }
 
 bool isMultiline(const std::string &s) {
@@ -254,3 +231,16 @@ std::string appTypeToString(AppType type) {
     return "OTHER";
   }
 }
+
+void fnv1a(uint64_t &hash, const char *data, size_t size) {
+  for (size_t i = 0; i < size; i++) {
+    hash ^= (unsigned char)data[i];
+    hash *= 1099511628211ULL;
+  }
+}
+
+std::string hashToHex(uint64_t hash) {
+  char text[17];
+  snprintf(text, sizeof(text), "%016llx", (unsigned long long)hash);
+  return text;
+}
@@ -0,0 +1,209 @@
+#include "WindowClassifier.h"
+#include "Constants.h"
+#include "DatabaseTableManagers.h"
+#include "SettingsCache.h"
+#include "Utils.h"
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <nlohmann/json.hpp>
+#include <regex>
+#include <stdexcept>
+#include <vector>
+
+using json = nlohmann::json;
+
+namespace {
+
+const char *RULES_SETTING = "windowRules";
+const size_t MAX_CACHED_WINDOWS = 512; // Closed windows are never reported
+
+// What the hardcoded checks did: the wmClass first, then title fallbacks so
+// Chrome macros work in Antigravity and ChatGPT windows
+const char *DEFAULT_RULES = R"([
+  {"name": "terminal", "wmClass": "^)" wmClassTerminal R"($",
+   "app": "TERMINAL"},
+  {"name": "chrome", "wmClass": "^)" wmClassChrome R"($", "app": "CHROME"},
+  {"name": "code", "wmClass": "^)" wmClassCode R"($", "app": "CODE"},
+  {"name": "chrome-like", "wmClass": "antigravity|chatgpt", "app": "CHROME"},
+  {"name": "chrome-like-title", "title": "antigravity|chatgpt",
+   "app": "CHROME"},
+  {"name": "terminal-title", "title": "terminal", "app": "TERMINAL"}
+])";
+
+struct Pattern {
+  bool any = true;
+  std::regex re;
+
+  bool matches(const std::string &value) const {
+    return any || std::regex_search(value, re);
+  }
+};
+
+struct Rule {
+  std::string name;
+  AppType app = AppType::OTHER;
+  Pattern wmClass, instance, title, url;
+};
+
+struct CachedWindow {
+  std::string wmClass, instance, title, url;
+  uint64_t generation;
+  WindowClass result;
+};
+
+std::mutex classifierMutex;
+bool loaded = false;
+std::atomic<bool> stale{false}; // windowRules changed under us
+uint64_t generation = 0;
+std::string rulesText;
+std::vector<Rule> rules;
+std::map<long, CachedWindow> windows;
+
+bool parseApp(const std::string &name, AppType &app) {
+  static const std::map<std::string, AppType> apps = {
+      {"OTHER", AppType::OTHER},
+      {"TERMINAL", AppType::TERMINAL},
+      {"CHROME", AppType::CHROME},
+      {"CODE", AppType::CODE}};
+  auto it = apps.find(name);
+  if (it == apps.end())
+    return false;
+  app = it->second;
+  return true;
+}
+
+// Throws std::exception with the reason on invalid rules
+std::vector<Rule> compile(const std::string &text) {
+  json j = json::parse(text);
+  if (!j.is_array())
+    throw std::runtime_error("rules must be a JSON array");
+  std::vector<Rule> compiled;
+  for (const json &entry : j) {
+    if (!entry.is_object())
+      throw std::runtime_error("each rule must be an object");
+    Rule rule;
+    rule.name = entry.value("name", "rule" + std::to_string(compiled.size()));
+    std::string app = entry.value("app", "OTHER");
+    if (!parseApp(app, rule.app))
+      throw std::runtime_error("rule " + rule.name + ": unknown app " + app +
+                               " (OTHER, TERMINAL, CHROME or CODE)");
+    for (auto [field, pattern] :
+         {std::pair<const char *, Pattern *>{"wmClass", &rule.wmClass},
+          {"instance", &rule.instance},
+          {"title", &rule.title},
+          {"url", &rule.url}}) {
+      if (!entry.contains(field))
+        continue;
+      try {
+        pattern->re = std::regex(entry[field].get<std::string>(),
+                                 std::regex::ECMAScript | std::regex::icase |
+                                     std::regex::optimize);
+        pattern->any = false;
+      } catch (const std::exception &e) {
+        throw std::runtime_error("rule " + rule.name + ": bad " + field +
+                                 " pattern: " + e.what());
+      }
+    }
+    compiled.push_back(std::move(rule));
+  }
+  return compiled;
+}
+
+// Caller holds classifierMutex
+void applyLocked(std::string text, std::vector<Rule> compiled) {
+  rulesText = std::move(text);
+  rules = std::move(compiled);
+  generation++;
+  windows.clear();
+}
+
+// Caller holds classifierMutex
+void loadLocked() {
+  if (!loaded) {
+    loaded = true;
+    SettingsCache::subscribe(
+        SettingsCache::Table::Settings, RULES_SETTING,
+        [](const std::string &, const std::string &) { stale = true; });
+  }
+  stale = false;
+  std::string text = SettingsTable::getSetting(RULES_SETTING);
+  if (!text.empty()) {
+    try {
+      applyLocked(text, compile(text));
+      logToFile("WindowClassifier: " + std::to_string(rules.size()) +
+                    " rules from " + RULES_SETTING,
+                LOG_WINDOW);
+      return;
+    } catch (const std::exception &e) {
+      logToFile(std::string("WindowClassifier: invalid ") + RULES_SETTING +
+                    ", using defaults: " + e.what(),
+                0xFFFFFFFF);
+    }
+  }
+  applyLocked(DEFAULT_RULES, compile(DEFAULT_RULES));
+}
+
+} // namespace
+
+WindowClass WindowClassifier::classify(long windowId,
+                                       const std::string &wmClass,
+                                       const std::string &instance,
+                                       const std::string &title,
+                                       const std::string &url, bool &cached) {
+  std::lock_guard<std::mutex> lock(classifierMutex);
+  if (!loaded || stale)
+    loadLocked();
+
+  auto it = windows.find(windowId);
+  if (it != windows.end() && it->second.generation == generation &&
+      it->second.wmClass == wmClass && it->second.instance == instance &&
+      it->second.title == title && it->second.url == url) {
+    cached = true;
+    return it->second.result;
+  }
+
+  cached = false;
+  WindowClass result;
+  for (const Rule &rule : rules) {
+    if (rule.wmClass.matches(wmClass) && rule.instance.matches(instance) &&
+        rule.title.matches(title) && rule.url.matches(url)) {
+      result.rule = rule.name;
+      result.app = rule.app;
+      break;
+    }
+  }
+
+  if (windows.size() >= MAX_CACHED_WINDOWS && !windows.count(windowId))
+    windows.clear();
+  windows[windowId] = {wmClass, instance, title, url, generation, result};
+  return result;
+}
+
+std::string WindowClassifier::getRules() {
+  std::lock_guard<std::mutex> lock(classifierMutex);
+  if (!loaded || stale)
+    loadLocked();
+  return json::parse(rulesText).dump(2);
+}
+
+bool WindowClassifier::setRules(const std::string &text, std::string &error) {
+  std::vector<Rule> compiled;
+  try {
+    compiled = compile(text.empty() ? DEFAULT_RULES : text);
+  } catch (const std::exception &e) {
+    error = e.what();
+    return false;
+  }
+  if (text.empty())
+    SettingsTable::deleteSetting(RULES_SETTING);
+  else
+    SettingsTable::setSetting(RULES_SETTING, json::parse(text).dump());
+
+  std::lock_guard<std::mutex> lock(classifierMutex);
+  if (!loaded)
+    loadLocked();
+  applyLocked(text.empty() ? DEFAULT_RULES : text, std::move(compiled));
+  stale = false; // Our own write
+  return true;
+}
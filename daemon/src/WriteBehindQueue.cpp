@@ -0,0 +1,337 @@
+#include "WriteBehindQueue.h"
+#include "SettingsCache.h"
+#include "StorageBackend.h"
+#include "Utils.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <thread>
+
+namespace {
+
+struct PendingWrites {
+  std::map<std::string, std::string> settings;
+  std::map<int, int> sessions;
+  std::map<std::string, int> peerTouches; // peer_id -> daemon_version or -1
+  std::map<int, std::string> historyAppends;
+  int historyFloor = -1; // Entries below this sequence are deleted
+
+  bool empty() const {
+    return settings.empty() && sessions.empty() && peerTouches.empty() &&
+           historyAppends.empty() && historyFloor < 0;
+  }
+};
+
+std::mutex queueMutex;  // guards pending and inFlight
+std::mutex flushMutex;  // serializes flushes against discards
+std::condition_variable flushWake;
+PendingWrites pending;
+PendingWrites inFlight; // taken by the current flush, still readable
+std::thread flushThread;
+std::atomic<bool> flushRunning{false};
+
+// A batch that failed this many times in a row is retried one row per
+// transaction, and the rows that still fail are logged and dropped, so one
+// bad row can't hold back every later write
+const int MAX_BATCH_ATTEMPTS = 3;
+int failedAttempts = 0; // Guarded by flushMutex
+
+enum class WriteResult { Written, NoConnection, Failed };
+
+void mergeTouch(std::map<std::string, int> &touches, const std::string &peer,
+                int version) {
+  auto it = touches.find(peer);
+  if (it == touches.end())
+    touches[peer] = version;
+  else if (version >= 0)
+    it->second = version;
+}
+
+WriteResult writeBatch(const PendingWrites &batch) {
+  std::unique_ptr<StorageConnection> con = Storage::connect();
+  if (!con) {
+    logToFile("WriteBehindQueue: Failed to get connection", 0xFFFFFFFF);
+    return WriteResult::NoConnection;
+  }
+  try {
+    con->begin();
+    if (batch.historyFloor >= 0) {
+      StorageStatement *pstmt = con->prepare(
+          "DELETE FROM terminal_history WHERE entry_index < ?");
+      pstmt->setInt(1, batch.historyFloor);
+      pstmt->executeUpdate();
+    }
+    for (const auto &[seq, path] : batch.historyAppends) {
+      if (seq < batch.historyFloor)
+        continue;
+      // Upsert so a retried batch is idempotent
+      StorageStatement *pstmt =
+          con->prepare("INSERT INTO terminal_history (entry_index, path) "
+                      "VALUES (?, ?) ON DUPLICATE KEY UPDATE path = ?");
+      pstmt->setInt(1, seq);
+      pstmt->setString(2, path);
+      pstmt->setString(3, path);
+      pstmt->executeUpdate();
+    }
+    for (const auto &[key, value] : batch.settings) {
+      StorageStatement *pstmt =
+          con->prepare("INSERT INTO system_settings (setting_key, "
+                      "setting_value) VALUES (?, ?) "
+                      "ON DUPLICATE KEY UPDATE setting_value = ?");
+      pstmt->setString(1, key);
+      pstmt->setString(2, value);
+      pstmt->setString(3, value);
+      pstmt->executeUpdate();
+    }
+    for (const auto &[tty, index] : batch.sessions) {
+      StorageStatement *pstmt = con->prepare(
+          "INSERT INTO terminal_sessions (tty, history_index) VALUES (?, ?) "
+          "ON DUPLICATE KEY UPDATE history_index = ?");
+      pstmt->setInt(1, tty);
+      pstmt->setInt(2, index);
+      pstmt->setInt(3, index);
+      pstmt->executeUpdate();
+    }
+    for (const auto &[peer, version] : batch.peerTouches) {
+      StorageStatement *pstmt;
+      if (version >= 0) {
+        pstmt = con->prepare(
+            "UPDATE peer_registry SET last_seen = NOW(), is_online = 1, "
+            "daemon_version = ? WHERE peer_id = ?");
+        pstmt->setInt(1, version);
+        pstmt->setString(2, peer);
+      } else {
+        pstmt = con->prepare("UPDATE peer_registry SET last_seen = NOW(), "
+                            "is_online = 1 WHERE peer_id = ?");
+        pstmt->setString(1, peer);
+      }
+      pstmt->executeUpdate();
+    }
+    con->commit();
+    return WriteResult::Written;
+  } catch (StorageError &e) {
+    logToFile("WriteBehindQueue: flush error: " + std::string(e.what()),
+              0xFFFFFFFF);
+    try {
+      con->rollback();
+    } catch (StorageError &) {
+    }
+    return WriteResult::Failed;
+  }
+}
+
+// Fold an older batch into newer; what newer already holds wins
+void mergeOlder(PendingWrites &newer, const PendingWrites &batch) {
+  for (auto &[key, value] : batch.settings)
+    newer.settings.emplace(key, value);
+  for (auto &[tty, index] : batch.sessions)
+    newer.sessions.emplace(tty, index);
+  for (auto &[seq, path] : batch.historyAppends)
+    newer.historyAppends.emplace(seq, path);
+  newer.historyFloor = std::max(newer.historyFloor, batch.historyFloor);
+  for (auto &[peer, version] : batch.peerTouches) {
+    auto it = newer.peerTouches.find(peer);
+    if (it == newer.peerTouches.end())
+      newer.peerTouches[peer] = version;
+    else if (it->second < 0)
+      it->second = version;
+  }
+}
+
+// Write each row of batch in its own transaction. Rows that fail are logged
+// and dropped; rows not tried for lack of a connection are returned.
+PendingWrites writeRowsSeparately(const PendingWrites &batch) {
+  PendingWrites unwritten;
+  auto writeRow = [&](const PendingWrites &row, const std::string &what) {
+    WriteResult result = writeBatch(row);
+    if (result == WriteResult::NoConnection) {
+      mergeOlder(unwritten, row);
+    } else if (result == WriteResult::Failed) {
+      logToFile("WriteBehindQueue: dropping " + what + " after " +
+                    std::to_string(MAX_BATCH_ATTEMPTS) + " failed flushes",
+                0xFFFFFFFF);
+    }
+  };
+  if (batch.historyFloor >= 0) {
+    PendingWrites row;
+    row.historyFloor = batch.historyFloor;
+    writeRow(row, "history trim below " + std::to_string(row.historyFloor));
+  }
+  for (const auto &[seq, path] : batch.historyAppends) {
+    if (seq < batch.historyFloor)
+      continue;
+    PendingWrites row;
+    row.historyAppends[seq] = path;
+    writeRow(row, "history entry " + std::to_string(seq) + " (" + path + ")");
+  }
+  for (const auto &[key, value] : batch.settings) {
+    PendingWrites row;
+    row.settings[key] = value;
+    writeRow(row, "setting " + key);
+  }
+  for (const auto &[tty, index] : batch.sessions) {
+    PendingWrites row;
+    row.sessions[tty] = index;
+    writeRow(row, "session pointer for tty " + std::to_string(tty));
+  }
+  for (const auto &[peer, version] : batch.peerTouches) {
+    PendingWrites row;
+    row.peerTouches[peer] = version;
+    writeRow(row, "last_seen of " + peer);
+  }
+  return unwritten;
+}
+
+void flushLoop(int intervalMs) {
+  while (flushRunning) {
+    {
+      std::unique_lock<std::mutex> lock(queueMutex);
+      flushWake.wait_for(lock, std::chrono::milliseconds(intervalMs),
+                         [] { return !flushRunning.load(); });
+    }
+    WriteBehindQueue::flush();
+  }
+}
+
+} // namespace
+
+void WriteBehindQueue::start(int intervalMs) {
+  if (flushRunning.exchange(true))
+    return;
+  flushThread = std::thread(flushLoop, intervalMs);
+}
+
+void WriteBehindQueue::stop() {
+  if (flushRunning.exchange(false)) {
+    flushWake.notify_all();
+    if (flushThread.joinable())
+      flushThread.join();
+  }
+  flush();
+}
+
+void WriteBehindQueue::flush() {
+  std::lock_guard<std::mutex> flushLock(flushMutex);
+  {
+    std::lock_guard<std::mutex> lock(queueMutex);
+    if (pending.empty())
+      return;
+    std::swap(pending, inFlight);
+  }
+
+  WriteResult result = writeBatch(inFlight);
+  PendingWrites unwritten;
+  if (result == WriteResult::Written) {
+    failedAttempts = 0;
+  } else if (result == WriteResult::NoConnection) {
+    unwritten = inFlight; // Storage is away, not the data's fault
+  } else if (++failedAttempts < MAX_BATCH_ATTEMPTS) {
+    unwritten = inFlight;
+  } else {
+    logToFile("WriteBehindQueue: batch failed " +
+                  std::to_string(failedAttempts) +
+                  " times, writing it row by row",
+              0xFFFFFFFF);
+    failedAttempts = 0;
+    unwritten = writeRowsSeparately(inFlight);
+  }
+
+  std::lock_guard<std::mutex> lock(queueMutex);
+  mergeOlder(pending, unwritten);
+  inFlight = PendingWrites();
+}
+
+void WriteBehindQueue::setSetting(const std::string &key,
+                                  const std::string &value) {
+  {
+    std::lock_guard<std::mutex> lock(queueMutex);
+    pending.settings[key] = value;
+  }
+  SettingsCache::set(SettingsCache::Table::Settings, key, value);
+}
+
+void WriteBehindQueue::setSessionPointer(int tty, int index) {
+  std::lock_guard<std::mutex> lock(queueMutex);
+  pending.sessions[tty] = index;
+}
+
+void WriteBehindQueue::touchLastSeen(const std::string &peer_id,
+                                     int daemon_version) {
+  std::lock_guard<std::mutex> lock(queueMutex);
+  mergeTouch(pending.peerTouches, peer_id, daemon_version);
+}
+
+void WriteBehindQueue::appendHistory(int seq, const std::string &path,
+                                     int floorSeq) {
+  std::lock_guard<std::mutex> lock(queueMutex);
+  pending.historyAppends[seq] = path;
+  if (floorSeq > pending.historyFloor) {
+    pending.historyFloor = floorSeq;
+    pending.historyAppends.erase(pending.historyAppends.begin(),
+                                 pending.historyAppends.lower_bound(floorSeq));
+  }
+}
+
+bool WriteBehindQueue::getPendingSetting(const std::string &key,
+                                         std::string &value) {
+  std::lock_guard<std::mutex> lock(queueMutex);
+  for (const PendingWrites *w : {&pending, &inFlight}) {
+    auto it = w->settings.find(key);
+    if (it != w->settings.end()) {
+      value = it->second;
+      return true;
+    }
+  }
+  return false;
+}
+
+bool WriteBehindQueue::getPendingSessionPointer(int tty, int &index) {
+  std::lock_guard<std::mutex> lock(queueMutex);
+  for (const PendingWrites *w : {&pending, &inFlight}) {
+    auto it = w->sessions.find(tty);
+    if (it != w->sessions.end()) {
+      index = it->second;
+      return true;
+    }
+  }
+  return false;
+}
+
+bool WriteBehindQueue::hasPendingPeers() {
+  std::lock_guard<std::mutex> lock(queueMutex);
+  return !pending.peerTouches.empty() || !inFlight.peerTouches.empty();
+}
+
+void WriteBehindQueue::discardSetting(const std::string &key) {
+  std::lock_guard<std::mutex> flushLock(flushMutex);
+  std::lock_guard<std::mutex> lock(queueMutex);
+  pending.settings.erase(key);
+}
+
+void WriteBehindQueue::discardSessionPointer(int tty) {
+  std::lock_guard<std::mutex> flushLock(flushMutex);
+  std::lock_guard<std::mutex> lock(queueMutex);
+  pending.sessions.erase(tty);
+}
+
+void WriteBehindQueue::discardHistory() {
+  std::lock_guard<std::mutex> flushLock(flushMutex);
+  std::lock_guard<std::mutex> lock(queueMutex);
+  pending.historyAppends.clear();
+  pending.historyFloor = -1;
+}
+
+void WriteBehindQueue::discardPeer(const std::string &peer_id) {
+  std::lock_guard<std::mutex> flushLock(flushMutex);
+  std::lock_guard<std::mutex> lock(queueMutex);
+  pending.peerTouches.erase(peer_id);
+}
+
+void WriteBehindQueue::discardAllPeers() {
+  std::lock_guard<std::mutex> flushLock(flushMutex);
+  std::lock_guard<std::mutex> lock(queueMutex);
+  pending.peerTouches.clear();
+}
@@ -1,16 +1,26 @@
 #include "cmdApp.h"
 #include "Constants.h"
 #include "DatabaseTableManagers.h"
+#include "DependencyCache.h"
 #include "Globals.h"
 #include "PeerManager.h"
+#include "PortProbe.h"
+#include "PortRegistry.h"
+#include "ServiceWatcher.h"
 #include "Utils.h"
 #include "cmdPeer.h"
 #include <algorithm>
+#include <cerrno>
 #include <chrono>
+#include <filesystem>
+#include <fstream>
 #include <map>
 #include <mutex>
+#include <sched.h>
 #include <set>
+#include <signal.h>
 #include <sstream>
+#include <sys/stat.h>
 #include <thread>
 #include <tuple>
 #include <unistd.h>
@@ -31,20 +41,33 @@ static const vector<AppConfig> APP_CONFIGS = {
 // ============================================================================
 // Peer app status cache (leader-side, populated from worker heartbeats)
 // ============================================================================
+struct PeerAppStatus {
+  json status; // {appId: {dev_installed, ...}}
+  uint64_t version = 0; // Worker's version of status; 0 if unversioned
+};
 static mutex peerAppStatusMutex;
-static map<string, json> peerAppStatusCache; // peer_id -> {appId: {dev_installed, ...}}
+static map<string, PeerAppStatus> peerAppStatusCache; // peer_id -> status
 
 // ============================================================================
 // AppManager namespace implementation
 // ============================================================================
 
 bool AppManager::startService(const string &serviceName) {
+  bool ok;
+  if (ServiceWatcher::control(UnitAction::Start, serviceName, ok))
+    return ok;
   string cmd = "/usr/bin/systemctl start " + serviceName + " 2>/dev/null";
   int rc = std::system(cmd.c_str());
   return (rc == 0);
 }
 
 bool AppManager::stopService(const string &serviceName) {
+  bool ok;
+  if (ServiceWatcher::control(UnitAction::Stop, serviceName, ok)) {
+    // Also reset-failed to allow immediate restart
+    ServiceWatcher::control(UnitAction::ResetFailed, serviceName, ok);
+    return true;
+  }
   string cmd = "/usr/bin/systemctl stop " + serviceName + " 2>/dev/null";
   std::system(cmd.c_str());
   // Also reset-failed to allow immediate restart
@@ -54,24 +77,36 @@ bool AppManager::stopService(const string &serviceName) {
 }
 
 bool AppManager::restartService(const string &serviceName) {
+  bool ok;
+  if (ServiceWatcher::control(UnitAction::Restart, serviceName, ok))
+    return ok;
   string cmd = "/usr/bin/systemctl restart " + serviceName + " 2>/dev/null";
   int rc = std::system(cmd.c_str());
   return (rc == 0);
 }
 
 bool AppManager::enableService(const string &serviceName) {
+  bool ok;
+  if (ServiceWatcher::control(UnitAction::Enable, serviceName, ok))
+    return ok;
   string cmd = "/usr/bin/systemctl enable " + serviceName + " 2>/dev/null";
   int rc = std::system(cmd.c_str());
   return (rc == 0);
 }
 
 bool AppManager::disableService(const string &serviceName) {
+  bool ok;
+  if (ServiceWatcher::control(UnitAction::Disable, serviceName, ok))
+    return ok;
   string cmd = "/usr/bin/systemctl disable " + serviceName + " 2>/dev/null";
   int rc = std::system(cmd.c_str());
   return (rc == 0);
 }
 
 bool AppManager::isServiceActive(const string &serviceName) {
+  bool active;
+  if (ServiceWatcher::isActive(serviceName, active))
+    return active;
   string cmd =
       "/usr/bin/systemctl is-active --quiet " + serviceName + " 2>/dev/null";
   int rc = std::system(cmd.c_str());
@@ -79,6 +114,9 @@ bool AppManager::isServiceActive(const string &serviceName) {
 }
 
 bool AppManager::isServiceEnabled(const string &serviceName) {
+  bool enabled;
+  if (ServiceWatcher::isEnabled(serviceName, enabled))
+    return enabled;
   string cmd =
       "/usr/bin/systemctl is-enabled --quiet " + serviceName + " 2>/dev/null";
   int rc = std::system(cmd.c_str());
@@ -92,28 +130,64 @@ string AppManager::getServiceStatus(const string &serviceName) {
 }
 
 bool AppManager::isPortListening(int port) {
+  bool listening;
+  if (PortProbe::isListening(port, listening))
+    return listening;
   string cmd = "/usr/bin/ss -tlnH sport = :" + to_string(port);
   return !executeCommand(cmd.c_str()).empty();
 }
 
 void AppManager::killProcessOnPort(int port) {
+  vector<pid_t> pids;
+  if (PortProbe::socketOwners(port, pids)) {
+    for (pid_t pid : pids) {
+      logToFile("killProcessOnPort: " + to_string(port) + " held by pid " +
+                    to_string(pid),
+                LOG_CORE);
+      kill(pid, SIGKILL);
+    }
+    return;
+  }
   string cmd = "/usr/bin/fuser -k -9 " + to_string(port) + "/tcp 2>/dev/null";
   std::system(cmd.c_str());
 }
 
 bool AppManager::waitForPortRelease(int port, int timeoutMs) {
-  int elapsedMs = 0;
-  const int pollIntervalMs = 200;
-
-  while (isPortListening(port) && elapsedMs < timeoutMs) {
+  // Probing is cheap now, so start polling fast and back off; most services
+  // let go of the port within a few milliseconds of stopping
+  auto start = chrono::steady_clock::now();
+  int pollIntervalMs = 5;
+  const int maxPollIntervalMs = 200;
+
+  while (isPortListening(port)) {
+    int elapsedMs = (int)chrono::duration_cast<chrono::milliseconds>(
+                        chrono::steady_clock::now() - start)
+                        .count();
+    if (elapsedMs >= timeoutMs)
+      return false;
     // Force kill after 2.5 seconds
     if (elapsedMs > 2500) {
       killProcessOnPort(port);
     }
     this_thread::sleep_for(chrono::milliseconds(pollIntervalMs));
-    elapsedMs += pollIntervalMs;
+    pollIntervalMs = min(pollIntervalMs * 2, maxPollIntervalMs);
   }
-  return !isPortListening(port);
+  return true;
+}
+
+bool AppManager::waitForPortListen(int port, int timeoutMs) {
+  auto start = chrono::steady_clock::now();
+  int pollIntervalMs = 5;
+  const int maxPollIntervalMs = 200;
+
+  while (!isPortListening(port)) {
+    if (chrono::steady_clock::now() - start >=
+        chrono::milliseconds(timeoutMs))
+      return false;
+    this_thread::sleep_for(chrono::milliseconds(pollIntervalMs));
+    pollIntervalMs = min(pollIntervalMs * 2, maxPollIntervalMs);
+  }
+  return true;
 }
 
 // Helper: Convert ExtraAppRecord to AppConfig
@@ -192,42 +266,141 @@ string AppManager::getAppPath(const string &appId, const string &mode) {
   return (mode == "prod") ? cfg.prodPath : cfg.devPath;
 }
 
+// Build fingerprints. buildCppComponent stamps the build directory with a
+// hash of the build configuration (CMake files, toolchain) and one of the
+// remaining sources; an unchanged component isn't rebuilt, a source change
+// builds incrementally and a configuration change rebuilds from scratch.
+static const char *BUILD_STAMP = ".build-fingerprint";
+static const set<string> FINGERPRINT_SKIP_DIRS = {"build", ".git",
+                                                  "node_modules"};
+static const vector<string> TOOLCHAIN = {"/usr/bin/cmake", "/usr/bin/make",
+                                         "/usr/bin/c++", "/usr/bin/cc"};
+
+static void hashString(uint64_t &hash, const string &text) {
+  fnv1a(hash, text.c_str(), text.size() + 1); // Keep the terminator
+}
+
+static bool isBuildConfigFile(const filesystem::path &file) {
+  return file.filename() == "CMakeLists.txt" || file.extension() == ".cmake";
+}
+
+static void fingerprintComponent(const string &path, uint64_t &config,
+                                 uint64_t &sources) {
+  namespace fs = filesystem;
+  config = sources = FNV1A_OFFSET_BASIS;
+  error_code ec;
+
+  vector<fs::path> files;
+  fs::recursive_directory_iterator it(
+      path, fs::directory_options::skip_permission_denied, ec);
+  for (; !ec && it != fs::recursive_directory_iterator(); it.increment(ec)) {
+    if (it->is_directory(ec) &&
+        FINGERPRINT_SKIP_DIRS.count(it->path().filename().string())) {
+      it.disable_recursion_pending();
+      continue;
+    }
+    if (it->is_regular_file(ec))
+      files.push_back(it->path());
+  }
+  sort(files.begin(), files.end()); // Directory order isn't stable
+
+  vector<char> buffer(65536);
+  for (const fs::path &file : files) {
+    uint64_t &hash = isBuildConfigFile(file) ? config : sources;
+    hashString(hash, fs::relative(file, path, ec).string());
+    ifstream in(file, ios::binary);
+    while (in.read(buffer.data(), buffer.size()) || in.gcount() > 0)
+      fnv1a(hash, buffer.data(), (size_t)in.gcount());
+  }
+
+  // A toolchain upgrade replaces the binaries
+  for (const string &tool : TOOLCHAIN) {
+    fs::path target = fs::canonical(tool, ec);
+    if (ec)
+      continue;
+    hashString(config, target.string());
+    hashString(config, to_string(fs::file_size(target, ec)));
+    hashString(config,
+               to_string(fs::last_write_time(target, ec)
+                             .time_since_epoch()
+                             .count()));
+  }
+}
+
+// Cores this process may run on
+static int buildJobs() {
+  cpu_set_t cpus;
+  if (sched_getaffinity(0, sizeof(cpus), &cpus) == 0 && CPU_COUNT(&cpus) > 0)
+    return CPU_COUNT(&cpus);
+  return max(1u, thread::hardware_concurrency());
+}
+
 string AppManager::buildCppComponent(const string &path) {
   string buildDir = path + "/build";
+  string stampPath = buildDir + "/" + BUILD_STAMP;
 
   stringstream result;
   result << "  Path: " << path << "\n";
 
-  // Clean rebuild: delete build directory first for consistency
-  string rmCmd = "/usr/bin/rm -rf " + buildDir;
-  if (std::system(rmCmd.c_str()) != 0) {
-    result << "  Warning: Failed to remove old build directory\n";
-  }
-  result << "  Clean: OK\n";
+  uint64_t configHash, sourcesHash;
+  fingerprintComponent(path, configHash, sourcesHash);
+  string configLine = "config " + hashToHex(configHash);
+  string sourcesLine = "sources " + hashToHex(sourcesHash);
 
-  // Create build directory
-  string mkdirCmd = "/usr/bin/mkdir -p " + buildDir;
-  if (std::system(mkdirCmd.c_str()) != 0) {
-    return result.str() + "Error: Failed to create build directory\n";
+  string stampConfig, stampSources;
+  {
+    ifstream stamp(stampPath);
+    getline(stamp, stampConfig);
+    getline(stamp, stampSources);
+  }
+  if (stampConfig == configLine && stampSources == sourcesLine) {
+    result << "  Up to date (" << hashToHex(sourcesHash)
+           << "), build skipped\n";
+    result << "Build complete.\n";
+    return result.str();
   }
+  // A failed build must not leave a matching stamp behind
+  ::unlink(stampPath.c_str());
+
+  if (stampConfig != configLine) {
+    // Clean rebuild when the configuration changed (or was never built)
+    string rmCmd = "/usr/bin/rm -rf " + buildDir;
+    if (std::system(rmCmd.c_str()) != 0) {
+      result << "  Warning: Failed to remove old build directory\n";
+    }
+    result << "  Clean: OK\n";
+
+    // Create build directory
+    string mkdirCmd = "/usr/bin/mkdir -p " + buildDir;
+    if (std::system(mkdirCmd.c_str()) != 0) {
+      return result.str() + "Error: Failed to create build directory\n";
+    }
 
-  // Run cmake
-  string cmakeCmd = "cd " + buildDir + " && /usr/bin/cmake .. 2>&1";
-  string cmakeOutput = executeCommand(cmakeCmd.c_str());
-  if (cmakeOutput.find("Error") != string::npos ||
-      cmakeOutput.find("error") != string::npos) {
-    return result.str() + "CMake output:\n" + cmakeOutput + "\n";
+    // Run cmake
+    string cmakeCmd = "cd " + buildDir + " && /usr/bin/cmake .. 2>&1";
+    string cmakeOutput = executeCommand(cmakeCmd.c_str());
+    if (cmakeOutput.find("Error") != string::npos ||
+        cmakeOutput.find("error") != string::npos) {
+      return result.str() + "CMake output:\n" + cmakeOutput + "\n";
+    }
+    result << "  CMake: OK\n";
+  } else {
+    result << "  Sources changed, incremental build\n";
   }
-  result << "  CMake: OK\n";
 
   // Run make
-  string makeCmd = "cd " + buildDir + " && /usr/bin/make -j$(nproc) 2>&1";
+  int jobs = buildJobs();
+  string makeCmd = "cd " + buildDir + " && /usr/bin/make -j" +
+                   to_string(jobs) + " 2>&1";
   string makeOutput = executeCommand(makeCmd.c_str());
   if (makeOutput.find("Error") != string::npos ||
       makeOutput.find("error:") != string::npos) {
     return result.str() + "Make output:\n" + makeOutput + "\n";
   }
-  result << "  Make: OK\n";
+  result << "  Make: OK (" << jobs << " jobs)\n";
+
+  ofstream stamp(stampPath);
+  stamp << configLine << "\n" << sourcesLine << "\n";
   result << "Build complete.\n";
 
   return result.str();
@@ -295,17 +468,13 @@ string AppManager::installDependencies(const string &appId, const string &mode,
     return result.str() + "  No package.json found, skipping.\n";
   }
 
-  // Run npm install
-  string npmCmd = "cd " + targetDir + " && /usr/bin/npm install 2>&1";
-  string npmOutput = executeCommand(npmCmd.c_str());
-
-  // Check for errors
-  if (npmOutput.find("ERR!") != string::npos ||
-      npmOutput.find("error") != string::npos) {
-    return result.str() + "npm output:\n" + npmOutput + "\n";
+  // Run npm install, unless the lockfile's tree is installed or cached
+  DependencyInstall install = DependencyCache::install(targetDir);
+  if (!install.ok) {
+    return result.str() + "npm output:\n" + install.output + "\n";
   }
 
-  result << "  npm install: OK\n";
+  result << "  " << DependencyCache::describe(install) << "\n";
   return result.str();
 }
 
@@ -339,9 +508,37 @@ json AppManager::getLocalAppStatusAll() {
   return result;
 }
 
-void AppManager::updatePeerAppStatus(const string &peerId, const json &appStatus) {
+void AppManager::updatePeerAppStatus(const string &peerId, const json &appStatus,
+                                     uint64_t version) {
   lock_guard<mutex> lock(peerAppStatusMutex);
-  peerAppStatusCache[peerId] = appStatus;
+  PeerAppStatus &entry = peerAppStatusCache[peerId];
+  entry.status = appStatus;
+  entry.version = version;
+}
+
+uint64_t AppManager::applyPeerAppStatusDelta(const string &peerId,
+                                             uint64_t baseVersion,
+                                             uint64_t version,
+                                             const json &delta) {
+  lock_guard<mutex> lock(peerAppStatusMutex);
+  auto it = peerAppStatusCache.find(peerId);
+  if (it == peerAppStatusCache.end())
+    return 0;
+  PeerAppStatus &entry = it->second;
+  // A delta against a version we don't hold can't be applied; the worker
+  // sees our version in the reply and resends the full status
+  if (baseVersion == 0 || entry.version != baseVersion)
+    return entry.version;
+  try {
+    entry.status = entry.status.patch(delta);
+  } catch (const std::exception &e) {
+    logToFile("Bad app status delta from " + peerId + ": " + e.what(),
+              LOG_CORE);
+    peerAppStatusCache.erase(it);
+    return 0;
+  }
+  entry.version = version;
+  return version;
 }
 
 void AppManager::clearPeerAppStatus(const string &peerId) {
@@ -598,7 +795,11 @@ CmdResult handleAppStatus(const json &command) {
         int port = stoi(portStr);
         bool listening = AppManager::isPortListening(port);
         ss << "    Port " << port << ": "
-           << (listening ? "LISTENING" : "NOT LISTENING") << "\n";
+           << (listening ? "LISTENING" : "NOT LISTENING");
+        pid_t pid;
+        if (listening && PortProbe::listenerPid(port, pid) && pid > 0)
+          ss << " (pid " << pid << ")";
+        ss << "\n";
       }
     }
   }
@@ -1015,24 +1216,38 @@ CmdResult handleAddExtraApp(const json &command) {
   result << "    Client subdir: " << (clientSubdir.empty() ? "(root)" : clientSubdir) << "\n";
 
   // 4. Allocate ports
-  auto [prodPort, devPort] = findNextAvailablePortPair();
-  if (prodPort < 0) {
-    return CmdResult(1, "No available ports in 3000-3499 range\n");
-  }
-
-  int serverPort = -1;
-  if (hasServer) {
-    serverPort = findNextAvailableServerPort();
-    if (serverPort < 0) {
+  int prodPort = -1, devPort = -1, serverPort = -1;
+  if (PortRegistry::isLoaded()) {
+    // The registry writes the port_ settings and leases them to the app
+    string peerId = PeerManager::getInstance().getPeerId();
+    if (!PortRegistry::allocatePair(appId + "-prod", appId + "-dev", appId,
+                                    peerId, prodPort, devPort)) {
+      return CmdResult(1, "No available ports in 3000-3499 range\n");
+    }
+    if (hasServer && !PortRegistry::allocateServer(appId + "-server", appId,
+                                                   peerId, serverPort)) {
       return CmdResult(1, "No available server ports in 3500+ range\n");
     }
-  }
+  } else {
+    tie(prodPort, devPort) = findNextAvailablePortPair();
+    if (prodPort < 0) {
+      return CmdResult(1, "No available ports in 3000-3499 range\n");
+    }
 
-  // Save ports to database
-  SettingsTable::setSetting("port_" + appId + "-prod", to_string(prodPort));
-  SettingsTable::setSetting("port_" + appId + "-dev", to_string(devPort));
-  if (hasServer) {
-    SettingsTable::setSetting("port_" + appId + "-server", to_string(serverPort));
+    if (hasServer) {
+      serverPort = findNextAvailableServerPort();
+      if (serverPort < 0) {
+        return CmdResult(1, "No available server ports in 3500+ range\n");
+      }
+    }
+
+    // Save ports to database
+    SettingsTable::setSetting("port_" + appId + "-prod", to_string(prodPort));
+    SettingsTable::setSetting("port_" + appId + "-dev", to_string(devPort));
+    if (hasServer) {
+      SettingsTable::setSetting("port_" + appId + "-server",
+                                to_string(serverPort));
+    }
   }
 
   result << "  Ports allocated:\n";
@@ -1116,6 +1331,167 @@ CmdResult handleRemoveExtraApp(const json &command) {
   return CmdResult(0, result.str());
 }
 
+// ============================================================================
+// Prod slots (blue/green)
+// ============================================================================
+// The prod path is a symlink to one of two worktrees, <prodPath>.blue and
+// <prodPath>.green. deployToProd checks out, installs and builds the new
+// commit in the idle slot while the live one keeps serving, then repoints
+// the link and restarts the services, so the app is only down for the
+// restart. The previous slot is left as it was for rollbackProd.
+static mutex prodSwitchMutex; // One deploy or rollback at a time
+
+static string slotPath(const string &prodPath, const string &slot) {
+  return prodPath + "." + slot;
+}
+
+static string otherSlot(const string &slot) {
+  return slot == "blue" ? "green" : "blue";
+}
+
+// Slot the prod link points at, "" while prod is still a plain worktree
+static string activeSlot(const string &prodPath) {
+  char target[4096];
+  ssize_t n = readlink(prodPath.c_str(), target, sizeof(target) - 1);
+  if (n <= 0)
+    return "";
+  target[n] = '\0';
+  string name = filesystem::path(target).filename().string();
+  string base = filesystem::path(prodPath).filename().string();
+  for (const string slot : {"blue", "green"}) {
+    if (name == base + "." + slot)
+      return slot;
+  }
+  return "";
+}
+
+static string shortHead(const string &path) {
+  string cmd =
+      "/usr/bin/git -C " + path + " rev-parse --short HEAD 2>/dev/null";
+  string head = executeCommand(cmd.c_str());
+  head.erase(head.find_last_not_of(" \n\r\t") + 1);
+  return head;
+}
+
+// Repoint the prod link at slot with a rename over it, so the path never
+// dangles
+static bool pointProdAt(const string &prodPath, const string &slot,
+                        string &error) {
+  string link = prodPath + ".link";
+  string target = filesystem::path(slotPath(prodPath, slot)).filename();
+  ::unlink(link.c_str());
+  if (symlink(target.c_str(), link.c_str()) != 0 ||
+      rename(link.c_str(), prodPath.c_str()) != 0) {
+    error = "Failed to point " + prodPath + " at " + target + ": " +
+            strerror(errno);
+    ::unlink(link.c_str());
+    return false;
+  }
+  return true;
+}
+
+// First deploy: the plain prod worktree becomes the blue slot. Its running
+// services keep their working directory across the rename.
+static bool convertProdToSlots(const string &prodPath, string &error) {
+  struct stat st;
+  if (lstat(prodPath.c_str(), &st) != 0 || !S_ISDIR(st.st_mode)) {
+    error = prodPath + " is neither a slot link nor a worktree";
+    return false;
+  }
+  string blue = slotPath(prodPath, "blue");
+  if (access(blue.c_str(), F_OK) == 0) {
+    error = blue + " already exists; move it away first";
+    return false;
+  }
+  if (rename(prodPath.c_str(), blue.c_str()) != 0) {
+    error = "Failed to move " + prodPath + ": " + strerror(errno);
+    return false;
+  }
+  // The repository's record of the worktree still names the old path
+  string repairCmd = "/usr/bin/git -C " + blue + " worktree repair 2>&1";
+  executeCommand(repairCmd.c_str());
+  if (!pointProdAt(prodPath, "blue", error)) {
+    rename(blue.c_str(), prodPath.c_str());
+    return false;
+  }
+  logToFile("Converted " + prodPath + " to blue/green slots", LOG_CORE);
+  return true;
+}
+
+// npm install everywhere in the slot a prod service runs from: the client
+// directory (the slot itself when clientSubdir is empty) and the server's.
+// saved accumulates the time the dependency cache saved.
+static bool installSlotDependencies(const AppConfig &config,
+                                    const string &slot, string &error,
+                                    double &saved) {
+  set<string> dirs = {config.clientSubdir.empty()
+                          ? slot
+                          : slot + "/" + config.clientSubdir};
+  if (config.hasServerComponent && !config.serverBuildSubdir.empty())
+    dirs.insert(config.serverBuildSubdir == "."
+                    ? slot
+                    : slot + "/" + config.serverBuildSubdir);
+  for (const string &dir : dirs) {
+    if (access((dir + "/package.json").c_str(), F_OK) != 0)
+      continue;
+    DependencyInstall install = DependencyCache::install(dir);
+    if (!install.ok) {
+      error = "npm install failed in " + dir + ":\n" + install.output + "\n";
+      return false;
+    }
+    saved += install.savedSeconds;
+  }
+  return true;
+}
+
+// Stop the prod services, start them from the slot the link now points at
+// and wait for the client port. Downtime runs from the stop until the port
+// listens again (or the start returned, when there is no port to watch).
+static bool restartProdServices(const AppConfig &config, stringstream &result) {
+  string clientService, serverService;
+  if (!config.clientServiceTemplate.empty())
+    clientService = AppManager::resolveServiceName(
+        config.clientServiceTemplate, config.appId, "prod");
+  if (config.hasServerComponent && !config.serverServiceTemplate.empty())
+    serverService = AppManager::resolveServiceName(
+        config.serverServiceTemplate, config.appId, "prod");
+  string portStr =
+      SettingsTable::getSetting("port_" + config.portKeyClient + "-prod");
+  int port = portStr.empty() ? 0 : stoi(portStr);
+
+  auto downSince = chrono::steady_clock::now();
+  if (!clientService.empty())
+    AppManager::stopService(clientService);
+  if (!serverService.empty())
+    AppManager::stopService(serverService);
+  if (port > 0)
+    AppManager::waitForPortRelease(port);
+
+  if (!serverService.empty()) {
+    AppManager::startService(serverService);
+    result << "  Started " << serverService << "\n";
+  }
+  if (!clientService.empty()) {
+    AppManager::startService(clientService);
+    result << "  Started " << clientService << "\n";
+  }
+
+  bool up = port <= 0 || AppManager::waitForPortListen(port);
+  auto downtimeMs = chrono::duration_cast<chrono::milliseconds>(
+                        chrono::steady_clock::now() - downSince)
+                        .count();
+  if (!up) {
+    result << "  Port " << port << " not listening after "
+           << downtimeMs / 1000 << " s\n";
+    return false;
+  }
+  result << "  Downtime: " << downtimeMs << " ms";
+  if (port > 0)
+    result << " (until port " << port << " listened again)";
+  result << "\n";
+  return true;
+}
+
 CmdResult handleProdStatus(const json &command) {
   if (!command.contains(COMMAND_ARG_APP)) {
     return CmdResult(1, "Missing required argument: --app\n");
@@ -1142,6 +1518,17 @@ CmdResult handleProdStatus(const json &command) {
   commit.erase(commit.find_last_not_of(" \n\r\t") + 1);
   result << "  Commit: " << commit << "\n";
 
+  string live = activeSlot(config.prodPath);
+  if (live.empty()) {
+    result << "  Slots: none yet (created by the next deployToProd)\n";
+  } else {
+    result << "  Slot: " << live << "\n";
+    string standby = slotPath(config.prodPath, otherSlot(live));
+    if (access(standby.c_str(), F_OK) == 0)
+      result << "  Standby: " << otherSlot(live) << " at "
+             << shortHead(standby) << " (rollbackProd switches to it)\n";
+  }
+
   // Check for uncommitted changes
   string statusCmd =
       "cd " + config.prodPath + " && /usr/bin/git status --porcelain 2>&1";
@@ -1234,7 +1621,13 @@ CmdResult handleDeployToProd(const json &command) {
     result << "  Using specified commit: " << commit.substr(0, 7) << "\n";
   }
 
-  // 2. Check prod worktree status - must be clean
+  unique_lock<mutex> switchLock(prodSwitchMutex, try_to_lock);
+  if (!switchLock.owns_lock()) {
+    return CmdResult(1, "Another prod deploy or rollback is running\n");
+  }
+
+  // 2. Check live prod worktree status - must be clean, its changes would
+  // not carry over to the new slot
   string statusCmd =
       "cd " + config.prodPath + " && /usr/bin/git status --porcelain 2>&1";
   string statusOutput = executeCommand(statusCmd.c_str());
@@ -1245,9 +1638,30 @@ CmdResult handleDeployToProd(const json &command) {
                config.prodPath + " status\n");
   }
 
-  // 3. Checkout the commit in prod
-  string checkoutCmd = "cd " + config.prodPath +
-                       " && /usr/bin/git checkout " + commit + " 2>&1";
+  string error;
+  string live = activeSlot(config.prodPath);
+  if (live.empty()) {
+    if (!convertProdToSlots(config.prodPath, error)) {
+      return CmdResult(1, error + "\n");
+    }
+    live = "blue";
+    result << "  Moved prod worktree to slot blue\n";
+  }
+  string idle = otherSlot(live);
+  string idlePath = slotPath(config.prodPath, idle);
+  result << "  Live slot: " << live << " (" << shortHead(config.prodPath)
+         << "), preparing " << idle << "\n";
+
+  // 3. Check out the commit in the idle slot. It only holds the previous
+  // deploy, so anything left there is discarded.
+  string checkoutCmd;
+  if (access(idlePath.c_str(), F_OK) != 0) {
+    checkoutCmd = "/usr/bin/git -C " + config.prodPath +
+                  " worktree add --detach " + idlePath + " " + commit + " 2>&1";
+  } else {
+    checkoutCmd = "cd " + idlePath + " && /usr/bin/git checkout --detach " +
+                  "--force " + commit + " 2>&1 && /usr/bin/git clean -fd 2>&1";
+  }
   string checkoutOutput = executeCommand(checkoutCmd.c_str());
   if (checkoutOutput.find("fatal") != string::npos ||
       checkoutOutput.find("error") != string::npos) {
@@ -1255,54 +1669,89 @@ CmdResult handleDeployToProd(const json &command) {
   }
   result << "  Checkout: OK\n";
 
-  // 4. Rebuild server if app has a buildable server component
+  // 4. Dependencies and server build, while the live slot keeps serving
+  double depsSaved = 0;
+  if (!installSlotDependencies(config, idlePath, error, depsSaved)) {
+    return CmdResult(1, result.str() + error);
+  }
+  char depsNote[48] = "";
+  if (depsSaved > 0)
+    snprintf(depsNote, sizeof(depsNote), " (cache saved %.1fs)", depsSaved);
+  result << "  Dependencies: OK" << depsNote << "\n";
+
   if (config.hasServerComponent && !config.serverBuildSubdir.empty()) {
-    result << "  Rebuilding server...\n";
-    string buildResult = AppManager::buildServerComponent(appId, "prod");
+    result << "  Building server...\n";
+    string buildResult = AppManager::buildCppComponent(
+        idlePath + "/" + config.serverBuildSubdir);
     if (buildResult.find("Build complete") == string::npos) {
       return CmdResult(1, "Build failed:\n" + buildResult);
     }
     result << "  Build: OK\n";
   }
 
-  // 5. Restart prod services
-  result << "  Restarting services...\n";
+  // 5. Switch the link and restart prod services from the new slot
+  if (!pointProdAt(config.prodPath, idle, error)) {
+    return CmdResult(1, error + "\n");
+  }
+  result << "  Switched " << config.prodPath << ": " << live << " -> " << idle
+         << "\n";
+  bool up = restartProdServices(config, result);
+
+  if (!up) {
+    result << "\nDeploy switched, but the app didn't come up. Roll back "
+              "with: d rollbackProd --app "
+           << appId << "\n";
+    return CmdResult(1, result.str());
+  }
+  result << "\nDeploy complete! Previous version kept in slot " << live
+         << ".\n";
+  return CmdResult(0, result.str());
+}
 
-  // Stop first
-  if (!config.clientServiceTemplate.empty()) {
-    string clientService = AppManager::resolveServiceName(
-        config.clientServiceTemplate, appId, "prod");
-    AppManager::stopService(clientService);
+CmdResult handleRollbackProd(const json &command) {
+  if (!command.contains(COMMAND_ARG_APP)) {
+    return CmdResult(1, "Missing required argument: --app\n");
   }
-  if (config.hasServerComponent && !config.serverServiceTemplate.empty()) {
-    string serverService = AppManager::resolveServiceName(
-        config.serverServiceTemplate, appId, "prod");
-    AppManager::stopService(serverService);
+
+  string appId = command[COMMAND_ARG_APP].get<string>();
+  AppConfig config = AppManager::getAppConfig(appId);
+  if (config.appId.empty()) {
+    return CmdResult(1, "Unknown app: " + appId + "\n");
   }
 
-  // Wait for ports
-  string portKey = "port_" + config.portKeyClient + "-prod";
-  string portStr = SettingsTable::getSetting(portKey);
-  if (!portStr.empty()) {
-    AppManager::waitForPortRelease(stoi(portStr));
+  if (config.prodPath.empty()) {
+    return CmdResult(1, "App " + appId + " has no prod path configured\n");
   }
 
-  // Start services
-  if (config.hasServerComponent && !config.serverServiceTemplate.empty()) {
-    string serverService = AppManager::resolveServiceName(
-        config.serverServiceTemplate, appId, "prod");
-    AppManager::startService(serverService);
-    result << "  Started " << serverService << "\n";
+  unique_lock<mutex> switchLock(prodSwitchMutex, try_to_lock);
+  if (!switchLock.owns_lock()) {
+    return CmdResult(1, "Another prod deploy or rollback is running\n");
   }
-  if (!config.clientServiceTemplate.empty()) {
-    string clientService = AppManager::resolveServiceName(
-        config.clientServiceTemplate, appId, "prod");
-    AppManager::startService(clientService);
-    result << "  Started " << clientService << "\n";
+
+  string live = activeSlot(config.prodPath);
+  if (live.empty()) {
+    return CmdResult(1, "No previous prod slot for " + appId +
+                            " (it has not been deployed with slots yet)\n");
+  }
+  string previous = otherSlot(live);
+  string previousPath = slotPath(config.prodPath, previous);
+  if (access(previousPath.c_str(), F_OK) != 0) {
+    return CmdResult(1, "No previous prod slot at " + previousPath + "\n");
   }
 
-  result << "\nDeploy complete!\n";
-  return CmdResult(0, result.str());
+  stringstream result;
+  result << "Rolling back " << appId << " prod...\n";
+  string error;
+  if (!pointProdAt(config.prodPath, previous, error)) {
+    return CmdResult(1, error + "\n");
+  }
+  result << "  Switched " << config.prodPath << ": " << live << " -> "
+         << previous << " (" << shortHead(previousPath) << ")\n";
+  bool up = restartProdServices(config, result);
+
+  result << (up ? "\nRollback complete!\n"
+                : "\nRolled back, but the app didn't come up.\n");
+  return CmdResult(up ? 0 : 1, result.str());
 }
 
 CmdResult handleListExtraApps(const json &) {
@@ -1354,23 +1803,7 @@ CmdResult handleGetAppPeers(const json &command) {
 
   // Worker: forward entire getAppPeers to leader (leader does the probing directly)
   if (!pm.isLeader() && pm.isConnectedToLeader()) {
-    int leaderFd = pm.getLeaderSocket();
-    string msg = command.dump() + "\n";
-    if (write(leaderFd, msg.c_str(), msg.length()) < 0) {
-      return CmdResult(1, "Failed to forward getAppPeers to leader\n");
-    }
-
-    // Read response - may be large, read until we get complete JSON
-    string response;
-    char buffer[8192];
-    while (true) {
-      ssize_t n = read(leaderFd, buffer, sizeof(buffer) - 1);
-      if (n <= 0) break;
-      buffer[n] = '\0';
-      response += buffer;
-      if (response.back() == '\n') break;
-    }
-
+    string response = pm.forwardToLeader(command, 5000);
     if (response.empty()) {
       return CmdResult(1, "No response from leader\n");
     }
@@ -1394,7 +1827,7 @@ CmdResult handleGetAppPeers(const json &command) {
   string localPeerId = pm.getPeerId();
 
   // Read cache snapshot under lock
-  map<string, json> cacheSnapshot;
+  map<string, PeerAppStatus> cacheSnapshot;
   {
     lock_guard<mutex> lock(peerAppStatusMutex);
     cacheSnapshot = peerAppStatusCache;
@@ -1430,8 +1863,9 @@ CmdResult handleGetAppPeers(const json &command) {
     } else {
       // Online remote peer - use cached heartbeat data
       auto cacheIt = cacheSnapshot.find(peer.peer_id);
-      if (cacheIt != cacheSnapshot.end() && cacheIt->second.contains(appId)) {
-        const json &appData = cacheIt->second[appId];
+      if (cacheIt != cacheSnapshot.end() &&
+          cacheIt->second.status.contains(appId)) {
+        const json &appData = cacheIt->second.status[appId];
         peerObj["dev_installed"] = appData.value("dev_installed", false);
         peerObj["prod_installed"] = appData.value("prod_installed", false);
         peerObj["dev_running"] = appData.value("dev_running", false);
@@ -1,10 +1,10 @@
 #include "cmdBrowser.h"
 #include "Constants.h"
+#include "ExtensionRpc.h"
 #include "KeyboardManager.h"
 #include "Types.h"
 #include "Utils.h"
 #include <mutex>
-#include <unistd.h>
 
 using namespace std;
 
@@ -12,14 +12,12 @@ using namespace std;
 extern unsigned int shouldLog;
 extern int g_clientSocket;
 
-// Forward declaration from cmdLogging.cpp
-void setNativeHostSocketForSync(int socket);
+// From cmdLogging.cpp
+void syncLoggingWithBridge();
 
-// Local state for active tab URL and native host
+// Local state for active tab URL
 static std::mutex g_activeTabUrlMutex;
 static std::string g_activeTabUrl = "";
-static int g_nativeHostSocket = -1;
-static std::mutex g_nativeHostSocketMutex;
 
 void setBrowserClientSocket(int socket) {
   // Not needed for current implementation
@@ -32,40 +30,19 @@ std::string getActiveTabUrlFromExtension() {
 }
 
 void triggerChromeChatGPTFocus() {
-  std::lock_guard<std::mutex> lock(g_nativeHostSocketMutex);
-  if (g_nativeHostSocket != -1) {
-    std::string msg =
-        std::string(R"({"action":"focusChatGPT"})") + mustEndWithNewLine;
-    ssize_t written = write(g_nativeHostSocket, msg.c_str(), msg.length());
-    if (written < 0) {
-      logToFile("[Chrome Extension] Write to native host failed (errno=" +
-                    std::to_string(errno) + "). Invalidating socket.",
-                LOG_CHROME);
-      g_nativeHostSocket = -1;
-    } else {
-      logToFile("[Chrome] Sent focus request to native host (fd=" +
-                    std::to_string(g_nativeHostSocket) +
-                    ", written=" + std::to_string(written) + " bytes): " + msg,
-                LOG_CHROME);
-    }
-  } else {
+  if (!ExtensionRpc::isAttached(ExtensionRpc::Channel::Chrome)) {
     logToFile("[Chrome] Cannot focus ChatGPT: native host not registered",
               LOG_CHROME);
+    return;
+  }
+  if (ExtensionRpc::notify(ExtensionRpc::Channel::Chrome,
+                           {{"action", "focusChatGPT"}})) {
+    logToFile("[Chrome] Sent focus request to native host", LOG_CHROME);
   }
 }
 
 bool isNativeHostConnected() {
-  std::lock_guard<std::mutex> lock(g_nativeHostSocketMutex);
-  return g_nativeHostSocket != -1;
-}
-
-static void syncLoggingWithBridge() {
-  std::lock_guard<std::mutex> lock(g_nativeHostSocketMutex);
-  if (g_nativeHostSocket != -1) {
-    std::string msg = std::string(R"({"action":"updateMask","mask":)") +
-                      std::to_string(shouldLog) + "}" + mustEndWithNewLine;
-    write(g_nativeHostSocket, msg.c_str(), msg.length());
-  }
+  return ExtensionRpc::isAttached(ExtensionRpc::Channel::Chrome);
 }
 
 CmdResult handleSetActiveTabUrl(const json &command) {
@@ -80,13 +57,8 @@ CmdResult handleSetActiveTabUrl(const json &command) {
 }
 
 CmdResult handleRegisterNativeHost(const json &) {
-  {
-    std::lock_guard<std::mutex> lock(g_nativeHostSocketMutex);
-    g_nativeHostSocket = g_clientSocket;
-  }
+  ExtensionRpc::attach(ExtensionRpc::Channel::Chrome, g_clientSocket);
   logToFile("[Chrome] Native messaging host registered", LOG_CHROME);
-  // Sync with logging module
-  setNativeHostSocketForSync(g_clientSocket);
   syncLoggingWithBridge();
   return CmdResult(0, std::string(R"({"status":"registered"})") +
                           mustEndWithNewLine);
@@ -27,6 +27,8 @@ CmdResult handleShowDb(const json &) {
   ss << "--- System Settings ---\n";
   ss << "shouldLogState: " << SettingsTable::getSetting("shouldLogState")
      << "\n";
+  ss << "--- Storage ---\n";
+  ss << Storage::getStats();
 
   return CmdResult(0, ss.str());
 }
@@ -1,9 +1,9 @@
 #include "cmdLogging.h"
 #include "Constants.h"
 #include "DatabaseTableManagers.h"
+#include "ExtensionRpc.h"
 #include "KeyboardManager.h"
 #include "Utils.h"
-#include <mutex>
 
 using namespace std;
 
@@ -11,28 +11,15 @@ using namespace std;
 extern unsigned int shouldLog;
 extern int g_clientSocket;
 
-// Local state for syncing with native host
-static std::mutex g_nativeHostSyncMutex;
-static int g_nativeHostSocketForSync = -1;
-
 void setLoggingClientSocket(int socket) {
   // This is used internally - not needed for current implementation
   (void)socket;
 }
 
-static void syncLoggingWithBridge() {
-  std::lock_guard<std::mutex> lock(g_nativeHostSyncMutex);
-  if (g_nativeHostSocketForSync != -1) {
-    std::string msg = std::string(R"({"action":"updateMask","mask":)") +
-                      std::to_string(shouldLog) + "}" + mustEndWithNewLine;
-    write(g_nativeHostSocketForSync, msg.c_str(), msg.length());
-  }
-}
-
-// Called by cmdBrowser when native host registers
-void setNativeHostSocketForSync(int socket) {
-  std::lock_guard<std::mutex> lock(g_nativeHostSyncMutex);
-  g_nativeHostSocketForSync = socket;
+// Pushes the log mask to the Chrome native host (also on its registration)
+void syncLoggingWithBridge() {
+  ExtensionRpc::notify(ExtensionRpc::Channel::Chrome,
+                       {{"action", "updateMask"}, {"mask", shouldLog}});
 }
 
 CmdResult handleShouldLog(const json &command) {
@@ -1,13 +1,22 @@
 #include "cmdPeer.h"
+#include "ArtifactStore.h"
 #include "Constants.h"
 #include "DatabaseTableManagers.h"
 #include "Globals.h"
+#include "ManagerPool.h"
 #include "PeerManager.h"
+#include "ReplyStream.h"
+#include "Replication.h"
 #include "Utils.h"
 #include "Version.h"
 #include <arpa/inet.h>
+#include <cmath>
+#include <chrono>
+#include <cstdio>
 #include <cstring>
+#include <functional>
 #include <netinet/in.h>
+#include <poll.h>
 #include <signal.h>
 #include <sys/select.h>
 #include <sys/socket.h>
@@ -25,64 +34,111 @@ extern string getPrimaryMacAddress();
 // External client socket - set by mainCommand before calling handlers
 extern int g_clientSocket;
 
+// One request/reply exchange with a manager on a pooled connection. The
+// reply always comes as frames so its end is known without a close; output
+// goes to the client's stream if there is one, else into the result.
 CmdResult sendToManager(const string &ip, const json &command) {
-  int sock = socket(AF_INET, SOCK_STREAM, 0);
-  if (sock < 0)
-    return CmdResult(1, "Failed to create socket for manager\n");
-
-  struct sockaddr_in server_addr;
-  server_addr.sin_family = AF_INET;
-  server_addr.sin_port = htons(MANAGER_PORT);
-  if (inet_pton(AF_INET, ip.c_str(), &server_addr.sin_addr) <= 0) {
-    close(sock);
-    return CmdResult(1, "Invalid IP address for manager: " + ip + "\n");
-  }
+  const int REPLY_IDLE_SECS = 300; // Builds can be quiet for minutes
+  ReplyStream *stream = ReplyStream::current();
+  json request = command;
+  request[COMMAND_ARG_STREAM] = true;
+  request["keep_alive"] = true;
+  string msg = request.dump() + "\n";
 
-  // Set timeout
-  struct timeval timeout;
-  timeout.tv_sec = 10;
-  timeout.tv_usec = 0;
-  setsockopt(sock, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
-  timeout.tv_sec = 300; // 5 minute timeout for build
-  setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
-
-  if (connect(sock, (struct sockaddr *)&server_addr, sizeof(server_addr)) < 0) {
-    close(sock);
-    return CmdResult(1, "Failed to connect to manager at " + ip + ":" +
-                            to_string(MANAGER_PORT) + "\n");
-  }
-
-  string msg = command.dump() + "\n";
-  if (send(sock, msg.c_str(), msg.length(), 0) < 0) {
-    close(sock);
-    return CmdResult(1, "Failed to send command to manager at " + ip + "\n");
-  }
-
-  char buffer[65536];
-  memset(buffer, 0, sizeof(buffer));
-  ssize_t n = recv(sock, buffer, sizeof(buffer) - 1, 0);
-  close(sock);
+  string output;
+  ReplyStream::Decoder::Sink sink = [&](const char *data, size_t length) {
+    if (stream)
+      stream->write(data, length);
+    else
+      output.append(data, length);
+  };
+
+  // A pooled connection the manager closed in the meantime fails before any
+  // reply byte; the request was not read then, so retry on a new one
+  for (int attempt = 0; attempt < 2; attempt++) {
+    bool reused = false;
+    string error;
+    int sock = ManagerPool::acquire(ip, reused, error);
+    if (sock < 0)
+      return CmdResult(1, error);
+
+    if (send(sock, msg.c_str(), msg.length(), MSG_NOSIGNAL) !=
+        (ssize_t)msg.length()) {
+      ManagerPool::discard(sock);
+      if (reused)
+        continue;
+      return CmdResult(1, "Failed to send command to manager at " + ip + "\n");
+    }
 
-  if (n <= 0)
-    return CmdResult(1, "No response from manager at " + ip + "\n");
+    ReplyStream::Decoder decoder;
+    bool gotReply = false;
+    char buffer[16384];
+    while (!decoder.done()) {
+      struct pollfd pfd;
+      pfd.fd = sock;
+      pfd.events = POLLIN;
+      int ready = poll(&pfd, 1, REPLY_IDLE_SECS * 1000);
+      if (ready < 0 && errno == EINTR)
+        continue;
+      if (ready <= 0) {
+        error = ready == 0 ? "no output for " + to_string(REPLY_IDLE_SECS) + "s"
+                           : string(strerror(errno));
+        break;
+      }
+      ssize_t n = recv(sock, buffer, sizeof(buffer), 0);
+      if (n < 0 && errno == EINTR)
+        continue;
+      if (n < 0) {
+        error = strerror(errno);
+        break;
+      }
+      if (n == 0) {
+        if (!gotReply && reused)
+          break; // Stale pooled connection; retried below
+        if (!decoder.finish(sink))
+          error = "connection closed before the final status";
+        break;
+      }
+      gotReply = true;
+      decoder.feed(buffer, n, sink);
+      if (stream && !stream->isOpen()) {
+        // Closing the connection makes the manager stop
+        ManagerPool::discard(sock);
+        return CmdResult(1, "Client disconnected\n");
+      }
+    }
 
-  try {
-    json response = json::parse(buffer);
-    int status =
-        response.contains("status") ? response["status"].get<int>() : 1;
-    string output = response.contains("output")
-                        ? response["output"].get<string>()
-                        : string(buffer);
+    if (!gotReply && reused && error.empty()) {
+      ManagerPool::discard(sock);
+      continue;
+    }
+    if (decoder.done() && decoder.reusable())
+      ManagerPool::release(ip, sock);
+    else
+      ManagerPool::discard(sock);
+
+    if (!decoder.done()) {
+      if (!gotReply)
+        return CmdResult(1, "No response from manager at " + ip + "\n");
+      return CmdResult(1, output + "\nManager at " + ip + ": " + error + "\n");
+    }
+    int status = decoder.status();
+    if (stream)
+      return CmdResult(status,
+                       status == 0 ? "" : "[exit " + to_string(status) + "]\n");
     return CmdResult(status, output);
-  } catch (const exception &e) {
-    return CmdResult(0, string(buffer)); // Fallback to raw output
   }
+  return CmdResult(1, "Failed to send command to manager at " + ip + "\n");
 }
 
 // Helper function for workers to query leader for peer IP
 static string queryLeaderForPeerIP(const string &peer_id) {
   PeerManager &pm = PeerManager::getInstance();
 
+  PeerRecord replicated;
+  if (LeaderReplica::isFresh() && LeaderReplica::getPeer(peer_id, replicated))
+    return replicated.ip_address;
+
   if (!pm.isConnectedToLeader()) {
     logToFile("Cannot query leader: not connected", LOG_CORE);
     return "";
@@ -189,6 +245,8 @@ CmdResult handleGetPeerStatus(const json &) {
   if (pm.isLeader()) {
     auto peers = pm.listPeers();
     status["connected_workers"] = (int)peers.size();
+  } else {
+    status["replica"] = LeaderReplica::getStatus();
   }
 
   return CmdResult(0, status.dump(2) + "\n");
@@ -217,7 +275,8 @@ CmdResult handleRegisterPeer(const json &command) {
   PeerTable::upsertPeer(peer_id, ip, mac, hostname, true, daemon_version);
 
   // Register in memory
-  pm.registerPeer(peer_id, ip, mac, hostname, g_clientSocket);
+  pm.registerPeer(peer_id, ip, mac, hostname,
+                  PeerConnection::find(g_clientSocket));
 
   logToFile("Peer registered: " + peer_id + " (" + ip + ")", LOG_CORE);
   return CmdResult(0, "Peer registered: " + peer_id + "\n");
@@ -262,21 +321,11 @@ CmdResult handleListPeers(const json &) {
     p["mac_address"] = peer.mac_address;
     p["hostname"] = peer.hostname;
     p["last_seen"] = peer.last_seen;
-
-    // Derive is_online from last_seen freshness (heartbeat is every 60s)
-    bool online = peer.is_online;
-    if (online && !peer.last_seen.empty()) {
-      // Parse "YYYY-MM-DD HH:MM:SS" and check if within 2 minutes
-      struct tm tm = {};
-      if (strptime(peer.last_seen.c_str(), "%Y-%m-%d %H:%M:%S", &tm)) {
-        time_t lastSeen = mktime(&tm);
-        time_t now = time(nullptr);
-        if (difftime(now, lastSeen) > 120) {
-          online = false;
-        }
-      }
-    }
-    p["is_online"] = online;
+    // From the leader's failure detector: suspect peers have missed
+    // heartbeats but are not yet declared offline
+    p["is_online"] = peer.is_online;
+    p["is_suspect"] = peer.is_suspect;
+    p["phi"] = round(peer.phi * 100) / 100;
     p["daemon_version"] = peer.daemon_version;
     result.push_back(p);
   }
@@ -319,9 +368,13 @@ CmdResult handleGetPeerInfo(const json &command) {
   string peer_id = command[COMMAND_ARG_PEER].get<string>();
 
   PeerManager &pm = PeerManager::getInstance();
+  PeerRecord peer;
 
-  // If we're a worker connected to leader, forward the request
-  if (!pm.isLeader() && pm.isConnectedToLeader()) {
+  // Workers answer from the leader replica while it is current, else
+  // forward the request if connected
+  if (!pm.isLeader() && LeaderReplica::isFresh()) {
+    LeaderReplica::getPeer(peer_id, peer);
+  } else if (!pm.isLeader() && pm.isConnectedToLeader()) {
     json fwdCmd;
     fwdCmd["command"] = COMMAND_GET_PEER_INFO;
     fwdCmd[COMMAND_ARG_PEER] = peer_id;
@@ -331,10 +384,10 @@ CmdResult handleGetPeerInfo(const json &command) {
       return CmdResult(0, response);
     }
     return CmdResult(1, "No response from leader\n");
+  } else {
+    peer = PeerTable::getPeer(peer_id);
   }
 
-  PeerRecord peer = PeerTable::getPeer(peer_id);
-
   if (peer.peer_id.empty()) {
     return CmdResult(1, "Peer not found: " + peer_id + "\n");
   }
@@ -351,6 +404,58 @@ CmdResult handleGetPeerInfo(const json &command) {
   return CmdResult(0, result.dump(2) + "\n");
 }
 
+// Streaming execOnPeer. Uses its own connection to the peer so the frames
+// never mix with other traffic on the shared peer sockets; the peer closes
+// it after the final frame.
+static CmdResult streamExecOnPeer(const string &peer_id, json execRequest,
+                                  ReplyStream &out) {
+  string ip = resolvePeerIP(peer_id);
+  if (ip.empty())
+    return CmdResult(1, "Peer not found or leader unavailable: " + peer_id +
+                            "\n");
+
+  int sock = socket(AF_INET, SOCK_STREAM, 0);
+  if (sock < 0)
+    return CmdResult(1, "Failed to create socket for peer " + peer_id + "\n");
+
+  struct timeval timeout;
+  timeout.tv_sec = 2;
+  timeout.tv_usec = 0;
+  setsockopt(sock, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(PEER_TCP_PORT);
+  if (inet_pton(AF_INET, ip.c_str(), &addr.sin_addr) <= 0 ||
+      connect(sock, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+    close(sock);
+    return CmdResult(1, "Failed to connect to peer: " + peer_id + " (" + ip +
+                            ")\n");
+  }
+
+  execRequest[COMMAND_ARG_STREAM] = true;
+  string msg = execRequest.dump() + "\n";
+  if (send(sock, msg.c_str(), msg.length(), MSG_NOSIGNAL) < 0) {
+    close(sock);
+    return CmdResult(1, "Failed to send command to peer: " + peer_id + "\n");
+  }
+
+  logToFile("Streaming exec request to " + peer_id + ": cd " +
+                execRequest[COMMAND_ARG_DIRECTORY].get<string>() + " && " +
+                execRequest[COMMAND_ARG_SHELL_CMD].get<string>(),
+            LOG_CORE);
+
+  int status = 1;
+  string error;
+  bool ok = ReplyStream::relay(sock, out, 120, status, error);
+  close(sock);
+  if (!ok)
+    return CmdResult(1, "\n" + peer_id + ": " + error + "\n");
+  return CmdResult(status,
+                   status == 0 ? "" : "[exit " + to_string(status) + "]\n");
+}
+
 CmdResult handleExecOnPeer(const json &command) {
   string peer_id = command[COMMAND_ARG_PEER].get<string>();
   string directory = command[COMMAND_ARG_DIRECTORY].get<string>();
@@ -364,10 +469,13 @@ CmdResult handleExecOnPeer(const json &command) {
   execRequest[COMMAND_ARG_DIRECTORY] = directory;
   execRequest[COMMAND_ARG_SHELL_CMD] = cmd;
 
+  if (ReplyStream *stream = ReplyStream::current())
+    return streamExecOnPeer(peer_id, execRequest, *stream);
+
   for (int attempt = 0; attempt < 2; ++attempt) {
     // Check if peer is already connected in memory
     PeerInfo peer = pm.getPeerInfo(peer_id);
-    if (peer.peer_id.empty() || peer.socket_fd < 0) {
+    if (peer.peer_id.empty() || !peer.connection) {
       // Not connected - need to find IP and connect on-demand
       string ip;
 
@@ -425,13 +533,13 @@ CmdResult handleExecOnPeer(const json &command) {
     struct timeval timeout;
     timeout.tv_sec = 120; // 2 minute timeout for command execution
     timeout.tv_usec = 0;
-    setsockopt(peer.socket_fd, SOL_SOCKET, SO_RCVTIMEO, &timeout,
+    setsockopt(peer.connection->fd(), SOL_SOCKET, SO_RCVTIMEO, &timeout,
                sizeof(timeout));
 
     // Read response
     char buffer[65536];
     memset(buffer, 0, sizeof(buffer));
-    ssize_t n = read(peer.socket_fd, buffer, sizeof(buffer) - 1);
+    ssize_t n = read(peer.connection->fd(), buffer, sizeof(buffer) - 1);
     if (n <= 0) {
       // Clear from map if it was a connection error (not timeout)
       if (n == 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) {
@@ -456,26 +564,335 @@ CmdResult handleExecOnPeer(const json &command) {
   return CmdResult(1, "Unknown error in handleExecOnPeer\n");
 }
 
-// Execute a command in a forked process to avoid blocking the daemon
-// Returns output via pipe, with timeout protection
-static string executeCommandWithTimeout(const string &full_cmd, int timeout_sec,
-                                        int &exit_code) {
+namespace {
+
+// One target of execOnPeers
+struct FanoutTarget {
+  string peer_id;
+  string ip;
+  int fd = -1;
+  bool connected = false;
+  string request; // Bytes still to send
+  ReplyStream::Decoder decoder;
+  string output;
+  bool truncated = false;
+  string error; // Set when the peer failed before its final status
+  bool finished = false;
+  double seconds = 0;
+};
+
+// peer_id -> ip for the peers named in spec ("all": every online peer)
+vector<pair<string, string>> resolveFanoutTargets(const string &spec,
+                                                  string &error) {
+  json peers;
+  try {
+    peers = json::parse(handleListPeers(json()).message);
+  } catch (...) {
+    error = "Could not get the peer list\n";
+    return {};
+  }
+  if (!peers.is_array()) {
+    error = "Could not get the peer list\n";
+    return {};
+  }
+
+  vector<pair<string, string>> targets;
+  if (spec == "all") {
+    for (const auto &peer : peers) {
+      if (peer.value("is_online", false))
+        targets.push_back({peer.value("peer_id", ""),
+                           peer.value("ip_address", "")});
+    }
+    return targets;
+  }
+
+  size_t start = 0;
+  while (start <= spec.size()) {
+    size_t comma = spec.find(',', start);
+    if (comma == string::npos)
+      comma = spec.size();
+    string id = spec.substr(start, comma - start);
+    start = comma + 1;
+    if (id.empty())
+      continue;
+    string ip;
+    for (const auto &peer : peers) {
+      if (peer.value("peer_id", "") == id)
+        ip = peer.value("ip_address", "");
+    }
+    targets.push_back({id, ip}); // Empty ip reported as not found
+  }
+  return targets;
+}
+
+void startFanoutTarget(FanoutTarget &target) {
+  if (target.ip.empty()) {
+    target.error = "peer not found";
+    return;
+  }
+  target.fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+  if (target.fd < 0) {
+    target.error = string("socket: ") + strerror(errno);
+    return;
+  }
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(PEER_TCP_PORT);
+  if (inet_pton(AF_INET, target.ip.c_str(), &addr.sin_addr) <= 0) {
+    target.error = "invalid address " + target.ip;
+    return;
+  }
+  if (connect(target.fd, (struct sockaddr *)&addr, sizeof(addr)) == 0)
+    target.connected = true;
+  else if (errno != EINPROGRESS)
+    target.error = string("connect: ") + strerror(errno);
+}
+
+// Advance one target after poll() reported events on its socket
+void serviceFanoutTarget(FanoutTarget &target, short revents) {
+  if (!target.connected) {
+    int err = 0;
+    socklen_t len = sizeof(err);
+    getsockopt(target.fd, SOL_SOCKET, SO_ERROR, &err, &len);
+    if (err != 0) {
+      target.error = string("connect: ") + strerror(err);
+      return;
+    }
+    target.connected = true;
+  }
+
+  if (!target.request.empty()) {
+    ssize_t sent = send(target.fd, target.request.data(),
+                        target.request.size(), MSG_NOSIGNAL);
+    if (sent < 0 && errno != EAGAIN && errno != EINTR) {
+      target.error = string("send: ") + strerror(errno);
+      return;
+    }
+    if (sent > 0)
+      target.request.erase(0, sent);
+    return;
+  }
+
+  if (!(revents & (POLLIN | POLLHUP | POLLERR)))
+    return;
+  ReplyStream::Decoder::Sink collect = [&target](const char *data,
+                                                 size_t length) {
+    size_t room = EXEC_ON_PEERS_MAX_OUTPUT - target.output.size();
+    if (length > room)
+      target.truncated = true;
+    target.output.append(data, min(length, room));
+  };
+  char buffer[16384];
+  ssize_t n = read(target.fd, buffer, sizeof(buffer));
+  if (n < 0 && (errno == EAGAIN || errno == EINTR))
+    return;
+  if (n < 0) {
+    target.error = string("read: ") + strerror(errno);
+    return;
+  }
+  if (n == 0) {
+    if (!target.decoder.finish(collect))
+      target.error = "connection closed before the final status";
+    return;
+  }
+  target.decoder.feed(buffer, n, collect);
+}
+
+string formatFanoutResult(const FanoutTarget &target) {
+  char seconds[32];
+  snprintf(seconds, sizeof(seconds), "%.1fs", target.seconds);
+  string block = "[" + target.peer_id + "] ";
+  if (!target.error.empty())
+    return block + "FAILED: " + target.error + " (" + seconds + ")\n";
+  block += "exit " + to_string(target.decoder.status()) + " (" + seconds +
+           ")\n" + target.output;
+  if (!target.output.empty() && target.output.back() != '\n')
+    block += "\n";
+  if (target.truncated)
+    block += "[output truncated]\n";
+  return block;
+}
+
+} // namespace
+
+CmdResult handleExecOnPeers(const json &command) {
+  string spec = command[COMMAND_ARG_PEERS].get<string>();
+  int timeoutSecs = EXEC_ON_PEERS_TIMEOUT_SECS;
+  if (command.contains(COMMAND_ARG_TIMEOUT)) {
+    const json &value = command[COMMAND_ARG_TIMEOUT];
+    try {
+      timeoutSecs = value.is_number() ? value.get<int>()
+                                      : stoi(value.get<string>());
+    } catch (...) {
+      timeoutSecs = 0;
+    }
+    if (timeoutSecs <= 0)
+      return CmdResult(1, "Invalid --timeout\n");
+  }
+
+  string error;
+  vector<pair<string, string>> resolved = resolveFanoutTargets(spec, error);
+  if (!error.empty())
+    return CmdResult(1, error);
+  if (resolved.empty())
+    return CmdResult(1, "No peers matched: " + spec + "\n");
+
+  json execRequest;
+  execRequest["command"] = COMMAND_EXEC_REQUEST;
+  execRequest[COMMAND_ARG_DIRECTORY] = command[COMMAND_ARG_DIRECTORY];
+  execRequest[COMMAND_ARG_SHELL_CMD] = command[COMMAND_ARG_SHELL_CMD];
+  execRequest[COMMAND_ARG_STREAM] = true; // Frames carry the exit status
+  string request = execRequest.dump() + "\n";
+
+  // Results go to the client as each peer finishes when it can stream
+  ReplyStream *stream = ReplyStream::current();
+  string collected;
+  auto emit = [&](const string &text) {
+    if (stream)
+      stream->write(text);
+    else
+      collected += text;
+  };
+
+  auto began = chrono::steady_clock::now();
+  auto deadline = began + chrono::seconds(timeoutSecs);
+  vector<FanoutTarget> targets(resolved.size());
+  size_t pending = 0;
+
+  auto finish = [&](FanoutTarget &target) {
+    if (target.fd >= 0)
+      close(target.fd);
+    target.fd = -1;
+    target.finished = true;
+    target.seconds =
+        chrono::duration<double>(chrono::steady_clock::now() - began).count();
+    pending--;
+    emit(formatFanoutResult(target));
+  };
+
+  for (size_t i = 0; i < resolved.size(); i++) {
+    FanoutTarget &target = targets[i];
+    target.peer_id = resolved[i].first;
+    target.ip = resolved[i].second;
+    target.request = request;
+    pending++;
+    startFanoutTarget(target);
+    if (!target.error.empty())
+      finish(target);
+  }
+  logToFile("execOnPeers: dispatched to " + to_string(pending) + " peers",
+            LOG_CORE);
+
+  while (pending > 0) {
+    if (stream && !stream->isOpen())
+      break; // Client gone; closing the sockets stops the peers' commands
+
+    auto now = chrono::steady_clock::now();
+    if (now >= deadline) {
+      for (auto &target : targets) {
+        if (!target.finished) {
+          target.error = "timed out after " + to_string(timeoutSecs) + "s";
+          finish(target);
+        }
+      }
+      break;
+    }
+
+    vector<struct pollfd> pfds;
+    vector<FanoutTarget *> polled;
+    for (auto &target : targets) {
+      if (target.finished)
+        continue;
+      struct pollfd pfd;
+      pfd.fd = target.fd;
+      pfd.events = (!target.connected || !target.request.empty()) ? POLLOUT
+                                                                  : POLLIN;
+      pfd.revents = 0;
+      pfds.push_back(pfd);
+      polled.push_back(&target);
+    }
+    int waitMs = (int)chrono::duration_cast<chrono::milliseconds>(deadline -
+                                                                   now)
+                     .count();
+    int ready = poll(pfds.data(), pfds.size(), min(waitMs, 1000));
+    if (ready < 0 && errno != EINTR) {
+      error = strerror(errno);
+      break;
+    }
+    for (size_t i = 0; ready > 0 && i < pfds.size(); i++) {
+      if (!pfds[i].revents)
+        continue;
+      FanoutTarget &target = *polled[i];
+      serviceFanoutTarget(target, pfds[i].revents);
+      if (!target.error.empty() || target.decoder.done())
+        finish(target);
+    }
+  }
+
+  // Abandoned targets (client gone or poll failure)
+  for (auto &target : targets) {
+    if (target.fd >= 0)
+      close(target.fd);
+  }
+
+  int succeeded = 0, failed = 0;
+  const FanoutTarget *slowest = nullptr;
+  for (const auto &target : targets) {
+    if (!target.finished)
+      continue;
+    if (target.error.empty() && target.decoder.status() == 0)
+      succeeded++;
+    else
+      failed++;
+    if (!slowest || target.seconds > slowest->seconds)
+      slowest = &target;
+  }
+  double total =
+      chrono::duration<double>(chrono::steady_clock::now() - began).count();
+  char summary[256];
+  snprintf(summary, sizeof(summary),
+           "execOnPeers: %d/%zu succeeded, %d failed in %.1fs", succeeded,
+           targets.size(), failed, total);
+  string tail = summary;
+  if (slowest)
+    tail += " (slowest: " + slowest->peer_id + ")";
+  if (!error.empty())
+    tail += " - aborted: " + error;
+  tail += "\n";
+  logToFile(tail, LOG_CORE);
+
+  int status = (failed == 0 && succeeded == (int)targets.size()) ? 0 : 1;
+  if (stream)
+    return CmdResult(status, tail);
+  return CmdResult(status, collected + tail);
+}
+
+// Execute a command in a forked process to avoid blocking the daemon.
+// Output is handed to onOutput as it is read; returning false from it kills
+// the command (the requester went away). Returns the exit code.
+static int runCommandWithTimeout(
+    const string &full_cmd, int timeout_sec,
+    const function<bool(const char *, size_t)> &onOutput) {
   int pipefd[2];
   if (pipe(pipefd) == -1) {
-    exit_code = 1;
-    return "Failed to create pipe: " + string(strerror(errno));
+    string error = "Failed to create pipe: " + string(strerror(errno));
+    onOutput(error.data(), error.size());
+    return 1;
   }
 
   pid_t pid = fork();
   if (pid == -1) {
     close(pipefd[0]);
     close(pipefd[1]);
-    exit_code = 1;
-    return "Failed to fork: " + string(strerror(errno));
+    string error = "Failed to fork: " + string(strerror(errno));
+    onOutput(error.data(), error.size());
+    return 1;
   }
 
   if (pid == 0) {
-    // Child process
+    // Child process, in its own group so a kill reaches what sh spawns
+    setpgid(0, 0);
     close(pipefd[0]); // Close read end
     dup2(pipefd[1], STDOUT_FILENO);
     dup2(pipefd[1], STDERR_FILENO);
@@ -486,12 +903,12 @@ static string executeCommandWithTimeout(const string &full_cmd, int timeout_sec,
     _exit(127); // exec failed
   }
 
-  // Parent process
+  // Parent process; set the group here too, so it exists before any kill
+  setpgid(pid, pid);
   close(pipefd[1]); // Close write end
 
   // Set read timeout using select
-  string output;
-  char buffer[256];
+  char buffer[4096];
   fd_set readfds;
   struct timeval tv;
   time_t start_time = time(nullptr);
@@ -503,14 +920,8 @@ static string executeCommandWithTimeout(const string &full_cmd, int timeout_sec,
     // Calculate remaining timeout
     int elapsed = time(nullptr) - start_time;
     int remaining = timeout_sec - elapsed;
-    if (remaining <= 0) {
-      // Timeout - kill the child
-      kill(pid, SIGKILL);
-      waitpid(pid, nullptr, 0);
-      close(pipefd[0]);
-      exit_code = 124; // timeout exit code
-      return output + "\n[TIMEOUT after " + to_string(timeout_sec) + "s]";
-    }
+    if (remaining <= 0)
+      break;
 
     tv.tv_sec = remaining;
     tv.tv_usec = 0;
@@ -521,30 +932,32 @@ static string executeCommandWithTimeout(const string &full_cmd, int timeout_sec,
         continue;
       break;
     }
-    if (ret == 0) {
-      // Timeout
-      kill(pid, SIGKILL);
+    if (ret == 0)
+      break; // Timeout
+
+    ssize_t n = read(pipefd[0], buffer, sizeof(buffer));
+    if (n <= 0) {
+      // EOF: the command finished
+      close(pipefd[0]);
+      int status;
+      waitpid(pid, &status, 0);
+      return WIFEXITED(status) ? WEXITSTATUS(status) : 1;
+    }
+    if (!onOutput(buffer, n)) {
+      kill(-pid, SIGKILL);
       waitpid(pid, nullptr, 0);
       close(pipefd[0]);
-      exit_code = 124;
-      return output + "\n[TIMEOUT after " + to_string(timeout_sec) + "s]";
+      return 1;
     }
-
-    ssize_t n = read(pipefd[0], buffer, sizeof(buffer) - 1);
-    if (n <= 0)
-      break;
-    buffer[n] = '\0';
-    output += buffer;
   }
 
+  // Timeout or select failure - kill the child and everything it started
+  kill(-pid, SIGKILL);
+  waitpid(pid, nullptr, 0);
   close(pipefd[0]);
-
-  // Wait for child and get exit code
-  int status;
-  waitpid(pid, &status, 0);
-  exit_code = WIFEXITED(status) ? WEXITSTATUS(status) : 1;
-
-  return output;
+  string notice = "\n[TIMEOUT after " + to_string(timeout_sec) + "s]";
+  onOutput(notice.data(), notice.size());
+  return 124; // timeout exit code
 }
 
 CmdResult handleExecRequest(const json &command) {
@@ -570,13 +983,29 @@ CmdResult handleExecRequest(const json &command) {
 
   logToFile("Executing: " + full_cmd, LOG_CORE);
 
+  // Stream frames back when the requester asked for them and is still
+  // connected to this thread
+  ReplyStream *stream = ReplyStream::current();
+  bool streaming = stream && command.value(COMMAND_ARG_STREAM, false);
+
   // Execute with 60 second timeout to prevent hangs
-  int exit_code = 0;
-  string output = executeCommandWithTimeout(full_cmd, 60, exit_code);
+  string output;
+  int exit_code = runCommandWithTimeout(
+      full_cmd, 60, [&](const char *data, size_t length) {
+        if (!streaming) {
+          output.append(data, length);
+          return true;
+        }
+        return stream->write(ReplyStream::outputFrame(data, length));
+      });
 
   logToFile("Command completed with exit code " + to_string(exit_code),
             LOG_CORE);
 
+  if (streaming) {
+    stream->write(ReplyStream::endFrame(exit_code));
+    return CmdResult(exit_code, "");
+  }
   return CmdResult(exit_code, output);
 }
 
@@ -608,11 +1037,114 @@ CmdResult handleRemoteDeployDaemon(const json &command) {
 
   logToFile("Directing deploy request to manager at " + ip, LOG_CORE);
 
+  ReplyStream *stream = ReplyStream::current();
+  string notes;
+  ArtifactStore::Progress progress = [&](const string &line) {
+    if (stream)
+      stream->write(line);
+    else
+      notes += line;
+  };
+
   // Send single 'deploy' command to manager
   json mgrCmd;
   mgrCmd["command"] = "deploy";
 
-  return sendToManager(ip, mgrCmd);
+  // Build here once per commit; the target installs this binary when its
+  // checkout, architecture and libraries match, and builds itself otherwise
+  Artifact artifact;
+  string error;
+  string source = getWgInterfaceIP();
+  if (source.empty()) {
+    progress("No WireGuard address to serve an artifact from; " + peer_id +
+             " builds locally\n");
+  } else if (!ArtifactStore::ensureForHead(artifact, error, progress)) {
+    progress("No artifact (" + error + "); " + peer_id + " builds locally\n");
+  } else {
+    mgrCmd["artifact"] = {{COMMAND_ARG_SHA256, artifact.sha256},
+                          {COMMAND_ARG_SIZE, artifact.size},
+                          {"commit", artifact.commit},
+                          {"arch", artifact.arch},
+                          {COMMAND_ARG_SOURCE, source},
+                          {COMMAND_ARG_SOURCE_PORT, PEER_TCP_PORT}};
+  }
+
+  CmdResult result = sendToManager(ip, mgrCmd);
+  result.message = notes + result.message;
+  return result;
+}
+
+// Leader: bring a worker's replica up to date (changes or a snapshot)
+CmdResult handleReplicaSync(const json &command) {
+  if (!PeerManager::getInstance().isLeader())
+    return CmdResult(1, "This daemon is not the leader.\n");
+  json reply = ReplicationLog::sync(command.value("epoch", uint64_t(0)),
+                                    command.value("since", uint64_t(0)));
+  if (reply.is_null())
+    return CmdResult(1, "Replication unavailable (no settings cache)\n");
+  return CmdResult(0, reply.dump());
+}
+
+// Worker: changes pushed by the leader. One-way, nothing is replied.
+CmdResult handleReplicaChanges(const json &command) {
+  LeaderReplica::applyPush(command);
+  return CmdResult(0, "");
+}
+
+// Run by the target's manager during deploy: download an artifact from the
+// daemon that built it. Progress is only logged; the reply is one line.
+CmdResult handleFetchArtifact(const json &command) {
+  string sha256 = command[COMMAND_ARG_SHA256].get<string>();
+  string source = command[COMMAND_ARG_SOURCE].get<string>();
+  uint64_t size = command[COMMAND_ARG_SIZE].is_string()
+                      ? stoull(command[COMMAND_ARG_SIZE].get<string>())
+                      : command[COMMAND_ARG_SIZE].get<uint64_t>();
+  // Given by the origin, so daemons on one host with their own ports work
+  int port = PEER_TCP_PORT;
+  if (command.contains(COMMAND_ARG_SOURCE_PORT)) {
+    const json &value = command[COMMAND_ARG_SOURCE_PORT];
+    port = value.is_string() ? stoi(value.get<string>()) : value.get<int>();
+    if (port <= 0 || port > 65535)
+      return CmdResult(1, "Invalid " + string(COMMAND_ARG_SOURCE_PORT) +
+                              ": " + to_string(port) + "\n");
+  }
+
+  string summary;
+  string error;
+  ArtifactStore::Progress progress = [&](const string &line) {
+    summary += line;
+  };
+  if (!ArtifactStore::fetch(source, port, sha256, size, error, progress)) {
+    logToFile("fetchArtifact " + sha256 + " from " + source + ":" +
+                  to_string(port) + ": " + error,
+              LOG_CORE);
+    return CmdResult(1, "Fetch failed: " + error + "\n");
+  }
+  logToFile("fetchArtifact: " + summary, LOG_CORE);
+  return CmdResult(0, summary.empty() ? "ok\n" : summary);
+}
+
+// Peer port: stream a stored artifact from an offset as output frames
+CmdResult handleServeArtifact(const json &command) {
+  ReplyStream *stream = ReplyStream::current();
+  if (!stream || !command.value(COMMAND_ARG_STREAM, false))
+    return CmdResult(1, "serveArtifact only replies as a stream\n");
+  string sha256 = command[COMMAND_ARG_SHA256].get<string>();
+  uint64_t offset = command.value(COMMAND_ARG_OFFSET, uint64_t(0));
+  return CmdResult(ArtifactStore::serve(sha256, offset, *stream), "");
+}
+
+CmdResult handleListArtifacts(const json &) {
+  ordered_json result = ordered_json::array();
+  for (const Artifact &artifact : ArtifactStore::list()) {
+    ordered_json entry;
+    entry["commit"] = artifact.commit;
+    entry["sha256"] = artifact.sha256;
+    entry["size"] = artifact.size;
+    entry["arch"] = artifact.arch;
+    result.push_back(entry);
+  }
+  return CmdResult(0, result.dump(2) + "\n");
 }
 
 CmdResult handleDbSanityCheck(const json &) {
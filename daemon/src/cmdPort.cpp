@@ -3,12 +3,17 @@
 #include "DatabaseTableManagers.h"
 #include "Globals.h"
 #include "PeerManager.h"
+#include "PortRegistry.h"
+#include "Replication.h"
 #include "Utils.h"
 #include <algorithm>
 #include <arpa/inet.h>
 #include <cstring>
+#include <filesystem>
 #include <fstream>
 #include <iomanip>
+#include <map>
+#include <mutex>
 #include <netinet/in.h>
 #include <sstream>
 #include <sys/socket.h>
@@ -39,23 +44,79 @@ static CmdResult forwardToLeader(const json &cmd, const string &cmdName) {
     }
   }
 
-  int leaderFd = pm.getLeaderSocket();
-  string msg = cmd.dump() + "\n";
-  if (write(leaderFd, msg.c_str(), msg.length()) < 0) {
-    return CmdResult(1, "Failed to forward " + cmdName + " to leader\n");
+  string response = pm.forwardToLeader(cmd);
+  if (!response.empty()) {
+    return CmdResult(0, response);
   }
+  return CmdResult(1, "No response from leader\n");
+}
+
+// Workers answer reads from the leader replica while it is current
+static bool readFromReplica() {
+  return !PeerManager::getInstance().isLeader() && LeaderReplica::isFresh();
+}
+
+static std::string firstLine(const std::filesystem::path &file) {
+  std::ifstream in(file);
+  std::string line;
+  std::getline(in, line);
+  line.erase(line.find_last_not_of(" \n\r\t") + 1);
+  return line;
+}
 
-  // Read response from leader
-  char buffer[8192];
-  memset(buffer, 0, sizeof(buffer));
-  ssize_t n = read(leaderFd, buffer, sizeof(buffer) - 1);
-  if (n > 0) {
-    return CmdResult(0, string(buffer));
+// Commit the checkout at path has checked out, read from its .git files
+// (worktrees and packed refs included) without running git
+static std::string readGitHead(const std::string &path) {
+  namespace fs = std::filesystem;
+  fs::path gitDir = fs::path(path) / ".git";
+  std::error_code ec;
+  if (fs::is_regular_file(gitDir, ec)) { // Worktree: "gitdir: <dir>"
+    std::string line = firstLine(gitDir);
+    if (line.compare(0, 8, "gitdir: ") != 0)
+      return "";
+    fs::path dir = line.substr(8);
+    gitDir = dir.is_absolute() ? dir : fs::path(path) / dir;
   }
-  return CmdResult(1, "No response from leader\n");
+  std::string head = firstLine(gitDir / "HEAD");
+  if (head.compare(0, 5, "ref: ") != 0)
+    return head; // Detached
+  std::string ref = head.substr(5);
+
+  fs::path commonDir = gitDir; // Branches live in the main repository
+  std::string common = firstLine(gitDir / "commondir");
+  if (!common.empty())
+    commonDir = fs::path(common).is_absolute() ? fs::path(common)
+                                               : gitDir / common;
+  std::string hash = firstLine(commonDir / ref);
+  if (!hash.empty())
+    return hash;
+  std::ifstream packed(commonDir / "packed-refs");
+  std::string line;
+  while (std::getline(packed, line)) {
+    // "<hash> <ref>"
+    if (line.size() == 41 + ref.size() && line.compare(41, ref.npos, ref) == 0)
+      return line.substr(0, 40);
+  }
+  return "";
 }
 
+// "hash - subject" of the checkout at path. git only runs when HEAD moved
+// since the last listing.
 static std::string getGitVersion(const std::string &path) {
+  static std::mutex versionMutex;
+  static std::map<std::string, std::pair<std::string, std::string>> versions;
+
+  std::string head = readGitHead(path);
+  if (head.empty()) {
+    return "N/A";
+  }
+  {
+    std::lock_guard<std::mutex> lock(versionMutex);
+    auto it = versions.find(path);
+    if (it != versions.end() && it->second.first == head)
+      return it->second.second;
+  }
+
   std::string cmdHash = "git -C " + path + " rev-parse --short HEAD";
   std::string hash = executeCommand(cmdHash.c_str());
 
@@ -72,10 +133,21 @@ static std::string getGitVersion(const std::string &path) {
   if (!msg.empty() && msg.back() == '\n')
     msg.pop_back();
 
-  return hash + " - " + msg;
+  std::string version = hash + " - " + msg;
+  std::lock_guard<std::mutex> lock(versionMutex);
+  versions[path] = {head, version};
+  return version;
 }
 
 CmdResult handleGetPort(const json &command) {
+  if (readFromReplica()) {
+    string key = command[COMMAND_ARG_KEY].get<string>();
+    string value;
+    if (!LeaderReplica::getSetting("port_" + key, value) || value.empty())
+      return CmdResult(1, "Port not set for " + key + "\n");
+    return CmdResult(0, value + "\n");
+  }
+
   // Forward to leader if we're a worker
   json fwdCmd = command;
   fwdCmd["command"] = COMMAND_GET_PORT;
@@ -95,11 +167,16 @@ CmdResult handleGetPort(const json &command) {
 }
 
 CmdResult handleSetPort(const json &command) {
+  PeerManager &pm = PeerManager::getInstance();
+
   // Forward to leader if we're a worker
   json fwdCmd = command;
   fwdCmd["command"] = COMMAND_SET_PORT;
+  fwdCmd[COMMAND_ARG_FROM_PEER] = pm.getPeerId();
   CmdResult fwdResult = forwardToLeader(fwdCmd, "setPort");
   if (fwdResult.status != -1) {
+    if (fwdResult.status == 0)
+      LeaderReplica::sync(); // Read our own write back from the replica
     return fwdResult; // Forwarded successfully or error
   }
 
@@ -113,7 +190,20 @@ CmdResult handleSetPort(const json &command) {
   }
   string portKey = "port_" + key;
   SettingsTable::setSetting(portKey, value);
-  return CmdResult(0, "Port set for " + key + " to " + value + "\n");
+  PortRegistry::lease(key, command.value(COMMAND_ARG_APP, ""),
+                      command.value(COMMAND_ARG_FROM_PEER, pm.getPeerId()));
+
+  string message = "Port set for " + key + " to " + value + "\n";
+  try {
+    for (const string &other : PortRegistry::keysOnPort(stoi(value))) {
+      if (other != key)
+        message += "Warning: port " + value + " is also registered to " +
+                   other + "\n";
+    }
+  } catch (...) {
+    // Not a number; stored as given like before
+  }
+  return CmdResult(0, message);
 }
 
 CmdResult handleDeletePort(const json &command) {
@@ -122,6 +212,8 @@ CmdResult handleDeletePort(const json &command) {
   fwdCmd["command"] = COMMAND_DELETE_PORT;
   CmdResult fwdResult = forwardToLeader(fwdCmd, "deletePort");
   if (fwdResult.status != -1) {
+    if (fwdResult.status == 0)
+      LeaderReplica::sync(); // Read our own write back from the replica
     return fwdResult; // Forwarded successfully or error
   }
 
@@ -135,45 +227,42 @@ CmdResult handleDeletePort(const json &command) {
   return CmdResult(1, "Port entry not found for " + key + "\n");
 }
 
-CmdResult handleListPorts(const json &command) {
-  // Forward to leader if we're a worker
-  json fwdCmd;
-  fwdCmd["command"] = COMMAND_LIST_PORTS;
-  CmdResult fwdResult = forwardToLeader(fwdCmd, "listPorts");
-  if (fwdResult.status != -1) {
-    return fwdResult; // Forwarded successfully or error
-  }
-
-  // We are the leader, handle locally
-  auto allSettings = SettingsTable::getAllSettings();
-  std::vector<std::pair<std::string, int>> ports;
-
+// port_* settings as registry entries, without owners (replica, no
+// registry)
+static std::vector<PortEntry> portsFromSettings(
+    const std::vector<std::pair<std::string, std::string>> &allSettings) {
+  std::vector<PortEntry> ports;
   for (const auto &p : allSettings) {
     if (p.first.find("port_") == 0) {
       try {
-        ports.push_back({p.first.substr(5), std::stoi(p.second)});
+        PortEntry entry;
+        entry.key = p.first.substr(5);
+        entry.port = std::stoi(p.second);
+        ports.push_back(entry);
       } catch (...) {
         // Skip invalid ports
       }
     }
   }
 
-  // Sort by port number (second element of pair)
+  // Sort by port number
   std::sort(ports.begin(), ports.end(),
-            [](const auto &a, const auto &b) { return a.second < b.second; });
+            [](const auto &a, const auto &b) { return a.port < b.port; });
+  return ports;
+}
 
+static std::string formatPortList(const std::vector<PortEntry> &ports) {
   std::stringstream ss;
   ss << "--- Registered Port Mappings ---\n";
   ss << std::left << std::setw(20) << "Key" << std::setw(8) << "Port"
-     << "Version" << "\n";
+     << std::setw(20) << "Owner" << "Version" << "\n";
   ss << std::string(80, '-') << "\n";
 
   if (ports.empty()) {
     ss << "  (No ports registered)\n";
   } else {
     for (const auto &p : ports) {
-      std::string key = p.first;
-      int port = p.second;
+      const std::string &key = p.key;
       std::string repoPath = "";
 
       // Determine repository path based on key
@@ -196,12 +285,36 @@ CmdResult handleListPorts(const json &command) {
         versionInfo = getGitVersion(repoPath);
       }
 
-      ss << std::left << std::setw(20) << key << std::setw(8) << port
-         << versionInfo << "\n";
+      std::string owner = p.app_id.empty() ? "-" : p.app_id;
+      if (!p.peer_id.empty())
+        owner += "@" + p.peer_id;
+
+      ss << std::left << std::setw(20) << key << std::setw(8) << p.port
+         << std::setw(20) << owner << versionInfo << "\n";
     }
   }
 
-  return CmdResult(0, ss.str());
+  return ss.str();
+}
+
+CmdResult handleListPorts(const json &command) {
+  if (readFromReplica())
+    return CmdResult(
+        0, formatPortList(portsFromSettings(LeaderReplica::getAllSettings())));
+
+  // Forward to leader if we're a worker
+  json fwdCmd;
+  fwdCmd["command"] = COMMAND_LIST_PORTS;
+  CmdResult fwdResult = forwardToLeader(fwdCmd, "listPorts");
+  if (fwdResult.status != -1) {
+    return fwdResult; // Forwarded successfully or error
+  }
+
+  // We are the leader, handle locally
+  if (PortRegistry::isLoaded())
+    return CmdResult(0, formatPortList(PortRegistry::list()));
+  return CmdResult(
+      0, formatPortList(portsFromSettings(SettingsTable::getAllSettings())));
 }
 
 CmdResult handlePublicTransportationStartProxy(const json &) {
@@ -1,6 +1,9 @@
 #include "cmdSystem.h"
 #include "Constants.h"
 #include "Globals.h"
+#include "NotifyChannel.h"
+#include "ServiceWatcher.h"
+#include "StartupTracer.h"
 #include "Utils.h"
 #include "main.h"
 #include <sstream>
@@ -18,13 +21,19 @@ static const string HELP_MESSAGE =
     "COMMON COMMANDS\n"
     "  ping                    Check daemon is running (returns 'pong')\n"
     "  help, --help            Show this help message\n"
-    "  listCommands            List all available commands\n\n"
+    "  listCommands            List all available commands\n"
+    "  startupTrace            Show how long each startup phase took\n"
+    "  notifyStats             Show one-way notification counters\n"
+    "  serviceStats            Show the watched systemd unit states\n\n"
     "KEYBOARD/INPUT\n"
     "  enableKeyboard          Enable keyboard input grabbing\n"
     "  disableKeyboard         Disable keyboard input grabbing\n"
     "  getKeyboardEnabled      Check if keyboard is enabled\n"
     "  simulateInput           Simulate input events or type text\n"
     "                          --string \"text\" OR --type --code --value\n\n"
+    "TERMINAL\n"
+    "  cdJump --query <terms>  cd to the most frecent history dir matching\n"
+    "                          all terms [--pwd <dir>] (excluded)\n\n"
     "PORT MANAGEMENT\n"
     "  listPorts               List all port assignments\n"
     "  getPort --key <app>     Get assigned port for an app\n"
@@ -75,6 +84,18 @@ CmdResult handleHelp(const json &) { return CmdResult(0, HELP_MESSAGE); }
 
 CmdResult handlePing(const json &) { return CmdResult(0, "pong\n"); }
 
+CmdResult handleStartupTrace(const json &) {
+  return CmdResult(0, StartupTracer::report());
+}
+
+CmdResult handleNotifyStats(const json &) {
+  return CmdResult(0, NotifyChannel::getStats());
+}
+
+CmdResult handleServiceStats(const json &) {
+  return CmdResult(0, ServiceWatcher::getStats());
+}
+
 CmdResult handleQuit(const json &) {
   running = 0; // Signal the daemon to shut down
   return CmdResult(0, "Shutting down daemon.\n");
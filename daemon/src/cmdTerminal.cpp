@@ -1,7 +1,10 @@
 #include "cmdTerminal.h"
 #include "Constants.h"
 #include "DatabaseTableManagers.h"
-#include "MySQLManager.h"
+#include "DirHistory.h"
+#include "DirJumpIndex.h"
+#include "StorageBackend.h"
+#include "WriteBehindQueue.h"
 #include "terminal.h"
 #include <sstream>
 
@@ -27,6 +30,10 @@ CmdResult handleCdBackward(const json &command) {
   return Terminal::cdBackward(command);
 }
 
+CmdResult handleCdJump(const json &command) {
+  return Terminal::cdJump(command);
+}
+
 CmdResult handleShowTerminalInstance(const json &command) {
   return Terminal::showTerminalInstance(command);
 }
@@ -58,12 +65,16 @@ CmdResult handlePrintDirHistory(const json &) {
     }
   }
 
+  ss << "\n--- Jump Index ---\n" << DirJumpIndex::getStats();
+
   ss << "\n--- Last Touched Directory ---\n";
-  string lastTouchedIndex =
-      SettingsTable::getSetting(INDEX_OF_LAST_TOUCHED_DIR_KEY);
-  if (!lastTouchedIndex.empty()) {
-    ss << "  Index: " << lastTouchedIndex
-       << " (lookup disabled due to per-TTY schema)\n";
+  int lastTouchedIndex = DirHistory::lastTouched();
+  if (lastTouchedIndex >= 0) {
+    string path;
+    ss << "  Index: " << lastTouchedIndex;
+    if (DirHistory::get(lastTouchedIndex, path))
+      ss << ": " << path;
+    ss << "\n";
   } else {
     ss << "No last touched directory recorded.\n";
   }
@@ -72,7 +83,9 @@ CmdResult handlePrintDirHistory(const json &) {
 }
 
 CmdResult handleEmptyDirHistoryTable(const json &) {
-  MySQLManager::emptyTable("terminal_history");
+  WriteBehindQueue::discardHistory();
+  Storage::emptyTable("terminal_history");
+  DirHistory::clear();
   return CmdResult(0, "terminal_history table emptied.\n");
 }
 
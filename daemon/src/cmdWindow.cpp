@@ -1,80 +1,51 @@
 #include "cmdWindow.h"
 #include "AutomationManager.h"
 #include "Constants.h"
+#include "ExtensionRpc.h"
 #include "KeyboardManager.h"
 #include "Utils.h"
-#include <cstring>
-#include <mutex>
-#include <unistd.h>
+#include "WindowClassifier.h"
 
 using namespace std;
 
-static int g_windowExtensionSocket = -1;
-static std::mutex g_windowExtensionSocketMutex;
+// The extension answers from GNOME Shell's main loop; listing hundreds of
+// windows still takes well under this
+static const int WINDOW_RPC_TIMEOUT_MS = 3000;
 
 // External client socket - set by mainCommand before calling handlers
 extern int g_clientSocket;
 
 void setWindowExtensionClientSocket(int socket) {
-  std::lock_guard<std::mutex> lock(g_windowExtensionSocketMutex);
-  g_windowExtensionSocket = socket;
+  ExtensionRpc::attach(ExtensionRpc::Channel::Window, socket);
 }
 
 CmdResult handleRegisterWindowExtension(const json &) {
-  {
-    std::lock_guard<std::mutex> lock(g_windowExtensionSocketMutex);
-    g_windowExtensionSocket = g_clientSocket;
-  }
+  ExtensionRpc::attach(ExtensionRpc::Channel::Window, g_clientSocket);
   logToFile("[Window Ext] Window Extension registered", LOG_WINDOW);
   return CmdResult(0, std::string(R"({"status":"registered"})") +
                           mustEndWithNewLine);
 }
 
+// Runs on a slow-command thread; the event loop delivers the reply
 CmdResult handleListWindows(const json &) {
-  std::lock_guard<std::mutex> lock(g_windowExtensionSocketMutex);
-  if (g_windowExtensionSocket == -1) {
-    return CmdResult(1, "Window extension not registered");
-  }
-
-  std::string msg =
-      std::string(R"({"action":"listWindows"})") + mustEndWithNewLine;
-  if (write(g_windowExtensionSocket, msg.c_str(), msg.length()) < 0) {
-    g_windowExtensionSocket = -1;
-    return CmdResult(1, "Failed to write to extension");
-  }
-
-  // Simple read blocking
-  char buffer[4096];
-  memset(buffer, 0, sizeof(buffer));
-  ssize_t n = read(g_windowExtensionSocket, buffer, sizeof(buffer) - 1);
-  if (n > 0) {
-    return CmdResult(0, std::string(buffer));
+  std::string reply, error;
+  if (!ExtensionRpc::call(ExtensionRpc::Channel::Window,
+                          {{"action", "listWindows"}}, WINDOW_RPC_TIMEOUT_MS,
+                          reply, error)) {
+    return CmdResult(1, error);
   }
-  return CmdResult(1, "No response from extension");
+  return CmdResult(0, reply);
 }
 
 CmdResult handleActivateWindow(const json &command) {
-  std::lock_guard<std::mutex> lock(g_windowExtensionSocketMutex);
-  if (g_windowExtensionSocket == -1) {
-    return CmdResult(1, "Window extension not registered");
-  }
-
   json forward = command;
   forward["action"] = "activateWindow";
-  std::string msg = forward.dump() + mustEndWithNewLine;
-
-  if (write(g_windowExtensionSocket, msg.c_str(), msg.length()) < 0) {
-    g_windowExtensionSocket = -1;
-    return CmdResult(1, "Failed to write to extension");
+  std::string reply, error;
+  if (!ExtensionRpc::call(ExtensionRpc::Channel::Window, forward,
+                          WINDOW_RPC_TIMEOUT_MS, reply, error)) {
+    return CmdResult(1, error);
   }
-
-  char buffer[1024];
-  memset(buffer, 0, sizeof(buffer));
-  ssize_t n = read(g_windowExtensionSocket, buffer, sizeof(buffer) - 1);
-  if (n > 0) {
-    return CmdResult(0, std::string(buffer));
-  }
-  return CmdResult(0, "Command sent (no reply)");
+  return CmdResult(0, reply);
 }
 
 CmdResult handleActiveWindowChanged(const json &command) {
@@ -84,3 +55,16 @@ CmdResult handleActiveWindowChanged(const json &command) {
 CmdResult handleGetActiveContext(const json &) {
   return CmdResult(0, KeyboardManager::mapper.getActiveContextJson().dump());
 }
+
+CmdResult handleGetWindowRules(const json &) {
+  return CmdResult(0, WindowClassifier::getRules() + "\n");
+}
+
+CmdResult handleSetWindowRules(const json &command) {
+  std::string error;
+  if (!WindowClassifier::setRules(command[COMMAND_ARG_VALUE].get<string>(),
+                                  error)) {
+    return CmdResult(1, "Invalid window rules: " + error + "\n");
+  }
+  return CmdResult(0, "Window rules updated\n");
+}
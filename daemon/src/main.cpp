@@ -4,9 +4,12 @@
 #include "DaemonServer.h"
 #include "DatabaseTableManagers.h"
 #include "KeyboardManager.h" // Added include
-#include "MySQLManager.h"
 #include "PeerManager.h"
+#include "PeerRegistry.h"
+#include "StartupTracer.h"
+#include "StorageBackend.h"
 #include "Version.h"
+#include "WriteBehindQueue.h"
 #include "common.h"
 #include <iostream>
 #include <nlohmann/json.hpp>
@@ -32,7 +35,9 @@ std::ofstream g_logFile;
 void signalHandler(int signum) {
   cout << "Interrupt signal (" << signum << ") received.\n";
   PeerManager::getInstance().stopReconnectLoop();
-  MySQLManager::stopMySQL();
+  PeerRegistry::stop();
+  WriteBehindQueue::stop();
+  Storage::stop();
   exit(signum);
 }
 
@@ -49,38 +54,19 @@ int main(int argc, char *argv[]) {
         return 0; // Help was displayed, no need to send to daemon
       }
       return send_command_to_daemon(cmdJson);
+    } else if (mode == "notify") {
+      ordered_json cmdJson = parse_client_args(argc, argv, 2);
+      if (cmdJson.contains("error")) {
+        return 1;
+      }
+      if (cmdJson.contains("_help_shown")) {
+        return 0;
+      }
+      return send_notification_to_daemon(cmdJson);
     } else if (mode == "daemon") {
       // Signals handled in initialize_daemon()
       cerr << "automateLinux daemon v" << DAEMON_VERSION << endl;
-
-      MySQLManager::initializeAndStartMySQL();
-
-      // Load peer config and restore connections
-      PeerManager &pm = PeerManager::getInstance();
-      pm.loadConfig();
-      if (pm.isLeader() && !pm.getPeerId().empty()) {
-        // Leader self-registers in database
-        string my_ip = getWgInterfaceIP();
-        string my_mac = getPrimaryMacAddress();
-        char hostname[256];
-        string my_hostname = "";
-        if (gethostname(hostname, sizeof(hostname)) == 0) {
-          my_hostname = string(hostname);
-        }
-        PeerTable::upsertPeer(pm.getPeerId(), my_ip, my_mac, my_hostname, true, DAEMON_VERSION);
-        cerr << "Peer config restored: leader " << pm.getPeerId() << endl;
-        pm.startReconnectLoop(); // Leader self-heartbeat to keep last_seen fresh
-      } else if (!pm.getLeaderAddress().empty()) {
-        // Worker connects to leader
-        if (pm.connectToLeader()) {
-          cerr << "Peer config restored: connected to leader at "
-               << pm.getLeaderAddress() << endl;
-        } else {
-          cerr << "Peer config restored: will retry leader connection" << endl;
-        }
-        // Start background reconnect loop (handles disconnections and failed initial connects)
-        pm.startReconnectLoop();
-      }
+      StartupTracer::begin();
 
       // Ensure socket directory exists
       std::filesystem::path socketDir =
@@ -106,18 +92,23 @@ int main(int argc, char *argv[]) {
       }
       if (initialize_daemon() != 0) {
         cerr << "Failed to initialize daemon." << endl;
-        MySQLManager::stopMySQL();
+        PeerRegistry::stop();
+        WriteBehindQueue::stop();
+        Storage::stop();
         return 1;
       }
 
       daemon_loop();
-      pm.stopReconnectLoop();
+      PeerManager::getInstance().stopReconnectLoop();
       KeyboardManager::mapper
           .stop(); // Explicitly stop mapper to ungrab devices
-      MySQLManager::stopMySQL();
+      PeerRegistry::stop(); // Persist liveness before storage goes
+      WriteBehindQueue::stop(); // Flush coalesced writes before storage goes
+      Storage::stop();
       cerr << "Daemon shutting down." << endl;
     } else {
-      cerr << "Unknown mode: expecting 'daemon send' or 'daemon daemon'\n";
+      cerr << "Unknown mode: expecting 'daemon send', 'daemon notify' or "
+              "'daemon daemon'\n";
       cerr << "Try: daemon send ping\n";
       cerr << "Or: daemon send enableKeyboard / disableKeyboard\n";
       return 1;
@@ -127,6 +118,7 @@ int main(int argc, char *argv[]) {
     cerr << "Modes:\n";
     cerr << "  daemon            Run the daemon in server mode.\n";
     cerr << "  send <command>    Send a command to the daemon.\n";
+    cerr << "  notify <command>  Send a one-way command without waiting.\n";
     return 1;
   }
   return 0;
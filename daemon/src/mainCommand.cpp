@@ -1,5 +1,6 @@
 #include "mainCommand.h"
 #include "Constants.h"
+#include "ReplyStream.h"
 #include "Utils.h"
 #include "Version.h"
 #include <string>
@@ -49,6 +50,10 @@ const CommandSignature COMMAND_REGISTRY[] = {
                      "Navigate forward in directory history (Ctrl+Down)"),
     CommandSignature(COMMAND_CD_BACKWARD, {COMMAND_ARG_TTY},
                      "Navigate backward in directory history (Ctrl+Up)"),
+    CommandSignature(COMMAND_CD_JUMP, {COMMAND_ARG_QUERY},
+                     "Jump to the best history match for --query "
+                     "(frecency ranked)",
+                     "--pwd"),
     CommandSignature(COMMAND_SHELL_SIGNAL, {COMMAND_ARG_SIGNAL},
                      "Handle shell signal events"),
     CommandSignature(COMMAND_SHOW_TERMINAL_INSTANCE, {COMMAND_ARG_TTY},
@@ -80,6 +85,12 @@ const CommandSignature COMMAND_REGISTRY[] = {
     CommandSignature(COMMAND_VERSION, {},
                      "Show daemon version (git commit count)"),
     CommandSignature(COMMAND_QUIT, {}, "Stop the daemon"),
+    CommandSignature(COMMAND_STARTUP_TRACE, {},
+                     "Show the duration of each daemon startup phase"),
+    CommandSignature(COMMAND_NOTIFY_STATS, {},
+                     "Show one-way notification queue and loss counters"),
+    CommandSignature(COMMAND_SERVICE_STATS, {},
+                     "Show the systemd unit status table and its counters"),
     CommandSignature(COMMAND_GET_DIR, {COMMAND_ARG_DIR_NAME},
                      "Get daemon directory path (base, data, mappings)"),
     CommandSignature(COMMAND_GET_FILE, {COMMAND_ARG_FILE_NAME},
@@ -141,6 +152,10 @@ const CommandSignature COMMAND_REGISTRY[] = {
     CommandSignature(COMMAND_FOCUS_ACK, {}, "Acknowledge focus request"),
     CommandSignature(COMMAND_GET_ACTIVE_CONTEXT, {},
                      "Get current active window context (JSON)"),
+    CommandSignature(COMMAND_GET_WINDOW_RULES, {},
+                     "Show the window classification rules (JSON)"),
+    CommandSignature(COMMAND_SET_WINDOW_RULES, {COMMAND_ARG_VALUE},
+                     "Replace the window classification rules (\"\" resets)"),
     CommandSignature(COMMAND_REGISTER_WINDOW_EXTENSION, {},
                      "Register GNOME window tracking extension"),
     CommandSignature(COMMAND_LIST_WINDOWS, {}, "List all tracked windows"),
@@ -161,7 +176,7 @@ const CommandSignature COMMAND_REGISTRY[] = {
     CommandSignature(COMMAND_GET_PORT, {COMMAND_ARG_KEY},
                      "Get assigned port for an app/service"),
     CommandSignature(COMMAND_SET_PORT, {COMMAND_ARG_KEY, COMMAND_ARG_VALUE},
-                     "Assign a port to an app/service"),
+                     "Assign a port to an app/service", "--app"),
     CommandSignature(COMMAND_LIST_PORTS, {}, "List all port assignments"),
     CommandSignature(COMMAND_DELETE_PORT, {COMMAND_ARG_KEY},
                      "Delete a port assignment"),
@@ -199,11 +214,15 @@ const CommandSignature COMMAND_REGISTRY[] = {
     CommandSignature(COMMAND_LIST_EXTRA_APPS, {},
                      "List all extra apps registered in database"),
     CommandSignature(COMMAND_DEPLOY_TO_PROD, {COMMAND_ARG_APP},
-                     "Deploy dev changes to prod worktree", "--commit <hash>"),
+                     "Deploy dev changes to the idle prod slot and switch to "
+                     "it",
+                     "--commit <hash>"),
     CommandSignature(COMMAND_PROD_STATUS, {COMMAND_ARG_APP},
                      "Check prod worktree status (clean/dirty)"),
     CommandSignature(COMMAND_CLEAN_PROD, {COMMAND_ARG_APP},
                      "Discard uncommitted changes in prod worktree"),
+    CommandSignature(COMMAND_ROLLBACK_PROD, {COMMAND_ARG_APP},
+                     "Switch prod back to the previous slot"),
     CommandSignature(COMMAND_GET_APP_PEERS, {COMMAND_ARG_APP},
                      "Show which peers have an app installed and running"),
     CommandSignature(COMMAND_INSTALL_APP_ON_PEER,
@@ -251,6 +270,11 @@ const CommandSignature COMMAND_REGISTRY[] = {
         COMMAND_EXEC_ON_PEER,
         {COMMAND_ARG_PEER, COMMAND_ARG_DIRECTORY, COMMAND_ARG_SHELL_CMD},
         "Execute a command on a remote peer in specified directory"),
+    CommandSignature(
+        COMMAND_EXEC_ON_PEERS,
+        {COMMAND_ARG_PEERS, COMMAND_ARG_DIRECTORY, COMMAND_ARG_SHELL_CMD},
+        "Execute a command on several peers (a,b,c or all) in parallel",
+        "--timeout"),
     CommandSignature(COMMAND_EXEC_REQUEST,
                      {COMMAND_ARG_DIRECTORY, COMMAND_ARG_SHELL_CMD},
                      "(Internal) Handle exec request from another peer"),
@@ -259,7 +283,17 @@ const CommandSignature COMMAND_REGISTRY[] = {
     CommandSignature(COMMAND_REMOTE_BD, {COMMAND_ARG_PEER},
                      "Build daemon on a remote peer"),
     CommandSignature(COMMAND_REMOTE_DEPLOY_DAEMON, {COMMAND_ARG_PEER},
-                     "Pull and build daemon on a remote peer"),
+                     "Pull and deploy daemon on a remote peer (built once "
+                     "here, fetched by the peer)"),
+    CommandSignature(COMMAND_FETCH_ARTIFACT,
+                     {COMMAND_ARG_SHA256, COMMAND_ARG_SOURCE, COMMAND_ARG_SIZE},
+                     "(Internal) Download a daemon artifact from a peer",
+                     "--sourcePort"),
+    CommandSignature(COMMAND_SERVE_ARTIFACT, {COMMAND_ARG_SHA256},
+                     "(Internal) Stream a daemon artifact to a peer",
+                     "--offset"),
+    CommandSignature(COMMAND_LIST_ARTIFACTS, {},
+                     "List daemon artifacts built for remote deploys"),
     CommandSignature(COMMAND_DB_SANITY_CHECK, {},
                      "Check and fix worker database (delete leader-only data)"),
     CommandSignature(
@@ -269,6 +303,12 @@ const CommandSignature COMMAND_REGISTRY[] = {
                      "Update this peer's MAC address in the leader's database"),
     CommandSignature("updatePeerMacInternal", {},
                      "(internal) Receives MAC update from worker"),
+    CommandSignature(COMMAND_REPLICA_SYNC, {},
+                     "(Internal) Send a worker the settings and peer changes "
+                     "it is missing"),
+    CommandSignature(COMMAND_REPLICA_CHANGES, {},
+                     "(Internal) Apply settings and peer changes from the "
+                     "leader"),
 
     // WireGuard Setup Commands
     CommandSignature(
@@ -307,6 +347,9 @@ static const CommandDispatch COMMAND_HANDLERS[] = {
     {COMMAND_PING, handlePing},
     {COMMAND_VERSION, handleVersion},
     {COMMAND_QUIT, handleQuit},
+    {COMMAND_STARTUP_TRACE, handleStartupTrace},
+    {COMMAND_NOTIFY_STATS, handleNotifyStats},
+    {COMMAND_SERVICE_STATS, handleServiceStats},
     {COMMAND_GET_DIR, handleGetDir},
     {COMMAND_GET_FILE, handleGetFile},
     {COMMAND_GET_SOCKET_PATH, handleGetSocketPath},
@@ -321,6 +364,7 @@ static const CommandDispatch COMMAND_HANDLERS[] = {
     {COMMAND_UPDATE_DIR_HISTORY, handleUpdateDirHistory},
     {COMMAND_CD_FORWARD, handleCdForward},
     {COMMAND_CD_BACKWARD, handleCdBackward},
+    {COMMAND_CD_JUMP, handleCdJump},
     {COMMAND_SHELL_SIGNAL, handleShellSignal},
     {COMMAND_SHOW_TERMINAL_INSTANCE, handleShowTerminalInstance},
     {COMMAND_SHOW_ALL_TERMINAL_INSTANCES, handleShowAllTerminalInstances},
@@ -362,6 +406,8 @@ static const CommandDispatch COMMAND_HANDLERS[] = {
     {COMMAND_ACTIVATE_WINDOW, handleActivateWindow},
     {COMMAND_ACTIVE_WINDOW_CHANGED, handleActiveWindowChanged},
     {COMMAND_GET_ACTIVE_CONTEXT, handleGetActiveContext},
+    {COMMAND_GET_WINDOW_RULES, handleGetWindowRules},
+    {COMMAND_SET_WINDOW_RULES, handleSetWindowRules},
 
     // Browser commands
     {COMMAND_SET_ACTIVE_TAB_URL, handleSetActiveTabUrl},
@@ -394,6 +440,7 @@ static const CommandDispatch COMMAND_HANDLERS[] = {
     {COMMAND_DEPLOY_TO_PROD, handleDeployToProd},
     {COMMAND_PROD_STATUS, handleProdStatus},
     {COMMAND_CLEAN_PROD, handleCleanProd},
+    {COMMAND_ROLLBACK_PROD, handleRollbackProd},
     {COMMAND_GET_APP_PEERS, handleGetAppPeers},
     {COMMAND_INSTALL_APP_ON_PEER, handleInstallAppOnPeer},
     {COMMAND_UNINSTALL_APP_ON_PEER, handleUninstallAppOnPeer},
@@ -409,14 +456,20 @@ static const CommandDispatch COMMAND_HANDLERS[] = {
     {COMMAND_DELETE_PEER, handleDeletePeer},
     {COMMAND_GET_PEER_INFO, handleGetPeerInfo},
     {COMMAND_EXEC_ON_PEER, handleExecOnPeer},
+    {COMMAND_EXEC_ON_PEERS, handleExecOnPeers},
     {COMMAND_EXEC_REQUEST, handleExecRequest},
     {COMMAND_REMOTE_PULL, handleRemotePull},
     {COMMAND_REMOTE_BD, handleRemoteBd},
     {COMMAND_REMOTE_DEPLOY_DAEMON, handleRemoteDeployDaemon},
+    {COMMAND_FETCH_ARTIFACT, handleFetchArtifact},
+    {COMMAND_SERVE_ARTIFACT, handleServeArtifact},
+    {COMMAND_LIST_ARTIFACTS, handleListArtifacts},
     {COMMAND_DB_SANITY_CHECK, handleDbSanityCheck},
     {COMMAND_REGISTER_WORKER, handleRegisterWorker},
     {COMMAND_UPDATE_PEER_MAC, handleUpdatePeerMac},
     {"updatePeerMacInternal", handleUpdatePeerMacInternal},
+    {COMMAND_REPLICA_SYNC, handleReplicaSync},
+    {COMMAND_REPLICA_CHANGES, handleReplicaChanges},
 
     // WireGuard commands
     {COMMAND_SETUP_WIREGUARD_PEER, handleSetupWireGuardPeer},
@@ -442,6 +495,7 @@ getCommandLogContext(const std::string &commandName) {
   if (commandName == COMMAND_UPDATE_DIR_HISTORY ||
       commandName == COMMAND_OPENED_TTY || commandName == COMMAND_CLOSED_TTY ||
       commandName == COMMAND_CD_FORWARD || commandName == COMMAND_CD_BACKWARD ||
+      commandName == COMMAND_CD_JUMP ||
       commandName == COMMAND_SHOW_TERMINAL_INSTANCE ||
       commandName == COMMAND_SHOW_ALL_TERMINAL_INSTANCES) {
     return {LOG_TERMINAL, "[Terminal]"};
@@ -479,8 +533,7 @@ CmdResult validateCommand(const json &command) {
 }
 
 // Main command dispatcher
-int mainCommand(const json &command, int client_sock) {
-  g_clientSocket = client_sock;
+CmdResult dispatchCommand(const json &command) {
   string commandStr = command.dump();
   string commandName =
       command.contains(COMMAND_KEY) ? command[COMMAND_KEY].get<string>() : "";
@@ -515,28 +568,46 @@ int mainCommand(const json &command, int client_sock) {
   if (!result.message.empty() && result.message.back() != '\n') {
     result.message += "\n";
   }
-  write(client_sock, result.message.c_str(), result.message.length());
+  return result;
+}
 
-  if (commandName == "closedTty") {
-    return 1;
-  }
+bool isSlowCommand(const string &commandName) {
+  return commandName == COMMAND_REMOTE_DEPLOY_DAEMON ||
+         commandName == COMMAND_FETCH_ARTIFACT ||
+         commandName == COMMAND_SERVE_ARTIFACT ||
+         commandName == COMMAND_EXEC_ON_PEER ||
+         commandName == COMMAND_EXEC_ON_PEERS ||
+         commandName == COMMAND_REMOTE_PULL ||
+         commandName == COMMAND_REMOTE_BD ||
+         commandName == COMMAND_EXEC_REQUEST ||
+         commandName == COMMAND_INSTALL_APP_ON_PEER ||
+         commandName == COMMAND_UNINSTALL_APP_ON_PEER ||
+         commandName == COMMAND_START_APP_ON_PEER ||
+         commandName == COMMAND_STOP_APP_ON_PEER ||
+         commandName == COMMAND_DEPLOY_TO_PROD ||
+         commandName == COMMAND_ROLLBACK_PROD ||
+         commandName == COMMAND_LIST_WINDOWS ||
+         commandName == COMMAND_ACTIVATE_WINDOW;
+}
 
-  // Return 1 (close) for regular commands, 0 (keep) for log listeners,
-  // 2 (handover to thread) for slow commands.
-  if (commandName == COMMAND_REGISTER_LOG_LISTENER ||
-      commandName == COMMAND_REGISTER_WINDOW_EXTENSION ||
-      commandName == COMMAND_REGISTER_NATIVE_HOST) {
-    return 0;
-  }
+int mainCommand(const json &command, int client_sock) {
+  g_clientSocket = client_sock;
+  string commandName =
+      command.contains(COMMAND_KEY) ? command[COMMAND_KEY].get<string>() : "";
+
+  // Slow commands run only on their thread; the caller gets errors in the
+  // request itself right away
+  if (isSlowCommand(commandName)) {
+    CmdResult integrityCheck = validateCommand(command);
+    if (integrityCheck.status != 0) {
+      write(client_sock, integrityCheck.message.c_str(),
+            integrityCheck.message.length());
+      return 1;
+    }
+    auto logCtx = getCommandLogContext(commandName);
+    logToFile(logCtx.second + " Received command: " + command.dump(),
+              logCtx.first);
 
-  if (commandName == COMMAND_REMOTE_DEPLOY_DAEMON ||
-      commandName == COMMAND_EXEC_ON_PEER ||
-      commandName == COMMAND_REMOTE_PULL || commandName == COMMAND_REMOTE_BD ||
-      commandName == COMMAND_EXEC_REQUEST ||
-      commandName == COMMAND_INSTALL_APP_ON_PEER ||
-      commandName == COMMAND_UNINSTALL_APP_ON_PEER ||
-      commandName == COMMAND_START_APP_ON_PEER ||
-      commandName == COMMAND_STOP_APP_ON_PEER) {
     // Hand over to thread
     std::thread([command, client_sock]() {
       string commandName = command[COMMAND_KEY].get<string>();
@@ -548,6 +619,8 @@ int mainCommand(const json &command, int client_sock) {
         }
       }
 
+      // Lets the handler send output to the client while it runs
+      ReplyStream stream(client_sock);
       CmdResult result;
       if (handler) {
         try {
@@ -573,5 +646,20 @@ int mainCommand(const json &command, int client_sock) {
     return 2;
   }
 
+  CmdResult result = dispatchCommand(command);
+  write(client_sock, result.message.c_str(), result.message.length());
+
+  if (commandName == "closedTty") {
+    return 1;
+  }
+
+  // Return 1 (close) for regular commands, 0 (keep) for log listeners,
+  // 2 (handover to thread) for slow commands.
+  if (commandName == COMMAND_REGISTER_LOG_LISTENER ||
+      commandName == COMMAND_REGISTER_WINDOW_EXTENSION ||
+      commandName == COMMAND_REGISTER_NATIVE_HOST) {
+    return 0;
+  }
+
   return 1;
 }
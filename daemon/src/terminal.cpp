@@ -1,6 +1,7 @@
 #include "terminal.h"
 #include "Constants.h"
-#include "DatabaseTableManagers.h"
+#include "DirHistory.h"
+#include "DirJumpIndex.h"
 #include "Utils.h"
 #include <filesystem>
 
@@ -15,43 +16,38 @@ string Terminal::standardizePath(string path) {
   return path;
 }
 
-Terminal::Terminal(int tty) : tty(tty) {
-  instances.push_back(this);
-
-  // Start at the last-interacted directory, not just the highest index
-  int startIndex = -1;
-  string lastTouched = SettingsTable::getSetting(INDEX_OF_LAST_TOUCHED_DIR_KEY);
-  if (!lastTouched.empty()) {
-    try {
-      startIndex = std::stoi(lastTouched);
-    } catch (...) {
-      startIndex = -1;
+// Nearest history entry from seq, stepping by step (+1/-1), that is an
+// existing directory; -1 if there is none
+static int findExistingDir(int seq, int step, string &dir) {
+  int first = DirHistory::firstSeq();
+  int next = DirHistory::nextSeq();
+  for (; seq >= first && seq < next; seq += step) {
+    string candidate;
+    if (!DirHistory::get(seq, candidate))
+      continue;
+    candidate = Terminal::standardizePath(candidate);
+    if (candidate != "/" && std::filesystem::is_directory(candidate)) {
+      dir = candidate;
+      return seq;
     }
   }
-  if (startIndex < 0)
-    startIndex = TerminalTable::getMaxHistoryIndex();
-  if (startIndex < 0) {
-    startIndex = 0;
-    string defaultDir = standardizePath(DIR_HISTORY_DEFAULT_DIR);
-    TerminalTable::upsertHistory(0, defaultDir);
-  }
+  return -1;
+}
 
+Terminal::Terminal(int tty) : tty(tty) {
+  instances.push_back(this);
+
+  // Start at the last-interacted directory, not just the newest entry.
   // Validate the directory exists, walk backward if not
-  for (int i = startIndex; i >= 0; i--) {
-    string dir = TerminalTable::getHistory(i);
-    if (!dir.empty() && dir != "/" && std::filesystem::is_directory(dir)) {
-      startIndex = i;
-      goto found;
-    }
-  }
-  // None found, use default
-  startIndex = TerminalTable::getMaxHistoryIndex();
+  int startIndex = DirHistory::lastTouched();
+  if (startIndex < DirHistory::firstSeq() ||
+      startIndex >= DirHistory::nextSeq())
+    startIndex = DirHistory::nextSeq() - 1;
+  string dir;
+  startIndex = findExistingDir(startIndex, -1, dir);
   if (startIndex < 0)
-    startIndex = 0;
-  TerminalTable::upsertHistory(startIndex, standardizePath(DIR_HISTORY_DEFAULT_DIR));
-
-found:
-  TerminalTable::setSessionPointer(tty, startIndex);
+    startIndex = DirHistory::append(standardizePath(DIR_HISTORY_DEFAULT_DIR));
+  DirHistory::setCursor(tty, startIndex);
 }
 
 Terminal::~Terminal() {
@@ -59,7 +55,7 @@ Terminal::~Terminal() {
   if (it != instances.end()) {
     instances.erase(it);
   }
-  TerminalTable::deleteSession(tty);
+  DirHistory::dropCursor(tty);
 }
 
 Terminal *Terminal::getInstanceByTTY(int tty) {
@@ -105,37 +101,16 @@ CmdResult Terminal::_openedTty(const json &command) {
   (void)command;
   CmdResult result;
   try {
-    int index = TerminalTable::getSessionPointer(tty);
-    if (index < 0) {
-      index = 0;
-      TerminalTable::setSessionPointer(tty, 0);
-      string defaultDir = standardizePath(DIR_HISTORY_DEFAULT_DIR);
-      TerminalTable::upsertHistory(0, defaultDir);
-    }
-    string dir = standardizePath(TerminalTable::getHistory(index));
-
     // Validate the directory exists, walk backward if not
-    if (!dir.empty() && dir != "/" && !std::filesystem::is_directory(dir)) {
-      for (int i = index - 1; i >= 0; i--) {
-        string candidate = standardizePath(TerminalTable::getHistory(i));
-        if (!candidate.empty() && candidate != "/" &&
-            std::filesystem::is_directory(candidate)) {
-          dir = candidate;
-          index = i;
-          TerminalTable::setSessionPointer(tty, index);
-          goto validated;
-        }
-      }
-      // No valid dir found, use default
-      dir = standardizePath(DIR_HISTORY_DEFAULT_DIR);
-      TerminalTable::setSessionPointer(tty, 0);
-    }
-
-  validated:
-    if (dir.empty() || dir == "/") {
+    int index = getIndex();
+    string dir;
+    int found = findExistingDir(index, -1, dir);
+    if (found < 0) {
       dir = standardizePath(DIR_HISTORY_DEFAULT_DIR);
-      TerminalTable::upsertHistory(index, dir);
+      found = DirHistory::append(dir);
     }
+    if (found != index)
+      DirHistory::setCursor(tty, found);
     result.message = dir + mustEndWithNewLine;
     result.status = 0;
   } catch (const std::exception &e) {
@@ -168,7 +143,7 @@ CmdResult Terminal::_closedTty(const json &command) {
   if (it != instances.end()) {
     instances.erase(it);
   }
-  TerminalTable::deleteSession(tty);
+  DirHistory::dropCursor(tty);
   result.status = 0;
   result.message = "\n";
   delete this;
@@ -204,7 +179,7 @@ CmdResult Terminal::_updateDirHistory(const json &command) {
            " index=" + to_string(index) + " pwd=" + pwd + " cur=" + currentDir +
            " next=" + nextDir);
 
-  SettingsTable::setSetting(INDEX_OF_LAST_TOUCHED_DIR_KEY, to_string(index));
+  DirHistory::setLastTouched(index);
   result.status = 0;
   result.message = "\n";
   if (pwd.empty() || pwd == "/") {
@@ -214,21 +189,19 @@ CmdResult Terminal::_updateDirHistory(const json &command) {
   } else if (currentDir == pwd) {
     // already there
   } else if (nextDir == pwd) {
-    TerminalTable::setSessionPointer(tty, index + 1);
+    DirHistory::setCursor(tty, index + 1);
   } else {
-    int insertIndex = TerminalTable::getMaxHistoryIndex() + 1;
-    TerminalTable::upsertHistory(insertIndex, pwd);
-    TerminalTable::setSessionPointer(tty, insertIndex);
-    SettingsTable::setSetting(INDEX_OF_LAST_TOUCHED_DIR_KEY,
-                              to_string(insertIndex));
-    TerminalTable::pruneHistory(MAX_DIR_HISTORY_SIZE);
+    // The ring drops the oldest entry once full
+    int insertIndex = DirHistory::append(pwd);
+    DirHistory::setCursor(tty, insertIndex);
+    DirHistory::setLastTouched(insertIndex);
   }
   return result;
 }
 
 int Terminal::getIndex() {
-  int idx = TerminalTable::getSessionPointer(tty);
-  return idx >= 0 ? idx : 0;
+  int idx = DirHistory::cursor(tty);
+  return idx >= 0 ? idx : DirHistory::firstSeq();
 }
 
 string Terminal::getPWD(const json &command) {
@@ -236,7 +209,9 @@ string Terminal::getPWD(const json &command) {
 }
 
 string Terminal::getDirHistoryEntry(int index) {
-  return TerminalTable::getHistory(index);
+  string path;
+  DirHistory::get(index, path);
+  return path;
 }
 
 // removed dirHistoryKeyPrefix
@@ -257,20 +232,19 @@ CmdResult Terminal::_cdForward(const json &command) {
   (void)command;
   CmdResult result;
   int index = getIndex();
-  int maxIndex = TerminalTable::getMaxHistoryIndex();
 
   forceLog("[Terminal] cdForward tty=" + to_string(tty) +
-           " index=" + to_string(index) + " max=" + to_string(maxIndex));
-
-  // Loop forward, skipping nonexistent directories
-  for (int i = index + 1; i <= maxIndex; i++) {
-    string dir = standardizePath(getDirHistoryEntry(i));
-    if (!dir.empty() && dir != "/" && std::filesystem::is_directory(dir)) {
-      TerminalTable::setSessionPointer(tty, i);
-      result.message = "cd " + dir + mustEndWithNewLine;
-      result.status = 0;
-      return result;
-    }
+           " index=" + to_string(index) +
+           " next=" + to_string(DirHistory::nextSeq()));
+
+  // Step forward, skipping nonexistent directories
+  string dir;
+  int found = findExistingDir(index + 1, 1, dir);
+  if (found >= 0) {
+    DirHistory::setCursor(tty, found);
+    result.message = "cd " + dir + mustEndWithNewLine;
+    result.status = 0;
+    return result;
   }
 
   result.status = 0;
@@ -299,15 +273,14 @@ CmdResult Terminal::_cdBackward(const json &command) {
   forceLog("[Terminal] cdBackward tty=" + to_string(tty) +
            " index=" + to_string(index));
 
-  // Loop backward, skipping nonexistent directories
-  for (int i = index - 1; i >= 0; i--) {
-    string dir = standardizePath(getDirHistoryEntry(i));
-    if (!dir.empty() && dir != "/" && std::filesystem::is_directory(dir)) {
-      TerminalTable::setSessionPointer(tty, i);
-      result.message = "cd " + dir + mustEndWithNewLine;
-      result.status = 0;
-      return result;
-    }
+  // Step backward, skipping nonexistent directories
+  string dir;
+  int found = findExistingDir(index - 1, -1, dir);
+  if (found >= 0) {
+    DirHistory::setCursor(tty, found);
+    result.message = "cd " + dir + mustEndWithNewLine;
+    result.status = 0;
+    return result;
   }
 
   result.status = 0;
@@ -316,6 +289,21 @@ CmdResult Terminal::_cdBackward(const json &command) {
   return result;
 }
 
+CmdResult Terminal::cdJump(const json &command) {
+  string query = getJsonString(command, COMMAND_ARG_QUERY);
+  string pwd = getJsonString(command, PWD_KEY);
+  string dir =
+      DirJumpIndex::query(query, pwd.empty() ? "" : standardizePath(pwd));
+
+  forceLog("[Terminal] cdJump query=" + query + " -> " +
+           (dir.empty() ? "(none)" : dir));
+
+  if (dir.empty())
+    return CmdResult(0, string("echo \nNO MATCH in history\n") +
+                            mustEndWithNewLine);
+  return CmdResult(0, "cd " + dir + mustEndWithNewLine);
+}
+
 string Terminal::toString() {
   int index = getIndex();
   string dir = getDirHistoryEntry(index);
@@ -0,0 +1,65 @@
+// Drives ChromeTabs against a DevTools endpoint for test_chrome_tabs.py.
+// Usage: chrome_tabs_driver <port>, then one query per line on stdin:
+//   connected      -> 1 or 0
+//   url <title>    -> the URL ChromeTabs::urlFor gives, or - when it fails
+#include "ChromeTabs.h"
+#include "Utils.h"
+#include <arpa/inet.h>
+#include <cstring>
+#include <iostream>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+// Stand-ins for the daemon's Utils.cpp, which pulls in curl and the database
+void logToFile(const std::string &message, unsigned int) {
+  std::cerr << message << std::endl;
+}
+
+std::string httpGet(const std::string &url) {
+  size_t hostAt = url.find("://") + 3;
+  size_t pathAt = url.find('/', hostAt);
+  size_t colon = url.find(':', hostAt);
+  int port = std::stoi(url.substr(colon + 1, pathAt - colon - 1));
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(port);
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  std::string response;
+  if (connect(fd, (sockaddr *)&addr, sizeof(addr)) == 0) {
+    std::string request = "GET " + url.substr(pathAt) +
+                          " HTTP/1.1\r\nHost: localhost\r\n"
+                          "Connection: close\r\n\r\n";
+    if (send(fd, request.data(), request.size(), 0) > 0) {
+      char buffer[4096];
+      ssize_t n;
+      while ((n = recv(fd, buffer, sizeof(buffer), 0)) > 0)
+        response.append(buffer, (size_t)n);
+    }
+  }
+  close(fd);
+  size_t body = response.find("\r\n\r\n");
+  return body == std::string::npos ? "" : response.substr(body + 4);
+}
+
+int main(int argc, char **argv) {
+  if (argc != 2) {
+    std::cerr << "Usage: " << argv[0] << " <port>" << std::endl;
+    return 2;
+  }
+  ChromeTabs::start(std::stoi(argv[1]));
+  std::string line;
+  while (std::getline(std::cin, line)) {
+    if (line == "connected") {
+      std::cout << (ChromeTabs::isConnected() ? 1 : 0) << std::endl;
+    } else if (line.compare(0, 4, "url ") == 0) {
+      std::string url;
+      bool found = ChromeTabs::urlFor(line.substr(4), url);
+      std::cout << (found ? url : "-") << std::endl;
+    }
+  }
+  ChromeTabs::stop();
+  return 0;
+}
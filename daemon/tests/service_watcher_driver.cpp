@@ -0,0 +1,277 @@
+// Drives ServiceWatcher over a fake UnitBus for test_service_watcher.py.
+// Usage: service_watcher_driver <jobTimeoutMs>, then one line per request on
+// stdin, answered with one line:
+//   state <unit> <activeState> <unitFileState>  -> ok; changes the fake
+//                                    service manager without any signal
+//   props <unit> <activeState>      -> ok; then PropertiesChanged
+//   files <unit> <unitFileState>    -> ok; then UnitFilesChanged
+//   job <unit> done|failed|hang     -> ok; how the unit's next job ends
+//   active|enabled <name>           -> 1, 0, or - when the watcher can't say
+//   control <action> <name>         -> 1 or 0, what control() reported
+//   changes <unit>                  -> times the change listener saw unit
+// Units are full names (cad-dev.service); queries take either form.
+#include "ServiceWatcher.h"
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <vector>
+
+// Stand-in for the daemon's Utils.cpp, which pulls in curl and the database
+void logToFile(const std::string &message, unsigned int) {
+  std::cerr << message << std::endl;
+}
+
+namespace {
+
+// The service manager, in memory. Signals are queued and delivered by
+// dispatch() on the watcher thread, as SystemdBus delivers them, and only
+// for watched units.
+class FakeUnitBus : public UnitBus {
+public:
+  explicit FakeUnitBus(int jobTimeoutMs) : jobTimeoutMs(jobTimeoutMs) {}
+
+  bool open(ChangeHandler handler) override {
+    onChange = std::move(handler);
+    return true;
+  }
+  void close() override {}
+
+  void dispatch(int timeoutMs) override {
+    std::deque<std::function<void()>> ready;
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      signalled.wait_for(lock, std::chrono::milliseconds(timeoutMs),
+                         [this] { return !signals.empty(); });
+      ready.swap(signals);
+    }
+    for (auto &signal : ready)
+      signal();
+  }
+
+  bool watchUnit(const std::string &unit) override {
+    UnitState state;
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      Unit &entry = units[unit];
+      entry.watched = true;
+      entry.reported = entry.state;
+      state = entry.state;
+    }
+    onChange(unit, state);
+    return true;
+  }
+
+  bool runAction(UnitAction action, const std::string &unit,
+                 std::string &error) override {
+    std::string job;
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      Unit &entry = units[unit];
+      switch (action) {
+      case UnitAction::Start:
+      case UnitAction::Stop:
+      case UnitAction::Restart: {
+        job = "/org/freedesktop/systemd1/job/" + std::to_string(nextJob++);
+        std::string result = entry.jobResult;
+        entry.jobResult = "done";
+        if (result == "hang")
+          break;
+        std::string activeState = action == UnitAction::Stop ? "inactive"
+                                  : result == "done"         ? "active"
+                                                             : "failed";
+        queueLocked([this, unit, activeState, job, result] {
+          propertiesChanged(unit, activeState);
+          jobs.finished(job, result);
+        });
+        break;
+      }
+      case UnitAction::ResetFailed:
+        if (entry.state.activeState == "failed")
+          queueLocked([this, unit] { propertiesChanged(unit, "inactive"); });
+        break;
+      case UnitAction::Enable:
+      case UnitAction::Disable: {
+        std::string fileState =
+            action == UnitAction::Enable ? "enabled" : "disabled";
+        queueLocked(
+            [this, unit, fileState] { unitFilesChanged(unit, fileState); });
+        break;
+      }
+      }
+    }
+
+    bool ok = true;
+    if (!job.empty()) {
+      std::string result =
+          jobs.wait(job, std::chrono::milliseconds(jobTimeoutMs));
+      if (result.empty()) {
+        error = "job timed out";
+        ok = false;
+      } else if (result != "done") {
+        error = "job " + result;
+        ok = false;
+      }
+    }
+    UnitState state;
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      Unit &entry = units[unit];
+      entry.reported = entry.state;
+      state = entry.state;
+    }
+    onChange(unit, state);
+    return ok;
+  }
+
+  // Test side
+  void setState(const std::string &unit, const std::string &activeState,
+                const std::string &fileState) {
+    std::lock_guard<std::mutex> lock(mutex);
+    UnitState &state = units[unit].state;
+    state.found = true;
+    state.activeState = activeState;
+    state.unitFileState = fileState;
+  }
+  void setJobResult(const std::string &unit, const std::string &result) {
+    std::lock_guard<std::mutex> lock(mutex);
+    units[unit].jobResult = result;
+  }
+  void signalProperties(const std::string &unit,
+                        const std::string &activeState) {
+    std::lock_guard<std::mutex> lock(mutex);
+    queueLocked(
+        [this, unit, activeState] { propertiesChanged(unit, activeState); });
+  }
+  void signalUnitFiles(const std::string &unit, const std::string &fileState) {
+    std::lock_guard<std::mutex> lock(mutex);
+    queueLocked(
+        [this, unit, fileState] { unitFilesChanged(unit, fileState); });
+  }
+
+private:
+  struct Unit {
+    UnitState state;    // What the service manager holds
+    UnitState reported; // What the watcher was last told
+    bool watched = false;
+    std::string jobResult = "done";
+  };
+
+  void queueLocked(std::function<void()> signal) {
+    signals.push_back(std::move(signal));
+    signalled.notify_all();
+  }
+
+  // PropertiesChanged carries the new ActiveState
+  void propertiesChanged(const std::string &unit,
+                         const std::string &activeState) {
+    UnitState state;
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      Unit &entry = units[unit];
+      entry.state.activeState = activeState;
+      if (!entry.watched)
+        return;
+      entry.reported.activeState = activeState;
+      state = entry.reported;
+    }
+    onChange(unit, state);
+  }
+
+  // UnitFilesChanged carries nothing; every watched unit is read back
+  void unitFilesChanged(const std::string &unit,
+                        const std::string &fileState) {
+    std::vector<std::pair<std::string, UnitState>> changed;
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      units[unit].state.unitFileState = fileState;
+      for (auto &[name, entry] : units) {
+        if (entry.watched &&
+            entry.reported.unitFileState != entry.state.unitFileState) {
+          entry.reported.unitFileState = entry.state.unitFileState;
+          changed.push_back({name, entry.reported});
+        }
+      }
+    }
+    for (const auto &[name, state] : changed)
+      onChange(name, state);
+  }
+
+  const int jobTimeoutMs;
+  ChangeHandler onChange;
+  UnitJobs jobs;
+  std::mutex mutex;
+  std::condition_variable signalled;
+  std::deque<std::function<void()>> signals;
+  std::map<std::string, Unit> units;
+  int nextJob = 1;
+};
+
+const std::map<std::string, UnitAction> ACTIONS = {
+    {"start", UnitAction::Start},
+    {"stop", UnitAction::Stop},
+    {"restart", UnitAction::Restart},
+    {"reset-failed", UnitAction::ResetFailed},
+    {"enable", UnitAction::Enable},
+    {"disable", UnitAction::Disable},
+};
+
+std::mutex changesMutex;
+std::map<std::string, int> changes;
+
+} // namespace
+
+int main(int argc, char **argv) {
+  if (argc != 2) {
+    std::cerr << "Usage: " << argv[0] << " <jobTimeoutMs>" << std::endl;
+    return 2;
+  }
+  auto owned = std::make_unique<FakeUnitBus>(std::stoi(argv[1]));
+  FakeUnitBus *bus = owned.get();
+  ServiceWatcher::setChangeListener([](const std::string &unit) {
+    std::lock_guard<std::mutex> lock(changesMutex);
+    changes[unit]++;
+  });
+  if (!ServiceWatcher::start(std::move(owned)))
+    return 1;
+
+  std::string line;
+  while (std::getline(std::cin, line)) {
+    std::istringstream words(line);
+    std::string request, unit, arg, arg2;
+    words >> request >> unit >> arg >> arg2;
+    if (request == "state") {
+      bus->setState(unit, arg, arg2);
+      std::cout << "ok" << std::endl;
+    } else if (request == "props") {
+      bus->signalProperties(unit, arg);
+      std::cout << "ok" << std::endl;
+    } else if (request == "files") {
+      bus->signalUnitFiles(unit, arg);
+      std::cout << "ok" << std::endl;
+    } else if (request == "job") {
+      bus->setJobResult(unit, arg);
+      std::cout << "ok" << std::endl;
+    } else if (request == "active" || request == "enabled") {
+      bool value = false;
+      bool known = request == "active"
+                       ? ServiceWatcher::isActive(unit, value)
+                       : ServiceWatcher::isEnabled(unit, value);
+      std::cout << (known ? (value ? "1" : "0") : "-") << std::endl;
+    } else if (request == "control" && ACTIONS.count(unit)) {
+      bool ok = false;
+      ServiceWatcher::control(ACTIONS.at(unit), arg, ok);
+      std::cout << (ok ? 1 : 0) << std::endl;
+    } else if (request == "changes") {
+      std::lock_guard<std::mutex> lock(changesMutex);
+      std::cout << changes[unit] << std::endl;
+    } else {
+      std::cout << "?" << std::endl;
+    }
+  }
+  ServiceWatcher::stop();
+  return 0;
+}
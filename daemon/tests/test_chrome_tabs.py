@@ -0,0 +1,238 @@
+#!/usr/bin/env python3
+# Test ChromeTabs' websocket client against a fake DevTools server on
+# localhost: the handshake with a frame right behind the 101 response,
+# fragmented messages with a ping between the fragments, 16 and 64 bit
+# lengths, a frame arriving a byte at a time, and the close handshake.
+#
+# Builds chrome_tabs_driver from src/ChromeTabs.cpp; no daemon or Chrome
+# needed. Extra compiler flags (say, -I for nlohmann/json) come from CXXFLAGS.
+import base64
+import hashlib
+import json
+import os
+import shlex
+import socket
+import struct
+import subprocess
+import sys
+import tempfile
+import threading
+import time
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+DAEMON = os.path.dirname(HERE)
+WS_GUID = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11"
+
+failures = []
+
+
+def check(name, ok, detail=""):
+    print(("PASS " if ok else "FAIL ") + name + (f": {detail}" if detail and not ok else ""))
+    if not ok:
+        failures.append(name)
+
+
+def frame(opcode, payload, fin=True):
+    head = bytes([(0x80 if fin else 0) | opcode])
+    size = len(payload)
+    if size < 126:
+        head += bytes([size])
+    elif size < 65536:
+        head += bytes([126]) + struct.pack(">H", size)
+    else:
+        head += bytes([127]) + struct.pack(">Q", size)
+    return head + payload
+
+
+def read_exact(conn, size):
+    data = b""
+    while len(data) < size:
+        chunk = conn.recv(size - len(data))
+        if not chunk:
+            raise ConnectionError("client closed")
+        data += chunk
+    return data
+
+
+# A client frame: (opcode, payload, was it masked)
+def read_frame(conn):
+    b0, b1 = read_exact(conn, 2)
+    size = b1 & 0x7F
+    if size == 126:
+        size = struct.unpack(">H", read_exact(conn, 2))[0]
+    elif size == 127:
+        size = struct.unpack(">Q", read_exact(conn, 8))[0]
+    mask = read_exact(conn, 4) if b1 & 0x80 else None
+    payload = read_exact(conn, size)
+    if mask:
+        payload = bytes(c ^ mask[i % 4] for i, c in enumerate(payload))
+    return b0 & 0x0F, payload, mask is not None
+
+
+# The client's answer to a control frame; opcode None when it never came
+def reply_frame(conn):
+    try:
+        return read_frame(conn)
+    except (OSError, ConnectionError):
+        return None, b"", False
+
+
+def target_event(method, target_id, title, url):
+    info = {"targetId": target_id, "type": "page", "title": title, "url": url}
+    return json.dumps({"method": method, "params": {"targetInfo": info}}).encode()
+
+
+class FakeDevTools:
+    def __init__(self):
+        self.listener = socket.socket()
+        self.listener.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+        self.listener.bind(("127.0.0.1", 0))
+        self.listener.listen(8)
+        self.port = self.listener.getsockname()[1]
+        self.serving = True  # Off after the close test, so no reconnect
+        self.websocket = None
+        self.ready = threading.Event()
+        threading.Thread(target=self.accept_loop, daemon=True).start()
+
+    def accept_loop(self):
+        while True:
+            conn, _ = self.listener.accept()
+            request = b""
+            while b"\r\n\r\n" not in request:
+                chunk = conn.recv(4096)
+                if not chunk:
+                    break
+                request += chunk
+            head = request.decode(errors="replace")
+            if "Upgrade: websocket" in head and self.serving:
+                self.upgrade(conn, head)
+            elif head.startswith("GET /json/version") and self.serving:
+                body = json.dumps({"webSocketDebuggerUrl":
+                                   f"ws://localhost:{self.port}/devtools/browser/fake"})
+                conn.sendall(("HTTP/1.1 200 OK\r\nContent-Type: application/json\r\n"
+                              f"Content-Length: {len(body)}\r\n\r\n{body}").encode())
+                conn.close()
+            else:
+                conn.sendall(b"HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\n\r\n")
+                conn.close()
+
+    def upgrade(self, conn, head):
+        check("handshake path", head.startswith("GET /devtools/browser/fake "), head.splitlines()[0])
+        key = ""
+        for line in head.split("\r\n"):
+            if line.lower().startswith("sec-websocket-key:"):
+                key = line.split(":", 1)[1].strip()
+        check("handshake key", len(base64.b64decode(key)) == 16, key)
+        accept = base64.b64encode(hashlib.sha1((key + WS_GUID).encode()).digest()).decode()
+        # The first event rides in the same segment as the 101
+        first = frame(0x1, target_event("Target.targetCreated", "A", "Alpha", "https://a.example/"))
+        conn.sendall(("HTTP/1.1 101 Switching Protocols\r\nUpgrade: websocket\r\n"
+                      f"Connection: Upgrade\r\nSec-WebSocket-Accept: {accept}\r\n\r\n").encode() + first)
+        opcode, payload, masked = read_frame(conn)
+        check("subscribe frame masked", masked)
+        check("subscribe sent", opcode == 0x1 and
+              json.loads(payload).get("method") == "Target.setDiscoverTargets", payload[:80])
+        conn.settimeout(3)  # A missing reply fails its check instead of hanging
+        self.websocket = conn
+        self.ready.set()
+
+
+class Driver:
+    def __init__(self, binary, port):
+        self.proc = subprocess.Popen([binary, str(port)], stdin=subprocess.PIPE,
+                                     stdout=subprocess.PIPE, stderr=subprocess.DEVNULL,
+                                     text=True, bufsize=1)
+
+    def ask(self, query):
+        self.proc.stdin.write(query + "\n")
+        return self.proc.stdout.readline().strip()
+
+    # Poll until the answer is expected, ChromeTabs applies events on its thread
+    def wait_for(self, query, expected, timeout=3.0):
+        deadline = time.time() + timeout
+        answer = self.ask(query)
+        while answer != expected and time.time() < deadline:
+            time.sleep(0.05)
+            answer = self.ask(query)
+        return answer
+
+    def stop(self):
+        self.proc.stdin.close()
+        self.proc.wait(timeout=5)
+
+
+def build_driver(out_dir):
+    binary = os.path.join(out_dir, "chrome_tabs_driver")
+    cmd = ["g++", "-std=c++17", "-I" + os.path.join(DAEMON, "include"),
+           *shlex.split(os.environ.get("CXXFLAGS", "")),
+           os.path.join(HERE, "chrome_tabs_driver.cpp"),
+           os.path.join(DAEMON, "src", "ChromeTabs.cpp"), "-lpthread", "-o", binary]
+    subprocess.run(cmd, check=True)
+    return binary
+
+
+def main():
+    server = FakeDevTools()
+    with tempfile.TemporaryDirectory() as tmp:
+        driver = Driver(build_driver(tmp), server.port)
+        try:
+            check("connected", server.ready.wait(5) and driver.wait_for("connected", "1") == "1")
+            ws = server.websocket
+
+            check("frame behind the 101 response",
+                  driver.wait_for("url Alpha", "https://a.example/") == "https://a.example/")
+
+            # Fragmented, with a ping between the fragments
+            message = target_event("Target.targetCreated", "B", "Beta", "https://b.example/")
+            third = len(message) // 3
+            ws.sendall(frame(0x1, message[:third], fin=False))
+            ws.sendall(frame(0x9, b"hb"))
+            ws.sendall(frame(0x0, message[third:2 * third], fin=False))
+            ws.sendall(frame(0x0, message[2 * third:]))
+            opcode, payload, masked = reply_frame(ws)
+            check("pong answers ping", opcode == 0xA and payload == b"hb" and masked,
+                  f"opcode={opcode} payload={payload!r}")
+            check("fragmented message",
+                  driver.wait_for("url Beta", "https://b.example/") == "https://b.example/")
+
+            # 16 bit length
+            title = "Gamma " + "g" * 300
+            message = target_event("Target.targetCreated", "C", title, "https://c.example/")
+            ws.sendall(frame(0x1, message))
+            check("126 length",
+                  driver.wait_for("url " + title, "https://c.example/") == "https://c.example/")
+
+            # 64 bit length
+            url = "https://d.example/?" + "d" * 70000
+            message = target_event("Target.targetCreated", "D", "Delta", url)
+            ws.sendall(frame(0x1, message))
+            check("127 length", driver.wait_for("url Delta", url) == url)
+
+            # A frame trickling in a byte at a time
+            message = target_event("Target.targetInfoChanged", "B", "Beta", "https://b2.example/")
+            for byte in frame(0x1, message):
+                ws.sendall(bytes([byte]))
+                time.sleep(0.002)
+            check("frame split across reads",
+                  driver.wait_for("url Beta", "https://b2.example/") == "https://b2.example/")
+
+            # Window titles carry the browser name
+            check("window title suffix",
+                  driver.ask("url Alpha - Google Chrome") == "https://a.example/")
+
+            # Close handshake; refuse reconnects so the map stays down
+            server.serving = False
+            ws.sendall(frame(0x8, b""))
+            opcode, _, masked = reply_frame(ws)
+            check("close answered", opcode == 0x8 and masked, f"opcode={opcode}")
+            check("disconnected after close", driver.wait_for("connected", "0") == "0")
+            check("no lookups while down", driver.ask("url Alpha") == "-")
+        finally:
+            driver.stop()
+
+    print(f"{len(failures)} failed" if failures else "All ChromeTabs tests passed")
+    return 1 if failures else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
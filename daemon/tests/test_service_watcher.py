@@ -0,0 +1,120 @@
+#!/usr/bin/env python3
+# Test ServiceWatcher against a fake UnitBus: the unit table following
+# PropertiesChanged and UnitFilesChanged, queries answered from memory,
+# control() finishing on JobRemoved, and a job that never ends timing out.
+#
+# Builds service_watcher_driver from src/ServiceWatcher.cpp; no systemd or
+# D-Bus needed. Extra compiler flags come from CXXFLAGS.
+import os
+import shlex
+import subprocess
+import sys
+import tempfile
+import time
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+DAEMON = os.path.dirname(HERE)
+JOB_TIMEOUT_MS = 300
+
+failures = []
+
+
+def check(name, ok, detail=""):
+    print(("PASS " if ok else "FAIL ") + name + (f": {detail}" if detail and not ok else ""))
+    if not ok:
+        failures.append(name)
+
+
+class Driver:
+    def __init__(self, binary):
+        self.proc = subprocess.Popen([binary, str(JOB_TIMEOUT_MS)], stdin=subprocess.PIPE,
+                                     stdout=subprocess.PIPE, stderr=subprocess.DEVNULL,
+                                     text=True, bufsize=1)
+
+    def ask(self, request):
+        self.proc.stdin.write(request + "\n")
+        return self.proc.stdout.readline().strip()
+
+    # Poll until the answer is expected, signals arrive on the watcher thread
+    def wait_for(self, request, expected, timeout=3.0):
+        deadline = time.time() + timeout
+        answer = self.ask(request)
+        while answer != expected and time.time() < deadline:
+            time.sleep(0.02)
+            answer = self.ask(request)
+        return answer
+
+    def stop(self):
+        self.proc.stdin.close()
+        self.proc.wait(timeout=5)
+
+
+def build_driver(out_dir):
+    binary = os.path.join(out_dir, "service_watcher_driver")
+    cmd = ["g++", "-std=c++17", "-I" + os.path.join(DAEMON, "include"),
+           *shlex.split(os.environ.get("CXXFLAGS", "")),
+           os.path.join(HERE, "service_watcher_driver.cpp"),
+           os.path.join(DAEMON, "src", "ServiceWatcher.cpp"), "-lpthread", "-o", binary]
+    subprocess.run(cmd, check=True)
+    return binary
+
+
+def main():
+    with tempfile.TemporaryDirectory() as tmp:
+        d = Driver(build_driver(tmp))
+        try:
+            unit = "cad-dev.service"
+            d.ask(f"state {unit} active enabled")
+            check("first query watches the unit", d.ask("active cad-dev") == "1")
+            check("enabled", d.ask("enabled cad-dev") == "1")
+            check("unknown unit is inactive", d.ask("active missing") == "0")
+            seen = int(d.ask(f"changes {unit}"))
+
+            # Later queries are memory reads: a change without a signal is unseen
+            d.ask(f"state {unit} inactive enabled")
+            check("served from memory", d.ask("active cad-dev") == "1")
+
+            d.ask(f"props {unit} inactive")
+            check("PropertiesChanged", d.wait_for("active cad-dev", "0") == "0")
+            check("listener told once", d.wait_for(f"changes {unit}", str(seen + 1)) == str(seen + 1))
+
+            d.ask(f"props {unit} inactive")
+            d.ask(f"props {unit} active")  # Delivered after the repeat
+            d.wait_for("active cad-dev.service", "1")
+            answer = d.ask(f"changes {unit}")
+            check("repeat state not reported", answer == str(seen + 2), answer)
+
+            d.ask(f"files {unit} disabled")
+            check("UnitFilesChanged", d.wait_for("enabled cad-dev", "0") == "0")
+
+            # control() returns once JobRemoved for its job came in
+            d.ask(f"job {unit} done")
+            check("start job done", d.ask("control start cad-dev") == "1")
+            check("state after start", d.ask("active cad-dev") == "1")
+            d.ask(f"job {unit} failed")
+            check("failed job reported", d.ask("control restart cad-dev") == "0")
+            check("state after failed job", d.ask("active cad-dev") == "0")
+            check("reset-failed", d.ask("control reset-failed cad-dev") == "1")
+            check("enable", d.ask("control enable cad-dev") == "1")
+            check("enabled after enable", d.wait_for("enabled cad-dev", "1") == "1")
+
+            # No JobRemoved: control() gives up after the job timeout
+            d.ask(f"job {unit} hang")
+            start = time.time()
+            answer = d.ask("control stop cad-dev")
+            elapsed = (time.time() - start) * 1000
+            check("hung job fails", answer == "0", answer)
+            check("hung job times out", JOB_TIMEOUT_MS * 0.9 <= elapsed < JOB_TIMEOUT_MS + 2000,
+                  f"{elapsed:.0f} ms")
+            d.ask(f"props {unit} inactive")
+            check("signals after a timeout", d.wait_for("active cad-dev", "0") == "0")
+            check("next job after a timeout", d.ask("control start cad-dev") == "1")
+        finally:
+            d.stop()
+
+    print(f"{len(failures)} failed" if failures else "All ServiceWatcher tests passed")
+    return 1 if failures else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
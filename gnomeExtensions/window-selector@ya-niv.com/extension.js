@@ -96,6 +96,12 @@ class PersistentDaemonConnector {
         }
     }
 
+    // Replies echo the request's id so the daemon can match them up
+    _reply(msg, payload) {
+        if (msg.requestId !== undefined) payload.requestId = msg.requestId;
+        this.outputStream.put_string(JSON.stringify(payload) + '\n', null);
+    }
+
     async _handleMessage(line) {
         this.logger.log(`Received from daemon: ${line}`);
         try {
@@ -108,8 +114,7 @@ class PersistentDaemonConnector {
                     wm_class: w.get_wm_class(),
                     workspace: w.get_workspace().index()
                 }));
-                const response = JSON.stringify(winList) + '\n';
-                this.outputStream.put_string(response, null);
+                this._reply(msg, { result: winList });
             } else if (msg.action === 'activateWindow') {
                 const winId = parseInt(msg.windowId);
                 const windows = global.display.get_tab_list(Meta.TabList.NORMAL, null);
@@ -123,8 +128,7 @@ class PersistentDaemonConnector {
                     result = "activated";
                 }
 
-                const response = JSON.stringify({ status: result, id: winId }) + '\n';
-                this.outputStream.put_string(response, null);
+                this._reply(msg, { status: result, id: winId });
             }
         } catch (e) {
             this.logger.log(`Error handling message: ${e.message}`);
@@ -8,7 +8,7 @@ _daemon_completion() {
     
     # Function to get daemon commands (excluding the `send` itself)
     get_daemon_commands() {
-        echo "(openedTty) (closedTty) (updateDirHistory) (cdForward) (cdBackward) showTerminalInstance showAllTerminalInstances deleteEntry showEntriesByPrefix deleteEntriesByPrefix showDB printDirHistory upsertEntry getEntry ping getKeyboardPath getMousePath getSocketPath setKeyboard enableKeyboard disableKeyboard getKeyboard getKeyboardEnabled shouldLog toggleKeyboard getDir getFile (activeWindowChanged) help quit simulateInput addLogFilter removeLogFilter listLogFilters clearLogFilters emptyDirHistoryTable publicTransportationStartProxy publicTransportationOpenApp listWindows activateWindow listPorts deletePort getPort setPort listCommands setPeerConfig getPeerStatus listPeers getPeerInfo execOnPeer remotePull remoteBd remoteDeployDaemon dbSanityCheck registerWorker setupWireGuardPeer listWireGuardPeers getWireGuardIp startApp stopApp restartApp appStatus listApps buildApp installAppDeps addExtraApp version"
+        echo "(openedTty) (closedTty) (updateDirHistory) (cdForward) (cdBackward) cdJump showTerminalInstance notifyStats serviceStats startupTrace showAllTerminalInstances deleteEntry showEntriesByPrefix deleteEntriesByPrefix showDB printDirHistory upsertEntry getEntry ping getKeyboardPath getMousePath getSocketPath setKeyboard enableKeyboard disableKeyboard getKeyboard getKeyboardEnabled shouldLog toggleKeyboard getDir getFile (activeWindowChanged) help quit simulateInput addLogFilter removeLogFilter listLogFilters clearLogFilters emptyDirHistoryTable publicTransportationStartProxy publicTransportationOpenApp listWindows activateWindow getWindowRules setWindowRules listPorts deletePort getPort setPort listCommands setPeerConfig getPeerStatus listPeers getPeerInfo execOnPeer execOnPeers remotePull remoteBd remoteDeployDaemon listArtifacts dbSanityCheck registerWorker setupWireGuardPeer listWireGuardPeers getWireGuardIp startApp stopApp restartApp appStatus listApps buildApp installAppDeps addExtraApp deployToProd rollbackProd prodStatus version"
     }
 
     # Function to get peer IDs dynamically from daemon
@@ -54,6 +54,7 @@ _daemon_completion() {
     command_args[(updateDirHistory)]="--tty --pwd"
     command_args[(cdForward)]="--tty"
     command_args[(cdBackward)]="--tty"
+    command_args[cdJump]="--query --pwd"
     command_args[showTerminalInstance]="--tty"
     command_args[deleteEntry]="--key"
     command_args[showEntriesByPrefix]="--prefix"
@@ -82,10 +83,12 @@ _daemon_completion() {
     command_args[publicTransportationOpenApp]=""
     command_args[listWindows]=""
     command_args[activateWindow]="--windowId"
+    command_args[getWindowRules]=""
+    command_args[setWindowRules]="--value"
     command_args[listPorts]=""
     command_args[deletePort]="--key"
     command_args[getPort]="--key"
-    command_args[setPort]="--key --value"
+    command_args[setPort]="--key --value --app"
 
     # Peer networking commands
     command_args[setPeerConfig]="--role --id --leader"
@@ -95,9 +98,11 @@ _daemon_completion() {
 
     # Peer exec commands
     command_args[execOnPeer]="--peer --directory --shellCmd"
+    command_args[execOnPeers]="--peers --directory --shellCmd --timeout"
     command_args[remotePull]="--peer"
     command_args[remoteBd]="--peer"
     command_args[remoteDeployDaemon]="--peer"
+    command_args[listArtifacts]=""
     command_args[dbSanityCheck]=""
     command_args[registerWorker]=""
 
@@ -110,6 +115,9 @@ _daemon_completion() {
     command_args[buildApp]="--app --mode --component"
     command_args[installAppDeps]="--app --component"
     command_args[addExtraApp]="--repoUrl"
+    command_args[deployToProd]="--app --commit"
+    command_args[rollbackProd]="--app"
+    command_args[prodStatus]="--app"
 
     # WireGuard setup commands
     command_args[setupWireGuardPeer]="--host --name --vpnIp --mac --dualBoot --privateKey"
@@ -140,6 +148,7 @@ _daemon_completion() {
     arg_values[--id]="" # Custom peer ID
     arg_values[--leader]="" # Leader IP address
     arg_values[--peer]="DYNAMIC_PEERS" # Peer ID - will be resolved dynamically
+    arg_values[--peers]="DYNAMIC_PEERS" # Comma separated peer IDs, or all
     arg_values[--directory]="" # Directory path for exec
     arg_values[--shellCmd]="" # Shell command to execute
 
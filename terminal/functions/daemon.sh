@@ -1,5 +1,5 @@
 daemon() {
-    if [[ "$1" == "send" || "$1" == "daemon" || "$1" == "--help" ]]; then
+    if [[ "$1" == "send" || "$1" == "notify" || "$1" == "daemon" || "$1" == "--help" ]]; then
         command daemon "$@"
     else
         command daemon send "$@"
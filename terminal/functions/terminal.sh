@@ -35,6 +35,12 @@ cd () {
 }
 export -f cd
 
+# jump to the most frecent history directory matching all terms: jd proj src
+jd() {
+    $(daemon send cdJump --query "$*" --pwd "$PWD")
+}
+export -f jd
+
 outputToSelf(){
     exec 1>/dev/pts/$(tty | sed 's:/dev/pts/::')
 }
@@ -1 +1 @@
-daemon closedTty
+daemon notify closedTty --tty "$AUTOMATE_LINUX_TTY_NUMBER"
@@ -1,10 +1,14 @@
 import socket
 import json
+import hashlib
+import platform
 import subprocess
 import os
+import select
 import threading
 import signal
 import sys
+import time
 
 PORT = 3505
 BASE_DIR = "/opt/automateLinux"
@@ -12,6 +16,9 @@ UDS_PATH = "/run/automatelinux/automatelinux-daemon.sock"
 SERVICES_DIR = os.path.join(BASE_DIR, "services/system")
 GENERATED_DIR = os.path.join(SERVICES_DIR, "generated")
 SYSTEM_DIR = "/etc/systemd/system"
+# A kept-alive connection waits this long for the next request; the daemon
+# drops its pooled connections sooner (ManagerPool::IDLE_SECS)
+IDLE_TIMEOUT = 120
 
 def log(msg):
     print(f"[Manager] {msg}")
@@ -27,11 +34,61 @@ def run_command(cmd, cwd=BASE_DIR, timeout=300):
     except Exception as e:
         return 1, str(e)
 
-def send_to_daemon(command_obj):
+def send_frame(conn, data):
+    """Send one output frame: a length header line, then the bytes."""
+    payload = data.encode() if isinstance(data, str) else data
+    header = json.dumps({"stream": "output", "length": len(payload)})
+    conn.sendall(header.encode() + b"\n" + payload)
+
+def send_end(conn, status, keep_alive=False):
+    """Send the final frame; keep_alive offers the connection for reuse."""
+    end = {"stream": "end", "status": status}
+    if keep_alive:
+        end["keep_alive"] = True
+    conn.sendall(json.dumps(end).encode() + b"\n")
+
+def reply(conn, request, result):
+    """Send a handler result, as frames when the daemon asked to stream."""
+    if request.get("stream"):
+        if result.get("output"):
+            send_frame(conn, result["output"])
+        send_end(conn, result.get("status", 1), request.get("keep_alive", False))
+    else:
+        conn.sendall(json.dumps(result).encode() + b"\n")
+
+def stream_command(cmd, conn, cwd=BASE_DIR, timeout=300):
+    """Run cmd, forwarding its output as frames while it runs."""
+    log(f"Streaming: {cmd} in {cwd}")
+    proc = subprocess.Popen(cmd, shell=True, cwd=cwd, stdout=subprocess.PIPE,
+                            stderr=subprocess.STDOUT)
+    deadline = time.monotonic() + timeout
+    try:
+        while True:
+            remaining = deadline - time.monotonic()
+            if remaining <= 0:
+                proc.kill()
+                proc.wait()
+                send_frame(conn, f"\nCommand timed out after {timeout}s\n")
+                return 124
+            ready, _, _ = select.select([proc.stdout], [], [], remaining)
+            if not ready:
+                continue
+            data = os.read(proc.stdout.fileno(), 4096)
+            if not data:
+                break
+            send_frame(conn, data)
+    except OSError:
+        # The daemon hung up; don't leave the command running for nobody
+        proc.kill()
+        proc.wait()
+        raise
+    return proc.wait()
+
+def send_to_daemon(command_obj, timeout=10):
     """Send a command to the local daemon via Unix socket."""
     try:
         sock = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
-        sock.settimeout(10)
+        sock.settimeout(timeout)
         sock.connect(UDS_PATH)
         msg = json.dumps(command_obj) + "\n"
         sock.sendall(msg.encode())
@@ -216,7 +273,8 @@ def handle_install_app(request):
 
     # 6. Set ports on local daemon
     for port_key, port_val in ports.items():
-        resp = send_to_daemon({"command": "setPort", "key": port_key, "value": str(port_val)})
+        resp = send_to_daemon({"command": "setPort", "key": port_key,
+                               "value": str(port_val), "app": app_id})
         steps.append({"step": f"setPort {port_key}={port_val}", "status": 0 if resp else 1, "output": resp or "failed"})
 
     # 7. Fix permissions
@@ -271,10 +329,13 @@ def handle_uninstall_app(request):
                 os.remove(svc_file)
     steps.append({"step": "stop+disable services", "status": 0, "output": ", ".join(service_names)})
 
-    # 2. Remove prod worktree
-    if prod_path and os.path.isdir(prod_path):
-        code, out = run_command(f"git -C {dev_path} worktree remove {prod_path} --force 2>/dev/null; rm -rf {prod_path}")
-        steps.append({"step": "remove prod worktree", "status": 0, "output": out.strip()})
+    # 2. Remove prod worktree (a link to the .blue/.green slots once deployed)
+    if prod_path and os.path.islink(prod_path):
+        os.remove(prod_path)
+    for path in [prod_path, f"{prod_path}.blue", f"{prod_path}.green"]:
+        if prod_path and os.path.isdir(path):
+            code, out = run_command(f"git -C {dev_path} worktree remove {path} --force 2>/dev/null; rm -rf {path}")
+            steps.append({"step": "remove prod worktree", "status": 0, "output": out.strip()})
 
     # 3. Remove dev directory
     if os.path.isdir(dev_path):
@@ -321,77 +382,163 @@ def handle_app_control(request):
 
     return {"status": 0, "output": resp}
 
-def handle_client(conn, addr):
-    log(f"Connection from {addr}")
+def fetch_artifact(conn, artifact):
+    """Get the daemon binary the deploying peer built for this commit.
+    Returns its path, or None after telling the caller why to build here."""
+    commit = artifact.get("commit", "")
+    _, head = run_command("git rev-parse HEAD")
+    if head.strip() != commit:
+        send_frame(conn, f"Checkout is at {head.strip()[:12]}, artifact is {commit[:12]}; building locally\n")
+        return None
+    if platform.machine() != artifact.get("arch"):
+        send_frame(conn, f"Artifact is for {artifact.get('arch')}, this is {platform.machine()}; building locally\n")
+        return None
+
+    sha = artifact.get("sha256", "")
+    fetch = {"command": "fetchArtifact", "sha256": sha,
+             "source": artifact.get("source", ""),
+             "size": artifact.get("size", 0)}
+    if "sourcePort" in artifact:
+        fetch["sourcePort"] = artifact["sourcePort"]
+    resp = send_to_daemon(fetch, timeout=600)
+    path = os.path.join(BASE_DIR, "data", "artifacts", sha)
+    if not os.path.isfile(path):
+        send_frame(conn, f"{resp or 'Daemon did not answer fetchArtifact'}; building locally\n")
+        return None
+    if resp:
+        send_frame(conn, resp + "\n")
+
+    # The daemon verified it; check again here, this is what gets installed
+    digest = hashlib.sha256()
+    with open(path, "rb") as f:
+        for block in iter(lambda: f.read(1 << 20), b""):
+            digest.update(block)
+    if digest.hexdigest() != sha:
+        send_frame(conn, "Artifact hash mismatch; building locally\n")
+        return None
+    code, out = run_command(f"ldd {path}")
+    missing = [line.strip() for line in out.splitlines() if "not found" in line]
+    if code != 0 or missing:
+        send_frame(conn, "Missing libraries: " + ", ".join(missing or [out.strip()]) + "; building locally\n")
+        return None
+    return path
+
+def read_request(conn, buffer):
+    """Read one request line. Returns (line, rest), line None at EOF or idle."""
+    conn.settimeout(IDLE_TIMEOUT)
     try:
-        # Read potentially large messages
-        data = b""
-        while True:
+        while b"\n" not in buffer:
             chunk = conn.recv(8192)
             if not chunk:
                 break
-            data += chunk
-            if data.endswith(b"\n"):
-                break
-        data = data.decode('utf-8')
-        if not data:
-            return
-
-        try:
-            request = json.loads(data)
-        except json.JSONDecodeError:
-            conn.sendall(b"Invalid JSON\n")
+            buffer += chunk
+    except socket.timeout:
+        return None, b""
+    finally:
+        conn.settimeout(None)
+    if not buffer:
+        return None, b""
+    line, _, rest = buffer.partition(b"\n")
+    return line, rest
+
+def handle_request(conn, request):
+    command = request.get("command")
+    log(f"Received command: {command}")
+    keep_alive = request.get("keep_alive", False)
+
+    if command == "deploy" and request.get("stream"):
+        send_frame(conn, "Pull:\n")
+        code = stream_command("git pull", conn)
+        if code == 0:
+            prebuilt = None
+            if request.get("artifact"):
+                send_frame(conn, "\nArtifact:\n")
+                prebuilt = fetch_artifact(conn, request["artifact"])
+            if prebuilt:
+                send_frame(conn, "\nInstall:\n")
+                code = stream_command(f"PREBUILT={prebuilt} bash -c 'cd daemon && source ./build.sh'", conn)
+            else:
+                send_frame(conn, "\nBuild:\n")
+                code = stream_command("bash -c 'cd daemon && source ./build.sh'", conn)
+        send_end(conn, code, keep_alive)
+
+    elif command == "deploy":
+        # 1. Pull
+        code, out1 = run_command("git pull")
+        if code != 0:
+            conn.sendall(json.dumps({"status": code, "output": f"Pull failed:\n{out1}"}).encode() + b"\n")
             return
 
-        command = request.get("command")
-        log(f"Received command: {command}")
-
-        if command == "deploy":
-            # 1. Pull
-            code, out1 = run_command("git pull")
-            if code != 0:
-                conn.sendall(json.dumps({"status": code, "output": f"Pull failed:\n{out1}"}).encode() + b"\n")
-                return
-
-            # 2. Build and Restart
-            code, out2 = run_command("bash -c 'cd daemon && source ./build.sh'")
+        # 2. Build and Restart
+        code, out2 = run_command("bash -c 'cd daemon && source ./build.sh'")
+
+        conn.sendall(json.dumps({"status": code, "output": f"Pull:\n{out1}\n\nBuild:\n{out2}"}).encode() + b"\n")
+
+    elif command == "restart-daemon":
+        code, out = run_command("sudo systemctl restart daemon.service")
+        reply(conn, request, {"status": code, "output": out})
+
+    elif command == "status":
+        code1, out1 = run_command("systemctl is-active daemon.service")
+        code2, out2 = run_command("git rev-list --count HEAD")
+        status = {
+            "daemon_active": out1.strip() == "active",
+            "version": out2.strip(),
+            "status": 0
+        }
+        if request.get("stream"):
+            send_frame(conn, json.dumps(status) + "\n")
+            send_end(conn, 0, keep_alive)
+        else:
+            conn.sendall(json.dumps(status).encode() + b"\n")
 
-            conn.sendall(json.dumps({"status": code, "output": f"Pull:\n{out1}\n\nBuild:\n{out2}"}).encode() + b"\n")
+    elif command == "install-app":
+        result = handle_install_app(request)
+        reply(conn, request, result)
 
-        elif command == "restart-daemon":
-            code, out = run_command("sudo systemctl restart daemon.service")
-            conn.sendall(json.dumps({"status": code, "output": out}).encode() + b"\n")
+    elif command == "uninstall-app":
+        result = handle_uninstall_app(request)
+        reply(conn, request, result)
 
-        elif command == "status":
-            code1, out1 = run_command("systemctl is-active daemon.service")
-            code2, out2 = run_command("git rev-list --count HEAD")
-            conn.sendall(json.dumps({
-                "daemon_active": out1.strip() == "active",
-                "version": out2.strip(),
-                "status": 0
-            }).encode() + b"\n")
+    elif command == "app-control":
+        result = handle_app_control(request)
+        reply(conn, request, result)
 
-        elif command == "install-app":
-            result = handle_install_app(request)
-            conn.sendall(json.dumps(result).encode() + b"\n")
+    else:
+        reply(conn, request, {"status": 1, "output": "Unknown command\n", "error": "Unknown command"})
 
-        elif command == "uninstall-app":
-            result = handle_uninstall_app(request)
-            conn.sendall(json.dumps(result).encode() + b"\n")
+def handle_client(conn, addr):
+    """Serve requests on one connection. Framed requests that ask for
+    keep_alive leave it open for the next one, until IDLE_TIMEOUT."""
+    log(f"Connection from {addr}")
+    buffer = b""
+    try:
+        while True:
+            line, buffer = read_request(conn, buffer)
+            if line is None:
+                return
 
-        elif command == "app-control":
-            result = handle_app_control(request)
-            conn.sendall(json.dumps(result).encode() + b"\n")
+            request = {}
+            try:
+                request = json.loads(line.decode('utf-8'))
+            except (json.JSONDecodeError, UnicodeDecodeError):
+                conn.sendall(b"Invalid JSON\n")
+                return
 
-        else:
-            conn.sendall(json.dumps({"status": 1, "error": "Unknown command"}).encode() + b"\n")
+            try:
+                handle_request(conn, request)
+            except Exception as e:
+                log(f"Error handling client: {e}")
+                try:
+                    # Mid-reply state is unknown: answer, then close
+                    reply(conn, dict(request, keep_alive=False),
+                          {"status": 1, "output": f"Manager error: {str(e)}\n"})
+                except:
+                    pass
+                return
 
-    except Exception as e:
-        log(f"Error handling client: {e}")
-        try:
-            conn.sendall(json.dumps({"status": 1, "output": f"Manager error: {str(e)}\n"}).encode() + b"\n")
-        except:
-            pass
+            if not (request.get("keep_alive") and request.get("stream")):
+                return
     finally:
         conn.close()
 